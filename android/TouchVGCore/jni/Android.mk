@@ -30,6 +30,7 @@ core_src   := ../../../core/src
 geom_files := $(core_src)/geom/mgbase.cpp \
               $(core_src)/geom/mgbox.cpp \
               $(core_src)/geom/mgcurv.cpp \
+              $(core_src)/geom/mgcurvfit.cpp \
               $(core_src)/geom/mglnrel.cpp \
               $(core_src)/geom/mgmat.cpp \
               $(core_src)/geom/mgnear.cpp \
@@ -41,7 +42,9 @@ geom_files := $(core_src)/geom/mgbase.cpp \
               $(core_src)/geom/nanosvg.cpp
 
 graph_files := $(core_src)/graph/gigraph.cpp \
-              $(core_src)/graph/gixform.cpp
+              $(core_src)/graph/gixform.cpp \
+              $(core_src)/graph/giimagereg.cpp \
+              $(core_src)/graph/gistyletable.cpp
 
 json_files := $(core_src)/jsonstorage/mgjsonstorage.cpp
 
@@ -69,6 +72,9 @@ shape_files := $(core_src)/shape/mgcomposite.cpp \
 
 doc_files  := $(core_src)/shapedoc/mgshapedoc.cpp \
               $(core_src)/shapedoc/mglayer.cpp \
+              $(core_src)/shapedoc/mgdocpager.cpp \
+              $(core_src)/shapedoc/mgdocpatch.cpp \
+              $(core_src)/shapedoc/mgdocjournal.cpp \
               $(core_src)/shapedoc/spfactoryimpl.cpp
 
 test_files := $(core_src)/test/testcanvas.cpp \
@@ -102,10 +108,14 @@ mgr_files  := $(core_src)/cmdmgr/cmdsubject.cpp \
 
 view_files := $(core_src)/view/GcGraphView.cpp \
               $(core_src)/view/GcMagnifierView.cpp \
+              $(core_src)/view/GcRenderCache.cpp \
+              $(core_src)/view/GcFrameScheduler.cpp \
+              $(core_src)/view/GcRenderService.cpp \
               $(core_src)/view/GcShapeDoc.cpp \
               $(core_src)/view/gicoreview.cpp \
               $(core_src)/view/gicorerecord.cpp \
               $(core_src)/export/svgcanvas.cpp \
+              $(core_src)/export/gibuffercanvas.cpp \
               $(core_src)/export/girecordcanvas.cpp \
               $(core_src)/record/recordshapes.cpp
 
@@ -170,6 +170,21 @@ public:
     
     //! Complete to draw a shape.
     virtual void endShape(int type, int sid, float x, float y) {}
+    
+    //! Draw a repeating pattern of dots with the current pen, optional.
+    /*! The dot (i, j) is centered at (x + i * dx, y + j * dy), 0 <= i < nx, 0 <= j < ny.
+        Each dot is a cross (or a similar mark) whose arms are \a size long from the center.
+        \return false if not supported, then the dots will be drawn as a path.
+     */
+    virtual bool drawDots(float x, float y, float dx, float dy, int nx, int ny, float size) { return false; }
+    
+    //! Draw a decoded image whose center will at (xc, yc), optional.
+    /*! \a image is returned by GiImageDecoder::decodeImage() with a pixel size chosen
+        for the display size, and is valid only during this call.
+        \return false if not supported, then the image will be drawn by drawBitmap() with \a name.
+     */
+    virtual bool drawDecodedBitmap(long image, const char* name, float xc, float yc,
+                                   float w, float h, float angle) { return false; }
 };
 
 #endif // TOUCHVG_CORE_GICANVAS_H
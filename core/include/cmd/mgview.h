@@ -6,6 +6,7 @@
 #define TOUCHVG_CMDVIEW_H
 
 #include "mgshapes.h"
+#include "mgvector.h"
 
 class MgMotion;
 struct MgCmdManager;
@@ -81,6 +82,8 @@ struct MgView
     virtual void shapeAdded(MgShape* shape) = 0;                //!< 通知已添加图形，由视图重新构建显示
     virtual bool shapeWillDeleted(const MgShape* shape) = 0;    //!< 通知将删除图形
     virtual int removeShape(const MgShape* shape) = 0;          //!< 删除图形
+    virtual void shapesAdded(const mgvector<int>& ids) = 0;     //!< 通知已批量添加图形，只发出一次通知
+    virtual int removeShapes(const mgvector<int>& ids) = 0;     //!< 批量删除图形，只发出一次通知
     virtual bool shapeCanRotated(const MgShape* shape) = 0;     //!< 通知是否能旋转图形
     virtual bool shapeCanTransform(const MgShape* shape) = 0;   //!< 通知是否能对图形变形
     virtual bool shapeCanUnlock(const MgShape* shape) = 0;      //!< 通知是否能对图形解锁
@@ -44,8 +44,12 @@ protected:
     virtual void setStepPoint(const MgMotion* sender, int step, const Point2d& pt);
     virtual bool isStepPointAccepted(const MgMotion* sender, const Point2d& pt);
     virtual int snapOptionsForStep(const MgMotion* sender, int step) { return -1; }
+    
+    //! 选项 compactStrokes 为true时在 addShape 前压缩手绘笔迹的顶点，默认不压缩(会略微移动顶点)
+    void compactStroke(const MgMotion* sender);
 
 private:
+    MgShape* takeShape(const MgMotion* sender);
     virtual bool isDrawingCommand() { return true; }
     
 public:
@@ -77,6 +81,7 @@ protected:
 private:
     MgShape*    m_shape;
     int         m_flags;
+    int         m_maxPoints;    // 本笔在拟合和压缩前的最大顶点数，供 takeShape() 预留容量
     static Point2d m_lastSnapped[2];
 };
 
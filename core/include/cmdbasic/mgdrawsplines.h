@@ -6,6 +6,7 @@
 #define TOUCHVG_CMD_DRAW_SPLINES_H_
 
 #include "mgcmddraw.h"
+#include "mgcurvfit.h"
 
 //! 样条曲线绘图命令类
 /*! \ingroup CORE_COMMAND
@@ -35,8 +36,11 @@ private:
     
 private:
     bool canAddPoint(const MgMotion* sender, bool ended);
+    void restartFitter(const MgMotion* sender);
     
-    bool    m_freehand;
+    bool            m_freehand;
+    MgCurveFitter   m_fitter;       // 手绘时逐点拟合，显示坐标
+
 };
 
 //! 用点击绘制样条曲线的命令类
@@ -6,10 +6,10 @@
 #define TOUCHVG_CMDOBSERVER_H_
 
 #include "mgvector.h"
+#include "mgview.h"
 
 class MgShape;
 class MgBaseShape;
-class MgMotion;
 class GiGraphics;
 class MgCommand;
 struct MgCmdManager;
@@ -74,6 +74,10 @@ struct CmdObserver {
     virtual void onShapeAdded(const MgMotion* sender, MgShape* sp) = 0;        //!< 通知已添加图形
     virtual bool onShapeWillDeleted(const MgMotion* sender, const MgShape* sp) = 0;  //!< 通知将删除图形
     virtual int onShapeDeleted(const MgMotion* sender, const MgShape* sp) = 0;       //!< 通知已删除图形
+    //! 批量添加图形后的通知，ids 为已添加到文档中的图形ID
+    virtual void onShapesAdded(const MgMotion* sender, const mgvector<int>& ids) = 0;
+    //! 批量删除图形的通知，此时图形仍在文档中，返回附带删除的图形数
+    virtual int onShapesDeleted(const MgMotion* sender, const mgvector<int>& ids) = 0;
     virtual bool onShapeCanRotated(const MgMotion* sender, const MgShape* sp) = 0;   //!< 通知是否能旋转图形
     virtual bool onShapeCanTransform(const MgMotion* sender, const MgShape* sp) = 0; //!< 通知是否能对图形变形
     virtual bool onShapeCanUnlock(const MgMotion* sender, const MgShape* sp) = 0;    //!< 通知是否能对图形解锁
@@ -114,6 +118,28 @@ public:
     virtual void onShapeAdded(const MgMotion* sender, MgShape* sp) {}
     virtual bool onShapeWillDeleted(const MgMotion* sender, const MgShape* sp) { return true; }
     virtual int onShapeDeleted(const MgMotion* sender, const MgShape* sp) { return 0; }
+    
+    //! 默认逐个调用 onShapeAdded()
+    virtual void onShapesAdded(const MgMotion* sender, const mgvector<int>& ids) {
+        for (int i = 0; i < ids.count(); i++) {
+            MgShape* sp = (MgShape*)sender->view->shapes()->findShape(ids.get(i));
+            if (sp) {
+                onShapeAdded(sender, sp);
+            }
+        }
+    }
+    //! 默认逐个调用 onShapeDeleted()
+    virtual int onShapesDeleted(const MgMotion* sender, const mgvector<int>& ids) {
+        int n = 0;
+        for (int i = 0; i < ids.count(); i++) {
+            const MgShape* sp = sender->view->shapes()->findShape(ids.get(i));
+            if (sp) {
+                n += onShapeDeleted(sender, sp);
+            }
+        }
+        return n;
+    }
+    
     virtual bool onShapeCanRotated(const MgMotion* sender, const MgShape* sp) { return true; }
     virtual bool onShapeCanTransform(const MgMotion* sender, const MgShape* sp) { return true; }
     virtual bool onShapeCanUnlock(const MgMotion* sender, const MgShape* sp) { return true; }
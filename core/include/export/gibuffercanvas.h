@@ -0,0 +1,122 @@
+//! \file gibuffercanvas.h
+//! \brief 定义将绘图指令编码到命令缓冲的画布类 GiBufferCanvas
+// Copyright (c) 2004-2015, https://github.com/rhcad/vgcore, BSD License
+
+#ifndef TOUCHVG_CORE_BUFFERCANVAS_H_
+#define TOUCHVG_CORE_BUFFERCANVAS_H_
+
+#include "gicanvas.h"
+#include "mgvector.h"
+#ifndef SWIG
+#include <vector>
+#endif
+
+//! 将绘图指令编码到整数和浮点数命令缓冲的画布类
+/*! 用于Java/C#等宿主：一帧绘图(drawAll/dynDraw)结束后调用 copyInts() 和 copyFloats()
+    一次取出全部指令，避免每个 moveTo/lineTo 都跨语言回调一次。
+
+    整数流以 kMagic|kVersion 和命令数开头，每个命令为操作码及其整数参数，
+    浮点参数按命令顺序存放在浮点流中。连续的 lineTo 或 bezierTo 合并为一个命令，
+    其后的整数为点段数。字符串存为字节数及按小端序每4字节一个整数的UTF-8内容。
+
+    | 操作码 | 整数参数 | 浮点参数 |
+    |--------|----------|----------|
+    | kSetPen | argb, style | width, phase, orgw |
+    | kSetBrush | argb, style | |
+    | kClearRect, kClipRect | | x, y, w, h |
+    | kDrawRect, kDrawEllipse | flags(1:stroke, 2:fill) | x, y, w, h |
+    | kDrawLine | | x1, y1, x2, y2 |
+    | kBeginPath, kClosePath, kSaveClip, kRestoreClip, kClipPath | | |
+    | kMoveTo | | x, y |
+    | kLineTo | n | n*(x, y) |
+    | kBezierTo | n | n*(c1x, c1y, c2x, c2y, x, y) |
+    | kQuadTo | | cpx, cpy, x, y |
+    | kDrawPath | flags | |
+    | kDrawHandle | type | x, y, angle |
+    | kDrawBitmap | name | xc, yc, w, h, angle |
+    | kDrawText | align, text | x, y, h, angle |
+    | kBeginShape | type, sid, version | x, y, w, h |
+    | kEndShape | type, sid | x, y |
+
+    \ingroup CORE_VIEW
+    \see replay
+ */
+class GiBufferCanvas : public GiCanvas
+{
+public:
+    enum {
+        kMagic = 0x56420000,        //!< 'VB'，整数流的第一个数为 kMagic|kVersion
+        kVersion = 1,               //!< 命令格式版本号
+        kSetPen = 1, kSetBrush, kClearRect, kDrawRect, kDrawLine, kDrawEllipse,
+        kBeginPath, kMoveTo, kLineTo, kBezierTo, kQuadTo, kClosePath, kDrawPath,
+        kSaveClip, kRestoreClip, kClipRect, kClipPath,
+        kDrawHandle, kDrawBitmap, kDrawText, kBeginShape, kEndShape,
+    };
+
+    GiBufferCanvas();
+    virtual ~GiBufferCanvas();
+
+    //! 清除命令，开始记录新的一帧
+    void reset();
+
+    int getCommandCount() const;    //!< 返回命令数
+    int getIntCount() const;        //!< 返回整数流的长度
+    int getFloatCount() const;      //!< 返回浮点流的长度
+
+    //! 复制整数流到数组中，返回长度
+    int copyInts(mgvector<int>& arr) const;
+
+    //! 复制浮点流到数组中，返回长度
+    int copyFloats(mgvector<float>& arr) const;
+
+    //! 将记录的命令重放到另一个画布上，返回命令数
+    int replay(GiCanvas* canvas) const;
+
+    //! 将宿主传回的命令缓冲重放到画布上，返回命令数，格式或版本不符则返回-1
+    static int replay(GiCanvas* canvas, const mgvector<int>& ints, const mgvector<float>& floats);
+
+#ifndef SWIG
+    const int* getInts() const;     //!< 返回整数流
+    const float* getFloats() const; //!< 返回浮点流
+
+    //! 将命令缓冲重放到画布上，返回命令数，格式或版本不符则返回-1
+    static int replay(GiCanvas* canvas, const int* ints, int icount, const float* floats, int fcount);
+
+    //! 取出整数流和浮点流(与数组交换而不复制)，本对象随后清空
+    void takeData(std::vector<int>& ints, std::vector<float>& floats);
+#endif
+
+public:
+    virtual void setPen(int argb, float width, int style, float phase, float orgw);
+    virtual void setBrush(int argb, int style);
+    virtual void clearRect(float x, float y, float w, float h);
+    virtual void drawRect(float x, float y, float w, float h, bool stroke, bool fill);
+    virtual void drawLine(float x1, float y1, float x2, float y2);
+    virtual void drawEllipse(float x, float y, float w, float h, bool stroke, bool fill);
+    virtual void beginPath();
+    virtual void moveTo(float x, float y);
+    virtual void lineTo(float x, float y);
+    virtual void bezierTo(float c1x, float c1y, float c2x, float c2y, float x, float y);
+    virtual void quadTo(float cpx, float cpy, float x, float y);
+    virtual void closePath();
+    virtual void drawPath(bool stroke, bool fill);
+    virtual void saveClip();
+    virtual void restoreClip();
+    virtual bool clipRect(float x, float y, float w, float h);
+    virtual bool clipPath();
+    virtual bool drawHandle(float x, float y, int type, float angle);
+    virtual bool drawBitmap(const char* name, float xc, float yc,
+                            float w, float h, float angle);
+    virtual float drawTextAt(const char* text, float x, float y, float h, int align, float angle);
+    virtual bool beginShape(int type, int sid, int version, float x, float y, float w, float h);
+    virtual void endShape(int type, int sid, float x, float y);
+
+private:
+    struct Impl;
+    Impl*   im;
+
+    GiBufferCanvas(const GiBufferCanvas&);
+    void operator=(const GiBufferCanvas&);
+};
+
+#endif // TOUCHVG_CORE_BUFFERCANVAS_H_
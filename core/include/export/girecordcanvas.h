@@ -5,7 +5,8 @@
 #ifndef TOUCHVG_CORE_GIRECORDCANVAS_H
 #define TOUCHVG_CORE_GIRECORDCANVAS_H
 
-#include "gicanvas.h"
+#include "gibuffercanvas.h"
+#include "mgbox.h"
 
 class MgRecordShape;
 class MgShape;
@@ -13,13 +14,20 @@ class MgShapes;
 class GiTransform;
 
 //! The canvas adapter class to record drawing.
-/*! \ingroup CORE_VIEW
+/*! Each shape drawn is added to shapes as a MgRecordShape in world coordinates.
+    If target is not null, all drawing is also forwarded to it, so the drawing
+    can be shown and recorded in one pass.
+    If shapes is being rebuilt (MgShapes::beginReuse), the record shapes in it are
+    reused in order. A buffer kept by the caller keeps its capacity between frames,
+    so recording similar frames needs no memory allocation.
+    \ingroup CORE_VIEW
  */
 class GiRecordCanvas : public GiCanvas
 {
 public:
-    GiRecordCanvas(MgShapes* shapes, const GiTransform* xf, int ignoreId);
-    virtual ~GiRecordCanvas() { clear(); }
+    GiRecordCanvas(MgShapes* shapes, const GiTransform* xf, int ignoreId,
+                   GiCanvas* target = (GiCanvas*)0, GiBufferCanvas* buf = (GiBufferCanvas*)0);
+    virtual ~GiRecordCanvas();
     
     void clear();
     
@@ -46,18 +54,33 @@ private:
     virtual bool drawHandle(float x, float y, int type, float angle);
     virtual bool drawBitmap(const char* name, float xc, float yc,
                             float w, float h, float angle);
+    virtual bool drawDecodedBitmap(long image, const char* name, float xc, float yc,
+                                   float w, float h, float angle);
     virtual float drawTextAt(const char* text, float x, float y, float h, int align, float angle);
     virtual float drawTextAt(GiTextWidthCallback* c, const char* text, float x, float y, float h, int align, float angle);
     
 private:
     const Matrix2d d2w() const;
+    void newShape();
+    MgRecordShape* recordShape();
+    void addExtent(const Box2d& rectW);
 
 private:
     MgShapes*       _shapes;
     MgShape*        _shape;
-    MgRecordShape*  _sp;
+    MgRecordShape*  _sp;            // the current shape, created when something is recorded
+    int             _refid;         // id of the shape being drawn
     const GiTransform* _xf;
     int             _ignoreId;
+    GiCanvas*       _target;        // canvas to forward the drawing to, or null
+    GiBufferCanvas* _buf;           // commands of the current shape in world coordinates
+    bool            _ownBuf;        // true if _buf is created by this canvas
+    Box2d           _extent;        // model extent of the current shape
+    int             _texts;         // count of drawTextAt commands in the current shape
+    struct { int argb; float width; int style; float phase; float orgw; } _pen;
+    struct { int argb; int style; } _brush;
+    int             _state;         // 1: _pen is set, 2: _brush is set
+    int             _stateCount;    // count of commands repeating _pen and _brush in _buf
 };
 
 #endif // TOUCHVG_CORE_GIRECORDCANVAS_H
@@ -8,8 +8,14 @@
 #include "mgshape.h"
 #include <vector>
 
+struct GiTextWidthCallback;
+class GiBufferCanvas;
+
 //! The shape class to record drawing.
-/*! \ingroup CORE_SHAPE
+/*! The recorded items are kept in one contiguous opcode/operand buffer
+    in the format of GiBufferCanvas, with coordinates in world space.
+    Drawing replays the buffer in place without creating any item objects.
+    \ingroup CORE_SHAPE
  */
 class MgRecordShape : public MgBaseShape
 {
@@ -17,21 +23,19 @@ public:
     MgRecordShape() : _sid(0) {}
     virtual ~MgRecordShape() { _clear(); }
     
-    //! Interface of recording items.
-    struct ICmd {
-        virtual ~ICmd() {}
-        virtual int type() const = 0;
-        virtual void copy(const ICmd& src) = 0;
-        virtual bool save(MgStorage* s) const = 0;
-        virtual bool load(MgStorage* s) = 0;
-        virtual bool draw(GiGraphics& gs, const Matrix2d& w2d) const = 0;
-        virtual Box2d getExtentW() const { return Box2d(0, 0, 1, 1); }
-    };
-    
-    int getCount() const { return (int)_items.size(); }
-    void addItem(const Matrix2d& w2m, ICmd* p);
+    int getCount() const;
     void setRefID(int sid) { _sid = sid; }
     
+    //! Take the recorded commands (in world coordinates) of the buffer, which will be reset.
+    void takeItems(GiBufferCanvas& buf, const Box2d& extentM);
+    //! Set the text width callback of the index-th drawTextAt command.
+    void setTextCallback(int index, GiTextWidthCallback* c);
+    
+    //! Output the recorded items as binary data in native byte order.
+    void toBinary(std::vector<unsigned char>& data) const;
+    //! Restore the recorded items from binary data generated by toBinary().
+    bool fromBinary(const unsigned char* data, int size);
+    
     static MgRecordShape* create() { return new MgRecordShape(); }
     static int Type() { return 30; }
     
@@ -56,11 +60,13 @@ public:
     
 private:
     void _clear();
-    ICmd* createItem(int type) const;
+    void _clearCallbacks();
+    bool loadLegacyItems(MgStorage* s);
     
-    typedef std::vector<ICmd*>  ITEMS;
-    ITEMS   _items;
-    int     _sid;
+    std::vector<int>    _ints;      // opcodes and integer operands
+    std::vector<float>  _floats;    // float operands in world coordinates
+    std::vector<GiTextWidthCallback*> _textcbs;
+    int                 _sid;
 };
 
 #endif // TOUCHVG_CORE_GIRECORDSHAPE_H
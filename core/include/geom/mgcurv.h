@@ -91,6 +91,9 @@ static int fitCurve2(int knotCount, Point2d* knots, int count, PtCallback pts, v
 
 typedef void (*FitCubicCallback)(void* data, const Point2d curve[4]);
 static void fitCurve3(FitCubicCallback fc, void* data, const Point2d *pts, int n, float tol);
+//! 按给定的端点切向拟合，startTangent 为起点处向前的切向，endTangent 为终点处向后的切向，为零矢量则由数据点计算
+static void fitCurve3(FitCubicCallback fc, void* data, const Point2d *pts, int n, float tol,
+                      const Vector2d& startTangent, const Vector2d& endTangent);
 static void fitCurve4(FitCubicCallback fc, void* data, PtCallback pts, void* data2, int n, float tol);
 #endif
 
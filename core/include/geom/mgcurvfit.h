@@ -0,0 +1,57 @@
+﻿//! \file mgcurvfit.h
+//! \brief 定义逐点拟合三次样条曲线的类 MgCurveFitter
+// Copyright (c) 2004-2015, https://github.com/rhcad/vgcore, BSD License
+
+#ifndef TOUCHVG_CURVEFITTER_H_
+#define TOUCHVG_CURVEFITTER_H_
+
+#include "mgpnt.h"
+
+struct MgCurveFitterImpl;
+
+//! 逐点拟合三次样条曲线的类，用于手绘时边输入边拟合
+/*! 输入的点累积在尾部缓冲区中，缓冲区达到两个窗口的点数时拟合前一个窗口的点并固定下来，
+    后续拟合从固定部分末端的切向接续，因此每个点只参与一次拟合，结束时只需拟合剩余的尾部。
+    结果与 mgcurv::fitCurve 相同：型值点数组和切矢量数组，可用于 MgSplines。
+    \ingroup GEOMAPI
+    \see mgcurv::fitCurve3
+*/
+class MgCurveFitter
+{
+public:
+    MgCurveFitter();
+    ~MgCurveFitter();
+
+    //! 开始新的拟合，清除原有结果
+    /*!
+        \param tol 拟合容差，与输入点的坐标单位相同，一般为显示坐标
+        \param window 每次固定下来的输入点数
+    */
+    void begin(float tol, int window = 32);
+
+    //! 追加一个输入点，与上一点重合则忽略，返回输入点数
+    int addPoint(const Point2d& pt);
+
+    //! 拟合剩余的输入点，返回型值点数
+    int end();
+
+    //! 返回输入点数
+    int getPointCount() const;
+
+    //! 返回已固定的型值点数，end() 后为全部型值点数
+    int getKnotCount() const;
+
+    //! 返回型值点数组
+    const Point2d* getKnots() const;
+
+    //! 返回型值点的切矢量数组
+    const Vector2d* getKnotVectors() const;
+
+private:
+    MgCurveFitterImpl*  m_data;
+
+    MgCurveFitter(const MgCurveFitter&);
+    void operator=(const MgCurveFitter&);
+};
+
+#endif // TOUCHVG_CURVEFITTER_H_
@@ -0,0 +1,79 @@
+﻿//! \file giatomicptr.h
+//! \brief 定义可在多线程间无锁交接的引用计数对象指针类 GiAtomicRefPtr
+// Copyright (c) 2004-2015, https://github.com/rhcad/vgcore, BSD License
+
+#ifndef TOUCHVG_ATOMICREFPTR_H_
+#define TOUCHVG_ATOMICREFPTR_H_
+
+#include "gilock.h"
+
+#ifndef SWIG
+
+//! 可在多线程间无锁交接的引用计数对象指针类
+/*! T 需有 addRef() 和 release() 函数，对象地址应能存放在 long 中(同对象句柄)。
+
+    读取(acquire)不加锁：在当前纪元的读者计数上登记后取得对象并增加引用。
+    替换(reset)时先交换指针再切换纪元，等待旧纪元的读者离开后才释放旧对象，
+    因此读者不会对已释放的对象增加引用，写者最多等待已开始的几次 addRef()。
+    \ingroup GRAPH_INTERFACE
+ */
+template <class T>
+class GiAtomicRefPtr
+{
+public:
+    GiAtomicRefPtr() : _value(0), _epoch(0) { _readers[0] = _readers[1] = 0; }
+    ~GiAtomicRefPtr() { reset((T*)0); }
+
+    //! 返回已增加引用的对象，用完应调用其 release()，没有对象则返回NULL
+    T* acquire() {
+        for (;;) {
+            long epoch = giAtomicLoad(&_epoch);
+            volatile long* readers = &_readers[epoch & 1];
+
+            giAtomicIncrement(readers);
+            if (epoch == giAtomicLoad(&_epoch)) {
+                T* p = fromLong(giAtomicLoad(&_value));
+                if (p) {
+                    p->addRef();
+                }
+                giAtomicDecrement(readers);
+                return p;
+            }
+            giAtomicDecrement(readers);     // 写者已切换纪元，重新登记
+        }
+    }
+
+    //! 设置新对象(接管调用者的一次引用)，等待正在读取的线程后释放旧对象
+    void reset(T* p) {
+        long value = toLong(p);
+        long old = giAtomicLoad(&_value);
+
+        while (!giAtomicCompareAndSwap(&_value, value, old)) {
+            old = giAtomicLoad(&_value);
+        }
+        if (old) {
+            long epoch = giAtomicIncrement(&_epoch) - 1;
+            while (giAtomicLoad(&_readers[epoch & 1]) != 0) {
+                GiSpinLock::yield();
+            }
+            fromLong(old)->release();
+        }
+    }
+
+    //! 返回当前对象，不增加引用，仅供设置对象的线程使用
+    T* get() const { return fromLong(giAtomicLoad(const_cast<volatile long*>(&_value))); }
+
+private:
+    static long toLong(T* p) { long v = 0; *(T**)&v = p; return v; }
+    static T* fromLong(long v) { T* p; *(long*)&p = v; return p; }
+
+    volatile long   _value;
+    volatile long   _epoch;
+    volatile long   _readers[2];
+
+    GiAtomicRefPtr(const GiAtomicRefPtr&);
+    void operator=(const GiAtomicRefPtr&);
+};
+
+#endif // SWIG
+#endif // TOUCHVG_ATOMICREFPTR_H_
@@ -130,6 +130,21 @@ public:
         return equals(src);
     }
     
+    //! 比较次序操作符函数，用于按绘图参数排序和查找
+    bool operator<(const GiContext& src) const {
+        if (m_lineStyle != src.m_lineStyle)
+            return m_lineStyle < src.m_lineStyle;
+        if (m_lineWidth != src.m_lineWidth)
+            return m_lineWidth < src.m_lineWidth;
+        if (m_autoScale != src.m_autoScale)
+            return m_autoScale < src.m_autoScale;
+        if (m_lineColor != src.m_lineColor)
+            return (unsigned)m_lineColor.getARGB() < (unsigned)src.m_lineColor.getARGB();
+        if (m_fillColor != src.m_fillColor)
+            return (unsigned)m_fillColor.getARGB() < (unsigned)src.m_fillColor.getARGB();
+        return m_arrayHead < src.m_arrayHead;
+    }
+    
     //! 比较不相等操作符函数
     bool operator!=(const GiContext& src) const {
         return !equals(src);
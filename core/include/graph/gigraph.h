@@ -158,6 +158,17 @@ public:
     //! 是否允许虚线偏移量
     bool setPhaseEnabled(bool enabled);
     
+    //! 设置合并绘制模式，返回原来的模式
+    /*! 合并时将连续的同画笔、只描边的直线和折线追加到一个路径中，直到画笔改变、
+        绘制其他图元、改变剪裁框或结束绘图时才输出，不改变绘制的先后次序。
+        \param mode 0-不合并，1-在每个图形内合并，
+            2-跨图形合并，图形的开始和结束不中断合并，仅用于不按图形分组输出的画布
+     */
+    int setBatchMode(int mode);
+    
+    //! 返回合并绘制模式
+    int getBatchMode() const;
+    
 public:
     //! 绘制直线段，模型坐标或世界坐标
     /*!
@@ -368,6 +379,36 @@ public:
     //! 显示路径对象
     bool drawPath(const GiContext* ctx, const MgPath& path, bool fill, bool modelUnit = true);
     
+    //! 绘制网格线，模型坐标或世界坐标
+    /*! 只生成显示区域内的网格线，普通线和主网格线各合并为一个路径绘制。
+        线距小于2像素时只绘制主网格线，主网格线也过密时不绘制。
+        \param ctx 普通网格线的绘图参数
+        \param ctxMajor 主网格线的绘图参数，为NULL时取为ctx
+        \param origin 网格原点，过该点的线为主网格线
+        \param cell 网格单元的宽和高
+        \param major 每隔多少条线为主网格线，小于2时没有主网格线
+        \param extent 网格范围，其边界上的线不绘制，为空时不限范围
+        \param modelUnit 指定的坐标尺寸是模型坐标(true)还是世界坐标(false)
+        \return 绘制的网格线数
+     */
+    int drawGridLines(const GiContext* ctx, const GiContext* ctxMajor,
+                      const Point2d& origin, const Vector2d& cell, int major,
+                      const Box2d& extent, bool modelUnit = true);
+    
+    //! 绘制点阵网格，模型坐标或世界坐标
+    /*! 只生成显示区域内的点，画布支持重复图案(GiCanvas::drawDots)时直接绘制图案，
+        否则将各点的十字合并为一个路径绘制。点距小于3像素时不绘制。
+        \param ctx 绘图参数
+        \param origin 网格原点，为其中一个点
+        \param cell 网格单元的宽和高
+        \param size 十字的半长
+        \param extent 网格范围，为空时不限范围
+        \param modelUnit 指定的坐标尺寸是模型坐标(true)还是世界坐标(false)
+        \return 绘制的点数
+     */
+    int drawGridDots(const GiContext* ctx, const Point2d& origin, const Vector2d& cell,
+                     float size, const Box2d& extent, bool modelUnit = true);
+    
     //! 在给定中心位置显示特殊符号
     /*!
         \param pnt 符号中心位置
@@ -397,7 +438,7 @@ public:
     void endPaint();
     
 #ifndef SWIG
-    //! 返回当前绘图画布对象
+    //! 返回当前绘图画布对象，先输出合并中的路径，调用者可直接改变画布的画笔和画刷
     GiCanvas* getCanvas();
     
     //! 返回坐标系管理对象
@@ -418,6 +459,7 @@ public:
     bool rawClosePath();
     float rawText(const char* text, float x, float y, float h, int align = 1);
     bool rawImage(const char* name, float xc, float yc, float w, float h, float angle);
+    bool rawImage(int handle, float xc, float yc, float w, float h, float angle);
     bool beginShape(int type, int sid, int version, float x, float y, float w, float h);
     void endShape(int type, int sid, float x, float y);
     float drawTextAt(GiTextWidthCallback* c, int argb, const char* text, const Point2d& pnt, float h, int align = 1, float angle = 0);
@@ -0,0 +1,105 @@
+﻿//! \file giimagereg.h
+//! \brief 定义图像名称登记和解码缓存类 GiImageRegistry
+// Copyright (c) 2004-2015, https://github.com/rhcad/vgcore, BSD License
+
+#ifndef TOUCHVG_IMAGEREGISTRY_H_
+#define TOUCHVG_IMAGEREGISTRY_H_
+
+#include "mgvector.h"
+
+//! 图像解码接口，由宿主实现并通过 GiImageRegistry::setDecoder() 设置
+/*! 各函数在绘图线程中调用，调用期间不占用 GiImageRegistry 的锁。
+    \ingroup GRAPH_INTERFACE
+    \interface GiImageDecoder
+ */
+struct GiImageDecoder {
+    virtual ~GiImageDecoder() {}
+
+    //! 得到图像的原始像素大小，依次放入 size 的前两项(宽和高)，失败返回false
+    virtual bool getImageSize(const char* name, mgvector<int>& size) = 0;
+
+    //! 将图像解码为指定的像素大小，返回宿主的图像对象编号，失败返回0
+    virtual long decodeImage(const char* name, int width, int height) = 0;
+
+    //! 返回已解码图像占用的内存字节数，默认按每像素4字节计算
+    virtual int getImageBytes(long image, int width, int height) { return image ? width * height * 4 : 0; }
+
+    //! 释放 decodeImage() 返回的图像对象
+    virtual void releaseImage(long image) = 0;
+};
+
+//! 图像名称登记和解码缓存类
+/*! 图像名称登记为整数句柄(从1开始，0表示无效)，图形只保存和比较句柄，
+    绘制时记录每个图像的显示大小。
+
+    设置解码器后，acquireImage() 按显示大小选择降采样级别(第L级为原图的1/2^L)，
+    已解码的级别按最近使用顺序缓存，总字节数超过预算时释放最久未用且未被占用的级别，
+    从而平移和重绘时不再重复解码，也不会解码远大于显示大小的图像。
+    本类的函数可在多个线程中调用。
+    \ingroup GRAPH_INTERFACE
+ */
+class GiImageRegistry
+{
+public:
+    //! 返回全局的图像登记对象
+    static GiImageRegistry& instance();
+
+    //! 登记图像名称，返回句柄，名称为空返回0
+    int intern(const char* name);
+
+    //! 返回已登记的图像句柄，未登记返回0
+    int findHandle(const char* name) const;
+
+    //! 返回图像名称，句柄无效时返回空串，返回的指针一直有效
+    const char* getName(int handle) const;
+
+    //! 返回已登记的图像数
+    int getCount() const;
+
+    //! 记录图像的显示像素大小，在绘制图像时调用
+    void noteDrawn(int handle, float width, float height);
+
+    //! 得到图像最近的显示像素大小，没有绘制过则返回false
+    bool getDrawnSize(int handle, float& width, float& height) const;
+
+    //! 设置解码器，将清除已解码的图像
+    /*! 正在使用的图像在 releaseImage() 后才由原解码器释放，原解码器应保持有效直到其图像都已释放。
+     */
+    void setDecoder(GiImageDecoder* decoder);
+
+    //! 设置已解码图像的内存预算(字节数)
+    void setBudget(int bytes);
+
+    int getBudget() const;          //!< 返回已解码图像的内存预算
+    int getUsedBytes() const;       //!< 返回已解码图像占用的内存字节数
+    int getDecodeCount() const;     //!< 返回累计的解码次数
+
+    //! 按显示像素大小得到合适级别的已解码图像，用完应调用 releaseImage()
+    /*! \param handle 图像句柄
+        \param width 显示像素宽度，为0则取最近的显示宽度
+        \param height 显示像素高度，为0则取最近的显示高度
+        \return 宿主的图像对象编号，没有解码器或解码失败时返回0
+     */
+    long acquireImage(int handle, float width = 0, float height = 0);
+
+    //! 按名称得到已解码图像，用完应调用 releaseImage()
+    long acquireImage(const char* name, float width, float height);
+
+    //! 结束使用 acquireImage() 返回的图像，此后可被释放
+    void releaseImage(long image);
+
+    //! 释放所有未被占用的已解码图像
+    void purge();
+
+private:
+    GiImageRegistry();
+    ~GiImageRegistry();
+
+    struct Impl;
+    Impl*   im;
+
+    GiImageRegistry(const GiImageRegistry&);
+    void operator=(const GiImageRegistry&);
+};
+
+#endif // TOUCHVG_IMAGEREGISTRY_H_
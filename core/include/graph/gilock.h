@@ -1,5 +1,5 @@
 ﻿//! \file gilock.h
-//! \brief 定义原子锁函数 giAtomicIncrement, giAtomicDecrement, giAtomicCompareAndSwap
+//! \brief 定义原子锁函数 giAtomicIncrement, giAtomicDecrement, giAtomicCompareAndSwap, giAtomicLoad 和自旋锁 GiSpinLock
 // Copyright (c) 2004-2015, https://github.com/rhcad/vgcore, BSD License
 
 #ifndef TOUCHVG_GILOCK_H_
@@ -12,6 +12,8 @@
     inline long giAtomicDecrement(volatile long *p) { return OSAtomicDecrement32((volatile int32_t *)p); }
     inline bool giAtomicCompareAndSwap(volatile long *p, long value, long oldValue) {
         return OSAtomicCompareAndSwapLong(oldValue, value, p); }
+    inline long giAtomicLoad(volatile long *p) {
+        long v = *p; while (!OSAtomicCompareAndSwapLong(v, v, p)) v = *p; return v; }
 #elif defined(__WINDOWS__) || defined(WIN32)
     #ifndef _WINDOWS_
         #define WIN32_LEAN_AND_MEAN
@@ -22,23 +24,53 @@
         inline long giAtomicDecrement(volatile long *p) { return InterlockedDecrement((long*)p); }
         inline bool giAtomicCompareAndSwap(volatile long *p, long value, long oldValue) {
             return InterlockedCompareExchange((long*)p, value, oldValue) == oldValue; }
+        inline long giAtomicLoad(volatile long *p) { return InterlockedCompareExchange((long*)p, 0, 0); }
     #else
         inline long giAtomicIncrement(volatile long *p) { return InterlockedIncrement(p); }
         inline long giAtomicDecrement(volatile long *p) { return InterlockedDecrement(p); }
         inline bool giAtomicCompareAndSwap(volatile long *p, long value, long oldValue) {
             return InterlockedCompareExchange(p, value, oldValue) == oldValue; }
+        inline long giAtomicLoad(volatile long *p) { return InterlockedCompareExchange(p, 0, 0); }
     #endif
 #elif defined(__ANDROID__) || defined(__linux__)
     inline long giAtomicIncrement(volatile long *p) { return __sync_add_and_fetch(p, 1L); }
     inline long giAtomicDecrement(volatile long *p) { return __sync_sub_and_fetch(p, 1L); }
     inline bool giAtomicCompareAndSwap(volatile long *p, long value, long oldValue) {
         return __sync_bool_compare_and_swap(p, oldValue, value); }
+    inline long giAtomicLoad(volatile long *p) { return __sync_fetch_and_add(p, 0L); }
 #else
     inline long giAtomicIncrement(volatile long *p) { return ++(*p); }
     inline long giAtomicDecrement(volatile long *p) { return --(*p); }
     inline bool giAtomicCompareAndSwap(volatile long *p, long value, long oldValue) {
         bool b = *p == oldValue; if (b) *p = value; return oldValue; }
+    inline long giAtomicLoad(volatile long *p) { return *p; }
 #endif
+
+#if !defined(__WINDOWS__) && !defined(WIN32)
+#include <sched.h>
+#endif
+
+//! 自旋锁，在构造时加锁，析构时解锁，适合很短的临界区
+/*! 锁变量初值为0，例如: `GiSpinLock lock(&_locker);`
+ */
+struct GiSpinLock {
+    volatile long* p;
+    GiSpinLock(volatile long* p) : p(p) {
+        while (!giAtomicCompareAndSwap(p, 1, 0)) {
+            yield();
+        }
+    }
+    ~GiSpinLock() { giAtomicCompareAndSwap(p, 0, 1); }
+    
+    //! 让出当前线程的时间片
+    static void yield() {
+#if defined(__WINDOWS__) || defined(WIN32)
+        Sleep(0);
+#else
+        sched_yield();
+#endif
+    }
+};
 #endif // SWIG
 
 #endif // TOUCHVG_GILOCK_H_
@@ -0,0 +1,170 @@
+﻿//! \file gistyletable.h
+//! \brief 定义共享绘图参数的登记表 GiStyleTable 和享元类 GiSharedContext
+// Copyright (c) 2004-2015, https://github.com/rhcad/vgcore, BSD License
+
+#ifndef TOUCHVG_STYLETABLE_H_
+#define TOUCHVG_STYLETABLE_H_
+
+#include "gicontxt.h"
+
+#ifndef SWIG
+
+class GiStyleTable;
+
+//! 已登记的绘图参数项，内容不再改变，由 GiStyleTable 按引用计数管理
+struct GiStyleEntry {
+    GiContext       ctx;
+    volatile long   refcount;
+    GiStyleTable*   table;          //!< 所属登记表，本项持有表的一个引用
+};
+
+//! 共享绘图参数的登记表
+/*! 相同的绘图参数只登记一项，各图形引用同一项而不各自保存一份 GiContext。
+    每个文档有自己的登记表(由文档的各副本共享)，图形加入文档时改用文档的登记表；
+    尚未加入文档的图形使用全局登记表。引用计数为0的项从表中移除。
+    本类的函数可在多个线程中调用。
+    \ingroup GRAPH_INTERFACE
+    \see GiSharedContext
+ */
+class GiStyleTable
+{
+public:
+    //! 返回全局的绘图参数登记表，用于不属于文档的图形，不会释放
+    static GiStyleTable& instance();
+
+    //! 创建一个登记表，引用计数为1，由 release() 释放
+    static GiStyleTable* create();
+
+    //! 增加登记表的引用
+    void addRef();
+
+    //! 释放登记表的引用，表和其中的项都不再被引用时删除
+    void release();
+
+    //! 登记绘图参数，返回已增加引用的项，相同的参数返回同一项
+    GiStyleEntry* intern(const GiContext& ctx);
+
+    //! 返回全局登记表中默认绘图参数(GiContext())对应的项，已增加引用，该项一直有效
+    static GiStyleEntry* defaultEntry();
+
+    //! 增加一项的引用，调用者应已持有该项
+    static void addRef(GiStyleEntry* entry);
+
+    //! 释放一项的引用，为0时从所属登记表中移除
+    static void release(GiStyleEntry* entry);
+
+    //! 返回已登记的不同绘图参数的个数
+    int getCount() const;
+
+private:
+    GiStyleTable();
+    ~GiStyleTable();
+
+    struct Impl;
+    Impl*   im;
+
+    GiStyleTable(const GiStyleTable&);
+    void operator=(const GiStyleTable&);
+};
+
+//! 共享绘图参数的享元类，作为 MgShapeT 的绘图参数成员
+/*! 只保存登记项的指针，复制时共享同一项，修改时登记新的参数项(写时复制)。
+    \ingroup GRAPH_INTERFACE
+ */
+class GiSharedContext
+{
+public:
+    GiSharedContext() : _entry(GiStyleTable::defaultEntry()) {}
+    GiSharedContext(const GiSharedContext& src) : _entry(src._entry) {
+        GiStyleTable::addRef(_entry);
+    }
+    GiSharedContext(const GiContext& ctx) : _entry(GiStyleTable::instance().intern(ctx)) {}
+    ~GiSharedContext() { GiStyleTable::release(_entry); }
+
+    GiSharedContext& operator=(const GiSharedContext& src) {
+        if (_entry != src._entry) {
+            GiStyleTable::addRef(src._entry);
+            GiStyleTable::release(_entry);
+            _entry = src._entry;
+        }
+        return *this;
+    }
+    GiSharedContext& operator=(const GiContext& ctx) { return copy(ctx); }
+
+    //! 返回共享的绘图参数
+    const GiContext& get() const { return _entry->ctx; }
+    operator const GiContext&() const { return _entry->ctx; }
+
+    //! 复制指定的属性，参数有变化时才在当前登记表中登记新的参数项
+    GiSharedContext& copy(const GiContext& src, int mask = -1) {
+        GiContext ctx(_entry->ctx);
+        ctx.copy(src, mask);
+        if (!ctx.equals(_entry->ctx)) {
+            GiStyleEntry* entry = _entry->table->intern(ctx);
+            GiStyleTable::release(_entry);
+            _entry = entry;
+        }
+        return *this;
+    }
+
+    //! 改用另一登记表中的相同参数项，用于图形加入文档时，table为NULL时不变
+    void bind(GiStyleTable* table) {
+        if (table && table != _entry->table) {
+            GiStyleEntry* entry = table->intern(_entry->ctx);
+            GiStyleTable::release(_entry);
+            _entry = entry;
+        }
+    }
+
+    //! 返回参数项所属的登记表
+    GiStyleTable* getTable() const { return _entry->table; }
+
+    //! 返回登记项的标识，相同的绘图参数有相同的标识，可用于按绘图参数排序
+    long styleHandle() const { long h; *(GiStyleEntry**)&h = _entry; return h; }
+
+private:
+    GiStyleEntry*   _entry;
+};
+
+//! 使图形的绘图参数改用文档的登记表，供 MgShapeT 在图形加入图形列表时调用
+inline void giBindStyle(GiSharedContext& ctx, GiStyleTable* table) { ctx.bind(table); }
+
+//! 文档读写时的绘图参数序号表
+/*! 保存文档时先收集各图形的绘图参数并只写出一次，图形只保存其序号；
+    加载时先读出所有绘图参数，图形再按序号取出，由图形登记到所在文档的登记表中。
+    \ingroup GRAPH_INTERFACE
+ */
+class GiStyleIndex
+{
+public:
+    GiStyleIndex();
+    ~GiStyleIndex();
+
+    //! 加入绘图参数，返回其序号(从0开始)，已有相同参数则返回原序号
+    int add(const GiContext& ctx);
+
+    //! 按文件中的次序追加绘图参数，不合并相同的参数
+    void append(const GiContext& ctx);
+
+    //! 返回绘图参数的序号，没有则返回-1
+    int find(const GiContext& ctx) const;
+
+    //! 返回绘图参数的个数
+    int getCount() const;
+
+    //! 返回指定序号的绘图参数，序号无效则返回NULL
+    const GiContext* get(int index) const;
+
+    //! 清除所有绘图参数
+    void clear();
+
+private:
+    struct Impl;
+    Impl*   im;
+
+    GiStyleIndex(const GiStyleIndex&);
+    void operator=(const GiStyleIndex&);
+};
+
+#endif // SWIG
+#endif // TOUCHVG_STYLETABLE_H_
@@ -0,0 +1,315 @@
+﻿//! \file githread.h
+//! \brief 定义线程辅助类 GiThread、事件信号类 GiSignal、线程池 GiThreadPool 和并行执行函数 giParallelFor
+// Copyright (c) 2004-2015, https://github.com/rhcad/vgcore, BSD License
+
+#ifndef TOUCHVG_GITHREAD_H_
+#define TOUCHVG_GITHREAD_H_
+
+#ifndef SWIG
+#include "gilock.h"
+
+#if defined(__WINDOWS__) || defined(WIN32)
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+//! 返回可用的处理器核数
+inline int giGetCpuCount()
+{
+#if defined(__WINDOWS__) || defined(WIN32)
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return si.dwNumberOfProcessors > 0 ? (int)si.dwNumberOfProcessors : 1;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+//! 简单的线程类，start() 启动线程函数，join() 或析构时等待结束
+class GiThread
+{
+public:
+    typedef void (*Proc)(void* param);
+
+    GiThread() : _proc((Proc)0), _param((void*)0), _started(false) {}
+    ~GiThread() { join(); }
+
+    //! 启动线程，失败返回false
+    bool start(Proc proc, void* param) {
+        if (_started || !proc)
+            return false;
+        _proc = proc;
+        _param = param;
+#if defined(__WINDOWS__) || defined(WIN32)
+        _handle = CreateThread(NULL, 0, run, this, 0, NULL);
+        _started = (_handle != NULL);
+#else
+        _started = (pthread_create(&_handle, NULL, run, this) == 0);
+#endif
+        return _started;
+    }
+
+    //! 等待线程结束
+    void join() {
+        if (_started) {
+#if defined(__WINDOWS__) || defined(WIN32)
+            WaitForSingleObject(_handle, INFINITE);
+            CloseHandle(_handle);
+#else
+            pthread_join(_handle, NULL);
+#endif
+            _started = false;
+        }
+    }
+
+private:
+#if defined(__WINDOWS__) || defined(WIN32)
+    static DWORD WINAPI run(LPVOID p) { ((GiThread*)p)->_proc(((GiThread*)p)->_param); return 0; }
+    HANDLE      _handle;
+#else
+    static void* run(void* p) { ((GiThread*)p)->_proc(((GiThread*)p)->_param); return NULL; }
+    pthread_t   _handle;
+#endif
+    Proc        _proc;
+    void*       _param;
+    bool        _started;
+
+    GiThread(const GiThread&);
+    void operator=(const GiThread&);
+};
+
+//! 自动复位的事件信号，set() 唤醒等待的线程，未等待时保留到下一次 wait()
+class GiSignal
+{
+public:
+#if defined(__WINDOWS__) || defined(WIN32)
+    GiSignal() { _event = CreateEvent(NULL, FALSE, FALSE, NULL); }
+    ~GiSignal() { CloseHandle(_event); }
+    void set() { SetEvent(_event); }
+    void wait() { WaitForSingleObject(_event, INFINITE); }
+#else
+    GiSignal() : _signaled(false) {
+        pthread_mutex_init(&_mutex, NULL);
+        pthread_cond_init(&_cond, NULL);
+    }
+    ~GiSignal() {
+        pthread_cond_destroy(&_cond);
+        pthread_mutex_destroy(&_mutex);
+    }
+    void set() {
+        pthread_mutex_lock(&_mutex);
+        _signaled = true;
+        pthread_cond_signal(&_cond);
+        pthread_mutex_unlock(&_mutex);
+    }
+    void wait() {
+        pthread_mutex_lock(&_mutex);
+        while (!_signaled) {
+            pthread_cond_wait(&_cond, &_mutex);
+        }
+        _signaled = false;
+        pthread_mutex_unlock(&_mutex);
+    }
+#endif
+
+private:
+#if defined(__WINDOWS__) || defined(WIN32)
+    HANDLE          _event;
+#else
+    pthread_mutex_t _mutex;
+    pthread_cond_t  _cond;
+    bool            _signaled;
+#endif
+
+    GiSignal(const GiSignal&);
+    void operator=(const GiSignal&);
+};
+
+//! giParallelFor 的内部任务数据，各线程按块动态领取序号区间
+struct GiParallelTask {
+    void (*fn)(int from, int to, void* data);
+    void*   data;
+    int     n;
+    int     chunk;
+    volatile long next;
+    int     maxHelpers;                 //!< 最多参与的工作线程数
+    int     helpers;                    //!< 已参与的工作线程数，由线程池加锁修改
+    volatile long active;               //!< 正在执行的工作线程数
+
+    static void run(void* param) {
+        GiParallelTask* t = (GiParallelTask*)param;
+        for (;;) {
+            long from = (giAtomicIncrement(&t->next) - 1) * t->chunk;
+            if (from >= t->n)
+                break;
+            t->fn((int)from, from + t->chunk < t->n ? (int)from + t->chunk : t->n, t->data);
+        }
+    }
+    bool hasMore() { return giAtomicLoad(&next) * chunk < n; }
+};
+
+//! giParallelFor 使用的常驻工作线程池，线程按需创建后一直等待新任务
+/*! 多个线程可同时提交任务，空闲工作线程领取尚有剩余块的任务协助执行。
+ */
+class GiThreadPool
+{
+public:
+    enum { kMaxWorkers = 15, kMaxTasks = 8 };
+
+    //! 返回进程内唯一的线程池，不销毁
+    static GiThreadPool& instance() {
+        static volatile long locker = 0;
+        static GiThreadPool* pool = (GiThreadPool*)0;
+        GiSpinLock lock(&locker);
+        if (!pool)
+            pool = new GiThreadPool();
+        return *pool;
+    }
+
+    //! 最多由 helpers 个工作线程协助当前线程执行任务，返回时所有块都已完成，返回参与的工作线程数
+    int run(GiParallelTask& task, int helpers) {
+        task.maxHelpers = helpers;
+        task.helpers = 0;
+        task.active = 0;
+
+        bool added = addTask(&task);
+        if (added) {
+            wakeWorkers(helpers);
+        }
+        GiParallelTask::run(&task);
+        if (added) {
+            removeTask(&task);                      // 此后不会再有线程加入
+            while (giAtomicLoad(&task.active) > 0) { // 等待正在执行最后一块的线程
+                GiSpinLock::yield();
+            }
+        }
+        return task.helpers;
+    }
+
+private:
+    struct Worker {
+        GiThreadPool*   pool;
+        GiSignal        signal;
+        GiThread        thread;
+    };
+
+    GiThreadPool() : _locker(0), _workers(0), _idle(0), _tasks(0) {}
+
+    bool addTask(GiParallelTask* task) {
+        GiSpinLock lock(&_locker);
+        if (_tasks >= kMaxTasks)
+            return false;
+        _taskList[_tasks++] = task;
+        return true;
+    }
+
+    void removeTask(GiParallelTask* task) {
+        GiSpinLock lock(&_locker);
+        for (int i = 0; i < _tasks; i++) {
+            if (_taskList[i] == task) {
+                _taskList[i] = _taskList[--_tasks];
+                break;
+            }
+        }
+    }
+
+    //! 唤醒空闲线程，不够时创建新线程
+    void wakeWorkers(int count) {
+        for (int i = 0; i < count; i++) {
+            Worker* w = (Worker*)0;
+            bool created = false;
+            {
+                GiSpinLock lock(&_locker);
+                if (_idle > 0) {
+                    w = _idleList[--_idle];
+                } else if (_workers < kMaxWorkers) {
+                    w = new Worker();
+                    w->pool = this;
+                    _workerList[_workers++] = w;
+                    created = true;
+                }
+            }
+            if (!w)
+                break;
+            if (created) {
+                w->thread.start(workerProc, w);
+            } else {
+                w->signal.set();
+            }
+        }
+    }
+
+    //! 领取一个可协助的任务，没有则登记为空闲线程
+    GiParallelTask* pickTask(Worker* w) {
+        GiSpinLock lock(&_locker);
+        for (int i = 0; i < _tasks; i++) {
+            GiParallelTask* t = _taskList[i];
+            if (t->helpers < t->maxHelpers && t->hasMore()) {
+                t->helpers++;
+                giAtomicIncrement(&t->active);
+                return t;
+            }
+        }
+        _idleList[_idle++] = w;
+        return (GiParallelTask*)0;
+    }
+
+    static void workerProc(void* param) {
+        Worker* w = (Worker*)param;
+        for (;;) {
+            GiParallelTask* t = w->pool->pickTask(w);
+            if (t) {
+                GiParallelTask::run(t);
+                giAtomicDecrement(&t->active);
+            } else {
+                w->signal.wait();
+            }
+        }
+    }
+
+private:
+    volatile long   _locker;
+    int             _workers;
+    int             _idle;
+    int             _tasks;
+    Worker*         _workerList[kMaxWorkers];
+    Worker*         _idleList[kMaxWorkers];
+    GiParallelTask* _taskList[kMaxTasks];
+
+    GiThreadPool(const GiThreadPool&);
+    void operator=(const GiThreadPool&);
+};
+
+//! 将序号 [0, n) 分块并行执行 fn(from, to, data)，返回使用的线程数
+/*! 当前线程也参与执行，返回时所有块都已完成。工作线程来自常驻的 GiThreadPool。
+    n 小于 minCount 或只有一个核时直接在当前线程中执行。
+    \param threads 最大线程数，为0则取处理器核数
+ */
+inline int giParallelFor(int n, int minCount, void (*fn)(int from, int to, void* data),
+                         void* data, int threads = 0)
+{
+    if (threads <= 0)
+        threads = giGetCpuCount();
+    if (threads > GiThreadPool::kMaxWorkers + 1)
+        threads = GiThreadPool::kMaxWorkers + 1;
+    if (n < minCount || threads < 2) {
+        if (n > 0)
+            fn(0, n, data);
+        return 1;
+    }
+
+    GiParallelTask task;
+
+    task.fn = fn;
+    task.data = data;
+    task.n = n;
+    task.chunk = n / (threads * 8) > 16 ? n / (threads * 8) : 16;  // 小块以平衡负载
+    task.next = 0;
+
+    return GiThreadPool::instance().run(task, threads - 1) + 1;
+}
+
+#endif // SWIG
+#endif // TOUCHVG_GITHREAD_H_
@@ -27,6 +27,9 @@ public:
     //! 改变顶点数
     virtual bool resize(int count);
     
+    //! 预留顶点数组的容量，不改变顶点数，使随后连续加点时不再分配内存
+    void reserve(int count);
+    
     //! 添加一个顶点
     virtual bool addPoint(const Point2d& pt);
     
@@ -41,10 +44,23 @@ public:
     
     //! 增量路径比较
     bool isIncrementFrom(const MgBaseLines& src) const;
+    
+    //! 将已完成的笔迹顶点压缩存储，quantum 为量化步长(模型坐标)，会略微移动顶点
+    /*! 以首点为原点、quantum 为单位将顶点量化为整数，逐点差值按变长整数编码，
+        浮点数组只在绘制、检测或修改时才解码出来，修改顶点后恢复为浮点数组。
+        保存时压缩数据按 base64 编码为JSON中的字符串(键名 packed)，并非独立的二进制文件。
+     */
+    bool compact(float quantum);
+    
+    //! 返回顶点是否为压缩存储
+    bool isCompact() const { return _packed != (unsigned char*)0; }
+    
+    //! 返回压缩数据的字节数
+    int getCompactSize() const { return _packedSize; }
 
 #ifndef SWIG
     virtual int getSubType() const { return isClosed() ? 1 : 0; }
-    virtual const Point2d* getPoints() const { return _points; }
+    virtual const Point2d* getPoints() const { return _pts(); }
 #endif
     
 protected:
@@ -64,11 +80,30 @@ protected:
     bool _hitTestBox(const Box2d& rect) const;
     bool _save(MgStorage* s) const;
     bool _load(MgShapeFactory* factory, MgStorage* s);
+    void _clearCachedData();
+    
+    //! 返回顶点数组，压缩存储时解码出来
+    const Point2d* _pts() const { return _points ? _points : _unpack(); }
+    
+    //! 返回可修改的顶点数组，压缩存储时解码并放弃压缩数据
+    Point2d* _editPoints();
+    
+    //! 返回需随顶点一起压缩的切矢量数组
+    virtual const Vector2d* _vectorsToPack() const { return (const Vector2d*)0; }
+    
+    //! 设置解码出的切矢量缓存，vecs 为NULL时释放缓存
+    virtual void _setCachedVectors(Vector2d* vecs) const { delete[] vecs; }
+    
+private:
+    const Point2d* _unpack() const;
+    void _freePoints();
     
 protected:
-    Point2d*    _points;
+    mutable Point2d* _points;       // 顶点数组，压缩存储时为解码缓存
     int      _maxCount;
     int      _count;
+    unsigned char*  _packed;        // 压缩的顶点数据
+    int      _packedSize;
 };
 
 //! 折线图形类
@@ -8,6 +8,8 @@
 
 #include "mglines.h"
 
+class MgCurveFitter;
+
 //! 二次样条曲线类
 /*! \ingroup CORE_SHAPE
  */
@@ -20,7 +22,11 @@ public:
     int smoothForPoints(int count, const Point2d* points, const Matrix2d& m2d, float tol);
     void clearVectors();
 #ifndef SWIG
-    const Vector2d* getVectors() const { return _knotvs; }
+    const Vector2d* getVectors() const { _pts(); return _knotvs; }
+    
+    //! 用拟合结果(显示坐标)替换型值点，m2d 为模型坐标到显示坐标的变换，返回型值点数
+    int smoothForFitter(const MgCurveFitter& fitter, const Matrix2d& m2d);
+    
     virtual bool isCurve() const { return true; }
     virtual bool resize(int count);
     virtual bool addPoint(const Point2d& pt);
@@ -40,8 +46,10 @@ protected:
     void _output(MgPath& path) const;
     bool _save(MgStorage* s) const;
     bool _load(MgShapeFactory* factory, MgStorage* s);
+    const Vector2d* _vectorsToPack() const { return _knotvs; }
+    void _setCachedVectors(Vector2d* vecs) const;
     
-    Vector2d*   _knotvs;
+    mutable Vector2d*   _knotvs;    // 切矢量数组，压缩存储时为解码缓存
 };
 
 #endif // TOUCHVG_SPLINES_SHAPE_H_
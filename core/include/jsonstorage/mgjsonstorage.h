@@ -14,6 +14,16 @@ inline FILE* mgopenfile(const char* fn, const char* m) {
     return fopen(fn, m);
 #endif
 }
+//! 定位到文件开头起的字节位置，可超过2GB，成功返回0
+inline int mgseekfile(FILE* fp, long long offset) {
+#if defined(_MSC_VER) && _MSC_VER >= 1400
+    return _fseeki64(fp, offset, SEEK_SET);
+#elif defined(_WIN32)
+    return offset == (long)offset ? fseek(fp, (long)offset, SEEK_SET) : -1;
+#else
+    return offset == (off_t)offset ? fseeko(fp, (off_t)offset, SEEK_SET) : -1;
+#endif
+}
 #endif
 struct MgStorage;
 
@@ -85,6 +95,9 @@ public:
     //! 设置是否在保存数值键值时加上引号
     void saveNumberAsString(bool str);
     
+    //! 设置保存文档时是否写出绘图参数表、图形只写参数序号，默认各图形写出自己的参数，旧版本才能读取
+    void setStyleIndexMode(bool indexed);
+    
     //! UTF-16/32编码的文件转换为UTF-8编码的文件，返回转换与否
     static bool toUTF8(const char* infile, const char* outfile);
     
@@ -0,0 +1,213 @@
+﻿//! \file mgtrace.h
+//! \brief 定义性能跟踪宏 MG_TRACE_SCOPE、跟踪记录输出函数 mgTraceDump 和单调时钟函数 mgMonotonicMicros
+// Copyright (c) 2004-2015, https://github.com/rhcad/vgcore, BSD License
+
+#ifndef TOUCHVG_TRACE_H
+#define TOUCHVG_TRACE_H
+
+#include "gilock.h"
+
+#if defined(__WINDOWS__) || defined(WIN32)
+#elif defined(__APPLE__)
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+//! 返回单调时钟的当前时间，微秒
+inline long long mgMonotonicMicros() {
+#if defined(__WINDOWS__) || defined(WIN32)
+    static LARGE_INTEGER freq = { 0 };
+    LARGE_INTEGER t;
+    if (!freq.QuadPart)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&t);
+    return t.QuadPart * 1000000 / freq.QuadPart;
+#elif defined(__APPLE__)
+    static mach_timebase_info_data_t tb = { 0, 0 };
+    if (!tb.denom)
+        mach_timebase_info(&tb);
+    return (long long)(mach_absolute_time() * tb.numer / tb.denom / 1000);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+#ifndef MG_TRACE
+
+#define MG_TRACE_SCOPE(name)
+
+#else // MG_TRACE
+
+#include <string>
+#include <stdio.h>
+#if !defined(__WINDOWS__) && !defined(WIN32)
+#include <pthread.h>
+#endif
+
+//! 在当前作用域记录一个跟踪区间，name 须为字符串常量
+#define MG_TRACE_SCOPE(name)    MgTraceScope _mgtrace_scope_(name)
+
+//! 单个线程的跟踪环形缓冲，只由所属线程写入
+struct MgTraceBuffer {
+    enum { kMaxEvents = 4096 };         //!< 每个线程保留的最近事件数
+    struct Event {
+        const char* name;               //!< 区间名称
+        long long   start;              //!< 开始时间，微秒
+        long long   dur;                //!< 持续时间，微秒
+    };
+    Event           events[kMaxEvents]; //!< 环形缓冲
+    volatile long   count;              //!< 已写入的事件总数
+    long            tid;                //!< 线程序号，从1开始
+    volatile long   inUse;              //!< 是否属于未退出的线程，线程退出后可被新线程重用
+};
+
+//! 跟踪记录的全局注册表，最多同时记录 kMaxThreads 个线程，已退出线程的缓冲会被重用
+struct MgTraceRegistry {
+    enum { kMaxThreads = 64 };
+    MgTraceBuffer*  buffers[kMaxThreads];
+    volatile long   count;              //!< 已分配的缓冲数
+    volatile long   threads;            //!< 已登记的线程数，用于分配线程序号
+
+    static MgTraceRegistry& instance() {
+        static MgTraceRegistry reg;     // 零初始化，无需构造
+        return reg;
+    }
+
+    //! 返回当前线程的跟踪缓冲，首次调用时登记，同时存在的线程数超出上限则返回NULL
+    static MgTraceBuffer* current() {
+#if defined(_MSC_VER)
+        static __declspec(thread) MgTraceBuffer* buf = 0;
+#else
+        static __thread MgTraceBuffer* buf = 0;
+#endif
+        if (!buf) {
+            buf = instance().acquire();
+            if (buf) {
+                watchThreadExit(buf);
+            }
+        }
+        return buf;
+    }
+
+    //! 返回单调时钟的当前时间，微秒
+    static long long now() { return mgMonotonicMicros(); }
+
+private:
+    //! 重用已退出线程的缓冲(清除其记录)，没有则分配新缓冲
+    MgTraceBuffer* acquire() {
+        long n = giAtomicLoad(&count);
+        long i;
+
+        for (i = 0; i < n && i < kMaxThreads; i++) {
+            MgTraceBuffer* p = buffers[i];
+            if (p && !giAtomicLoad(&p->inUse) && giAtomicCompareAndSwap(&p->inUse, 1, 0)) {
+                p->count = 0;
+                p->tid = giAtomicIncrement(&threads);
+                return p;
+            }
+        }
+        i = giAtomicIncrement(&count) - 1;
+        if (i >= kMaxThreads) {
+            giAtomicDecrement(&count);
+            return (MgTraceBuffer*)0;
+        }
+
+        MgTraceBuffer* p = new MgTraceBuffer;
+        p->count = 0;
+        p->tid = giAtomicIncrement(&threads);
+        p->inUse = 1;
+        buffers[i] = p;
+
+        return p;
+    }
+
+    //! 线程退出时交还缓冲
+#if defined(__WINDOWS__) || defined(WIN32)
+    static void WINAPI releaseBuffer(void* p) {
+        if (p) ((MgTraceBuffer*)p)->inUse = 0;
+    }
+    static void watchThreadExit(MgTraceBuffer* buf) {
+        static DWORD index = FLS_OUT_OF_INDEXES;
+        static volatile long locker = 0;
+        {
+            GiSpinLock lock(&locker);
+            if (index == FLS_OUT_OF_INDEXES)
+                index = FlsAlloc(releaseBuffer);
+        }
+        if (index != FLS_OUT_OF_INDEXES)
+            FlsSetValue(index, buf);
+    }
+#else
+    static void releaseBuffer(void* p) {
+        ((MgTraceBuffer*)p)->inUse = 0;
+    }
+    static pthread_key_t& exitKey() {
+        static pthread_key_t key;
+        return key;
+    }
+    static void createExitKey() {
+        pthread_key_create(&exitKey(), releaseBuffer);
+    }
+    static void watchThreadExit(MgTraceBuffer* buf) {
+        static pthread_once_t once = PTHREAD_ONCE_INIT;
+        pthread_once(&once, createExitKey);
+        pthread_setspecific(exitKey(), buf);
+    }
+#endif
+};
+
+//! 记录一个跟踪区间的辅助类，在析构时写入当前线程的环形缓冲
+class MgTraceScope {
+public:
+    MgTraceScope(const char* name) : _name(name), _start(MgTraceRegistry::now()) {}
+    ~MgTraceScope() {
+        MgTraceBuffer* buf = MgTraceRegistry::current();
+        if (buf) {
+            MgTraceBuffer::Event& e = buf->events[buf->count % MgTraceBuffer::kMaxEvents];
+            e.name = _name;
+            e.start = _start;
+            e.dur = MgTraceRegistry::now() - _start;
+            giAtomicIncrement(&buf->count);     // 先写事件再发布计数
+        }
+    }
+private:
+    const char* _name;
+    long long   _start;
+};
+
+//! 将所有线程的跟踪记录输出为 Chrome trace_event 格式的JSON文本
+/*! 可在 chrome://tracing 或 Perfetto 中打开。写入线程不加锁，
+    正被覆盖的最旧一个槽位会被跳过。
+ */
+inline void mgTraceDump(std::string& json)
+{
+    MgTraceRegistry& reg = MgTraceRegistry::instance();
+    long nthreads = reg.count < MgTraceRegistry::kMaxThreads ? reg.count : MgTraceRegistry::kMaxThreads;
+    char tmp[200];
+    bool first = true;
+
+    json = "{\"traceEvents\":[";
+    for (long i = 0; i < nthreads; i++) {
+        const MgTraceBuffer* buf = reg.buffers[i];
+        if (!buf)
+            continue;
+        long end = buf->count;
+        long begin = end > MgTraceBuffer::kMaxEvents ? end - MgTraceBuffer::kMaxEvents + 1 : 0;
+
+        for (long n = begin; n < end; n++) {
+            const MgTraceBuffer::Event& e = buf->events[n % MgTraceBuffer::kMaxEvents];
+            sprintf(tmp, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%ld,\"ts\":%lld,\"dur\":%lld}",
+                    first ? "" : ",", e.name, buf->tid, e.start, e.dur);
+            json += tmp;
+            first = false;
+        }
+    }
+    json += "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+#endif // MG_TRACE
+
+#endif // TOUCHVG_TRACE_H
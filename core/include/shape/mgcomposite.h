@@ -61,10 +61,18 @@ protected:
     bool _offset(const Vector2d& vec, int segment);
     bool _draw(int mode, GiGraphics& gs, const GiContext& ctx, int segment) const;
     void _output(MgPath& path) const;
+    void _invalidateIndex();
 
 protected:
     MgShape*    _owner;
     MgShapes*   _shapes;
+    
+private:
+    struct ChildIndex;
+    ChildIndex* _getIndex() const;
+    const MgShape* _findHandle(int& index) const;
+    mutable ChildIndex* _index;     // 子图形句柄序号前缀和及包络框索引，随改变计数失效
+    mutable volatile long _indexLocker; // 多个绘图线程同时访问时只由一个线程建立索引
 };
 
 //! 成组图形类
@@ -21,11 +21,18 @@ public:
 #endif
     void setName(const char* name);
     
+    //! 返回图像名称在 GiImageRegistry 中的句柄
+    int getImageHandle() const { return _handle; }
+    
     Vector2d getImageSize() const { return _size; }
     void setImageSize(Vector2d size);
     
     static const MgShape* findShapeByImageID(const MgShapes* shapes, const char* name);
     
+#ifndef SWIG
+    virtual void setOwner(MgObject* owner);
+#endif
+
 protected:
     void _copy(const MgImageShape& src);
     bool _equals(const MgImageShape& src) const;
@@ -37,6 +44,11 @@ protected:
 protected:
     char    _name[64];
     Vector2d _size;
+    int     _handle;
+    MgShape* _owner;
+
+private:
+    void setHandle(int handle);
 };
 
 #endif // TOUCHVG_IMAGE_SHAPE_H_
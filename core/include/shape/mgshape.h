@@ -60,6 +60,14 @@ public:
 
     //! 从指定的序列化对象加载图形
     virtual bool load(MgShapeFactory* factory, MgStorage* s);
+    
+#ifndef SWIG
+    //! 保存绘图参数的各项属性
+    static void saveContext(MgStorage* s, const GiContext& ctx);
+    
+    //! 读取绘图参数的各项属性
+    static GiContext loadContext(MgStorage* s);
+#endif
 
     //! 返回图形编号
     virtual int getID() const = 0;
@@ -79,6 +87,11 @@ public:
     virtual void copy(const MgObject& src);
     virtual bool equals(const MgObject& src) const;
     virtual bool isKindOf(int type) const;
+    
+#ifndef SWIG
+    //! 返回是否被多处引用(如前端文档、撤销记录)，被引用的图形不能就地修改
+    virtual bool isShared() const { return true; }
+#endif
 
     //! 显示内部图形
     static bool drawShape(const MgShapes* shapes, const MgBaseShape& sp, int mode,
@@ -6,9 +6,29 @@
 #define TOUCHVG_MGSHAPES_H_
 
 #include "mgshape.h"
+#ifndef SWIG
+#include <vector>
+#endif
 
-//! 图形列表类
+class GiStyleTable;
+
+//! 分批加载图形的进度接口，用于报告进度和取消加载
 /*! \ingroup CORE_SHAPE
+    \interface MgLoadProgress
+ */
+struct MgLoadProgress {
+    virtual ~MgLoadProgress() {}
+    virtual bool isStopping() = 0;      //!< 返回是否需要停止加载
+    //! 图形列表已加载 count 个图形，total 为文件中记录的该列表图形数
+    virtual void onShapeLoaded(MgShapes* shapes, int count, int total) = 0;
+};
+
+//! 图形列表类
+/*! 按类型、标签和图像句柄查找图形时使用二级索引(复合图形按其子图形递归登记)，
+    索引在首次查找时建立，之后随增删图形增量维护，浅拷贝时一并复制。
+    查找函数可在多个绘图线程中用于前端文档。
+    图形的标签和图像名称在加入列表后不应原地修改，应克隆后用 updateShape() 更新。
+    \ingroup CORE_SHAPE
     \see MgShapeIterator
 */
 class MgShapes : public MgObject
@@ -44,6 +64,7 @@ public:
     const MgShape* findShapeByTag(int tag) const;
     const MgShape* findShapeByType(int type) const;
     const MgShape* findShapeByTypeAndTag(int type, int tag) const;
+    const MgShape* findShapeByImageHandle(int handle) const;    //!< 查找图像句柄对应的图像图形，含复合图形的子图形
     Box2d getExtent() const;
     
     const MgShape* hitTest(const Box2d& limits, MgHitResult& res
@@ -63,11 +84,14 @@ public:
     bool saveShape(MgStorage* s, const MgShape* shape, int index) const;
     int load(MgShapeFactory* factory, MgStorage* s, bool addOnly = false);
     void setNewShapeID(int sid);
+#ifndef SWIG
+    void setLoadProgress(MgLoadProgress* p);    //!< 设置加载进度接口，在 load() 中每加载一个图形就通知一次
+#endif
     
     //! 删除所有图形
     void clear();
     
-    //! 释放临时数据内存
+    //! 释放临时数据内存，跳过被其他文档副本引用的图形
     void clearCachedData();
 
     //! 复制(默认为深拷贝)每一个图形，浅拷贝则添加图形的引用计数且不改变图形的拥有者
@@ -95,6 +119,59 @@ public:
     }
     //! 指定新的顺序
     bool reorderShapes(int n, const int *ids);
+    
+    //! 添加已加载的图形到图形列表中，不复制图形对象，尽量使用给定的ID
+    bool addShapeWithID(MgShape* shape, int sid);
+    
+    //! 批量添加新图形到图形列表末尾，不复制图形对象，返回添加的图形数
+    int addShapes(int n, MgShape* const* shapes, bool force = true);
+    
+    //! 批量更新为新的图形，按ID直接定位而不遍历图形列表，返回更新的图形数
+    /*! 已更新的图形由本列表接管，原图形对象会被释放；
+        同一ID有多个新图形时只用第一个，其余的也由本列表释放；
+        没有对应原图形的新图形仍由调用者释放
+     */
+    int updateShapes(int n, MgShape* const* shapes, bool force = true);
+    
+    //! 批量移除图形，按ID直接定位而不遍历图形列表，返回移除的图形数
+    int removeShapes(int n, const int* ids);
+    
+    //! 图形的标签或图像句柄原地改变后更新本列表及上级列表的索引，由 setTag() 等调用
+    void updateIndex(const MgShape* shape);
+    
+    //! 返回图形加入本列表时绘图参数改用的登记表，图层为所属文档的登记表，复合图形的子图形列表随上级列表
+    virtual GiStyleTable* getStyleTable() const;
+    
+    //! 批量变形图形，返回变形的图形数
+    /*! 只被本列表引用的图形就地变形，被共享的图形复制后变形再一次性替换(写时复制)。
+        各图形分块并行变形，ids 为NULL时变形全部图形。
+     */
+    int transformShapes(int n, const int* ids, const Matrix2d& mat);
+    
+    //! 开始原地重建本列表(例如每帧重新生成的动态图形)，列表被共享时返回false
+    /*! 重建期间 addShape() 和 addShapeDirect() 按顺序复用原有的同类图形对象和列表结点，
+        endReuse() 移除未复用的图形并保留其中几个，各帧的图形相似时重建不再分配内存。
+        重建期间只应按顺序添加图形，不要移动图形。
+     */
+    bool beginReuse();
+    
+    //! 返回重建位置上未被共享的指定类型(MgShape::getType())的图形并增加其引用计数，没有则返回NULL
+    /*! 调用者修改该图形后传给 addShapeDirect()，或放弃时调用其 release() */
+    MgShape* reuseShape(int type);
+    
+    //! 结束原地重建，移除未复用的图形
+    void endReuse();
+    
+    //! 开始记录本列表中改动的图形ID，之后的浅拷贝共享该记录，用于只按改动比较前后快照
+    /*! 只有开始记录的列表追加记录，浅拷贝得到的列表(快照)改动时不再共享该记录。
+     */
+    void trackChanges() const;
+    
+    //! 得到从较早的快照 base 到本列表改动过的图形ID，按首次改动的次序
+    /*! 返回改动的图形数。二者不是同一记录的先后快照、记录已丢弃、
+        图形次序可能改变或改动无法按ID确定时返回-1，此时应逐个比较图形。
+     */
+    int getChangedIDs(const MgShapes* base, std::vector<int>& ids) const;
 #endif
     
     //! 复制出一个新图形对象
@@ -106,12 +183,15 @@ public:
     //! 移除一个图形
     bool removeShape(int sid);
 
-    //! 将一个图形移到另一个图形列表
+    //! 将一个图形移到另一个图形列表，图形未被其他文档副本引用时直接转移图形对象
     bool moveShapeTo(int sid, MgShapes* dest);
 
     //! 将所有图形复制到另一个图形列表
     void copyShapesTo(MgShapes* dest) const;
     
+    //! 将所有图形移到另一个图形列表，返回移动的图形数。只复制被其他文档副本引用的图形
+    int moveShapesTo(MgShapes* dest);
+    
     //! 移动图形到最后，以便显示在最顶部
     bool bringToFront(int sid);
     
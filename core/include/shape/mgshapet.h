@@ -5,11 +5,14 @@
 #ifndef TOUCHVG_MGSHAPE_TEMPL_H_
 #define TOUCHVG_MGSHAPE_TEMPL_H_
 
-#include "mgshape.h"
+#include "mgshapes.h"
+#include "gistyletable.h"
 
 //! 矢量图形模板类
 /*! \ingroup CORE_SHAPE
     使用 MgShapeT<ShapeClass>::registerCreator() 登记图形种类;
+    绘图参数默认内联在图形中，可用 MgShapeT<ShapeClass, GiSharedContext> 登记为共享的登记项，
+    相同参数的图形引用同一项，但创建和加入图形列表时需在登记表中查找。
  */
 template <class ShapeT, class ContextT = GiContext>
 class MgShapeT : public MgShape
@@ -26,8 +29,7 @@ public:
     MgShapeT() : _id(0), _parent((MgShapes*)0), _tag(0), _refcount(1) {
     }
     
-    MgShapeT(const ContextT& ctx) : _id(0), _parent((MgShapes*)0), _tag(0) {
-        _context = ctx;
+    MgShapeT(const ContextT& ctx) : _context(ctx), _id(0), _parent((MgShapes*)0), _tag(0), _refcount(1) {
     }
     
     virtual ~MgShapeT() {
@@ -74,8 +76,12 @@ public:
         giAtomicIncrement(&_refcount);
     }
     
+    bool isShared() const {
+        return giAtomicLoad(const_cast<volatile long*>(&_refcount)) > 1;
+    }
+    
     MgObject* clone() const {
-        ThisClass *p = new ThisClass;
+        ThisClass *p = new ThisClass(_context);     // 共享的绘图参数直接引用，不必再登记
         p->copy(*this);
         return p;
     }
@@ -91,6 +97,9 @@ public:
     void setParent(MgShapes* p, int sid) {
         _parent = p;
         _id = sid;
+        if (p && !isShared()) {
+            bindStyle(_context, p);     // 改用所在文档的登记表，共享的图形不变
+        }
         shape()->setOwner(this);
     }
 
@@ -99,7 +108,17 @@ public:
     }
 
     void setTag(int tag) {
-        _tag = tag;
+        if (_tag != tag) {
+            _tag = tag;
+            if (_parent)
+                _parent->updateIndex(this);     // 原地改了标签，更新所在列表的索引
+        }
+    }
+    
+private:
+    static void bindStyle(GiContext&, MgShapes*) {}
+    static void bindStyle(GiSharedContext& ctx, MgShapes* p) {
+        giBindStyle(ctx, p->getStyleTable());
     }
 };
 
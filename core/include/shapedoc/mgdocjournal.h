@@ -0,0 +1,56 @@
+﻿//! \file mgdocjournal.h
+//! \brief 定义增量自动保存的日志类 MgDocJournal
+// Copyright (c) 2004-2015, https://github.com/rhcad/vgcore, BSD License
+
+#ifndef TOUCHVG_DOCJOURNAL_H_
+#define TOUCHVG_DOCJOURNAL_H_
+
+class MgShapeDoc;
+struct MgShapeFactory;
+class GiTransform;
+
+//! 增量自动保存的日志类，在图形文件旁的 vgfile.log 中追加改动记录
+/*! 每次保存只将与上次保存的文档快照的差异(见 MgDocPatch)作为一条记录追加到日志，
+    记录带有序号和校验和，写入中断的不完整记录在恢复时被忽略并截掉。
+    图形文件(基础文件)的JSON根节点中记录了已包含的最后记录序号，
+    恢复时加载基础文件后依次应用序号较新的记录。
+    日志超过基础文件一定比例时，在后台线程将快照写到临时文件再替换基础文件，
+    下次保存时去掉日志中已包含在基础文件中的记录。
+    \ingroup CORE_SHAPE
+ */
+class MgDocJournal
+{
+public:
+    MgDocJournal();
+    ~MgDocJournal();
+
+    //! 打开图形文件及其日志，将基础文件和日志中的改动加载到文档
+    /*! 图形文件不存在时不改变文档，首次保存时写出基础文件。图形文件加载失败时返回false。
+     */
+    bool open(const char* vgfile, MgShapeDoc* doc, MgShapeFactory* factory,
+              GiTransform* xform = (GiTransform*)0);
+
+    //! 等待后台重写结束并关闭日志，compact 为true时将最后保存的快照完整写到基础文件
+    void close(bool compact = false);
+
+    bool isOpened() const;              //!< 返回是否已打开
+    long long getLogSize() const;       //!< 返回日志文件的字节数
+    long long getBaseSize() const;      //!< 返回基础文件的字节数
+
+    //! 设置日志超过基础文件的比例，超过时在后台重写基础文件
+    void setCompactRatio(float ratio);
+
+    //! 保存自上次保存以来的改动，返回改动项数，没有改动时返回0，失败返回-1
+    /*! \param doc 不再改变的文档快照(如前端文档)，本对象保留其引用作为下次比较的起点
+     */
+    int save(const MgShapeDoc* doc);
+
+private:
+    struct Impl;
+    Impl*   im;
+
+    MgDocJournal(const MgDocJournal&);
+    void operator=(const MgDocJournal&);
+};
+
+#endif // TOUCHVG_DOCJOURNAL_H_
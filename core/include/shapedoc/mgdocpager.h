@@ -0,0 +1,57 @@
+﻿//! \file mgdocpager.h
+//! \brief 定义按显示范围分页加载图形的类 MgDocPager
+// Copyright (c) 2004-2015, https://github.com/rhcad/vgcore, BSD License
+
+#ifndef TOUCHVG_DOCPAGER_H_
+#define TOUCHVG_DOCPAGER_H_
+
+#include "mgbox.h"
+
+class MgShapeDoc;
+struct MgShapeFactory;
+class GiTransform;
+
+//! 按显示范围分页加载超大图形文档的类
+/*! 打开文件时根据每个图形保存的包络框建立空间索引(缓存在 vgfile.idx 中)，
+    每次 update() 只加载与窗口(含边距)相交的图形，并释放远离窗口的图形，
+    使内存占用与窗口内容而不是文件大小成正比。分页加载的文档应为只读。
+    \ingroup CORE_SHAPE
+ */
+class MgDocPager
+{
+public:
+    MgDocPager();
+    ~MgDocPager();
+
+    //! 打开图形文件，建立或读取空间索引文件
+    bool open(const char* vgfile, bool useIndexFile = true);
+
+    //! 关闭文件，不改变已加载的图形
+    void close();
+
+    bool isOpened() const;          //!< 返回是否已打开文件
+    int getShapeCount() const;      //!< 返回文件中的图形总数
+    int getLoadedCount() const;     //!< 返回当前已加载的图形数
+    Box2d getExtent() const;        //!< 返回文件中所有图形的模型坐标范围
+
+    //! 设置加载边距(相对窗口宽高的比例)和同时加载的最大图形数(0表示不限)
+    void setLimits(float margin, int maxShapes);
+
+    //! 加载文档属性和空的图层，不加载图形，xform 不为NULL时放缩到文档初始状态
+    bool loadSkeleton(MgShapeDoc* doc, MgShapeFactory* factory, GiTransform* xform = (GiTransform*)0);
+
+    //! 加载与模型坐标窗口相交的图形，释放远离窗口的图形，返回加载和释放的图形数
+    /*! \param keepIds 不释放的图形ID(例如选中的图形)，可为NULL
+     */
+    int update(MgShapeDoc* doc, MgShapeFactory* factory, const Box2d& rectM,
+               const int* keepIds = (const int*)0, int keepCount = 0);
+
+private:
+    struct Impl;
+    Impl*   im;
+
+    MgDocPager(const MgDocPager&);
+    void operator=(const MgDocPager&);
+};
+
+#endif // TOUCHVG_DOCPAGER_H_
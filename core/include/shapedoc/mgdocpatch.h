@@ -0,0 +1,37 @@
+﻿//! \file mgdocpatch.h
+//! \brief 定义文档版本间的二进制差异补丁类 MgDocPatch
+// Copyright (c) 2004-2015, https://github.com/rhcad/vgcore, BSD License
+
+#ifndef TOUCHVG_DOCPATCH_H_
+#define TOUCHVG_DOCPATCH_H_
+
+#include <vector>
+
+class MgShapeDoc;
+struct MgShapeFactory;
+
+//! 文档版本间的二进制差异补丁，用于多设备同步时只传输改动
+/*! 按图形ID和改变计数比较两个文档快照(例如两次 acquireFrontDoc 得到的前端文档)，
+    同一文档的浅拷贝快照间按图层的改动记录(见 MgShapes::getChangedIDs)只比较改动过的图形，
+    记录各图层中删除、添加、改变几何形状、只改变绘图参数或标签的图形，
+    图形次序改变时再记录新的ID次序，以及页面范围的改变。
+    改动的图形按键值对编码为紧凑的二进制，字段名只在首次出现时写出。
+    \ingroup CORE_SHAPE
+ */
+class MgDocPatch
+{
+public:
+    //! 计算从 from 到 to 的补丁，返回改动项数，没有改动时为0且仍生成空补丁
+    /*! from 为NULL时按空文档计算，即补丁包含 to 的全部图形。
+     */
+    static int make(const MgShapeDoc* from, const MgShapeDoc* to,
+                    std::vector<unsigned char>& patch);
+
+    //! 将补丁应用到与其起始版本一致的文档，补丁无效或起始版本不符时不改变文档
+    /*! 只处理补丁涉及的图形，按ID直接删除和替换，耗时与补丁大小而不是图层大小相关。
+     */
+    static bool apply(MgShapeDoc* doc, MgShapeFactory* factory,
+                      const unsigned char* data, int size);
+};
+
+#endif // TOUCHVG_DOCPATCH_H_
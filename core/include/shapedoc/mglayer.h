@@ -38,6 +38,9 @@ public:
     virtual bool equals(const MgObject& src) const;
     virtual int getType() const { return Type(); }
     virtual bool isKindOf(int type) const { return type == Type() || type == MgShapes::Type(); }
+#ifndef SWIG
+    virtual GiStyleTable* getStyleTable() const;
+#endif
     
 protected:
     MgLayer(MgShapeDoc* doc, int index);
@@ -9,6 +9,7 @@
 
 class MgLayer;
 struct MgShapeFactory;
+class GiStyleIndex;
 
 //! 图形文档
 /*! \ingroup CORE_SHAPE
@@ -42,11 +43,25 @@ public:
     
     //! 加载图形，并自动放缩到之前的状态
     bool loadAll(MgShapeFactory* factory, MgStorage* s, GiTransform* xform);
+    
+#ifndef SWIG
+    //! 设置加载进度接口，可在工作线程中分批提交已加载的图形或取消加载
+    void setLoadProgress(MgLoadProgress* p);
+    
+    //! 返回本文档及其副本共享的绘图参数登记表
+    GiStyleTable* getStyleTable() const;
+    
+    //! 读出文档的绘图参数表(styles 节点)，s 应位于 shapedoc 节点内，用于单独加载图形
+    static void loadStyles(MgStorage* s, GiStyleIndex& styles);
+#endif
+    
+    //! 将所有图层的图形和页面参数移到另一文档，返回移动的图形数。只复制被其他文档副本引用的图形
+    int moveShapesTo(MgShapeDoc* dest);
 
     //! 删除所有图形
     void clear();
 
-    //! 释放临时数据内存
+    //! 释放临时数据内存，跳过被其他文档副本引用的图形
     void clearCachedData();
 
     //! 显示所有图形
@@ -80,6 +95,9 @@ public:
     
     //! 返回当前图层
     MgLayer* getCurrentLayer() const;
+    
+    //! 返回指定序号的图层，序号无效则返回NULL
+    MgLayer* getLayer(int index) const;
 
     //! 切换图层，自动追加末尾图层
     bool switchLayer(int index);
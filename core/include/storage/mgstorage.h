@@ -5,6 +5,14 @@
 #ifndef TOUCHVG_MGSTORAGE_H_
 #define TOUCHVG_MGSTORAGE_H_
 
+#ifndef SWIG
+#include <string.h>
+#include <string>
+#include <vector>
+#endif
+
+class GiStyleIndex;
+
 //! 图形存取接口
 /*! \ingroup CORE_STORAGE
     \interface MgStorage
@@ -76,6 +84,86 @@ struct MgStorage
 
     //! 设置读写错误描述文字，总是返回false
     virtual bool setError(const char* errdesc) { return !errdesc; }
+    
+#ifndef SWIG
+    //! 创建定位在当前节点的只读存取对象，与本对象共享已解析的数据，可在其他线程中读取子节点
+    /*! 返回的对象由调用者 delete，使用期间本对象不能离开当前节点。不支持并行读取则返回NULL。
+     */
+    virtual MgStorage* cloneForRead() { return (MgStorage*)0; }
+    
+    //! 返回是否将带序号的节点写为数组，此时同级的命名节点会被数组取代
+    virtual bool isArrayMode() const { return false; }
+    
+    //! 返回保存文档时是否写出绘图参数表、图形只写参数序号，默认各图形写出自己的参数
+    virtual bool isStyleIndexMode() const { return false; }
+    
+    //! 将二进制数据按 base64 编码为字符串键值写入，适合JSON等文本存储
+    void writeBinary(const char* name, const unsigned char* data, int size);
+    
+    //! 读取 writeBinary() 写入的键值并解码到 data，返回字节数，没有该键值或编码错误时返回0
+    int readBinary(const char* name, std::vector<unsigned char>& data);
+    
+    MgStorage() : _styles((GiStyleIndex*)0) {}
+    
+    //! 返回文档读写期间的绘图参数序号表，为NULL时各图形逐个读写绘图参数
+    GiStyleIndex* getStyleIndex() const { return _styles; }
+    
+    //! 设置绘图参数序号表，由文档在读写图形前后设置
+    void setStyleIndex(GiStyleIndex* styles) { _styles = styles; }
+    
+private:
+    GiStyleIndex*   _styles;
+#endif
 };
 
+#ifndef SWIG
+inline void MgStorage::writeBinary(const char* name, const unsigned char* data, int size)
+{
+    static const char kBase64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string str;
+
+    str.reserve((size + 2) / 3 * 4);
+    for (int i = 0; i < size; i += 3) {
+        unsigned int v = data[i] << 16;
+        if (i + 1 < size) v |= data[i + 1] << 8;
+        if (i + 2 < size) v |= data[i + 2];
+        str += kBase64[(v >> 18) & 63];
+        str += kBase64[(v >> 12) & 63];
+        str += i + 1 < size ? kBase64[(v >> 6) & 63] : '=';
+        str += i + 2 < size ? kBase64[v & 63] : '=';
+    }
+    writeString(name, str.c_str());
+}
+
+inline int MgStorage::readBinary(const char* name, std::vector<unsigned char>& data)
+{
+    static const char kBase64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    int len = readString(name);
+    unsigned int v = 0;
+    int bits = 0;
+
+    data.clear();
+    if (len < 1)
+        return 0;
+
+    std::vector<char> str(len + 1, 0);
+    len = readString(name, &str[0], len);
+    data.reserve(len / 4 * 3);
+    for (int i = 0; i < len && str[i] != '='; i++) {
+        const char* c = strchr(kBase64, str[i]);
+        if (!c || !*c) {
+            data.clear();
+            return 0;
+        }
+        v = (v << 6) | (unsigned int)(c - kBase64);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            data.push_back((unsigned char)(v >> bits));
+        }
+    }
+    return (int)data.size();
+}
+#endif
+
 #endif // TOUCHVG_MGSTORAGE_H_
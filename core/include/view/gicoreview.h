@@ -13,6 +13,29 @@ class GiCanvas;
 class GiCoreViewImpl;
 struct MgView;
 
+//! 异步加载图形的进度回调接口
+/*! \ingroup CORE_VIEW
+    \interface MgLoadingCallback
+ */
+struct MgLoadingCallback {
+    virtual ~MgLoadingCallback() {}
+    //! 已提交 count 个图形到前端(播放项 playh)，total 为已知的图形总数，可在此请求刷新显示
+    virtual void onLoadingProgress(long playh, int count, int total) = 0;
+};
+
+//! 渲染服务的离屏绘图目标接口
+/*! 本接口的函数在渲染服务的工作线程中调用，见 GiCoreView::startRenderService()
+    \ingroup CORE_VIEW
+    \interface GiRenderTarget
+ */
+struct GiRenderTarget {
+    virtual ~GiRenderTarget() {}
+    //! 开始绘制第 frame 帧，返回宽高为 width、height 的离屏画布，返回NULL则跳过本帧
+    virtual GiCanvas* beginFrame(int frame, int width, int height) = 0;
+    //! 结束绘制，completed 为true表示可显示此帧，为false表示已被新的请求中断，count 为绘制的图形数
+    virtual void endFrame(GiCanvas* canvas, int frame, bool completed, int count) = 0;
+};
+
 //! 获取配置项的回调接口
 /*! \ingroup CORE_VIEW
     \interface MgOptionCallback
@@ -83,13 +106,22 @@ public:
     bool twoFingersMove(GiView* view, GiGestureState state,
             float x1, float y1, float x2, float y2, bool switchGesture = false);
     
+    void setFrameScheduling(bool enabled);                          //!< 设置是否按帧合并重绘请求，启用后由 onFrameTick() 发出
+    int onFrameTick();                                              //!< 在每帧开始时(如vsync回调)发出累积的更新，返回0-无,1-重绘,2-追加图形,3-重新生成
+    float onFramePresented();                                       //!< 在一帧显示后调用，返回输入到显示的毫秒数，无待显示的更新时返回-1
+    int getFrameStats(mgvector<float>& stats);                      //!< 得到最近各帧的统计: 帧数,请求数,更新数,平均/中位/P95/最大延迟毫秒，返回统计的帧数
+    
     bool submitBackDoc(GiView* view, bool changed);                 //!< 提交静态图形到前端，在UI的regen回调中用
     bool submitDynamicShapes(GiView* view);                         //!< 提交动态图形到前端，需要并发保护
+    bool startRenderService(GiView* view, GiRenderTarget* target);  //!< 启动工作线程，每次提交静态图形后自动绘制到离屏画布，在主线程用
+    void stopRenderService(GiView* view);                           //!< 中断绘制并停止视图的渲染服务，在主线程用
     
     float calcPenWidth(GiView* view, float lineWidth);              //!< 计算画笔的像素宽度
     GiGestureType getGestureType();                                 //!< 得到当前手势类型
     GiGestureState getGestureState();                               //!< 得到当前手势状态
     static int getVersion();                                        //!< 得到内核版本号
+    static long getAllocCount();                                    //!< 得到堆分配次数，需定义 MG_ALLOC_COUNTER 编译，否则为-1
+    static bool dumpTrace(MgStringCallback* c);                     //!< 输出性能跟踪记录(Chrome trace JSON)，需定义 MG_TRACE 编译，否则返回false
     bool isZoomEnabled(GiView* view);                               //!< 是否允许放缩显示
     void setZoomEnabled(GiView* view, bool enabled);                //!< 设置是否允许放缩显示
     
@@ -110,6 +142,16 @@ public:
     bool restoreRecord(int type, const char* path, long doc, long changeCount,
                        int index, int count, int tick, long curTick);   //!< 恢复录制
     
+    long beginLoading();                                            //!< 创建异步加载任务，返回播放项句柄，在主线程用
+    bool loadInBackground(long playh, const char* vgfile,
+                          MgLoadingCallback* c = (MgLoadingCallback*)0); //!< 在工作线程中加载图形，分批提交显示，可用 GiPlaying::stop() 取消
+    bool endLoading(long playh, bool readOnly = false);             //!< 应用加载结果到当前文档并释放任务，在主线程用
+    bool loadPagedFile(const char* vgfile, int maxShapes = 0);      //!< 按显示范围分页加载超大图形文件，文档只读，平移放缩时自动加载和释放图形
+    int updatePaging();                                             //!< 按当前显示范围加载和释放分页图形，返回变化的图形数
+    bool openAutoSave(const char* vgfile);                          //!< 加载图形文件并重放其增量保存日志，之后 autoSave() 只追加改动
+    int autoSave(long doc);                                         //!< 将前端文档自上次保存以来的改动追加到日志，返回改动项数，失败为-1
+    void closeAutoSave(bool compact = true);                        //!< 结束增量保存，compact 为true时将日志合并到图形文件
+    
     void traverseOptions(MgOptionCallback* c);                      //!< 遍历选项
     void setOptionBool(const char* name, bool value);               //!< 设置或清除布尔选项值
     void setOptionInt(const char* name, int value);                 //!< 设置或清除整型选项值
@@ -174,6 +216,8 @@ public:
     const char* getContent(long doc);
     void freeContent();
     bool setContent(const char* content, bool readOnly = false);
+    int savePatch(long fromDoc, long toDoc, const char* filename);  //!< 保存两个前端文档间的二进制补丁，返回改动项数
+    bool applyPatch(const char* filename);                          //!< 将 savePatch 的补丁应用到当前文档
     bool zoomToInitial();
     bool zoomToExtent(float margin = 2);
     bool zoomToModel(float x, float y, float w, float h, float margin = 2);
@@ -19,7 +19,7 @@ public:
     static GiPlaying* fromHandle(long h) { GiPlaying* p; *(long*)&p = h; return p; } //!< 转为对象
     long toHandle() const { long h; *(const GiPlaying**)&h = this; return h; }   //!< 得到句柄
     
-    enum { kDrawingTag = -1, kPlayingTag = -2 };
+    enum { kDrawingTag = -1, kPlayingTag = -2, kLoadingTag = -3 };
     static GiPlaying* create(MgCoreView* v, int tag, bool doubleSided = true);   //!< 创建播放项
     
     void release(MgCoreView* v);                //!< 销毁播放项
@@ -30,11 +30,13 @@ public:
     static void releaseDoc(long doc);           //!< 释放 acquireDoc() 返回的句柄
     MgShapeDoc* getBackDoc();                   //!< 得到修改图形用的图形文档
     void submitBackDoc();                       //!< 提交图形文档结果，需要并发保护
+    void clearFrontDoc();                       //!< 释放显示用的图形文档，后端图形不再与之共享
     
     long acquireFrontShapes();                  //!< 得到显示用的图形列表句柄，需要并发保护
     static void releaseShapes(long shapes);     //!< 释放 acquireShapes() 返回的句柄
     long getBackShapesHandle(bool needClear);   //!< 得到修改图形用的动态图形列表句柄
     MgShapes* getBackShapes(bool needClear);    //!< 得到修改图形用的动态图形列表
+    MgShapes* rebuildBackShapes();              //!< 得到原地重建的动态图形列表，复用上上次提交的图形对象，填充后必须提交
     void submitBackShapes();                    //!< 提交动态图形列表结果，需要并发保护
     
     void stop();                                //!< 标记需要停止
@@ -48,6 +48,13 @@ public:
     virtual void viewChanged(GiView* oldview) {}    //!< 当前视图改变的通知
     virtual void shapeWillDelete(int sid) {}        //!< 图形将删除的通知
     virtual void shapeDeleted(int sid) {}           //!< 删除图形的通知
+    
+    //! 批量删除图形的通知，默认逐个调用 shapeDeleted()
+    virtual void shapesDeleted(const mgvector<int>& ids) {
+        for (int i = 0; i < ids.count(); i++) {
+            shapeDeleted(ids.get(i));
+        }
+    }
     virtual bool shapeDblClick(int type, int sid, int tag) { return false; } //!< 通知图形双击编辑
     
     //! 图形点击的通知，返回false继续显示上下文按钮
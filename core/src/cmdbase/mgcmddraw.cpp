@@ -8,11 +8,12 @@
 #include <string.h>
 #include "mglog.h"
 #include "mgstorage.h"
+#include "mglines.h"
 
 Point2d MgCommandDraw::m_lastSnapped[];
 
 MgCommandDraw::MgCommandDraw(const char* name)
-    : MgCommand(name), m_step(0), m_shape(MgShape::Null())
+    : MgCommand(name), m_step(0), m_shape(MgShape::Null()), m_maxPoints(0)
 {
 }
 
@@ -131,6 +132,44 @@ bool MgCommandDraw::_initialize(int shapeType, const MgMotion* sender, MgStorage
     return true;
 }
 
+void MgCommandDraw::compactStroke(const MgMotion* sender)
+{
+    MgBaseShape* sp = m_shape->shape();
+    
+    if (sp->isKindOf(MgBaseLines::Type())
+        && sender->view->getOptionBool("compactStrokes", false)) {
+        ((MgBaseLines*)sp)->compact(sender->displayMmToModel(0.02f));   // 远小于一个像素
+    }
+}
+
+// 取出动态图形作为新图形。折线类图形的顶点多，直接转移动态图形对象而不复制，
+// 另建同类型的空图形作为动态图形；其他图形只有几个顶点，但子类命令可能在动态图形上
+// 设置了专有参数(例如网格间距)，新建的空图形无法继承，故仍复制出新图形。
+MgShape* MgCommandDraw::takeShape(const MgMotion* sender)
+{
+    MgShape* dynsp = MgShape::Null();
+    
+    if (m_shape->shapec()->isKindOf(MgBaseLines::Type())) {
+        dynsp = sender->view->createShapeCtx(m_shape->shapec()->getType(), &m_shape->context());
+    }
+    if (!dynsp) {
+        return m_shape->cloneShape();
+    }
+    
+    for (int bit = kMgSquare; bit <= kMgCanAddVertex; bit++) {  // 沿用命令设置的图形特征
+        dynsp->shape()->setFlag((MgShapeBit)bit, m_shape->shapec()->getFlag((MgShapeBit)bit));
+    }
+    dynsp->setTag(m_shape->getTag());
+    dynsp->setParent(m_shape->getParent(), 0);
+    ((MgBaseLines*)dynsp->shape())->reserve(m_maxPoints);   // 下一笔通常与本笔相近，拟合前的顶点数
+    m_maxPoints = 0;
+    
+    MgShape* newsp = m_shape;
+    m_shape = dynsp;
+    
+    return newsp;
+}
+
 MgShape* MgCommandDraw::addShape(const MgMotion* sender, MgShape* shape)
 {
     shape = shape ? shape : m_shape;
@@ -150,11 +189,13 @@ MgShape* MgCommandDraw::addShape(const MgMotion* sender, MgShape* shape)
     }
     
     if (sender->view->shapeWillAdded(shape)) {
-        newsp = sender->view->shapes()->addShape(*shape);
         if (shape == m_shape) {
+            newsp = takeShape(sender);
+            sender->view->shapes()->addShapeWithID(newsp, newsp->getID());
             m_shape->shape()->clear();
             sender->view->shapeAdded(newsp);
         } else {
+            newsp = sender->view->shapes()->addShape(*shape);
             sender->view->getCmdSubject()->onShapeAdded(sender, newsp);
         }
         if (strcmp(getName(), "splines") != 0) {
@@ -233,6 +274,7 @@ bool MgCommandDraw::touchBegan(const MgMotion* sender)
 
 bool MgCommandDraw::touchMoved(const MgMotion* sender)
 {
+    m_maxPoints = mgMax(m_maxPoints, m_shape->getPointCount());
     sender->view->redraw();
     sender->view->shapeChanged(m_shape);
     return true;
@@ -127,12 +127,7 @@ bool MgCmdErase::touchEnded(const MgMotion* sender)
     
     if (!m_delIds.empty()
         && sender->view->shapeWillDeleted(s->findShape(m_delIds.front()))) {
-        int count = 0;
-        std::vector<int>::iterator it = m_delIds.begin();
-        
-        for (; it != m_delIds.end(); ++it) {
-            count += sender->view->removeShape(s->findShape(*it));
-        }
+        int count = sender->view->removeShapes(mgvector<int>(&m_delIds.front(), (int)m_delIds.size()));
         if (count > 0) {
             sender->view->regenAll(true);
             char buf[31];
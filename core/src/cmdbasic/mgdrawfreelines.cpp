@@ -68,6 +68,7 @@ bool MgCmdDrawFreeLines::touchMoved(const MgMotion* sender)
 bool MgCmdDrawFreeLines::touchEnded(const MgMotion* sender)
 {
     if (m_step > 1) {
+        compactStroke(sender);
         addShape(sender);
     } else {
         click(sender);  // add a point
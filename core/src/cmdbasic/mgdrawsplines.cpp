@@ -20,6 +20,9 @@ bool MgCmdDrawSplines::backStep(const MgMotion* sender)
     if (m_step > 1) {                   // freehand: 去掉倒数第二个点，倒数第一点是临时动态点
         ((MgBaseLines*)dynshape()->shape())->removePoint(m_freehand ? m_step - 1 : m_step);
         dynshape()->shape()->update();
+        if (m_freehand) {
+            restartFitter(sender);
+        }
     }
     
     return MgCommandDraw::backStep(sender);
@@ -61,6 +64,8 @@ bool MgCmdDrawSplines::touchBegan(const MgMotion* sender)
         if (!m_freehand)
             dynshape()->shape()->setPoint(1, pnt);
         dynshape()->shape()->update();
+        if (m_freehand)
+            restartFitter(sender);
         
         return MgCommandDraw::touchBegan(sender);
     }
@@ -80,6 +85,7 @@ bool MgCmdDrawSplines::touchMoved(const MgMotion* sender)
         if (canAddPoint(sender, false)) {
             lines->addPoint(pnt);
             m_step++;
+            m_fitter.addPoint(pnt * sender->view->xform()->modelToDisplay());
         }
     } else {
         dynshape()->shape()->setPoint(m_step, pnt);
@@ -102,17 +108,12 @@ bool MgCmdDrawSplines::touchEnded(const MgMotion* sender)
     if (m_freehand) {
         Tol tol(sender->displayMmToModel(1.f));
         if (m_step > 0 && !dynshape()->shape()->getExtent().isEmpty(tol, false)) {
-            MgShape* newsp = addShape(sender);
-            if (newsp) {/*
-                m_step = 0;
-                sender->view->regenAppend(0);
-                newsp = newsp->cloneShape();
-                lines = (MgSplines*)newsp->shape();
-                lines->smooth(sender->view->xform()->modelToDisplay(),
-                              sender->view->xform()->getWorldToDisplayY() * 0.5f);
-                sender->view->shapes()->updateShape(newsp);
-                sender->view->regenAppend(newsp->getID())*/
+            int n = m_fitter.end();             // 只需拟合最后未固定的点
+            if (n > 2 && n < lines->getPointCount()) {
+                lines->smoothForFitter(m_fitter, sender->view->xform()->modelToDisplay());
             }
+            compactStroke(sender);
+            addShape(sender);
         }
         else {
             click(sender);  // add a point
@@ -146,6 +147,16 @@ bool MgCmdDrawSplines::cancel(const MgMotion* sender)
     return MgCommandDraw::cancel(sender);
 }
 
+void MgCmdDrawSplines::restartFitter(const MgMotion* sender)
+{
+    const GiTransform* xf = sender->view->xform();
+    
+    m_fitter.begin(xf->getWorldToDisplayY() * 0.5f);
+    for (int i = 0, n = dynshape()->getPointCount(); i < n; i++) {
+        m_fitter.addPoint(dynshape()->getPoint(i) * xf->modelToDisplay());
+    }
+}
+
 bool MgCmdDrawSplines::canAddPoint(const MgMotion* sender, bool ended)
 {
     if (!m_freehand && !ended)
@@ -151,6 +151,18 @@ private:
         }
         return n;
     }
+    virtual void onShapesAdded(const MgMotion* sender, const mgvector<int>& ids) {
+        for (Iterator it = _arr.begin(); it != _arr.end(); ++it) {
+            it->first->onShapesAdded(sender, ids);
+        }
+    }
+    virtual int onShapesDeleted(const MgMotion* sender, const mgvector<int>& ids) {
+        int n = 0;
+        for (Iterator it = _arr.begin(); it != _arr.end(); ++it) {
+            n += it->first->onShapesDeleted(sender, ids);
+        }
+        return n;
+    }
     virtual bool onShapeCanRotated(const MgMotion* sender, const MgShape* shape) {
         for (Iterator it = _arr.begin(); it != _arr.end(); ++it) {
             if (!it->first->onShapeCanRotated(sender, shape)) {
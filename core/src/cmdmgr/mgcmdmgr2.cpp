@@ -36,7 +36,10 @@ MgShape* MgCmdManagerImpl::addImageShape(const MgMotion* sender, const char* nam
     
     MgShapeT<MgImageShape> shape;
     
-    shape._context.setFillColor(GiColor::White());    // avoid can't hitted inside
+    GiContext ctx;
+    
+    ctx.setFillColor(GiColor::White());     // avoid can't hitted inside
+    shape.setContext(ctx, GiContext::kFillARGB);
     shape._shape.setName(name);
     shape._shape.setRect2P(rect.leftTop(), rect.rightBottom());
     shape._shape.setImageSize(Vector2d(w, h));
@@ -84,12 +87,7 @@ void MgCmdManagerImpl::eraseWnd(const MgMotion* sender)
     
     if (!delIds.empty()
         && sender->view->shapeWillDeleted(s->findShape(delIds.front()))) {
-        std::vector<int>::iterator i = delIds.begin();
-        int n = 0;
-        
-        for (; i != delIds.end(); ++i) {
-            n += sender->view->removeShape(s->findShape(*i));
-        }
+        int n = sender->view->removeShapes(mgvector<int>(&delIds.front(), (int)delIds.size()));
         if (n > 0) {
             sender->view->regenAll(true);
             char buf[31];
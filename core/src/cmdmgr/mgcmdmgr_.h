@@ -8,6 +8,7 @@
 #include "mgcmdmgr.h"
 #include "mgsnap.h"
 #include "mgaction.h"
+#include "mgpath.h"
 #include <map>
 #include <string>
 
@@ -103,6 +104,7 @@ private:
     int             _snapShapeId;
     int             _snapHandle;
     int             _snapHandleSrc;
+    MgPath          _snapPaths[2];  // 捕捉交点时重复使用的路径缓冲
 };
 
 #endif // TOUCHVG_CMD_MANAGER_IMPL_H_
@@ -6,6 +6,7 @@
 #include <string.h>
 #include <algorithm>
 #include <functional>
+#include <map>
 #include "mgsnap.h"
 #include "mgaction.h"
 #include "mgcomposite.h"
@@ -212,7 +213,7 @@ bool MgCmdSelect::backStep(const MgMotion* sender)
 
 bool MgCmdSelect::draw(const MgMotion* sender, GiGraphics* gs)
 {
-    std::vector<const MgShape*> selection;
+    std::vector<const MgShape*>& selection = m_selection;
     const std::vector<const MgShape*>& shapes = (m_clones.empty() ? selection : (std::vector<const MgShape*>&)m_clones);
     std::vector<const MgShape*>::const_iterator it;
     Point2d pnt;
@@ -224,6 +225,7 @@ bool MgCmdSelect::draw(const MgMotion* sender, GiGraphics* gs)
     bool boxrorate = (!isEditMode(sender->view) && m_boxHandle >= 8 && m_boxHandle < 12);
     
     // 从 m_selIds 得到临时图形数组 selection
+    selection.clear();
     for (sel_iterator its = m_selIds.begin(); its != m_selIds.end(); ++its) {
         const MgShape* shape = getShape(*its, sender);
         if (shape)
@@ -473,7 +475,9 @@ Point2d MgCmdSelect::snapPoint(const MgMotion* sender, const MgShape* shape)
 {
     CmdSubject *subject = sender->view->getCmdSubject();
     int n = (int)m_clones.size();
-    std::vector<int> ignoreids(50 + n, 0);
+    std::vector<int>& ignoreids = m_ignoreIds;  // 重用数组，避免拖动时每次分配内存
+    
+    ignoreids.assign(50 + n, 0);
     
     for (unsigned i = 0; i < m_clones.size(); i++)
         ignoreids[i] = m_clones[i]->getID();
@@ -1126,6 +1130,8 @@ bool MgCmdSelect::applyCloneShapes(MgView* view, bool apply, bool addNewShapes)
         m_clones.clear();
     }
     else if (!m_clones.empty()) {
+        std::vector<int> added;
+        
         if (addNewShapes) {
             m_selIds.clear();
             m_id = 0;
@@ -1139,7 +1145,7 @@ bool MgCmdSelect::applyCloneShapes(MgView* view, bool apply, bool addNewShapes)
             if (addNewShapes) {
                 if (view->shapeWillAdded(m_clones[i])
                     && view->shapes()->addShapeDirect(m_clones[i])) {
-                    view->shapeAdded(m_clones[i]);
+                    added.push_back(m_clones[i]->getID());
                     m_selIds.push_back(m_clones[i]->getID());
                     m_id = m_clones[i]->getID();
                     changed = true;
@@ -1166,6 +1172,9 @@ bool MgCmdSelect::applyCloneShapes(MgView* view, bool apply, bool addNewShapes)
             }
         }
         m_clones.clear();
+        if (!added.empty()) {
+            view->shapesAdded(mgvector<int>(&added.front(), (int)added.size()));
+        }
     }
     if (changed) {
         view->regenAll(true);
@@ -1272,13 +1281,19 @@ bool MgCmdSelect::deleteSelection(const MgMotion* sender)
     if (shape && sender->view->shapeWillDeleted(shape)) {
         applyCloneShapes(sender->view, false);
 
+        mgvector<int> ids((int)m_selIds.size());
+        int n = 0;
+        
         for (sel_iterator it = m_selIds.begin(); it != m_selIds.end(); ++it) {
             shape = sender->view->shapes()->findShape(*it);
             if (shape && !shape->shapec()->isLocked()
                 && !shape->shapec()->getFlag(kMgNoDel)) {
-                count += sender->view->removeShape(shape);
+                ids.set(n++, shape->getID());
             }
         }
+        if (n > 0) {
+            count = sender->view->removeShapes(mgvector<int>(ids.address(), n));
+        }
         
         m_selIds.clear();
         m_id = 0;
@@ -1344,6 +1359,9 @@ bool MgCmdSelect::ungroupSelection(const MgMotion* sender)
     if (oldsp && !m_shapeEdited && sender->view->shapeWillDeleted(oldsp)) {
         applyCloneShapes(sender->view, false);
 
+        mgvector<int> ids((int)m_selIds.size());
+        int n = 0;
+        
         for (sel_iterator it = m_selIds.begin(); it != m_selIds.end(); ++it) {
             oldsp = sender->view->shapes()->findShape(*it);
             if (oldsp && oldsp->shapec()->isKindOf(MgGroup::Type())) {
@@ -1351,10 +1369,13 @@ bool MgCmdSelect::ungroupSelection(const MgMotion* sender)
                     const MgGroup* group = (const MgGroup*)oldsp->shapec();
                     
                     group->shapes()->copyShapesTo(oldsp->getParent());
-                    count += sender->view->removeShape(oldsp);
+                    ids.set(n++, oldsp->getID());
                 }
             }
         }
+        if (n > 0) {
+            count = sender->view->removeShapes(mgvector<int>(ids.address(), n));
+        }
         
         m_id = 0;
         m_selIds.clear();
@@ -1603,17 +1624,19 @@ bool MgCmdSelect::overturnPolygon(const MgMotion* sender)
 
 bool MgCmdSelect::applyTransform(const MgMotion* sender, const Matrix2d& xf)
 {
+    std::map<MgShapes*, std::vector<int> > groups;    // 按所在图形列表批量变形
     int count = 0;
     
     for (sel_iterator it = m_selIds.begin(); it != m_selIds.end(); ++it) {
         const MgShape* oldsp = sender->view->shapes()->findShape(*it);
         if (oldsp) {
-            MgShape* newsp = oldsp->cloneShape();
-            newsp->shape()->transform(xf);
-            oldsp->getParent()->updateShape(newsp);
-            count++;
+            groups[oldsp->getParent()].push_back(*it);
         }
     }
+    for (std::map<MgShapes*, std::vector<int> >::iterator it = groups.begin();
+         it != groups.end(); ++it) {
+        count += it->first->transformShapes((int)it->second.size(), &it->second.front(), xf);
+    }
     if (count > 0) {
         sender->view->regenAll(true);
         longPress(sender);
@@ -109,6 +109,8 @@ private:
     bool                    m_dragging;         // 是否正在拖动
     bool                    m_canRotateHandle;  // 是否允许绕控制点旋转
     bool                    m_shapeEdited;      // 图形可自定义编辑
+    std::vector<const MgShape*> m_selection;    // draw中重复使用的选中图形数组
+    std::vector<int>        m_ignoreIds;        // snapPoint中重复使用的忽略图形ID数组
 };
 
 #endif // TOUCHVG_CMD_SELECT_H_
@@ -5,6 +5,7 @@
 #include "mgbasicsps.h"
 #include "mgcomposite.h"
 #include "mglog.h"
+#include "mgtrace.h"
 
 //! 捕捉结果
 struct SnapItem {
@@ -147,7 +148,7 @@ static bool snapHandle(const MgMotion* sender, const Point2d& orgpt, int mask,
 
 static bool snapPerp(const MgMotion* sender, const Point2d& orgpt, const Tol& tol,
                      const MgShape* shape, const MgShape* sp, SnapItem& arr0,
-                     bool perpOut, const Box2d& nearBox)
+                     bool perpOut, const Box2d& nearBox, MgPath* paths)
 {
     int ret = -1;
     const MgBaseShape* s = sp->shapec();
@@ -184,12 +185,16 @@ static bool snapPerp(const MgMotion* sender, const Point2d& orgpt, const Tol& to
                         pt2 = arr0.pt;
                         int n = MgEllipse::crossCircle(pt1, pt2, sp2->shapec());
                         if (n < 0) {
-                            MgPath path1;
+                            MgPath& path1 = paths[0];
+                            MgPath& path2 = paths[1];
                             
+                            path1.clear();
                             path1.moveTo(pt1);
                             path1.lineTo(pt1 + (pt2 - pt1) * 2.f);
+                            path2.clear();
+                            sp2->shapec()->output(path2);
                             
-                            path1.crossWithPath(sp2->shapec()->getPath(), Box2d(orgpt, 1e10f, 0), arr0.pt);
+                            path1.crossWithPath(path2, Box2d(orgpt, 1e10f, 0), arr0.pt);
                         } else if (n > 0) {
                             arr0.pt = pt2.distanceTo(orgpt) < pt1.distanceTo(orgpt) ? pt2 : pt1;
                         }
@@ -474,7 +479,7 @@ static void snapGrid(const MgMotion*, const Point2d& orgpt,
 static bool snapCross(const MgMotion* sender, const Point2d& orgpt,
                       const int* ignoreids, int ignoreHd,
                       const MgShape* shape, const MgShape* sp1,
-                      SnapItem& arr0, Point2d* matchpt)
+                      SnapItem& arr0, Point2d* matchpt, MgPath* paths)
 {
     MgShapeIterator it(sender->view->shapes());
     Point2d ptd, ptcross, pt1, pt2;
@@ -498,7 +503,11 @@ static bool snapCross(const MgMotion* sender, const Point2d& orgpt,
             continue;
         }
         
-        MgPath path1(sp1->shapec()->getPath());
+        MgPath& path1 = paths[0];   // 重用路径缓冲，避免拖动时每次分配内存
+        MgPath& path2 = paths[1];
+        
+        path1.clear();
+        sp1->shapec()->output(path1);
         
         while (const MgShape* sp2 = it.getNext()) {
             if (skipShape(ignoreids, sp2) || sp2 == shape || sp2 == sp1
@@ -510,7 +519,9 @@ static bool snapCross(const MgMotion* sender, const Point2d& orgpt,
             int n = MgEllipse::crossCircle(pt1, pt2, sp1->shapec(), sp2->shapec(), orgpt);
             
             if (n < 0) {
-                n = path1.crossWithPath(sp2->shapec()->getPath(), snapbox, ptcross) ? 1 : 0;
+                path2.clear();
+                sp2->shapec()->output(path2);
+                n = path1.crossWithPath(path2, snapbox, ptcross) ? 1 : 0;
             } else if (n > 0) {
                 ptcross = pt2.distanceTo(ptd) < pt1.distanceTo(ptd) ? pt2 : pt1;
                 n = snapbox.contains(ptcross) ? 1 : 0;
@@ -593,7 +604,7 @@ static void snapShape(const MgMotion* sender, const Point2d& orgpt,
                       bool needTangent, bool needCross, bool needParallel, const Box2d& nearBox, bool needGrid,
                       const MgShape* spTarget, const MgShape* shape, int ignoreHd,
                       const int* ignoreids, SnapItem arr[3],
-                      Point2d* matchpt, const Point2d& ignoreStart)
+                      Point2d* matchpt, const Point2d& ignoreStart, MgPath* paths)
 {
     if (skipShape(ignoreids, spTarget) || spTarget == shape) {
         return;
@@ -608,8 +619,8 @@ static void snapShape(const MgMotion* sender, const Point2d& orgpt,
     }
     if (extent.isIntersect(wndbox)) {
         b |= (handleMask && snapHandle(sender, orgpt, handleMask, shape, ignoreHd, spTarget, arr[0], matchpt));
-        b |= (needPerp && snapPerp(sender, orgpt, tolPerp, shape, spTarget, arr[0], perpOut, nearBox));
-        b |= (needCross && snapCross(sender, orgpt, ignoreids, ignoreHd, shape, spTarget, arr[0], matchpt));
+        b |= (needPerp && snapPerp(sender, orgpt, tolPerp, shape, spTarget, arr[0], perpOut, nearBox, paths));
+        b |= (needCross && snapCross(sender, orgpt, ignoreids, ignoreHd, shape, spTarget, arr[0], matchpt, paths));
         b |= (needParallel && shape && snapParallel(sender, orgpt, ignoreids, ignoreHd, shape, spTarget, arr[0]));
         b |= (needTangent && shape && snapTangent(sender, orgpt, shape, ignoreHd, spTarget, arr[0], matchpt));
         
@@ -646,7 +657,8 @@ static inline int getHandleMask(MgView* view)
 static void snapPoints(const MgMotion* sender, const Point2d& orgpt,
                        const MgShape* shape, int ignoreHd,
                        const int* ignoreids, SnapItem arr[3],
-                       Point2d* matchpt, const Point2d& ignoreStart, bool startMustVertex)
+                       Point2d* matchpt, const Point2d& ignoreStart, bool startMustVertex,
+                       MgPath* paths)
 {
     if (!sender->view->getOptionBool("snapEnabled", true)
         || (shape && ignoreHd >= 0 &&
@@ -681,7 +693,7 @@ static void snapPoints(const MgMotion* sender, const Point2d& orgpt,
                   handleMask, needNear, needExtend, tolNear,
                   needPerp, perpOut, tolPerp,
                   needTangent, needCross, needParallel, nearBox, needGrid,
-                  spTarget, shape, ignoreHd, ignoreids, arr, matchpt, ignoreStart);
+                  spTarget, shape, ignoreHd, ignoreids, arr, matchpt, ignoreStart, paths);
         
         if (spTarget->shapec()->isKindOf(MgGroup::Type())
             && sender->view->getOptionBool("snapInGroup", false)) {
@@ -691,7 +703,7 @@ static void snapPoints(const MgMotion* sender, const Point2d& orgpt,
                           handleMask, needNear, false, tolNear,
                           false, false, tolPerp,
                           false, false, false, nearBox, false,
-                          sp2, shape, ignoreHd, ignoreids, arr, matchpt, ignoreStart);
+                          sp2, shape, ignoreHd, ignoreids, arr, matchpt, ignoreStart, paths);
             }
         }
     }
@@ -701,6 +713,7 @@ static void snapPoints(const MgMotion* sender, const Point2d& orgpt,
 Point2d MgCmdManagerImpl::snapPoint(const MgMotion* sender, const Point2d& orgpt, const MgShape* shape,
                                     int hotHandle, int ignoreHd, const int* ignoreids)
 {
+    MG_TRACE_SCOPE("snapPoint");
     bool startMustVertex = (!shape && hotHandle == 1 && ignoreHd < 0
                             && sender->view->getOptionBool("startMustVertex", false));
     const int ignoreids_tmp[2] = { shape ? shape->getID() : 0, 0 };
@@ -736,7 +749,8 @@ Point2d MgCmdManagerImpl::snapPoint(const MgMotion* sender, const Point2d& orgpt
                         || shape->getHandleType(hotHandle) == kMgHandleCenter));
     
     snapPoints(sender, orgpt, shape, ignoreHd < 0 ? hotHandle : ignoreHd, ignoreids,
-               arr, matchpt ? &pnt : NULL, _ignoreStart, startMustVertex);  // 在所有图形中捕捉
+               arr, matchpt ? &pnt : NULL, _ignoreStart, startMustVertex,
+               _snapPaths);                         // 在所有图形中捕捉
     checkResult(arr, hotHandle);
     pnt = matchpt && pnt.x > -1e8f ? pnt : _ptSnap; // 顶点匹配优先于用触点捕捉结果
     
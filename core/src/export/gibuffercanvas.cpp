@@ -0,0 +1,455 @@
+// gibuffercanvas.cpp
+// Copyright (c) 2004-2015, https://github.com/rhcad/vgcore, BSD License
+
+#include "gibuffercanvas.h"
+#include <vector>
+#include <string>
+#include <string.h>
+
+struct GiBufferCanvas::Impl
+{
+    std::vector<int>    ints;
+    std::vector<float>  floats;
+    int                 count;      // 命令数
+    int                 lastOp;     // 可合并点段的上一命令(kLineTo/kBezierTo)在整数流中的位置，-1表示没有
+
+    Impl() { reset(); }
+
+    void reset() {
+        ints.clear();
+        floats.clear();
+        ints.push_back(kMagic | kVersion);
+        ints.push_back(0);
+        count = 0;
+        lastOp = -1;
+    }
+
+    void op(int code) {
+        ints.push_back(code);
+        ints[1] = ++count;
+        lastOp = -1;
+    }
+
+    // 连续的同类点段命令只增加点段数
+    void segment(int code) {
+        if (lastOp >= 0 && ints[lastOp] == code) {
+            ints[lastOp + 1]++;
+        } else {
+            op(code);
+            lastOp = (int)ints.size() - 1;
+            ints.push_back(1);
+        }
+    }
+
+    void f2(float a, float b) { floats.push_back(a); floats.push_back(b); }
+    void f4(float a, float b, float c, float d) { f2(a, b); f2(c, d); }
+
+    void str(const char* s) {
+        const int len = s ? (int)strlen(s) : 0;
+        ints.push_back(len);
+        for (int i = 0; i < len; i += 4) {
+            unsigned v = 0;
+            for (int j = 0; j < 4 && i + j < len; j++) {
+                v |= (unsigned)(unsigned char)s[i + j] << (j * 8);
+            }
+            ints.push_back((int)v);
+        }
+    }
+};
+
+// 解码过程中读取整数流和浮点流的辅助类，越界时置 bad 标记
+struct GiBufferReader
+{
+    const int*      ints;
+    const float*    floats;
+    int             icount, fcount, i, f;
+    bool            bad;
+    std::string     text;
+
+    int n() { if (i < icount) return ints[i++]; bad = true; return 0; }
+    float x() { if (f < fcount) return floats[f++]; bad = true; return 0; }
+
+    const char* str() {
+        const int len = n();
+        text.clear();
+        if (len < 0 || i + (len + 3) / 4 > icount) {
+            bad = true;
+            return "";
+        }
+        for (int k = 0; k < len; k++) {
+            text += (char)(((unsigned)ints[i + k / 4] >> ((k % 4) * 8)) & 0xFF);
+        }
+        i += (len + 3) / 4;
+        return text.c_str();
+    }
+};
+
+GiBufferCanvas::GiBufferCanvas()
+{
+    im = new Impl();
+}
+
+GiBufferCanvas::~GiBufferCanvas()
+{
+    delete im;
+}
+
+void GiBufferCanvas::reset()
+{
+    im->reset();
+}
+
+int GiBufferCanvas::getCommandCount() const
+{
+    return im->count;
+}
+
+int GiBufferCanvas::getIntCount() const
+{
+    return (int)im->ints.size();
+}
+
+int GiBufferCanvas::getFloatCount() const
+{
+    return (int)im->floats.size();
+}
+
+const int* GiBufferCanvas::getInts() const
+{
+    return &im->ints.front();
+}
+
+const float* GiBufferCanvas::getFloats() const
+{
+    return im->floats.empty() ? (const float*)0 : &im->floats.front();
+}
+
+void GiBufferCanvas::takeData(std::vector<int>& ints, std::vector<float>& floats)
+{
+    ints.swap(im->ints);
+    floats.swap(im->floats);
+    im->reset();
+}
+
+int GiBufferCanvas::copyInts(mgvector<int>& arr) const
+{
+    const int n = getIntCount();
+    arr.setSize(n);
+    memcpy(arr.address(), getInts(), n * sizeof(int));
+    return n;
+}
+
+int GiBufferCanvas::copyFloats(mgvector<float>& arr) const
+{
+    const int n = getFloatCount();
+    arr.setSize(n);
+    if (n > 0) {
+        memcpy(arr.address(), getFloats(), n * sizeof(float));
+    }
+    return n;
+}
+
+void GiBufferCanvas::setPen(int argb, float width, int style, float phase, float orgw)
+{
+    im->op(kSetPen);
+    im->ints.push_back(argb);
+    im->ints.push_back(style);
+    im->floats.push_back(width);
+    im->f2(phase, orgw);
+}
+
+void GiBufferCanvas::setBrush(int argb, int style)
+{
+    im->op(kSetBrush);
+    im->ints.push_back(argb);
+    im->ints.push_back(style);
+}
+
+void GiBufferCanvas::clearRect(float x, float y, float w, float h)
+{
+    im->op(kClearRect);
+    im->f4(x, y, w, h);
+}
+
+void GiBufferCanvas::drawRect(float x, float y, float w, float h, bool stroke, bool fill)
+{
+    im->op(kDrawRect);
+    im->ints.push_back((stroke ? 1 : 0) | (fill ? 2 : 0));
+    im->f4(x, y, w, h);
+}
+
+void GiBufferCanvas::drawLine(float x1, float y1, float x2, float y2)
+{
+    im->op(kDrawLine);
+    im->f4(x1, y1, x2, y2);
+}
+
+void GiBufferCanvas::drawEllipse(float x, float y, float w, float h, bool stroke, bool fill)
+{
+    im->op(kDrawEllipse);
+    im->ints.push_back((stroke ? 1 : 0) | (fill ? 2 : 0));
+    im->f4(x, y, w, h);
+}
+
+void GiBufferCanvas::beginPath()
+{
+    im->op(kBeginPath);
+}
+
+void GiBufferCanvas::moveTo(float x, float y)
+{
+    im->op(kMoveTo);
+    im->f2(x, y);
+}
+
+void GiBufferCanvas::lineTo(float x, float y)
+{
+    im->segment(kLineTo);
+    im->f2(x, y);
+}
+
+void GiBufferCanvas::bezierTo(float c1x, float c1y, float c2x, float c2y, float x, float y)
+{
+    im->segment(kBezierTo);
+    im->f4(c1x, c1y, c2x, c2y);
+    im->f2(x, y);
+}
+
+void GiBufferCanvas::quadTo(float cpx, float cpy, float x, float y)
+{
+    im->op(kQuadTo);
+    im->f4(cpx, cpy, x, y);
+}
+
+void GiBufferCanvas::closePath()
+{
+    im->op(kClosePath);
+}
+
+void GiBufferCanvas::drawPath(bool stroke, bool fill)
+{
+    im->op(kDrawPath);
+    im->ints.push_back((stroke ? 1 : 0) | (fill ? 2 : 0));
+}
+
+void GiBufferCanvas::saveClip()
+{
+    im->op(kSaveClip);
+}
+
+void GiBufferCanvas::restoreClip()
+{
+    im->op(kRestoreClip);
+}
+
+bool GiBufferCanvas::clipRect(float x, float y, float w, float h)
+{
+    im->op(kClipRect);
+    im->f4(x, y, w, h);
+    return w > 0 && h > 0;
+}
+
+bool GiBufferCanvas::clipPath()
+{
+    im->op(kClipPath);
+    return true;
+}
+
+bool GiBufferCanvas::drawHandle(float x, float y, int type, float angle)
+{
+    im->op(kDrawHandle);
+    im->ints.push_back(type);
+    im->f2(x, y);
+    im->floats.push_back(angle);
+    return true;
+}
+
+bool GiBufferCanvas::drawBitmap(const char* name, float xc, float yc,
+                                float w, float h, float angle)
+{
+    im->op(kDrawBitmap);
+    im->str(name);
+    im->f4(xc, yc, w, h);
+    im->floats.push_back(angle);
+    return true;
+}
+
+float GiBufferCanvas::drawTextAt(const char* text, float x, float y, float h, int align, float angle)
+{
+    float width = 0;
+
+    im->op(kDrawText);
+    im->ints.push_back(align);
+    im->str(text);
+    im->f4(x, y, h, angle);
+
+    // 宿主稍后才绘制，这里按字符估算宽度：ASCII字符为半个字高，其余字符为一个字高
+    for (const unsigned char* p = (const unsigned char*)text; p && *p; p++) {
+        if (*p < 0x80) {
+            width += h * 0.5f;
+        } else if ((*p & 0xC0) == 0xC0) {
+            width += h;
+        }
+    }
+    return width;
+}
+
+bool GiBufferCanvas::beginShape(int type, int sid, int version, float x, float y, float w, float h)
+{
+    im->op(kBeginShape);
+    im->ints.push_back(type);
+    im->ints.push_back(sid);
+    im->ints.push_back(version);
+    im->f4(x, y, w, h);
+    return true;
+}
+
+void GiBufferCanvas::endShape(int type, int sid, float x, float y)
+{
+    im->op(kEndShape);
+    im->ints.push_back(type);
+    im->ints.push_back(sid);
+    im->f2(x, y);
+}
+
+int GiBufferCanvas::replay(GiCanvas* canvas) const
+{
+    return replay(canvas, getInts(), getIntCount(), getFloats(), getFloatCount());
+}
+
+int GiBufferCanvas::replay(GiCanvas* canvas, const mgvector<int>& ints, const mgvector<float>& floats)
+{
+    return replay(canvas, ints.address(), ints.count(), floats.address(), floats.count());
+}
+
+int GiBufferCanvas::replay(GiCanvas* canvas, const int* ints, int icount, const float* floats, int fcount)
+{
+    GiBufferReader r = { ints, floats, icount, fcount, 0, 0, false, std::string() };
+
+    if (!canvas || !ints || icount < 2 || r.n() != (kMagic | kVersion)) {
+        return -1;
+    }
+
+    const int count = r.n();
+    int done = 0;
+
+    for (; done < count && !r.bad; done++) {
+        const int op = r.n();
+        switch (op) {
+            case kSetPen: {
+                int argb = r.n(), style = r.n();
+                float width = r.x(), phase = r.x();
+                canvas->setPen(argb, width, style, phase, r.x());
+                break;
+            }
+            case kSetBrush: {
+                int argb = r.n();
+                canvas->setBrush(argb, r.n());
+                break;
+            }
+            case kClearRect: {
+                float x = r.x(), y = r.x(), w = r.x();
+                canvas->clearRect(x, y, w, r.x());
+                break;
+            }
+            case kDrawRect:
+            case kDrawEllipse: {
+                int flags = r.n();
+                float x = r.x(), y = r.x(), w = r.x(), h = r.x();
+                if (op == kDrawRect)
+                    canvas->drawRect(x, y, w, h, !!(flags & 1), !!(flags & 2));
+                else
+                    canvas->drawEllipse(x, y, w, h, !!(flags & 1), !!(flags & 2));
+                break;
+            }
+            case kDrawLine: {
+                float x1 = r.x(), y1 = r.x(), x2 = r.x();
+                canvas->drawLine(x1, y1, x2, r.x());
+                break;
+            }
+            case kBeginPath:
+                canvas->beginPath();
+                break;
+            case kMoveTo: {
+                float x = r.x();
+                canvas->moveTo(x, r.x());
+                break;
+            }
+            case kLineTo:
+                for (int n = r.n(); n > 0 && !r.bad; n--) {
+                    float x = r.x();
+                    canvas->lineTo(x, r.x());
+                }
+                break;
+            case kBezierTo:
+                for (int n = r.n(); n > 0 && !r.bad; n--) {
+                    float c1x = r.x(), c1y = r.x(), c2x = r.x(), c2y = r.x(), x = r.x();
+                    canvas->bezierTo(c1x, c1y, c2x, c2y, x, r.x());
+                }
+                break;
+            case kQuadTo: {
+                float cpx = r.x(), cpy = r.x(), x = r.x();
+                canvas->quadTo(cpx, cpy, x, r.x());
+                break;
+            }
+            case kClosePath:
+                canvas->closePath();
+                break;
+            case kDrawPath: {
+                int flags = r.n();
+                canvas->drawPath(!!(flags & 1), !!(flags & 2));
+                break;
+            }
+            case kSaveClip:
+                canvas->saveClip();
+                break;
+            case kRestoreClip:
+                canvas->restoreClip();
+                break;
+            case kClipRect: {
+                float x = r.x(), y = r.x(), w = r.x();
+                canvas->clipRect(x, y, w, r.x());
+                break;
+            }
+            case kClipPath:
+                canvas->clipPath();
+                break;
+            case kDrawHandle: {
+                int type = r.n();
+                float x = r.x(), y = r.x();
+                canvas->drawHandle(x, y, type, r.x());
+                break;
+            }
+            case kDrawBitmap: {
+                std::string name(r.str());
+                float xc = r.x(), yc = r.x(), w = r.x(), h = r.x();
+                canvas->drawBitmap(name.c_str(), xc, yc, w, h, r.x());
+                break;
+            }
+            case kDrawText: {
+                int align = r.n();
+                std::string text(r.str());
+                float x = r.x(), y = r.x(), h = r.x();
+                canvas->drawTextAt(text.c_str(), x, y, h, align, r.x());
+                break;
+            }
+            case kBeginShape: {
+                int type = r.n(), sid = r.n(), version = r.n();
+                float x = r.x(), y = r.x(), w = r.x();
+                canvas->beginShape(type, sid, version, x, y, w, r.x());
+                break;
+            }
+            case kEndShape: {
+                int type = r.n(), sid = r.n();
+                float x = r.x();
+                canvas->endShape(type, sid, x, r.x());
+                break;
+            }
+            default:
+                r.bad = true;
+                break;
+        }
+    }
+
+    return r.bad ? -1 : done;
+}
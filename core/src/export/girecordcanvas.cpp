@@ -2,701 +2,194 @@
 
 #include "girecordshape.h"
 #include "girecordcanvas.h"
+#include "gibuffercanvas.h"
 #include "mgshapes.h"
 #include "mgshapet.h"
 #include "mgstorage.h"
 #include <string>
+#include <string.h>
 
-//! The class for recording 'setPen'.
-struct CmdSetPen : public MgRecordShape::ICmd {
-    int argb; float width; int style; float phase; float orgw;
-    CmdSetPen() : argb(0xFF000000), width(0), style(0), phase(0), orgw(0) {}
-    CmdSetPen(int argb, float width, int style, float phase, float orgw)
-        : argb(argb), width(width), style(style), phase(phase), orgw(orgw) {}
-    
-    virtual int type() const { return 1; }
-    virtual void copy(const ICmd& src) {
-        if (src.type() == type()) {
-            const CmdSetPen& p = (const CmdSetPen&)src;
-            argb = p.argb;
-            width = p.width;
-            style = p.style;
-            phase = p.phase;
-            orgw = p.orgw;
-        }
-    }
-    virtual bool save(MgStorage* s) const {
-        s->writeInt("argb", argb);
-        s->writeFloat("width", width);
-        s->writeInt("style", style);
-        s->writeFloat("phase", phase);
-        s->writeFloat("orgw", orgw);
-        return true;
-    }
-    virtual bool load(MgStorage* s) {
-        argb = s->readInt("argb", argb);
-        width = s->readFloat("width", width);
-        style = s->readInt("style", style);
-        phase = s->readFloat("phase", phase);
-        orgw = s->readFloat("orgw", orgw);
-        return true;
-    }
-    virtual bool draw(GiGraphics& gs, const Matrix2d&) const {
-        gs.getCanvas()->setPen(argb, width, style, phase, orgw);
-        return true;
-    }
-};
-
-//! The class for recording 'setBrush'.
-struct CmdSetBrush : public MgRecordShape::ICmd {
-    int argb; int style;
-    CmdSetBrush() : argb(0) {}
-    CmdSetBrush(int argb, int style) : argb(argb), style(style) {}
-    
-    virtual int type() const { return 2; }
-    virtual void copy(const ICmd& src) {
-        if (src.type() == type()) {
-            const CmdSetBrush& p = (const CmdSetBrush&)src;
-            argb = p.argb;
-            style = p.style;
-        }
-    }
-    virtual bool save(MgStorage* s) const {
-        s->writeInt("argb", argb);
-        s->writeInt("style", style);
-        return true;
-    }
-    virtual bool load(MgStorage* s) {
-        argb = s->readInt("argb", argb);
-        style = s->readInt("style", style);
-        return true;
-    }
-    virtual bool draw(GiGraphics& gs, const Matrix2d&) const {
-        gs.getCanvas()->setBrush(argb, style);
-        return true;
-    }
-};
-
-//! The class for recording 'clearRect'.
-struct CmdClearRect : public MgRecordShape::ICmd {
-    Point2d pt; Vector2d vec;
-    CmdClearRect() {}
-    CmdClearRect(const Matrix2d& d2w, float x, float y, float w, float h)
-        : pt(Point2d(x, y) * d2w), vec(Vector2d(w, h) * d2w) {}
-    
-    virtual int type() const { return 3; }
-    virtual void copy(const ICmd& src) {
-        if (src.type() == type()) {
-            const CmdClearRect& p = (const CmdClearRect&)src;
-            pt = p.pt;
-            vec = p.vec;
-        }
-    }
-    virtual bool save(MgStorage* s) const {
-        s->writeFloat("x", pt.x);
-        s->writeFloat("y", pt.y);
-        s->writeFloat("w", vec.x);
-        s->writeFloat("h", vec.y);
-        return true;
-    }
-    virtual bool load(MgStorage* s) {
-        pt.set(s->readFloat("x", pt.x), s->readFloat("y", pt.y));
-        vec.set(s->readFloat("w", vec.x), s->readFloat("h", vec.y));
-        return true;
-    }
-    virtual bool draw(GiGraphics& gs, const Matrix2d& w2d) const {
-        Point2d pt2(pt * w2d);
-        Vector2d vec2(vec * w2d);
-        gs.getCanvas()->clearRect(pt2.x, pt2.y, vec2.x, vec2.y);
-        return true;
-    }
-    virtual Box2d getExtentW() const { return Box2d(pt, pt + vec); }
-};
+//! The canvas adapter to replay recorded commands in world coordinates onto the display canvas.
+/*! Only clipPath, saveClip and restoreClip change the drawing state,
+    other commands are skipped after a failed clipPath as in the same way of recording.
+ */
+class GiRecordPlayer : public GiCanvas
+{
+public:
+    GiRecordPlayer(GiCanvas* cv, const Matrix2d& w2d, const std::vector<GiTextWidthCallback*>& cbs)
+        : _cv(cv), _w2d(w2d), _cbs(cbs), _candraw(true), _texts(0) {}
 
-//! The class for recording 'clipRect'.
-struct CmdClipRect : public MgRecordShape::ICmd {
-    Point2d pt; Vector2d vec;
-    CmdClipRect() {}
-    CmdClipRect(const Matrix2d& d2w, float x, float y, float w, float h)
-        : pt(Point2d(x, y) * d2w), vec(Vector2d(w, h) * d2w) {}
-    
-    virtual int type() const { return 18; }
-    virtual void copy(const ICmd& src) {
-        if (src.type() == type()) {
-            const CmdClipRect& p = (const CmdClipRect&)src;
-            pt = p.pt;
-            vec = p.vec;
-        }
-    }
-    virtual bool save(MgStorage* s) const {
-        s->writeFloat("x", pt.x);
-        s->writeFloat("y", pt.y);
-        s->writeFloat("w", vec.x);
-        s->writeFloat("h", vec.y);
-        return true;
-    }
-    virtual bool load(MgStorage* s) {
-        pt.set(s->readFloat("x", pt.x), s->readFloat("y", pt.y));
-        vec.set(s->readFloat("w", vec.x), s->readFloat("h", vec.y));
-        return true;
+    virtual void setPen(int argb, float width, int style, float phase, float orgw) {
+        if (_candraw) _cv->setPen(argb, width, style, phase, orgw);
     }
-    virtual bool draw(GiGraphics& gs, const Matrix2d& w2d) const {
-        Point2d pt2(pt * w2d);
-        Vector2d vec2(vec * w2d);
-        return gs.getCanvas()->clipRect(pt2.x, pt2.y, vec2.x, vec2.y);
+    virtual void setBrush(int argb, int style) {
+        if (_candraw) _cv->setBrush(argb, style);
     }
-    virtual Box2d getExtentW() const { return Box2d(pt, pt + vec); }
-};
-
-//! The class for recording 'drawRect'.
-struct CmdDrawRect : public MgRecordShape::ICmd {
-    Point2d pt; Vector2d vec; bool stroke; bool fill;
-    CmdDrawRect() {}
-    CmdDrawRect(const Matrix2d& d2w, float x, float y, float w, float h, bool stroke, bool fill)
-        : pt(Point2d(x, y) * d2w), vec(Vector2d(w, h) * d2w), stroke(stroke), fill(fill) {}
-    
-    virtual int type() const { return 4; }
-    virtual void copy(const ICmd& src) {
-        if (src.type() == type()) {
-            const CmdDrawRect& p = (const CmdDrawRect&)src;
-            pt = p.pt;
-            vec = p.vec;
-            stroke = p.stroke;
-            fill = p.fill;
+    virtual void clearRect(float x, float y, float w, float h) {
+        if (_candraw) {
+            Point2d pt(pnt(x, y));
+            Vector2d vec(Vector2d(w, h) * _w2d);
+            _cv->clearRect(pt.x, pt.y, vec.x, vec.y);
         }
     }
-    virtual bool save(MgStorage* s) const {
-        s->writeFloat("x", pt.x);
-        s->writeFloat("y", pt.y);
-        s->writeFloat("w", vec.x);
-        s->writeFloat("h", vec.y);
-        s->writeBool("stroke", stroke);
-        s->writeBool("fill", fill);
-        return true;
-    }
-    virtual bool load(MgStorage* s) {
-        pt.set(s->readFloat("x", pt.x), s->readFloat("y", pt.y));
-        vec.set(s->readFloat("w", vec.x), s->readFloat("h", vec.y));
-        stroke = s->readBool("stroke", stroke);
-        fill = s->readBool("fill", fill);
-        return true;
-    }
-    virtual bool draw(GiGraphics& gs, const Matrix2d& w2d) const {
-        Point2d pt2(pt * w2d);
-        Vector2d vec2(vec * w2d);
-        gs.getCanvas()->drawRect(pt2.x, pt2.y, vec2.x, vec2.y, stroke, fill);
-        return true;
-    }
-    virtual Box2d getExtentW() const { return Box2d(pt, pt + vec); }
-};
-
-//! The class for recording 'drawLine'.
-struct CmdDrawLine : public MgRecordShape::ICmd {
-    Point2d pt1; Point2d pt2;
-    CmdDrawLine() {}
-    CmdDrawLine(const Matrix2d& d2w, float x1, float y1, float x2, float y2)
-        : pt1(Point2d(x1, y1) * d2w), pt2(Point2d(x2, y2) * d2w) {}
-    
-    virtual int type() const { return 5; }
-    virtual void copy(const ICmd& src) {
-        if (src.type() == type()) {
-            const CmdDrawLine& p = (const CmdDrawLine&)src;
-            pt1 = p.pt1;
-            pt2 = p.pt2;
+    virtual void drawRect(float x, float y, float w, float h, bool stroke, bool fill) {
+        if (_candraw) {
+            Point2d pt(pnt(x, y));
+            Vector2d vec(Vector2d(w, h) * _w2d);
+            _cv->drawRect(pt.x, pt.y, vec.x, vec.y, stroke, fill);
         }
     }
-    virtual bool save(MgStorage* s) const {
-        s->writeFloat("x1", pt1.x);
-        s->writeFloat("y1", pt1.y);
-        s->writeFloat("x2", pt2.x);
-        s->writeFloat("y2", pt2.y);
-        return true;
-    }
-    virtual bool load(MgStorage* s) {
-        pt1.set(s->readFloat("x1", pt1.x), s->readFloat("y1", pt1.y));
-        pt2.set(s->readFloat("x2", pt2.x), s->readFloat("y2", pt2.y));
-        return true;
-    }
-    virtual bool draw(GiGraphics& gs, const Matrix2d& w2d) const {
-        Point2d pt3(pt1 * w2d);
-        Point2d pt4(pt2 * w2d);
-        gs.getCanvas()->drawLine(pt3.x, pt3.y, pt4.x, pt4.y);
-        return true;
-    }
-    virtual Box2d getExtentW() const { return Box2d(pt1, pt2); }
-};
-
-//! The class for recording 'drawEllipse'.
-struct CmdDrawEllipse : public MgRecordShape::ICmd {
-    Point2d pt; Vector2d vec; bool stroke; bool fill;
-    CmdDrawEllipse() {}
-    CmdDrawEllipse(const Matrix2d& d2w, float x, float y, float w, float h, bool stroke, bool fill)
-        : pt(Point2d(x, y) * d2w), vec(Vector2d(w, h) * d2w), stroke(stroke), fill(fill) {}
-    
-    virtual int type() const { return 6; }
-    virtual void copy(const ICmd& src) {
-        if (src.type() == type()) {
-            const CmdDrawEllipse& p = (const CmdDrawEllipse&)src;
-            pt = p.pt;
-            vec = p.vec;
-            stroke = p.stroke;
-            fill = p.fill;
+    virtual void drawLine(float x1, float y1, float x2, float y2) {
+        if (_candraw) {
+            Point2d pt1(pnt(x1, y1)), pt2(pnt(x2, y2));
+            _cv->drawLine(pt1.x, pt1.y, pt2.x, pt2.y);
         }
     }
-    virtual bool save(MgStorage* s) const {
-        s->writeFloat("x", pt.x);
-        s->writeFloat("y", pt.y);
-        s->writeFloat("w", vec.x);
-        s->writeFloat("h", vec.y);
-        s->writeBool("stroke", stroke);
-        s->writeBool("fill", fill);
-        return true;
-    }
-    virtual bool load(MgStorage* s) {
-        pt.set(s->readFloat("x", pt.x), s->readFloat("y", pt.y));
-        vec.set(s->readFloat("w", vec.x), s->readFloat("h", vec.y));
-        stroke = s->readBool("stroke", stroke);
-        fill = s->readBool("fill", fill);
-        return true;
-    }
-    virtual bool draw(GiGraphics& gs, const Matrix2d& w2d) const {
-        Point2d pt2(pt * w2d);
-        Vector2d vec2(vec * w2d);
-        gs.getCanvas()->drawEllipse(pt2.x, pt2.y, vec2.x, vec2.y, stroke, fill);
-        return true;
-    }
-    virtual Box2d getExtentW() const { return Box2d(pt, pt + vec); }
-};
-
-//! The class for recording 'beginPath'.
-struct CmdBeginPath : public MgRecordShape::ICmd {
-    CmdBeginPath() {}
-    
-    virtual int type() const { return 7; }
-    virtual void copy(const ICmd&) {}
-    virtual bool save(MgStorage*) const {
-        return true;
-    }
-    virtual bool load(MgStorage*) {
-        return true;
-    }
-    virtual bool draw(GiGraphics& gs, const Matrix2d&) const {
-        gs.getCanvas()->beginPath();
-        return true;
-    }
-};
-
-//! The class for recording 'moveTo'.
-struct CmdMoveTo : public MgRecordShape::ICmd {
-    Point2d pt;
-    CmdMoveTo() {}
-    CmdMoveTo(const Matrix2d& d2w, float x, float y) : pt(Point2d(x, y) * d2w) {}
-    
-    virtual int type() const { return 8; }
-    virtual void copy(const ICmd& src) {
-        if (src.type() == type()) {
-            const CmdMoveTo& p = (const CmdMoveTo&)src;
-            pt = p.pt;
+    virtual void drawEllipse(float x, float y, float w, float h, bool stroke, bool fill) {
+        if (_candraw) {
+            Point2d pt(pnt(x, y));
+            Vector2d vec(Vector2d(w, h) * _w2d);
+            _cv->drawEllipse(pt.x, pt.y, vec.x, vec.y, stroke, fill);
         }
     }
-    virtual bool save(MgStorage* s) const {
-        s->writeFloat("x", pt.x);
-        s->writeFloat("y", pt.y);
-        return true;
+    virtual void beginPath() {
+        if (_candraw) _cv->beginPath();
     }
-    virtual bool load(MgStorage* s) {
-        pt.set(s->readFloat("x", pt.x), s->readFloat("y", pt.y));
-        return true;
-    }
-    virtual bool draw(GiGraphics& gs, const Matrix2d& w2d) const {
-        Point2d pt2(pt * w2d);
-        gs.getCanvas()->moveTo(pt2.x, pt2.y);
-        return true;
-    }
-    virtual Box2d getExtentW() const { return Box2d(pt, 1e-3f, 0); }
-};
-
-//! The class for recording 'lineTo'.
-struct CmdLineTo : public MgRecordShape::ICmd {
-    Point2d pt;
-    CmdLineTo() {}
-    CmdLineTo(const Matrix2d& d2w, float x, float y) : pt(Point2d(x, y) * d2w) {}
-    
-    virtual int type() const { return 9; }
-    virtual void copy(const ICmd& src) {
-        if (src.type() == type()) {
-            const CmdLineTo& p = (const CmdLineTo&)src;
-            pt = p.pt;
+    virtual void moveTo(float x, float y) {
+        if (_candraw) {
+            Point2d pt(pnt(x, y));
+            _cv->moveTo(pt.x, pt.y);
         }
     }
-    virtual bool save(MgStorage* s) const {
-        s->writeFloat("x", pt.x);
-        s->writeFloat("y", pt.y);
-        return true;
-    }
-    virtual bool load(MgStorage* s) {
-        s->writeFloat("x", pt.x);
-        s->writeFloat("y", pt.y);
-        return true;
-    }
-    virtual bool draw(GiGraphics& gs, const Matrix2d& w2d) const {
-        Point2d pt2(pt * w2d);
-        gs.getCanvas()->lineTo(pt2.x, pt2.y);
-        return true;
-    }
-    virtual Box2d getExtentW() const { return Box2d(pt, 1e-3f, 0); }
-};
-
-//! The class for recording 'bezierTo'.
-struct CmdBezierTo : public MgRecordShape::ICmd {
-    Point2d c1, c2, pt;
-    CmdBezierTo() {}
-    CmdBezierTo(const Matrix2d& d2w, float c1x, float c1y, float c2x, float c2y, float x, float y)
-        : c1(Point2d(c1x, c1y) * d2w), c2(Point2d(c2x, c2y) * d2w), pt(Point2d(x, y) * d2w) {}
-    
-    virtual int type() const { return 10; }
-    virtual void copy(const ICmd& src) {
-        if (src.type() == type()) {
-            const CmdBezierTo& p = (const CmdBezierTo&)src;
-            c1 = p.c1;
-            c2 = p.c2;
-            pt = p.pt;
+    virtual void lineTo(float x, float y) {
+        if (_candraw) {
+            Point2d pt(pnt(x, y));
+            _cv->lineTo(pt.x, pt.y);
         }
     }
-    virtual bool save(MgStorage* s) const {
-        s->writeFloat("c1x", c1.x);
-        s->writeFloat("c1y", c1.y);
-        s->writeFloat("c2x", c2.x);
-        s->writeFloat("c2y", c2.y);
-        s->writeFloat("x", pt.x);
-        s->writeFloat("y", pt.y);
-        return true;
-    }
-    virtual bool load(MgStorage* s) {
-        c1.x = s->readFloat("c1x", c1.x);
-        c1.y = s->readFloat("c1y", c1.y);
-        c2.x = s->readFloat("c2x", c2.x);
-        c2.y = s->readFloat("c2y", c2.y);
-        pt.x = s->readFloat("x", pt.x);
-        pt.y = s->readFloat("y", pt.y);
-        return true;
-    }
-    virtual bool draw(GiGraphics& gs, const Matrix2d& w2d) const {
-        Point2d c1t(c1 * w2d), c2t(c2 * w2d), pt2(pt * w2d);
-        gs.getCanvas()->bezierTo(c1t.x, c1t.y, c2t.x, c2t.y, pt2.x, pt2.y);
-        return true;
-    }
-    virtual Box2d getExtentW() const { return Box2d(pt, c1, c2, pt); }
-};
-
-//! The class for recording 'quadTo'.
-struct CmdQuadTo : public MgRecordShape::ICmd {
-    Point2d cp, pt;
-    CmdQuadTo() {}
-    CmdQuadTo(const Matrix2d& d2w, float cpx, float cpy, float x, float y)
-        : cp(Point2d(cpx, cpy) * d2w), pt(Point2d(x, y) * d2w) {}
-    
-    virtual int type() const { return 11; }
-    virtual void copy(const ICmd& src) {
-        if (src.type() == type()) {
-            const CmdQuadTo& p = (const CmdQuadTo&)src;
-            cp = p.cp;
-            pt = p.pt;
+    virtual void bezierTo(float c1x, float c1y, float c2x, float c2y, float x, float y) {
+        if (_candraw) {
+            Point2d c1(pnt(c1x, c1y)), c2(pnt(c2x, c2y)), pt(pnt(x, y));
+            _cv->bezierTo(c1.x, c1.y, c2.x, c2.y, pt.x, pt.y);
         }
     }
-    virtual bool save(MgStorage* s) const {
-        s->writeFloat("cpx", cp.x);
-        s->writeFloat("cpy", cp.y);
-        s->writeFloat("x", pt.x);
-        s->writeFloat("y", pt.y);
-        return true;
-    }
-    virtual bool load(MgStorage* s) {
-        cp.x = s->readFloat("cpx", cp.x);
-        cp.y = s->readFloat("cpy", cp.y);
-        pt.x = s->readFloat("x", pt.x);
-        pt.y = s->readFloat("y", pt.y);
-        return true;
-    }
-    virtual bool draw(GiGraphics& gs, const Matrix2d& w2d) const {
-        Point2d cp2(cp * w2d), pt2(pt * w2d);
-        gs.getCanvas()->quadTo(cp2.x, cp2.y, pt2.x, pt2.y);
-        return true;
-    }
-    virtual Box2d getExtentW() const { return Box2d(cp, pt); }
-};
-
-//! The class for recording 'closePath'.
-struct CmdClosePath : public MgRecordShape::ICmd {
-    CmdClosePath() {}
-    
-    virtual int type() const { return 12; }
-    virtual void copy(const ICmd&) {}
-    virtual bool save(MgStorage*) const {
-        return true;
-    }
-    virtual bool load(MgStorage*) {
-        return true;
-    }
-    virtual bool draw(GiGraphics& gs, const Matrix2d&) const {
-        gs.getCanvas()->closePath();
-        return true;
-    }
-};
-
-//! The class for recording 'drawPath'.
-struct CmdDrawPath : public MgRecordShape::ICmd {
-    bool stroke; bool fill;
-    CmdDrawPath() {}
-    CmdDrawPath(bool stroke, bool fill) : stroke(stroke), fill(fill) {}
-    
-    virtual int type() const { return 13; }
-    virtual void copy(const ICmd& src) {
-        if (src.type() == type()) {
-            const CmdDrawPath& p = (const CmdDrawPath&)src;
-            stroke = p.stroke;
-            fill = p.fill;
+    virtual void quadTo(float cpx, float cpy, float x, float y) {
+        if (_candraw) {
+            Point2d cp(pnt(cpx, cpy)), pt(pnt(x, y));
+            _cv->quadTo(cp.x, cp.y, pt.x, pt.y);
         }
     }
-    virtual bool save(MgStorage* s) const {
-        s->writeBool("stroke", stroke);
-        s->writeBool("fill", fill);
-        return true;
+    virtual void closePath() {
+        if (_candraw) _cv->closePath();
     }
-    virtual bool load(MgStorage* s) {
-        stroke = s->readBool("stroke", stroke);
-        fill = s->readBool("fill", fill);
-        return true;
+    virtual void drawPath(bool stroke, bool fill) {
+        if (_candraw) _cv->drawPath(stroke, fill);
     }
-    virtual bool draw(GiGraphics& gs, const Matrix2d&) const {
-        gs.getCanvas()->drawPath(stroke, fill);
-        return true;
+    virtual void saveClip() {
+        _cv->saveClip();
+        _candraw = true;
     }
-};
-
-//! The class for recording 'clipPath'.
-struct CmdClipPath : public MgRecordShape::ICmd {
-    int t;
-    CmdClipPath(int t = 0) : t(t) {}
-    
-    enum { Clip, Save, Restore };
-    static int Type() { return 17; }
-    virtual int type() const { return Type(); }
-    virtual void copy(const ICmd& src) {
-        if (src.type() == type()) {
-            const CmdClipPath& p = (const CmdClipPath&)src;
-            t = p.t;
-        }
+    virtual void restoreClip() {
+        _cv->restoreClip();
+        _candraw = true;
     }
-    virtual bool save(MgStorage* s) const {
-        s->writeInt("t", t);
-        return true;
+    virtual bool clipRect(float x, float y, float w, float h) {
+        if (!_candraw)
+            return false;
+        Point2d pt(pnt(x, y));
+        Vector2d vec(Vector2d(w, h) * _w2d);
+        return _cv->clipRect(pt.x, pt.y, vec.x, vec.y);
     }
-    virtual bool load(MgStorage* s) {
-        t = s->readInt("t", t);
-        return true;
+    virtual bool clipPath() {
+        _candraw = _cv->clipPath();
+        return _candraw;
     }
-    virtual bool draw(GiGraphics& gs, const Matrix2d&) const {
-        switch (t) {
-            case Clip:
-                return gs.getCanvas()->clipPath();
-            case Save:
-                gs.getCanvas()->saveClip();
-                break;
-            case Restore:
-                gs.getCanvas()->restoreClip();
-                break;
-            default:
-                break;
-        }
-        return true;
+    virtual bool drawHandle(float x, float y, int type, float angle) {
+        if (!_candraw)
+            return false;
+        Point2d pt(pnt(x, y));
+        return _cv->drawHandle(pt.x, pt.y, type, angle);
     }
-};
-
-//! The class for recording 'drawHandle'.
-struct CmdDrawHandle : public MgRecordShape::ICmd {
-    Point2d pt; int t; float angle;
-    CmdDrawHandle() : t(0), angle(0) {}
-    CmdDrawHandle(const Matrix2d& d2w, float x, float y, int t, float a)
-        : pt(Point2d(x, y) * d2w), t(t), angle(a) {}
-    
-    virtual int type() const { return 14; }
-    virtual void copy(const ICmd& src) {
-        if (src.type() == type()) {
-            const CmdDrawHandle& p = (const CmdDrawHandle&)src;
-            pt = p.pt;
-            angle = p.angle;
-            t = p.t;
+    virtual bool drawBitmap(const char* name, float xc, float yc, float w, float h, float angle) {
+        if (!_candraw)
+            return false;
+        Point2d pt(pnt(xc, yc));
+        Vector2d vec(Vector2d(w, h) * _w2d);
+        return _cv->drawBitmap(name, pt.x, pt.y, vec.x, vec.y, angle);
+    }
+    virtual float drawTextAt(const char* text, float x, float y, float h, int align, float angle) {
+        const int index = _texts++;
+        float w = 0;
+
+        if (_candraw) {
+            Point2d pt(pnt(x, y));
+            w = _cv->drawTextAt(text, pt.x, pt.y, (Vector2d(h, 0) * _w2d).length(), align, angle);
+            if (index < (int)_cbs.size() && _cbs[index]) {
+                _cbs[index]->drawTextEnded(_cbs[index], w);
+            }
         }
+        return w;
     }
-    virtual bool save(MgStorage* s) const {
-        s->writeFloat("x", pt.x);
-        s->writeFloat("y", pt.y);
-        s->writeFloat("angle", angle);
-        s->writeInt("t", t);
-        return true;
-    }
-    virtual bool load(MgStorage* s) {
-        pt.x = s->readFloat("x", pt.x);
-        pt.y = s->readFloat("y", pt.y);
-        angle = s->readFloat("angle", angle);
-        t = s->readInt("t", t);
-        return true;
-    }
-    virtual bool draw(GiGraphics& gs, const Matrix2d& w2d) const {
-        Point2d pt2(pt * w2d);
-        return gs.getCanvas()->drawHandle(pt2.x, pt2.y, t, angle);
-    }
-    virtual Box2d getExtentW() const { return Box2d(pt, 1e-3f, 0); }
-};
+    virtual bool beginShape(int, int, int, float, float, float, float) { return false; }
+    virtual void endShape(int, int, float, float) {}
 
-//! The class for recording 'drawBitmap'.
-struct CmdDrawBitmap : public MgRecordShape::ICmd {
-    std::string name; Point2d pt; Vector2d vec; float angle;
-    CmdDrawBitmap() : angle(0) {}
-    CmdDrawBitmap(const Matrix2d& d2w, const char* name, float xc, float yc, float w, float h, float angle)
-        : name(name), pt(Point2d(xc, yc) * d2w), vec(Vector2d(w, h) * d2w), angle(angle) {}
-    
-    virtual int type() const { return 15; }
-    virtual void copy(const ICmd& src) {
-        if (src.type() == type()) {
-            const CmdDrawBitmap& p = (const CmdDrawBitmap&)src;
-            name = p.name;
-            pt = p.pt;
-            vec = p.vec;
-            angle = p.angle;
-        }
-    }
-    virtual bool save(MgStorage* s) const {
-        s->writeString("name", name.c_str());
-        s->writeFloat("xc", pt.x);
-        s->writeFloat("yc", pt.y);
-        s->writeFloat("w", vec.x);
-        s->writeFloat("h", vec.y);
-        s->writeFloat("angle", angle);
-        return true;
-    }
-    virtual bool load(MgStorage* s) {
-        int len = s->readString("name", NULL, 0);
-        name.resize(len, 0);
-        len = s->readString("name", const_cast<char*>(name.c_str()), (int)name.size());
-        
-        pt.x = s->readFloat("xc", pt.x);
-        pt.y = s->readFloat("yc", pt.y);
-        vec.x = s->readFloat("w", vec.x);
-        vec.y = s->readFloat("h", vec.y);
-        angle = s->readFloat("angle", angle);
-        
-        return len > 0;
-    }
-    virtual bool draw(GiGraphics& gs, const Matrix2d& w2d) const {
-        Point2d pt2(pt * w2d);
-        Vector2d vec2(vec * w2d);
-        return gs.getCanvas()->drawBitmap(name.c_str(), pt2.x, pt2.y, vec2.x, vec2.y, angle);
-    }
-    virtual Box2d getExtentW() const { return Box2d(pt, pt + vec); }
-};
+private:
+    Point2d pnt(float x, float y) const { return Point2d(x, y) * _w2d; }
 
-//! The class for recording 'drawTextAt'.
-struct CmdDrawTextAt : public MgRecordShape::ICmd {
-    std::string text; Point2d pt; Vector2d vec; int align; float angle;
-    GiTextWidthCallback* c; mutable float w;
-    
-    CmdDrawTextAt() : align(0), angle(0), c(NULL), w(0) {}
-    CmdDrawTextAt(const Matrix2d& d2w, GiTextWidthCallback* c, const char* text,
-                  float x, float y, float h, int align, float angle)
-        : text(text), pt(Point2d(x, y) * d2w), vec(Vector2d(h, h) * d2w), align(align), angle(angle), c(c), w(0)
-    {
-        if (c) c->addRefTextWidth();
-    }
-    ~CmdDrawTextAt() { if (c) c->releaseTextWidth(); }
-    
-    virtual int type() const { return 16; }
-    virtual void copy(const ICmd& src) {
-        if (src.type() == type()) {
-            const CmdDrawTextAt& p = (const CmdDrawTextAt&)src;
-            text = p.text;
-            pt = p.pt;
-            vec = p.vec;
-            align = p.align;
-            if (p.c && c != p.c) {
-                c = p.c;
-                c->addRefTextWidth();
-            }
-            w = p.w;
-        }
-    }
-    virtual bool save(MgStorage* s) const {
-        s->writeString("text", text.c_str());
-        s->writeFloat("x", pt.x);
-        s->writeFloat("y", pt.y);
-        s->writeFloat("h", vec.x);
-        s->writeInt("align", align);
-        s->writeFloat("angle", angle);
-        s->writeFloat("w", w);
-        return true;
-    }
-    virtual bool load(MgStorage* s) {
-        int len = s->readString("text", NULL, 0);
-        text.resize(len, 0);
-        len = s->readString("text", const_cast<char*>(text.c_str()), (int)text.size());
-        
-        pt.x = s->readFloat("x", pt.x);
-        pt.y = s->readFloat("y", pt.y);
-        vec.x = s->readFloat("h", vec.x);
-        align = s->readInt("align", align);
-        angle = s->readFloat("angle", angle);
-        angle = s->readFloat("w", w);
-        
-        return len > 0;
-    }
-    virtual bool draw(GiGraphics& gs, const Matrix2d& w2d) const {
-        Point2d pt2(pt * w2d);
-        Vector2d vec2(vec * w2d);
-        w = gs.getCanvas()->drawTextAt(text.c_str(), pt2.x, pt2.y, vec2.x, align, angle);
-        if (c) c->drawTextEnded(c, w);
-        return w > 0;
-    }
-    virtual Box2d getExtentW() const { return Box2d(pt, pt + vec); }
+    GiCanvas*       _cv;
+    const Matrix2d& _w2d;
+    const std::vector<GiTextWidthCallback*>& _cbs;
+    bool            _candraw;
+    int             _texts;
 };
 
 // MgRecordShape
 //
 
-MgRecordShape::ICmd* MgRecordShape::createItem(int type) const
-{
-    switch (type) {
-        case 1: return new CmdSetPen();
-        case 2: return new CmdSetBrush();
-        case 3: return new CmdClearRect();
-        case 4: return new CmdDrawRect();
-        case 5: return new CmdDrawLine();
-        case 6: return new CmdDrawEllipse();
-        case 7: return new CmdBeginPath();
-        case 8: return new CmdMoveTo();
-        case 9: return new CmdLineTo();
-        case 10: return new CmdBezierTo();
-        case 11: return new CmdQuadTo();
-        case 12: return new CmdClosePath();
-        case 13: return new CmdDrawPath();
-        case 14: return new CmdDrawHandle();
-        case 15: return new CmdDrawBitmap();
-        case 16: return new CmdDrawTextAt();
-        case 17: return new CmdClipPath();
-        case 18: return new CmdClipRect();
-    }
-    return NULL;
+static const int kBinaryMagic = 0x56475253;     // 'VGRS'
+static const int kBinaryVersion = 1;
+
+int MgRecordShape::getCount() const
+{
+    return _ints.size() > 1 ? _ints[1] : 0;
 }
 
-void MgRecordShape::_clear()
+void MgRecordShape::_clearCallbacks()
 {
-    for (ITEMS::iterator it = _items.begin(); it != _items.end(); ++it) {
-        delete *it;
+    for (size_t i = 0; i < _textcbs.size(); i++) {
+        if (_textcbs[i])
+            _textcbs[i]->releaseTextWidth();
     }
-    _items.clear();
+    _textcbs.clear();
+}
+
+void MgRecordShape::_clear()
+{
+    _clearCallbacks();
+    _ints.clear();
+    _floats.clear();
     _sid = 0;
 }
 
+void MgRecordShape::takeItems(GiBufferCanvas& buf, const Box2d& extentM)
+{
+    buf.takeData(_ints, _floats);
+    _extent = extentM;
+}
+
+void MgRecordShape::setTextCallback(int index, GiTextWidthCallback* c)
+{
+    if (index >= 0 && (c || index < (int)_textcbs.size())) {
+        if (index >= (int)_textcbs.size())
+            _textcbs.resize(index + 1, (GiTextWidthCallback*)0);
+        if (c)
+            c->addRefTextWidth();
+        if (_textcbs[index])
+            _textcbs[index]->releaseTextWidth();
+        _textcbs[index] = c;
+    }
+}
+
 MgObject* MgRecordShape::clone() const
 {
     MgRecordShape* p = new MgRecordShape();
@@ -709,10 +202,10 @@ void MgRecordShape::copy(const MgObject& src)
     if (src.isKindOf(Type()) && this != &src) {
         const MgRecordShape& p = (const MgRecordShape&)src;
         _clear();
-        for (ITEMS::const_iterator it = p._items.begin(); it != p._items.end(); ++it) {
-            ICmd* item = createItem((*it)->type());
-            item->copy(**it);
-            _items.push_back(item);
+        _ints = p._ints;
+        _floats = p._floats;
+        for (size_t i = 0; i < p._textcbs.size(); i++) {
+            setTextCallback((int)i, p._textcbs[i]);
         }
         _sid = p._sid;
     }
@@ -723,7 +216,7 @@ bool MgRecordShape::equals(const MgObject& src) const
 {
     if (src.isKindOf(Type())) {
         const MgRecordShape& p = (const MgRecordShape&)src;
-        if (_items.size() != p._items.size() || _sid != p._sid)
+        if (_sid != p._sid || _ints != p._ints || _floats != p._floats)
             return false;
     }
     return MgBaseShape::equals(src);
@@ -731,69 +224,250 @@ bool MgRecordShape::equals(const MgObject& src) const
 
 bool MgRecordShape::save(MgStorage* s) const
 {
-    int i = 0;
-    bool ret = true;
-    
     s->writeInt("refid", _sid);
-    for (ITEMS::const_iterator it = _items.begin(); ret && it != _items.end(); ++it) {
-        ret = s->writeNode("p", i, false);
-        if (ret) {
-            s->writeInt("type", (*it)->type());
-            ret = (*it)->save(s);
-            s->writeNode("p", i++, true);
-        }
+    if (!_ints.empty()) {       // the ops and args are packed as binary and written in base64
+        std::vector<unsigned char> data;
+        toBinary(data);
+        s->writeBinary("packed", &data.front(), (int)data.size());
     }
-    return ret && _save(s);
+    return _save(s);
 }
 
 bool MgRecordShape::load(MgShapeFactory* factory, MgStorage* s)
 {
     _clear();
-    
+
     _sid = s->readInt("refid", _sid);
-    for (int i = 0; s->readNode("p", i, false); i++) {
-        ICmd* item = createItem(s->readInt("type", 0));
-        
-        if (item && item->load(s)) {
-            _items.push_back(item);
-        } else {
-            delete item;
+
+    std::vector<unsigned char> data;
+    int n = s->readIntArray("ops");
+
+    if (s->readBinary("packed", data) > 0) {
+        if (!fromBinary(&data.front(), (int)data.size())) {
+            return s->setError("Invalid packed items.");
         }
-        s->readNode("p", i, true);
+    } else if (n > 1) {
+        _ints.resize(n);
+        s->readIntArray("ops", &_ints.front(), n);
+        n = s->readFloatArray("args");
+        if (n > 0) {
+            _floats.resize(n);
+            s->readFloatArray("args", &_floats.front(), n);
+        }
+        if (_ints[0] != (GiBufferCanvas::kMagic | GiBufferCanvas::kVersion)) {
+            _ints.clear();
+            _floats.clear();
+        }
+    } else {
+        loadLegacyItems(s);
     }
+
     return _load(factory, s);
 }
 
-bool MgRecordShape::draw(int, GiGraphics& gs, const GiContext& ctx, int) const
+static std::string readString(MgStorage* s, const char* name)
 {
-    const Matrix2d& w2d = gs.xf().worldToDisplay();
-    bool candraw = true;
-    
-    for (ITEMS::const_iterator it = _items.begin(); it != _items.end(); ++it) {
-        int type = (*it)->type();
-        if (type == CmdClipPath::Type()) {
-            candraw = (*it)->draw(gs, w2d);
-        } else if (candraw) {
-            (*it)->draw(gs, w2d);
+    std::string str;
+    int len = s->readString(name, NULL, 0);
+
+    if (len > 0) {
+        str.resize(len, 0);
+        len = s->readString(name, const_cast<char*>(str.c_str()), len);
+        str.resize(len > 0 ? len : 0);
+    }
+    return str;
+}
+
+// Converts the items saved as "p0", "p1"... nodes by the earlier versions.
+bool MgRecordShape::loadLegacyItems(MgStorage* s)
+{
+    GiBufferCanvas buf;
+
+    for (int i = 0; s->readNode("p", i, false); i++) {
+        const int type = s->readInt("type", 0);
+
+        switch (type) {
+            case 1:
+                buf.setPen(s->readInt("argb", 0xFF000000), s->readFloat("width", 0),
+                           s->readInt("style", 0), s->readFloat("phase", 0), s->readFloat("orgw", 0));
+                break;
+            case 2:
+                buf.setBrush(s->readInt("argb", 0), s->readInt("style", 0));
+                break;
+            case 3: case 4: case 6: case 18: {
+                float x = s->readFloat("x", 0), y = s->readFloat("y", 0);
+                float w = s->readFloat("w", 0), h = s->readFloat("h", 0);
+                if (type == 3) {
+                    buf.clearRect(x, y, w, h);
+                } else if (type == 18) {
+                    buf.clipRect(x, y, w, h);
+                } else {
+                    bool stroke = s->readBool("stroke", false), fill = s->readBool("fill", false);
+                    if (type == 4)
+                        buf.drawRect(x, y, w, h, stroke, fill);
+                    else
+                        buf.drawEllipse(x, y, w, h, stroke, fill);
+                }
+                break;
+            }
+            case 5:
+                buf.drawLine(s->readFloat("x1", 0), s->readFloat("y1", 0),
+                             s->readFloat("x2", 0), s->readFloat("y2", 0));
+                break;
+            case 7:
+                buf.beginPath();
+                break;
+            case 8:
+                buf.moveTo(s->readFloat("x", 0), s->readFloat("y", 0));
+                break;
+            case 9:
+                buf.lineTo(s->readFloat("x", 0), s->readFloat("y", 0));
+                break;
+            case 10:
+                buf.bezierTo(s->readFloat("c1x", 0), s->readFloat("c1y", 0),
+                             s->readFloat("c2x", 0), s->readFloat("c2y", 0),
+                             s->readFloat("x", 0), s->readFloat("y", 0));
+                break;
+            case 11:
+                buf.quadTo(s->readFloat("cpx", 0), s->readFloat("cpy", 0),
+                           s->readFloat("x", 0), s->readFloat("y", 0));
+                break;
+            case 12:
+                buf.closePath();
+                break;
+            case 13:
+                buf.drawPath(s->readBool("stroke", false), s->readBool("fill", false));
+                break;
+            case 14:
+                buf.drawHandle(s->readFloat("x", 0), s->readFloat("y", 0),
+                               s->readInt("t", 0), s->readFloat("angle", 0));
+                break;
+            case 15: {
+                std::string name(readString(s, "name"));
+                if (!name.empty()) {
+                    buf.drawBitmap(name.c_str(), s->readFloat("xc", 0), s->readFloat("yc", 0),
+                                   s->readFloat("w", 0), s->readFloat("h", 0), s->readFloat("angle", 0));
+                }
+                break;
+            }
+            case 16: {
+                std::string text(readString(s, "text"));
+                if (!text.empty()) {
+                    buf.drawTextAt(text.c_str(), s->readFloat("x", 0), s->readFloat("y", 0),
+                                   fabsf(s->readFloat("h", 0)), s->readInt("align", 0), s->readFloat("angle", 0));
+                }
+                break;
+            }
+            case 17:
+                switch (s->readInt("t", 0)) {
+                    case 0: buf.clipPath(); break;
+                    case 1: buf.saveClip(); break;
+                    case 2: buf.restoreClip(); break;
+                }
+                break;
         }
+        s->readNode("p", i, true);
+    }
+
+    if (buf.getCommandCount() > 0) {
+        buf.takeData(_ints, _floats);
+    }
+    return !_ints.empty();
+}
+
+void MgRecordShape::toBinary(std::vector<unsigned char>& data) const
+{
+    const int header[] = { kBinaryMagic, kBinaryVersion, _sid, (int)_ints.size(), (int)_floats.size() };
+    const float box[] = { _extent.xmin, _extent.ymin, _extent.xmax, _extent.ymax };
+    const size_t isize = _ints.size() * sizeof(int);
+    const size_t fsize = _floats.size() * sizeof(float);
+
+    data.resize(sizeof(header) + sizeof(box) + isize + fsize);
+    unsigned char* p = &data.front();
+
+    memcpy(p, header, sizeof(header));
+    p += sizeof(header);
+    memcpy(p, box, sizeof(box));
+    p += sizeof(box);
+    if (isize > 0) {
+        memcpy(p, &_ints.front(), isize);
+        p += isize;
+    }
+    if (fsize > 0) {
+        memcpy(p, &_floats.front(), fsize);
     }
-    return !_items.empty();
 }
 
-void MgRecordShape::addItem(const Matrix2d& w2m, ICmd* p)
+bool MgRecordShape::fromBinary(const unsigned char* data, int size)
 {
-    _extent.unionWith(p->getExtentW() * w2m);
-    _items.push_back(p);
+    int header[5];
+    float box[4];
+    const int hsize = (int)(sizeof(header) + sizeof(box));
+
+    if (!data || size < hsize)
+        return false;
+    memcpy(header, data, sizeof(header));
+    memcpy(box, data + sizeof(header), sizeof(box));
+    if (header[0] != kBinaryMagic || header[1] != kBinaryVersion
+        || header[3] < 0 || header[4] < 0
+        || size != hsize + (header[3] + header[4]) * 4) {
+        return false;
+    }
+    if (header[3] > 1) {
+        int magic;
+        memcpy(&magic, data + hsize, sizeof(magic));
+        if (magic != (GiBufferCanvas::kMagic | GiBufferCanvas::kVersion))
+            return false;
+    } else if (header[3] != 0) {
+        return false;
+    }
+
+    _clear();
+    _sid = header[2];
+    _extent = Box2d(box[0], box[1], box[2], box[3]);
+    _ints.resize(header[3]);
+    _floats.resize(header[4]);
+    if (header[3] > 0) {
+        memcpy(&_ints.front(), data + hsize, header[3] * sizeof(int));
+    }
+    if (header[4] > 0) {
+        memcpy(&_floats.front(), data + hsize + header[3] * sizeof(int), header[4] * sizeof(float));
+    }
+
+    return true;
+}
+
+bool MgRecordShape::draw(int, GiGraphics& gs, const GiContext&, int) const
+{
+    GiCanvas* canvas = gs.getCanvas();
+
+    if (!canvas || getCount() == 0)
+        return false;
+
+    GiRecordPlayer player(canvas, gs.xf().worldToDisplay(), _textcbs);
+
+    return GiBufferCanvas::replay(&player, &_ints.front(), (int)_ints.size(),
+                                  _floats.empty() ? (const float*)0 : &_floats.front(),
+                                  (int)_floats.size()) > 0;
 }
 
 // GiRecordCanvas
 //
 
-GiRecordCanvas::GiRecordCanvas(MgShapes* shapes, const GiTransform* xf, int ignoreId)
-    : _shapes(shapes), _xf(xf), _ignoreId(ignoreId)
+GiRecordCanvas::GiRecordCanvas(MgShapes* shapes, const GiTransform* xf, int ignoreId,
+                               GiCanvas* target, GiBufferCanvas* buf)
+    : _shapes(shapes), _shape(NULL), _sp(NULL), _refid(0), _xf(xf), _ignoreId(ignoreId), _target(target)
+    , _buf(buf ? buf : new GiBufferCanvas()), _ownBuf(!buf), _state(0), _stateCount(0)
 {
-    _shape = MgShapeT<MgRecordShape>::create();
-    _sp = (MgRecordShape*)_shape->shape();
+    newShape();
+}
+
+GiRecordCanvas::~GiRecordCanvas()
+{
+    clear();
+    if (_ownBuf) {
+        delete _buf;
+    }
 }
 
 const Matrix2d GiRecordCanvas::d2w() const
@@ -801,139 +475,283 @@ const Matrix2d GiRecordCanvas::d2w() const
     return _xf->displayToWorld();
 }
 
-void GiRecordCanvas::clear()
+// The shape is created or reused when something is recorded, so nothing is allocated
+// for a frame which draws nothing but the ignored shape.
+MgRecordShape* GiRecordCanvas::recordShape()
 {
-    if (_shape) {
-        if (_sp->getCount() > 0) {
-            _shapes->addShapeDirect(_shape);
+    if (!_shape) {
+        _shape = _shapes->reuseShape(MgShapeT<MgRecordShape>::Type());
+        if (_shape) {
+            _sp = (MgRecordShape*)_shape->shape();
+            _sp->clear();           // keeps the capacity for takeItems() to swap in
         } else {
-            _shape->release();
+            _shape = MgShapeT<MgRecordShape>::create();
+            _sp = (MgRecordShape*)_shape->shape();
         }
-        _shape = NULL;
-        _sp = NULL;
     }
+    return _sp;
 }
 
-bool GiRecordCanvas::beginShape(int, int sid, int, float, float, float, float)
+void GiRecordCanvas::newShape()
+{
+    _refid = 0;
+    _buf->reset();
+    _extent = Box2d(_FLT_MAX, _FLT_MAX, -_FLT_MAX, -_FLT_MAX);
+    _texts = 0;
+
+    // GiGraphics skips unchanged pens and brushes, so each shape starts with the
+    // current ones to be replayed alone.
+    if (_state & 1) {
+        _buf->setPen(_pen.argb, _pen.width, _pen.style, _pen.phase, _pen.orgw);
+    }
+    if (_state & 2) {
+        _buf->setBrush(_brush.argb, _brush.style);
+    }
+    _stateCount = _buf->getCommandCount();
+}
+
+void GiRecordCanvas::addExtent(const Box2d& rectW)
+{
+    const Matrix2d& w2m = _xf->worldToModel();
+
+    _extent.unionWith(rectW.leftBottom() * w2m);
+    _extent.unionWith(rectW.rightTop() * w2m);
+    _extent.unionWith(rectW.leftTop() * w2m);
+    _extent.unionWith(rectW.rightBottom() * w2m);
+}
+
+void GiRecordCanvas::clear()
+{
+    if (_buf->getCommandCount() > _stateCount) {
+        recordShape()->takeItems(*_buf, _extent.xmin <= _extent.xmax ? _extent : Box2d());
+        _sp->setRefID(_refid);
+        _shapes->addShapeDirect(_shape);
+    } else if (_shape) {
+        _shape->release();
+    }
+    _shape = NULL;
+    _sp = NULL;
+}
+
+bool GiRecordCanvas::beginShape(int type, int sid, int version, float x, float y, float w, float h)
 {
     if (sid == _ignoreId) {
         return false;
     }
-    if (!_shape || _sp->getCount() > 0) {
+    if (_target && !_target->beginShape(type, sid, version, x, y, w, h)) {
+        return false;
+    }
+    if (_buf->getCommandCount() > _stateCount) {
         clear();
-        _shape = MgShapeT<MgRecordShape>::create();
-        _sp = (MgRecordShape*)_shape->shape();
+        newShape();
     }
-    _sp->setRefID(sid);
-    
+    _refid = sid;
+
     return true;
 }
 
-void GiRecordCanvas::endShape(int, int, float, float)
+void GiRecordCanvas::endShape(int type, int sid, float x, float y)
 {
+    if (_target) {
+        _target->endShape(type, sid, x, y);
+    }
     clear();
-    _shape = MgShapeT<MgRecordShape>::create();
-    _sp = (MgRecordShape*)_shape->shape();
+    newShape();
 }
 
 void GiRecordCanvas::setPen(int argb, float width, int style, float phase, float orgw)
 {
-    _sp->addItem(_xf->worldToModel(), new CmdSetPen(argb, width, style, phase, orgw));
+    if (_target) {
+        _target->setPen(argb, width, style, phase, orgw);
+    }
+    _buf->setPen(argb, width, style, phase, orgw);
+    _pen.argb = argb;
+    _pen.width = width;
+    _pen.style = style;
+    _pen.phase = phase;
+    _pen.orgw = orgw;
+    _state |= 1;
 }
 
 void GiRecordCanvas::setBrush(int argb, int style)
 {
-    _sp->addItem(_xf->worldToModel(), new CmdSetBrush(argb, style));
+    if (_target) {
+        _target->setBrush(argb, style);
+    }
+    _buf->setBrush(argb, style);
+    _brush.argb = argb;
+    _brush.style = style;
+    _state |= 2;
 }
 
 void GiRecordCanvas::clearRect(float x, float y, float w, float h)
 {
-    _sp->addItem(_xf->worldToModel(), new CmdClearRect(d2w(), x, y, w, h));
+    if (_target) {
+        _target->clearRect(x, y, w, h);
+    }
+    Point2d pt(Point2d(x, y) * d2w());
+    Vector2d vec(Vector2d(w, h) * d2w());
+    _buf->clearRect(pt.x, pt.y, vec.x, vec.y);
+    addExtent(Box2d(pt, pt + vec));
 }
 
 void GiRecordCanvas::drawRect(float x, float y, float w, float h, bool stroke, bool fill)
 {
-    _sp->addItem(_xf->worldToModel(), new CmdDrawRect(d2w(), x, y, w, h, stroke, fill));
+    if (_target) {
+        _target->drawRect(x, y, w, h, stroke, fill);
+    }
+    Point2d pt(Point2d(x, y) * d2w());
+    Vector2d vec(Vector2d(w, h) * d2w());
+    _buf->drawRect(pt.x, pt.y, vec.x, vec.y, stroke, fill);
+    addExtent(Box2d(pt, pt + vec));
 }
 
 void GiRecordCanvas::drawLine(float x1, float y1, float x2, float y2)
 {
-    _sp->addItem(_xf->worldToModel(), new CmdDrawLine(d2w(), x1, y1, x2, y2));
+    if (_target) {
+        _target->drawLine(x1, y1, x2, y2);
+    }
+    Point2d pt1(Point2d(x1, y1) * d2w());
+    Point2d pt2(Point2d(x2, y2) * d2w());
+    _buf->drawLine(pt1.x, pt1.y, pt2.x, pt2.y);
+    addExtent(Box2d(pt1, pt2));
 }
 
 void GiRecordCanvas::drawEllipse(float x, float y, float w, float h, bool stroke, bool fill)
 {
-    _sp->addItem(_xf->worldToModel(), new CmdDrawEllipse(d2w(), x, y, w, h, stroke, fill));
+    if (_target) {
+        _target->drawEllipse(x, y, w, h, stroke, fill);
+    }
+    Point2d pt(Point2d(x, y) * d2w());
+    Vector2d vec(Vector2d(w, h) * d2w());
+    _buf->drawEllipse(pt.x, pt.y, vec.x, vec.y, stroke, fill);
+    addExtent(Box2d(pt, pt + vec));
 }
 
 void GiRecordCanvas::beginPath()
 {
-    _sp->addItem(_xf->worldToModel(), new CmdBeginPath());
+    if (_target) {
+        _target->beginPath();
+    }
+    _buf->beginPath();
 }
 
 void GiRecordCanvas::moveTo(float x, float y)
 {
-    _sp->addItem(_xf->worldToModel(), new CmdMoveTo(d2w(), x, y));
+    if (_target) {
+        _target->moveTo(x, y);
+    }
+    Point2d pt(Point2d(x, y) * d2w());
+    _buf->moveTo(pt.x, pt.y);
+    addExtent(Box2d(pt, pt));
 }
 
 void GiRecordCanvas::lineTo(float x, float y)
 {
-    _sp->addItem(_xf->worldToModel(), new CmdLineTo(d2w(), x, y));
+    if (_target) {
+        _target->lineTo(x, y);
+    }
+    Point2d pt(Point2d(x, y) * d2w());
+    _buf->lineTo(pt.x, pt.y);
+    addExtent(Box2d(pt, pt));
 }
 
 void GiRecordCanvas::bezierTo(float c1x, float c1y, float c2x, float c2y, float x, float y)
 {
-    _sp->addItem(_xf->worldToModel(), new CmdBezierTo(d2w(), c1x, c1y, c2x, c2y, x, y));
+    if (_target) {
+        _target->bezierTo(c1x, c1y, c2x, c2y, x, y);
+    }
+    Point2d c1(Point2d(c1x, c1y) * d2w());
+    Point2d c2(Point2d(c2x, c2y) * d2w());
+    Point2d pt(Point2d(x, y) * d2w());
+    _buf->bezierTo(c1.x, c1.y, c2.x, c2.y, pt.x, pt.y);
+    addExtent(Box2d(pt, c1, c2, pt));
 }
 
 void GiRecordCanvas::quadTo(float cpx, float cpy, float x, float y)
 {
-    _sp->addItem(_xf->worldToModel(), new CmdQuadTo(d2w(), cpx, cpy, x, y));
+    if (_target) {
+        _target->quadTo(cpx, cpy, x, y);
+    }
+    Point2d cp(Point2d(cpx, cpy) * d2w());
+    Point2d pt(Point2d(x, y) * d2w());
+    _buf->quadTo(cp.x, cp.y, pt.x, pt.y);
+    addExtent(Box2d(cp, pt));
 }
 
 void GiRecordCanvas::closePath()
 {
-    _sp->addItem(_xf->worldToModel(), new CmdClosePath());
+    if (_target) {
+        _target->closePath();
+    }
+    _buf->closePath();
 }
 
 void GiRecordCanvas::drawPath(bool stroke, bool fill)
 {
-    _sp->addItem(_xf->worldToModel(), new CmdDrawPath(stroke, fill));
+    if (_target) {
+        _target->drawPath(stroke, fill);
+    }
+    _buf->drawPath(stroke, fill);
 }
 
 void GiRecordCanvas::saveClip()
 {
-    _sp->addItem(_xf->worldToModel(), new CmdClipPath(CmdClipPath::Save));
+    if (_target) {
+        _target->saveClip();
+    }
+    _buf->saveClip();
 }
 
 void GiRecordCanvas::restoreClip()
 {
-    _sp->addItem(_xf->worldToModel(), new CmdClipPath(CmdClipPath::Restore));
+    if (_target) {
+        _target->restoreClip();
+    }
+    _buf->restoreClip();
 }
 
 bool GiRecordCanvas::clipRect(float x, float y, float w, float h)
 {
-    _sp->addItem(_xf->worldToModel(), new CmdClipRect(d2w(), x, y, w, h));
-    return true;
+    Point2d pt(Point2d(x, y) * d2w());
+    Vector2d vec(Vector2d(w, h) * d2w());
+    _buf->clipRect(pt.x, pt.y, vec.x, vec.y);
+    return !_target || _target->clipRect(x, y, w, h);
 }
 
 bool GiRecordCanvas::clipPath()
 {
-    _sp->addItem(_xf->worldToModel(), new CmdClipPath(CmdClipPath::Clip));
-    return true;
+    _buf->clipPath();
+    return !_target || _target->clipPath();
 }
 
 bool GiRecordCanvas::drawHandle(float x, float y, int type, float angle)
 {
-    _sp->addItem(_xf->worldToModel(), new CmdDrawHandle(d2w(), x, y, type, angle));
-    return true;
+    Point2d pt(Point2d(x, y) * d2w());
+    _buf->drawHandle(pt.x, pt.y, type, angle);
+    addExtent(Box2d(pt, pt));
+    return !_target || _target->drawHandle(x, y, type, angle);
 }
 
 bool GiRecordCanvas::drawBitmap(const char* name, float xc, float yc,
                                 float w, float h, float angle)
 {
-    _sp->addItem(_xf->worldToModel(), new CmdDrawBitmap(d2w(), name, xc, yc, w, h, angle));
-    return true;
+    Point2d pt(Point2d(xc, yc) * d2w());
+    Vector2d vec(Vector2d(w, h) * d2w());
+    _buf->drawBitmap(name, pt.x, pt.y, vec.x, vec.y, angle);
+    addExtent(Box2d(pt, fabsf(vec.x), fabsf(vec.y)));
+    return !_target || _target->drawBitmap(name, xc, yc, w, h, angle);
+}
+
+bool GiRecordCanvas::drawDecodedBitmap(long image, const char* name, float xc, float yc,
+                                       float w, float h, float angle)
+{
+    Point2d pt(Point2d(xc, yc) * d2w());
+    Vector2d vec(Vector2d(w, h) * d2w());
+    _buf->drawBitmap(name, pt.x, pt.y, vec.x, vec.y, angle);   // 只记录名称，回放时再按名称绘制
+    addExtent(Box2d(pt, fabsf(vec.x), fabsf(vec.y)));
+    return !_target || _target->drawDecodedBitmap(image, name, xc, yc, w, h, angle)
+        || _target->drawBitmap(name, xc, yc, w, h, angle);
 }
 
 float GiRecordCanvas::drawTextAt(const char* text, float x, float y, float h, int align, float angle)
@@ -943,7 +761,15 @@ float GiRecordCanvas::drawTextAt(const char* text, float x, float y, float h, in
 
 float GiRecordCanvas::drawTextAt(GiTextWidthCallback* c, const char* text, float x, float y, float h, int align, float angle)
 {
-    CmdDrawTextAt *p = new CmdDrawTextAt(d2w(), c, text, x, y, h, align, angle);
-    _sp->addItem(_xf->worldToModel(), p);
-    return h;
+    Point2d pt(Point2d(x, y) * d2w());
+    float hw = (Vector2d(h, 0) * d2w()).length();
+
+    _buf->drawTextAt(text, pt.x, pt.y, hw, align, angle);
+    addExtent(Box2d(pt, pt + Vector2d(h, h) * d2w()));
+    if (c) {
+        recordShape()->setTextCallback(_texts, c);
+    }
+    _texts++;
+
+    return _target ? _target->drawTextAt(c, text, x, y, h, align, angle) : h;
 }
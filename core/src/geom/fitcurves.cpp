@@ -25,6 +25,15 @@ typedef struct {
 
 typedef Point2d (*PtCallback)(void* data, int i);
 
+//! Scratch array kept on the stack for small regions (as in incremental fitting).
+template <class T, int N>
+struct ScratchArr {
+    T *p;
+    T buf[N];
+    ScratchArr(int n) : p(n > N ? new T[n] : buf) {}
+    ~ScratchArr() { if (p != buf) delete[] p; }
+};
+
 //! The wrapper class of multiple points.
 typedef struct _PtArr {
     const Point2d *d;
@@ -45,11 +54,14 @@ typedef struct _PtArr {
 typedef void        (*FitCubicCallback)(void* data, const Point2d curve[4]);
 void                FitCurve(FitCubicCallback fc, void* data, const Point2d *d, int nPts, float error);
 void      FitCurve2(FitCubicCallback fc, void* data, PtCallback d, void* data2, int nPts, float error);
-static  void        FitCurve_(FitCubicCallback fc, void* data, const PtArr &d, int nPts, float error);
+void      FitCurve3(FitCubicCallback fc, void* data, const Point2d *d, int nPts, float error,
+                    const Vector2d& tan1, const Vector2d& tan2);
+static  void        FitCurve_(FitCubicCallback fc, void* data, const PtArr &d, int nPts, float error,
+                              const point_t& tan1, const point_t& tan2);
 static  void        FitCubic(FitCubicCallback fc, void* data, const PtArr &d, int first, int &last,
                              const point_t& tHat1, const point_t& tHat2, double error);
-static  double      *Reparameterize(const PtArr &d, int first, int last, double *u,
-                                    const BezierCurve& bezCurve);
+static  void        Reparameterize(const PtArr &d, int first, int last, const double *u,
+                                   const BezierCurve& bezCurve, double *uPrime);
 static  double      NewtonRaphsonRootFind(const BezierCurve& Q, const point_t& P, double u);
 static  point_t     BezierII(int degree, const point_t *V, double t);
 static  double      B0(double u), B1(double u), B2(double u), B3(double u);
@@ -58,7 +70,7 @@ static  point_t     ComputeRightTangent(const PtArr &d, int end);
 static  point_t     ComputeCenterTangent(const PtArr &d, int center);
 static  double      ComputeMaxError(const PtArr &d, int first, int last,
                                     const BezierCurve& bezCurve, double *u, int &splitPoint);
-static  double      *ChordLengthParameterize(const PtArr &d, int first, int &last);
+static  void        ChordLengthParameterize(const PtArr &d, int first, int &last, double *u);
 static  BezierCurve GenerateBezier(const PtArr &d, int first, int last,
                                    const double *uPrime, const point_t& tHat1, const point_t& tHat2);
 
@@ -72,16 +84,32 @@ static  BezierCurve GenerateBezier(const PtArr &d, int first, int last,
 void FitCurve(FitCubicCallback fc, void* data, const Point2d *d, int nPts, float error)
 {
     PtArr arr(d);
-    FitCurve_(fc, data, arr, nPts, error);
+    FitCurve_(fc, data, arr, nPts, error, point_t(), point_t());
 }
 
 void FitCurve2(FitCubicCallback fc, void* data, PtCallback d, void* data2, int nPts, float error)
 {
     PtArr arr(d, data2);
-    FitCurve_(fc, data, arr, nPts, error);
+    FitCurve_(fc, data, arr, nPts, error, point_t(), point_t());
 }
 
-static void FitCurve_(FitCubicCallback fc, void* data, const PtArr &d, int nPts, float error)
+/*
+ *  FitCurve3 :
+ *      Fit with the given unit tangents at the endpoints (ignored if zero),
+ *      so that the curve can join the neighbouring curves smoothly.
+ *  tan1: Tangent at the first point, pointing forward
+ *  tan2: Tangent at the last point, pointing backward
+ */
+void FitCurve3(FitCubicCallback fc, void* data, const Point2d *d, int nPts, float error,
+               const Vector2d& tan1, const Vector2d& tan2)
+{
+    PtArr arr(d);
+    FitCurve_(fc, data, arr, nPts, error, point_t(tan1.x, tan1.y).normalized(),
+              point_t(tan2.x, tan2.y).normalized());
+}
+
+static void FitCurve_(FitCubicCallback fc, void* data, const PtArr &d, int nPts, float error,
+                      const point_t& tan1, const point_t& tan2)
 {
     point_t     tHat1, tHat2;   // Unit tangent vectors at endpoints
     int         first = 0;
@@ -89,11 +117,11 @@ static void FitCurve_(FitCubicCallback fc, void* data, const PtArr &d, int nPts,
     int         oldlast;
     const Point2d ptbuf[4] = { Point2d::kInvalid() };
     
-    tHat1 = ComputeLeftTangent(d, first);
+    tHat1 = tan1.lengthSquare() > 0 ? tan1 : ComputeLeftTangent(d, first);
     while (tHat1.isDegenerate() && first < last)
         tHat1 = ComputeLeftTangent(d, ++first);
     
-    tHat2 = ComputeRightTangent(d, last);
+    tHat2 = tan2.lengthSquare() > 0 ? tan2 : ComputeRightTangent(d, last);
     while (tHat2.isDegenerate() && last > first)
         tHat2 = ComputeRightTangent(d, --last);
     
@@ -127,8 +155,6 @@ static void FitCubic(FitCubicCallback fc, void* data, const PtArr &d, int first,
                      const point_t& tHat1, const point_t& tHat2, double error)
 {
     BezierCurve bezCurve;       // Control points of fitted Bezier curve
-    double      *u;             // Parameter values for point
-    double      *uPrime;        // Improved parameter values
     double      maxError;       // Maximum fitting error
     int         splitPoint;     // Point to split point set at
     double      iterationError; // Error below which you try iterating
@@ -151,37 +177,38 @@ static void FitCubic(FitCubicCallback fc, void* data, const PtArr &d, int first,
         return;
     }
 
-    // Parameterize points, and attempt to fit curve
-    u = ChordLengthParameterize(d, first, last);
-    bezCurve = GenerateBezier(d, first, last, u, tHat1, tHat2);
+    {   // The parameter buffers are released before splitting recursively
+        ScratchArr<double, 64> ubuf(last - first + 1), ubuf2(last - first + 1);
+        double *u = ubuf.p;         // Parameter values for point
+        double *uPrime = ubuf2.p;   // Improved parameter values
 
-    // Find max deviation of points to fitted curve
-    maxError = ComputeMaxError(d, first, last, bezCurve, u, splitPoint);
-    if (maxError < error) {
-        delete[] u;
-        (*fc)(data, bezCurve.copy(ptbuf));
-        return;
-    }
+        // Parameterize points, and attempt to fit curve
+        ChordLengthParameterize(d, first, last, u);
+        bezCurve = GenerateBezier(d, first, last, u, tHat1, tHat2);
+
+        // Find max deviation of points to fitted curve
+        maxError = ComputeMaxError(d, first, last, bezCurve, u, splitPoint);
+        if (maxError < error) {
+            (*fc)(data, bezCurve.copy(ptbuf));
+            return;
+        }
 
-    // If error not too large, try some reparameterization and iteration
-    if (maxError < iterationError) {
-        for (i = 0; i < maxIterations; i++) {
-            uPrime = Reparameterize(d, first, last, u, bezCurve);
-            bezCurve = GenerateBezier(d, first, last, uPrime, tHat1, tHat2);
-            maxError = ComputeMaxError(d, first, last, bezCurve, uPrime, splitPoint);
-            if (maxError < error) {
-                delete[] u;
-                delete[] uPrime;
-                (*fc)(data, bezCurve.copy(ptbuf));
-                return;
+        // If error not too large, try some reparameterization and iteration
+        if (maxError < iterationError) {
+            for (i = 0; i < maxIterations; i++) {
+                Reparameterize(d, first, last, u, bezCurve, uPrime);
+                bezCurve = GenerateBezier(d, first, last, uPrime, tHat1, tHat2);
+                maxError = ComputeMaxError(d, first, last, bezCurve, uPrime, splitPoint);
+                if (maxError < error) {
+                    (*fc)(data, bezCurve.copy(ptbuf));
+                    return;
+                }
+                mgSwap(u, uPrime);
             }
-            delete[] u;
-            u = uPrime;
         }
     }
 
     // Fitting failed -- split at max error point and fit recursively
-    delete[] u;
     tHatCenter = ComputeCenterTangent(d, splitPoint);
     FitCubic(fc, data, d, first, splitPoint, tHat1, tHatCenter, error);
     tHatCenter = point_t(-tHatCenter.x, -tHatCenter.y); // negate
@@ -211,7 +238,8 @@ static BezierCurve GenerateBezier(const PtArr &d, int first, int last,
     BezierCurve bezCurve;                   // RETURN bezier curve ctl pts
 
     // Compute the A's
-    A = new point_t[nPts * 2];
+    ScratchArr<point_t, 128> abuf(nPts * 2);
+    A = abuf.p;
     B = A + nPts;
     for (i = 0; i < nPts; i++) {
         A[i] = tHat1.scaledVector(B1(uPrime[i]));
@@ -238,8 +266,7 @@ static BezierCurve GenerateBezier(const PtArr &d, int first, int last,
         X[0] += A[i].dotProduct(tmp);
         X[1] += B[i].dotProduct(tmp);
     }
-    
-    delete[] A;
+
 
     // Compute the determinants of C and X
     det_C0_C1 = C[0][0] * C[1][1] - C[1][0] * C[0][1];
@@ -286,16 +313,14 @@ static BezierCurve GenerateBezier(const PtArr &d, int first, int last,
  *  first, last: Indices defining region
  *  u: Current parameter values
  *  bezCurve: Current fitted curve
+ *  uPrime: New parameter values
  */
-static double *Reparameterize(const PtArr &d, int first, int last, double *u, const BezierCurve& bezCurve)
+static void Reparameterize(const PtArr &d, int first, int last, const double *u,
+                           const BezierCurve& bezCurve, double *uPrime)
 {
-    double  *uPrime;                // New parameter values
-
-    uPrime = new double[last - first + 1];
     for (int i = first; i <= last; i++) {
         uPrime[i-first] = NewtonRaphsonRootFind(bezCurve, d[i], u[i - first]);
     }
-    return uPrime;
 }
 
 
@@ -423,13 +448,11 @@ static point_t ComputeCenterTangent(const PtArr &d, int center) {
  *  ChordLengthParameterize :
  *  Assign parameter values to digitized points
  *  using relative distances between points.
+ *  u: Parameterization
  */
-static double *ChordLengthParameterize(const PtArr &d, int first, int &last)
+static void ChordLengthParameterize(const PtArr &d, int first, int &last, double *u)
 {
     int     i;
-    double  *u;         // Parameterization
-
-    u = new double[last-first+1];
 
     u[0] = 0.0;
     for (i = first+1; i <= last; i++) {
@@ -443,8 +466,6 @@ static double *ChordLengthParameterize(const PtArr &d, int first, int &last)
     for (i = first + 1; i <= last; i++) {
         u[i-first] = u[i-first] / u[last-first];
     }
-
-    return u;
 }
 
 
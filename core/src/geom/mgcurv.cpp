@@ -972,6 +972,8 @@ struct FitCurveHelper {
 
 extern void FitCurve(mgcurv::FitCubicCallback, void*, const Point2d *, int, float);
 extern void FitCurve2(mgcurv::FitCubicCallback, void*, mgcurv::PtCallback, void*, int, float);
+extern void FitCurve3(mgcurv::FitCubicCallback, void*, const Point2d *, int, float,
+                      const Vector2d&, const Vector2d&);
 
 int mgcurv::fitCurve(int knotCount, Point2d* knots, Vector2d* knotvs,
                      int count, const Point2d* pts, float tol)
@@ -1005,6 +1007,12 @@ void mgcurv::fitCurve3(FitCubicCallback fc, void* data, const Point2d *pts, int
     FitCurve(fc, data, pts, n, tol);
 }
 
+void mgcurv::fitCurve3(FitCubicCallback fc, void* data, const Point2d *pts, int n, float tol,
+                       const Vector2d& startTangent, const Vector2d& endTangent)
+{
+    FitCurve3(fc, data, pts, n, tol, startTangent, endTangent);
+}
+
 void mgcurv::fitCurve4(FitCubicCallback fc, void* data, PtCallback pts, void* data2, int n, float tol)
 {
     FitCurve2(fc, data, pts, data2, n, tol);
@@ -0,0 +1,116 @@
+﻿// mgcurvfit.cpp: 实现逐点拟合三次样条曲线的类 MgCurveFitter
+// Copyright (c) 2004-2015, https://github.com/rhcad/vgcore, BSD License
+
+#include "mgcurvfit.h"
+#include "mgcurv.h"
+#include <vector>
+
+//! MgCurveFitter的内部数据类
+struct MgCurveFitterImpl
+{
+    std::vector<Point2d>    tail;       //!< 尚未拟合的输入点，首点为已固定部分的末端
+    std::vector<Point2d>    knots;      //!< 已固定的型值点
+    std::vector<Vector2d>   knotvs;     //!< 已固定的型值点的切矢量
+    Vector2d                startTan;   //!< 尾部首点处向前的切向，零矢量表示未知
+    float                   tol;
+    int                     window;
+    int                     count;      //!< 输入点数
+
+    //! 拟合 tail 的前 n 个点，追加到型值点中
+    void fit(int n, const Vector2d& endTan) {
+        mgcurv::fitCurve3(append, this, &tail.front(), n, tol, startTan, endTan);
+    }
+
+    static void append(void* data, const Point2d curve[4]) {
+        MgCurveFitterImpl* p = (MgCurveFitterImpl*)data;
+
+        if (curve[0].isDegenerate()) {              // 拟合中断，下一段另起
+            return;
+        }
+        if (!p->knots.empty() && p->knots.back() == curve[0]) {
+            p->knots.push_back(curve[3]);
+            p->knotvs.push_back(curve[3] - curve[2]);
+        } else {
+            p->knots.push_back(curve[0]);
+            p->knotvs.push_back(curve[1] - curve[0]);
+            p->knots.push_back(curve[3]);
+            p->knotvs.push_back(curve[3] - curve[2]);
+        }
+    }
+};
+
+MgCurveFitter::MgCurveFitter() : m_data(new MgCurveFitterImpl)
+{
+    begin(1.f);
+}
+
+MgCurveFitter::~MgCurveFitter()
+{
+    delete m_data;
+}
+
+void MgCurveFitter::begin(float tol, int window)
+{
+    m_data->tail.clear();
+    m_data->knots.clear();
+    m_data->knotvs.clear();
+    m_data->startTan = Vector2d();
+    m_data->tol = tol;
+    m_data->window = window < 4 ? 4 : window;
+    m_data->count = 0;
+}
+
+int MgCurveFitter::addPoint(const Point2d& pt)
+{
+    std::vector<Point2d>& tail = m_data->tail;
+    int w = m_data->window;
+
+    if (!tail.empty() && tail.back().distanceSquare(pt) < 1e-4f) {
+        return m_data->count;
+    }
+    tail.push_back(pt);
+    m_data->count++;
+
+    if ((int)tail.size() >= 2 * w) {                // 固定前一个窗口，末端切向取两侧点的连线
+        m_data->fit(w + 1, tail[w - 1] - tail[w + 1]);
+        if (!m_data->knots.empty() && m_data->knots.back() == tail[w]) {
+            m_data->startTan = m_data->knotvs.back();
+        } else {
+            m_data->startTan = Vector2d();
+        }
+        tail.erase(tail.begin(), tail.begin() + w);
+    }
+
+    return m_data->count;
+}
+
+int MgCurveFitter::end()
+{
+    if (m_data->tail.size() > 1) {
+        m_data->fit((int)m_data->tail.size(), Vector2d());
+    }
+    m_data->tail.clear();
+    m_data->startTan = Vector2d();
+
+    return getKnotCount();
+}
+
+int MgCurveFitter::getPointCount() const
+{
+    return m_data->count;
+}
+
+int MgCurveFitter::getKnotCount() const
+{
+    return (int)m_data->knots.size();
+}
+
+const Point2d* MgCurveFitter::getKnots() const
+{
+    return m_data->knots.empty() ? (const Point2d*)0 : &m_data->knots.front();
+}
+
+const Vector2d* MgCurveFitter::getKnotVectors() const
+{
+    return m_data->knotvs.empty() ? (const Vector2d*)0 : &m_data->knotvs.front();
+}
@@ -5,6 +5,7 @@
 #include "mglnrel.h"
 #include "mgcurv.h"
 #include "giplclip.h"
+#include "giimagereg.h"
 
 #ifndef SafeCall
 #define SafeCall(p, f)      if (p) p->f
@@ -67,8 +68,7 @@ bool GiGraphics::beginPaint(GiCanvas* canvas, const RECT_2D& clipBox)
     }
     
     m_impl->canvas = canvas;
-    m_impl->ctxused = 0;
-    m_impl->stopping = 0;
+    m_impl->ctxused = 0;                // 不清除 stopping，以免丢失其他线程的中断请求
     
     float phase = fabsf(m_impl->phase);
     m_impl->phase = (phase < 1e4f ? phase + 0.5f : 0.5f) * (m_impl->phase > 0 ? 1.f : -1.f);
@@ -95,6 +95,9 @@ bool GiGraphics::beginPaint(GiCanvas* canvas, const RECT_2D& clipBox)
 
 void GiGraphics::endPaint()
 {
+    if (m_impl->canvas) {
+        m_impl->flushBatch();
+    }
     m_impl->canvas = (GiCanvas *)0;
 }
 
@@ -110,22 +113,43 @@ bool GiGraphics::isPrint() const
 
 bool GiGraphics::isStopping() const
 {
-    return m_impl->stopping > 0;
+    return giAtomicLoad(&m_impl->stopping) > 0;
 }
 
 void GiGraphics::stopDrawing(bool stopped)
 {
-    if (m_impl->stopping == 0 && stopped)
-        giAtomicIncrement(&m_impl->stopping);
-    else while (m_impl->stopping > 0 && !stopped)
+    if (stopped)
+        giAtomicCompareAndSwap(&m_impl->stopping, 1, 0);
+    else while (giAtomicLoad(&m_impl->stopping) > 0)
         giAtomicDecrement(&m_impl->stopping);
 }
 
 GiCanvas* GiGraphics::getCanvas()
 {
+    if (m_impl->canvas) {               // 调用者可能直接改变画布的状态
+        m_impl->flushBatch();
+        m_impl->ctxused = 0;
+    }
     return m_impl->canvas;
 }
 
+int GiGraphics::setBatchMode(int mode)
+{
+    int old = m_impl->batchMode;
+    
+    if (m_impl->canvas && mode < 1) {
+        m_impl->flushBatch();
+    }
+    m_impl->batchMode = mode;
+    
+    return old;
+}
+
+int GiGraphics::getBatchMode() const
+{
+    return m_impl->batchMode;
+}
+
 Box2d GiGraphics::getClipModel() const
 {
     return m_impl->rectDrawM;
@@ -157,6 +181,7 @@ bool GiGraphics::setClipBox(const RECT_2D& rc)
             m_impl->rectDraw.inflate(GiGraphicsImpl::CLIP_INFLATE);
             m_impl->rectDrawM = m_impl->rectDraw * xf().displayToModel();
             m_impl->rectDrawW = m_impl->rectDrawM * xf().modelToWorld();
+            m_impl->flushBatch();
             SafeCall(m_impl->canvas, clipRect(m_impl->clipBox.left, m_impl->clipBox.top,
                                               m_impl->clipBox.width(),
                                               m_impl->clipBox.height()));
@@ -182,6 +207,7 @@ bool GiGraphics::setClipWorld(const Box2d& rectWorld)
                 m_impl->rectDraw.inflate(GiGraphicsImpl::CLIP_INFLATE);
                 m_impl->rectDrawM = m_impl->rectDraw * xf().displayToModel();
                 m_impl->rectDrawW = m_impl->rectDrawM * xf().modelToWorld();
+                m_impl->flushBatch();
                 SafeCall(m_impl->canvas, clipRect(m_impl->clipBox.left, m_impl->clipBox.top,
                                                   m_impl->clipBox.width(), m_impl->clipBox.height()));
             }
@@ -341,11 +367,14 @@ class PolylineAux
 {
     GiGraphics* m_gs;
     const GiContext* m_pContext;
+    GiGraphicsImpl* m_impl;
 public:
-    PolylineAux(GiGraphics* gs, const GiContext* ctx) : m_gs(gs), m_pContext(ctx) {}
+    PolylineAux(GiGraphics* gs, const GiContext* ctx, GiGraphicsImpl* impl)
+        : m_gs(gs), m_pContext(ctx), m_impl(impl) {}
     bool draw(const Point2d* pxs, int n) const {
         return pxs && n > 1 && m_gs->rawLines(m_pContext, pxs, n);
     }
+    Point2d* buffer(int n) const { return m_impl->pxbuf(n); }
 };
 
 static bool DrawEdge(int count, int &i, Point2d* pts, Point2d &ptLast, 
@@ -384,9 +413,7 @@ static bool DrawEdge(int count, int &i, Point2d* pts, Point2d &ptLast,
     // 显示找到的多条线段
     n = ei - si + 1;
     if (n > 1) {
-        vector<Point2d> pxpoints;
-        pxpoints.resize(n);
-        Point2d* pxs = &pxpoints.front();
+        Point2d* pxs = aux.buffer(n);
         n = 0;
         for (int j = si; j <= ei; j++) {
             // 记下第一个点，其他点如果和上一点不重合则记下，否则跳过
@@ -414,8 +441,6 @@ bool GiGraphics::drawLines(const GiContext* ctx, int count,
 
     int i;
     Point2d pt1, pt2, ptLast;
-    vector<Point2d> pxpoints;
-    vector<Point2d> pointBuf;
     bool ret = false;
     Matrix2d matD(S2D(xf(), modelUnit));
 
@@ -424,8 +449,7 @@ bool GiGraphics::drawLines(const GiContext* ctx, int count,
         return false;
 
     if (DRAW_MAXR(m_impl, modelUnit).contains(extent)) {    // 全部在显示区域内
-        pxpoints.resize(count);
-        Point2d* pxs = &pxpoints.front();
+        Point2d* pxs = m_impl->pxbuf(count);
         int n = 0;
         for (i = 0; i < count; i++) {
             pt2 = points[i] * matD;
@@ -436,13 +460,12 @@ bool GiGraphics::drawLines(const GiContext* ctx, int count,
         }
         ret = rawLines(ctx, pxs, n);
     } else {                                        // 部分在显示区域内
-        pointBuf.resize(count);
+        Point2d* pts = m_impl->ptbuf(count);
         for (i = 0; i < count; i++)                 // 转换到像素坐标
-            pointBuf[i] = points[i] * matD;
-        Point2d* pts = &pointBuf.front();
+            pts[i] = points[i] * matD;
 
         ptLast = pts[0];
-        PolylineAux aux(this, ctx);
+        PolylineAux aux(this, ctx, m_impl);
         for (i = 0; i < count - 1; i++) {
             ret = DrawEdge(count, i, pts, ptLast, aux, m_impl->rectDraw) || ret;
         }
@@ -461,8 +484,6 @@ bool GiGraphics::drawBeziers(const GiContext* ctx, int count,
     count = 1 + (count - 1) / 3 * 3;
 
     bool ret = false;
-    vector<Point2d> pxpoints;
-    vector<Point2d> pointBuf;
     int i, j, n, si, ei;
     Point2d * pxs;
     Matrix2d matD(S2D(xf(), modelUnit));
@@ -472,23 +493,20 @@ bool GiGraphics::drawBeziers(const GiContext* ctx, int count,
         return false;
     
     if (closed) {
-        pxpoints.resize(count);
-        pxs = &pxpoints.front();
+        pxs = m_impl->pxbuf(count);
         for (i = 0; i < count; i++)
             pxs[i] = points[i] * matD;
         ret = rawBeziers(ctx, pxs, count, closed);
     }
     else if (DRAW_MAXR(m_impl, modelUnit).contains(extent)) {   // 全部在显示区域内
-        pxpoints.resize(count);
-        pxs = &pxpoints.front();
+        pxs = m_impl->pxbuf(count);
         for (i = 0; i < count; i++)
             pxs[i] = points[i] * matD;
         ret = rawBeziers(ctx, pxs, count);
     } else {
-        pointBuf.resize(count);
+        Point2d* pts = m_impl->ptbuf(count);
         for (i = 0; i < count; i++)                 // 转换到像素坐标
-            pointBuf[i] = points[i] * matD;
-        Point2d* pts = &pointBuf.front();
+            pts[i] = points[i] * matD;
 
         for (i = 0; i + 3 < count;) {
             for (; i + 3 < count && !m_impl->rectDraw.isIntersect(Box2d(4, &pts[i])); i += 3) ;
@@ -497,8 +515,7 @@ bool GiGraphics::drawBeziers(const GiContext* ctx, int count,
                 ei = i + 3;
             if (ei > si) {
                 n = ei - si + 1;
-                pxpoints.resize(n);
-                pxs = &pxpoints.front();
+                pxs = m_impl->pxbuf(n);
                 for (j=0; j<n; j++)
                     pxs[j] = pts[si + j];
                 ret = rawBeziers(ctx, pxs, n);
@@ -518,8 +535,6 @@ bool GiGraphics::drawBeziers(const GiContext* ctx, int count,
         count = 0x1000;
     
     bool ret = false;
-    vector<Point2d> pxpoints;
-    vector<Point2d> pointBuf;
     int i, j, n, si, ei;
     Point2d * pxs;
     Matrix2d matD(S2D(xf(), modelUnit));
@@ -528,8 +543,7 @@ bool GiGraphics::drawBeziers(const GiContext* ctx, int count,
     if (!DRAW_RECT(m_impl, modelUnit).isIntersect(extent))  // 全部在显示区域外
         return false;
     
-    pointBuf.resize(1 + (count - 1) * 3);
-    pxs = &pointBuf.front();
+    pxs = m_impl->ptbuf(1 + (count - 1) * 3);
     
     if (closed) {
         pxs[0] = knot[0] * matD;
@@ -566,8 +580,7 @@ bool GiGraphics::drawBeziers(const GiContext* ctx, int count,
                 ei = i + 3;
             if (ei > si) {
                 n = ei - si + 1;
-                pxpoints.resize(n);
-                pxs = &pxpoints.front();
+                pxs = m_impl->pxbuf(n);
                 for (j=0; j<n; j++)
                     pxs[j] = pts[si + j];
                 ret = rawBeziers(ctx, pxs, n);
@@ -635,7 +648,6 @@ static bool drawPolygonEdge(const PolylineAux& aux,
                             int ienter)
 {
     bool ret = false;
-    vector<Point2d> pxpoints;
     Point2d pt1, pt2;
     int si, ei, n, i;
 
@@ -644,8 +656,7 @@ static bool drawPolygonEdge(const PolylineAux& aux,
         ei = findInvisibleEdge(clip, si, ienter);
         n = ei - si + 1;
         if (n > 1) {
-            pxpoints.resize(n);
-            Point2d *pxs = &pxpoints.front();
+            Point2d *pxs = aux.buffer(n);
             n = 0;
             for (i = si; i <= ei; i++) {
                 pt2 = clip.getPoint(i);
@@ -676,12 +687,9 @@ bool GiGraphics::_drawPolygon(const GiContext* ctx, int count, const Point2d* po
     if (context.isNullLine() && !context.hasFillColor())
         return false;
 
-    vector<Point2d> pxpoints;
     Point2d pt1, pt2;
     Matrix2d matD(S2D(xf(), modelUnit));
-
-    pxpoints.resize(count);
-    Point2d *pxs = &pxpoints.front();
+    Point2d *pxs = m_impl->pxbuf(count);
     int n = 0;
     for (int i = 0; i < count; i++) {
         pt2 = points[i];
@@ -724,7 +732,7 @@ bool GiGraphics::drawPolygon(const GiContext* ctx, int count,
     if (DRAW_MAXR(m_impl, modelUnit).contains(extent)) {        // 全部在显示区域内
         ret = _drawPolygon(ctx, count, points, true, true, true, modelUnit);
     } else {                                                    // 部分在显示区域内
-        PolygonClip clip (m_impl->rectDraw);
+        PolygonClip clip (m_impl->rectDraw, m_impl->clipBuf1, m_impl->clipBuf2);
         if (!clip.clip(count, points, &S2D(xf(), modelUnit)))   // 多边形剪裁
             return false;
         count = clip.getCount();
@@ -736,7 +744,7 @@ bool GiGraphics::drawPolygon(const GiContext* ctx, int count,
         if (ienter == count) {
             ret = _drawPolygon(ctx, count, points, false, false, true, modelUnit) || ret;
         } else {
-            ret = drawPolygonEdge(PolylineAux(this, ctx), count, clip, ienter) || ret;
+            ret = drawPolygonEdge(PolylineAux(this, ctx, m_impl), count, clip, ienter) || ret;
         }
     }
 
@@ -896,12 +904,11 @@ bool GiGraphics::drawHermiteSplines(const GiContext* ctx, int count, const Point
     int i;
     Point2d pt;
     Vector2d vec;
-    vector<Point2d> pxpoints;
     Matrix2d matD(S2D(xf(), modelUnit));
     Matrix2d mat2(matD / 3.f);
-
-    pxpoints.resize(1 + (closed ? count : count - 1) * 3);
-    Point2d *pxs = &pxpoints.front();
+    const int n = 1 + (closed ? count : count - 1) * 3;
+    Point2d *pxs = m_impl->pxbuf(n);
+    const Point2d *pxs0 = pxs;
 
     pt = knots[0] * matD;                       // 第一个Bezier段的起点
     vec = knotvs[0] * mat2;                     // 第一个Bezier段的起始矢量
@@ -915,11 +922,11 @@ bool GiGraphics::drawHermiteSplines(const GiContext* ctx, int count, const Point
     }
     if (closed) {
         *pxs++ = (pt += vec);                   // 产生Bezier段的第二点
-        *pxs++ = 2 * pxpoints[0] - pxpoints[1].asVector();  // 产生Bezier段的第三点
-        *pxs++ = pxpoints[0];                   // 产生Bezier段的终点
+        *pxs++ = 2 * pxs0[0] - pxs0[1].asVector();  // 产生Bezier段的第三点
+        *pxs++ = pxs0[0];                       // 产生Bezier段的终点
     }
     
-    return rawBeziers(ctx, &pxpoints.front(), getSize(pxpoints), closed);
+    return rawBeziers(ctx, pxs0, n, closed);
 }
 
 bool GiGraphics::drawBSplines(const GiContext* ctx, int count, const Point2d* ctlpts,
@@ -942,12 +949,12 @@ bool GiGraphics::drawBSplines(const GiContext* ctx, int count, const Point2d* ct
     int i;
     Point2d pt1, pt2, pt3, pt4;
     float d6 = 1.f / 6.f;
-    vector<Point2d> pxpoints;
     Matrix2d matD(S2D(xf(), modelUnit));
 
-    // 开辟像素坐标数组
-    pxpoints.resize(1 + (closed ? count : (count - 3)) * 3);
-    Point2d *pxs = &pxpoints.front();
+    // 取像素坐标数组
+    const int n = 1 + (closed ? count : (count - 3)) * 3;
+    Point2d *pxs = m_impl->pxbuf(n);
+    const Point2d *pxs0 = pxs;
 
     // 计算第一个曲线段
     pt1 = ctlpts[0] * matD;
@@ -971,7 +978,7 @@ bool GiGraphics::drawBSplines(const GiContext* ctx, int count, const Point2d* ct
     }
 
     // 绘图
-    return rawBeziers(ctx, &pxpoints.front(), getSize(pxpoints), closed);
+    return rawBeziers(ctx, pxs0, n, closed);
 }
 
 bool GiGraphics::drawQuadSplines(const GiContext* ctx, int count, const Point2d* ctlpts,
@@ -1077,6 +1084,147 @@ bool GiGraphics::drawPath_(const GiContext* ctx, const MgPath& path, bool fill,
     return rawEndPath(ctx, fill);
 }
 
+//! 得到在[lo, hi]内的网格线序号范围，strict为true时不含在边界上的线
+static int gridRange(float lo, float hi, float org, float step, bool strict, int& i0, int& i1)
+{
+    float tol = step * 1e-3f;
+    
+    i0 = (int)ceilf((lo - org + (strict ? tol : -tol)) / step);
+    i1 = (int)floorf((hi - org - (strict ? tol : -tol)) / step);
+    
+    return i1 - i0 + 1;
+}
+
+//! 生成一类网格线的路径，cls: 0-全部，1-普通线，2-主网格线
+static int gridLinesPath(GiGraphics* gs, const Matrix2d& matD, const Box2d& rect,
+                         const Point2d& origin, const Vector2d& cell,
+                         const int ix[2], const int iy[2], int major, int cls)
+{
+    int n = 0;
+    Point2d a, b;
+    
+    for (int i = ix[0]; i <= ix[1]; i++) {
+        if (cls == 0 || (cls == 2) == (i % major == 0)) {
+            float x = origin.x + cell.x * (float)i;
+            a = Point2d(x, rect.ymin) * matD;
+            b = Point2d(x, rect.ymax) * matD;
+            gs->rawMoveTo(a.x, a.y);
+            gs->rawLineTo(b.x, b.y);
+            n++;
+        }
+    }
+    for (int j = iy[0]; j <= iy[1] && !gs->isStopping(); j++) {
+        if (cls == 0 || (cls == 2) == (j % major == 0)) {
+            float y = origin.y + cell.y * (float)j;
+            a = Point2d(rect.xmin, y) * matD;
+            b = Point2d(rect.xmax, y) * matD;
+            gs->rawMoveTo(a.x, a.y);
+            gs->rawLineTo(b.x, b.y);
+            n++;
+        }
+    }
+    
+    return n;
+}
+
+int GiGraphics::drawGridLines(const GiContext* ctx, const GiContext* ctxMajor,
+                              const Point2d& origin, const Vector2d& cell, int major,
+                              const Box2d& extent, bool modelUnit)
+{
+    const Matrix2d& matD = S2D(xf(), modelUnit);
+    Box2d rect(DRAW_RECT(m_impl, modelUnit));
+    bool limited = !extent.isEmpty();
+    int ix[2], iy[2];
+    
+    if (limited)
+        rect.intersectWith(extent);
+    if (rect.isEmpty() || cell.x < _MGZERO || cell.y < _MGZERO || isStopping())
+        return 0;
+    
+    float spacing = mgMin((Vector2d(cell.x, 0) * matD).length(),
+                          (Vector2d(0, cell.y) * matD).length());
+    
+    major = major < 2 ? 1 : major;
+    if (spacing * major < 2.f)
+        return 0;
+    
+    if (gridRange(rect.xmin, rect.xmax, origin.x, cell.x, limited, ix[0], ix[1]) < 1)
+        ix[1] = ix[0] - 1;
+    if (gridRange(rect.ymin, rect.ymax, origin.y, cell.y, limited, iy[0], iy[1]) < 1)
+        iy[1] = iy[0] - 1;
+    
+    int n = 0, k;
+    const GiContext* ctx2 = ctxMajor ? ctxMajor : ctx;
+    
+    if (major > 1 && (spacing < 2.f || ctx2 != ctx)) {
+        if (spacing >= 2.f) {
+            rawBeginPath();
+            k = gridLinesPath(this, matD, rect, origin, cell, ix, iy, major, 1);
+            if (k > 0 && rawEndPath(ctx, false))
+                n += k;
+        }
+        rawBeginPath();
+        k = gridLinesPath(this, matD, rect, origin, cell, ix, iy, major, 2);
+        if (k > 0 && rawEndPath(ctx2, false))
+            n += k;
+    }
+    else {
+        rawBeginPath();
+        k = gridLinesPath(this, matD, rect, origin, cell, ix, iy, major, 0);
+        if (k > 0 && rawEndPath(ctx, false))
+            n += k;
+    }
+    
+    return n;
+}
+
+int GiGraphics::drawGridDots(const GiContext* ctx, const Point2d& origin, const Vector2d& cell,
+                             float size, const Box2d& extent, bool modelUnit)
+{
+    const Matrix2d& matD = S2D(xf(), modelUnit);
+    Box2d rect(DRAW_RECT(m_impl, modelUnit));
+    int ix[2], iy[2];
+    
+    if (!extent.isEmpty())
+        rect.intersectWith(extent);
+    if (!m_impl->canvas || rect.isEmpty() || cell.x < _MGZERO || cell.y < _MGZERO || isStopping())
+        return 0;
+    
+    Vector2d vx(Vector2d(cell.x, 0) * matD);
+    Vector2d vy(Vector2d(0, cell.y) * matD);
+    
+    if (mgMin(vx.length(), vy.length()) < 3.f)
+        return 0;
+    
+    int nx = gridRange(rect.xmin, rect.xmax, origin.x, cell.x, false, ix[0], ix[1]);
+    int ny = gridRange(rect.ymin, rect.ymax, origin.y, cell.y, false, iy[0], iy[1]);
+    
+    if (nx < 1 || ny < 1)
+        return 0;
+    
+    Point2d org((origin + Vector2d(cell.x * (float)ix[0], cell.y * (float)iy[0])) * matD);
+    float s = (Vector2d(size, 0) * matD).length();
+    
+    if (fabsf(vx.y) < _MGZERO && fabsf(vy.x) < _MGZERO && setPen(ctx)) {
+        m_impl->flushBatch();
+        if (m_impl->canvas->drawDots(org.x, org.y, vx.x, vy.y, nx, ny, s))
+            return nx * ny;
+    }
+    
+    rawBeginPath();
+    for (int j = 0; j < ny && !isStopping(); j++) {
+        for (int i = 0; i < nx; i++) {
+            Point2d pt(org + vx * (float)i + vy * (float)j);
+            rawMoveTo(pt.x - s, pt.y);
+            rawLineTo(pt.x + s, pt.y);
+            rawMoveTo(pt.x, pt.y - s);
+            rawLineTo(pt.x, pt.y + s);
+        }
+    }
+    
+    return rawEndPath(ctx, false) ? nx * ny : 0;
+}
+
 //! 箭头图案
 static const struct {
     bool        fill;
@@ -1132,38 +1280,22 @@ bool GiGraphics::drawPathWithArrayHead(const GiContext& ctx, MgPath& path, int s
 
 bool GiGraphics::setPen(const GiContext* ctx)
 {
-    bool changed = !(m_impl->ctxused & 1);
-    
-    if (m_impl->canvas) {
-        if (ctx && (!mgEquals(ctx->getLineWidth(), m_impl->ctx.getLineWidth())
-                    || ctx->isAutoScale() != m_impl->ctx.isAutoScale())) {
-            m_impl->ctx.setLineWidth(ctx->getLineWidth(), ctx->isAutoScale());
-            changed = true;
-        }
-        if (ctx && !mgEquals(ctx->getExtraWidth(), m_impl->ctx.getExtraWidth())) {
-            m_impl->ctx.setExtraWidth(ctx->getExtraWidth());
-            changed = true;
-        }
-        if (ctx && ctx->getLineColor() != m_impl->ctx.getLineColor()) {
-            m_impl->ctx.setLineColor(ctx->getLineColor());
-            changed = true;
-        }
-        if (ctx && ctx->getLineStyleEx() != m_impl->ctx.getLineStyleEx()) {
-            m_impl->ctx.setLineStyle(ctx->getLineStyleEx(), true);
-            changed = true;
-        }
+    if (m_impl->canvas && ctx) {
+        m_impl->ctx.setLineWidth(ctx->getLineWidth(), ctx->isAutoScale());
+        m_impl->ctx.setExtraWidth(ctx->getExtraWidth());
+        m_impl->ctx.setLineColor(ctx->getLineColor());
+        m_impl->ctx.setLineStyle(ctx->getLineStyleEx(), true);
     }
     
     ctx = &(m_impl->ctx);
-    if (m_impl->canvas && changed) {
-        m_impl->ctxused &= 1;
+    if (m_impl->canvas) {               // 由画布状态缓存去掉与当前画笔相同的设置
         float w = calcPenWidth(ctx->getLineWidth(), ctx->isAutoScale());
         float orgw = ctx->getLineWidth();
         orgw = (orgw < -0.1f && ctx->isAutoScale()) ? orgw - 1e4f : orgw;
-        m_impl->canvas->setPen(calcPenColor(ctx->getLineColor()).getARGB(),
-                               w + ctx->getExtraWidth(),
-                               ctx->getLineStyleEx(),
-                               mgMax(m_impl->phase, 0.f), orgw);
+        m_impl->setPen(calcPenColor(ctx->getLineColor()).getARGB(),
+                       w + ctx->getExtraWidth(),
+                       ctx->getLineStyleEx(),
+                       mgMax(m_impl->phase, 0.f), orgw);
     }
     
     return !ctx->isNullLine();
@@ -1171,19 +1303,13 @@ bool GiGraphics::setPen(const GiContext* ctx)
 
 bool GiGraphics::setBrush(const GiContext* ctx)
 {
-    bool changed = !(m_impl->ctxused & 2);
-    
-    if (m_impl->canvas) {
-        if (ctx && ctx->getFillColor() != m_impl->ctx.getFillColor()) {
-            m_impl->ctx.setFillColor(ctx->getFillColor());
-            changed = true;
-        }
+    if (m_impl->canvas && ctx) {
+        m_impl->ctx.setFillColor(ctx->getFillColor());
     }
     
     ctx = &(m_impl->ctx);
-    if (m_impl->canvas && changed) {
-        m_impl->ctxused &= 2;
-        m_impl->canvas->setBrush(calcPenColor(ctx->getFillColor()).getARGB(), 0);
+    if (m_impl->canvas) {
+        m_impl->setBrush(calcPenColor(ctx->getFillColor()).getARGB());
     }
     
     return ctx->hasFillColor();
@@ -1191,9 +1317,13 @@ bool GiGraphics::setBrush(const GiContext* ctx)
 
 bool GiGraphics::rawLine(const GiContext* ctx, float x1, float y1, float x2, float y2)
 {
-    if (m_impl->canvas && !m_impl->stopping && setPen(ctx)
+    if (m_impl->canvas && !isStopping() && setPen(ctx)
         && !isnan(x1) && !isnan(y1) && !isnan(x2) && !isnan(y2)) {
-        m_impl->canvas->drawLine(x1, y1, x2, y2);
+        if (m_impl->batchMode > 0) {    // 追加到合并中的描边路径
+            m_impl->batchLineTo(x1, y1, x2, y2);
+        } else {
+            m_impl->canvas->drawLine(x1, y1, x2, y2);
+        }
         return true;
     }
     return false;
@@ -1202,11 +1332,23 @@ bool GiGraphics::rawLine(const GiContext* ctx, float x1, float y1, float x2, flo
 bool GiGraphics::rawLines(const GiContext* ctx, const Point2d* pxs, int count)
 {
     if (m_impl->canvas && setPen(ctx) && pxs && count > 0) {
+        if (m_impl->batchMode > 0) {
+            for (int i = 0; i < count; i++) {
+                if (pxs[i].isDegenerate())
+                    return false;
+            }
+            m_impl->openBatch();
+            m_impl->canvas->moveTo(pxs[0].x, pxs[0].y);
+            for (int i = 1; i < count && !isStopping(); i++) {
+                m_impl->canvas->lineTo(pxs[i].x, pxs[i].y);
+            }
+            return true;
+        }
         m_impl->canvas->beginPath();
         if (pxs[0].isDegenerate())
             return false;
         m_impl->canvas->moveTo(pxs[0].x, pxs[0].y);
-        for (int i = 1; i < count && !m_impl->stopping; i++) {
+        for (int i = 1; i < count && !isStopping(); i++) {
             if (pxs[i].isDegenerate())
                 return false;
             m_impl->canvas->lineTo(pxs[i].x, pxs[i].y);
@@ -1220,11 +1362,12 @@ bool GiGraphics::rawLines(const GiContext* ctx, const Point2d* pxs, int count)
 bool GiGraphics::rawBeziers(const GiContext* ctx, const Point2d* pxs, int count, bool closed)
 {
     if (m_impl->canvas && setPen(ctx) && pxs && count > 0) {
+        m_impl->flushBatch();
         m_impl->canvas->beginPath();
         if (pxs[0].isDegenerate())
             return false;
         m_impl->canvas->moveTo(pxs[0].x, pxs[0].y);
-        for (int i = 1; i + 2 < count && !m_impl->stopping; i += 3) {
+        for (int i = 1; i + 2 < count && !isStopping(); i += 3) {
             if (pxs[i].isDegenerate() || pxs[i+1].isDegenerate() || pxs[i+2].isDegenerate())
                 return false;
             m_impl->canvas->bezierTo(pxs[i].x, pxs[i].y, pxs[i+1].x, pxs[i+1].y,
@@ -1245,11 +1388,12 @@ bool GiGraphics::rawPolygon(const GiContext* ctx, const Point2d* pxs, int count)
     bool useBrush = setBrush(ctx);
     
     if (m_impl->canvas && pxs && count > 0) {
+        m_impl->flushBatch();
         m_impl->canvas->beginPath();
         if (pxs[0].isDegenerate())
             return false;
         m_impl->canvas->moveTo(pxs[0].x, pxs[0].y);
-        for (int i = 1; i < count && !m_impl->stopping; i++) {
+        for (int i = 1; i < count && !isStopping(); i++) {
             if (pxs[i].isDegenerate())
                 return false;
             m_impl->canvas->lineTo(pxs[i].x, pxs[i].y);
@@ -1266,8 +1410,9 @@ bool GiGraphics::rawRect(const GiContext* ctx, float x, float y, float w, float
     bool usePen = setPen(ctx);
     bool useBrush = setBrush(ctx);
     
-    if (m_impl->canvas && !m_impl->stopping
+    if (m_impl->canvas && !isStopping()
         && !isnan(x) && !isnan(y) && !isnan(w) && !isnan(h)) {
+        m_impl->flushBatch();
         m_impl->canvas->drawRect(x, y, w, h, usePen, useBrush);
         return true;
     }
@@ -1279,8 +1424,9 @@ bool GiGraphics::rawEllipse(const GiContext* ctx, float x, float y, float w, flo
     bool usePen = setPen(ctx);
     bool useBrush = setBrush(ctx);
     
-    if (m_impl->canvas && !m_impl->stopping
+    if (m_impl->canvas && !isStopping()
         && !isnan(x) && !isnan(y) && !isnan(w) && !isnan(h)) {
+        m_impl->flushBatch();
         m_impl->canvas->drawEllipse(x, y, w, h, usePen, useBrush);
         return true;
     }
@@ -1290,6 +1436,7 @@ bool GiGraphics::rawEllipse(const GiContext* ctx, float x, float y, float w, flo
 bool GiGraphics::rawBeginPath()
 {
     if (m_impl->canvas) {
+        m_impl->flushBatch();
         m_impl->canvas->beginPath();
     }
     return !!m_impl->canvas;
@@ -1328,7 +1475,7 @@ bool GiGraphics::rawLineTo(float x, float y)
 bool GiGraphics::rawBezierTo(float c1x, float c1y, float c2x, 
                              float c2y, float x, float y)
 {
-    if (m_impl->canvas && !m_impl->stopping
+    if (m_impl->canvas && !isStopping()
         && !isnan(c1x) && !isnan(c1y) && !isnan(c2x) && !isnan(c2y)
         && !isnan(x) && !isnan(y)) {
         m_impl->canvas->bezierTo(c1x, c1y, c2x, c2y, x, y);
@@ -1339,7 +1486,7 @@ bool GiGraphics::rawBezierTo(float c1x, float c1y, float c2x,
 
 bool GiGraphics::rawQuadTo(float cpx, float cpy, float x, float y)
 {
-    if (m_impl->canvas && !m_impl->stopping
+    if (m_impl->canvas && !isStopping()
         && !isnan(cpx) && !isnan(cpy) && !isnan(x) && !isnan(y)) {
         m_impl->canvas->quadTo(cpx, cpy, x, y);
         return true;
@@ -1357,8 +1504,9 @@ bool GiGraphics::rawClosePath()
 
 float GiGraphics::rawText(const char* text, float x, float y, float h, int align)
 {
-    if (m_impl->canvas && text && !m_impl->stopping
+    if (m_impl->canvas && text && !isStopping()
         && !isnan(x) && !isnan(y)) {
+        m_impl->flushBatch();
         return m_impl->canvas->drawTextAt(text, x, y, h, align, 0);
     }
     return 0;
@@ -1367,17 +1515,40 @@ float GiGraphics::rawText(const char* text, float x, float y, float h, int align
 bool GiGraphics::rawImage(const char* name, float xc, float yc, 
                           float w, float h, float angle)
 {
-    if (m_impl->canvas && name && !m_impl->stopping
+    if (m_impl->canvas && name && !isStopping()
         && !isnan(xc) && !isnan(yc)) {
+        m_impl->flushBatch();
         return m_impl->canvas->drawBitmap(name, xc, yc, w, h, angle);
     }
     return false;
 }
 
+bool GiGraphics::rawImage(int handle, float xc, float yc,
+                          float w, float h, float angle)
+{
+    if (m_impl->canvas && handle > 0 && !isStopping()
+        && !isnan(xc) && !isnan(yc)) {
+        GiImageRegistry& reg = GiImageRegistry::instance();
+        reg.noteDrawn(handle, w, h);
+        m_impl->flushBatch();
+        
+        long image = reg.acquireImage(handle, w, h);   // 有解码器时取按显示大小缓存的图像
+        if (image) {
+            bool ret = m_impl->canvas->drawDecodedBitmap(image, reg.getName(handle), xc, yc, w, h, angle);
+            reg.releaseImage(image);
+            if (ret)
+                return true;
+        }
+        return m_impl->canvas->drawBitmap(reg.getName(handle), xc, yc, w, h, angle);
+    }
+    return false;
+}
+
 bool GiGraphics::drawHandle(const Point2d& pnt, int type, float angle, bool modelUnit)
 {
-    if (m_impl->canvas && type >= 0 && !m_impl->stopping && !pnt.isDegenerate()) {
+    if (m_impl->canvas && type >= 0 && !isStopping() && !pnt.isDegenerate()) {
         Point2d ptd(pnt * S2D(xf(), modelUnit));
+        m_impl->flushBatch();
         return m_impl->canvas->drawHandle(ptd.x, ptd.y, type, angle);
     }
     return false;
@@ -1411,7 +1582,7 @@ float GiGraphics::drawTextAt(GiTextWidthCallback* c, int argb, const char* text,
 {
     float ret = 0;
     
-    if (m_impl->canvas && text && h > 0 && !m_impl->stopping && !pnt.isDegenerate()) {
+    if (m_impl->canvas && text && h > 0 && !isStopping() && !pnt.isDegenerate()) {
         Point2d ptd(pnt * xf().modelToDisplay());
         float w2d = xf().getWorldToDisplayY(h < 0);
         h = fabsf(h) * w2d;
@@ -1423,6 +1594,7 @@ float GiGraphics::drawTextAt(GiTextWidthCallback* c, int argb, const char* text,
         GiContext ctx;
         ctx.setFillARGB(argb ? argb : 0xFF000000);
         if (setBrush(&ctx)) {
+            m_impl->flushBatch();
             TextWidthCallback1 *cw = c ? new TextWidthCallback1(c, w2d) : (TextWidthCallback1 *)0;
             ret = m_impl->canvas->drawTextAt(cw, text, ptd.x, ptd.y, h, align, angle) / w2d;
         }
@@ -1433,10 +1605,16 @@ float GiGraphics::drawTextAt(GiTextWidthCallback* c, int argb, const char* text,
 
 bool GiGraphics::beginShape(int type, int sid, int version, float x, float y, float w, float h)
 {
+    if (m_impl->canvas && m_impl->batchMode < 2) {
+        m_impl->flushBatch();
+    }
     return m_impl->canvas && m_impl->canvas->beginShape(type, sid, version, x, y, w, h);
 }
 
 void GiGraphics::endShape(int type, int sid, float x, float y)
 {
+    if (m_impl->batchMode < 2) {
+        m_impl->flushBatch();
+    }
     m_impl->canvas->endShape(type, sid, x, y);
 }
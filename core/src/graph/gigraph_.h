@@ -5,6 +5,7 @@
 #include "gigraph.h"
 #include "gicanvas.h"
 #include "gilock.h"
+#include <vector>
 
 //! GiGraphics的内部实现类
 class GiGraphicsImpl
@@ -16,7 +17,17 @@ public:
     bool        needFreeXf;         //!< 是否自动释放 xform
     GiCanvas*   canvas;             //!< 显示适配器
     GiContext   ctx;                //!< 当前绘图参数
-    int         ctxused;            //!< 画笔和画刷的设置标志
+    int         ctxused;            //!< 画笔(1)和画刷(2)已设置到画布的标志
+    int         penArgb;            //!< 画布的当前画笔颜色
+    float       penWidth;           //!< 画布的当前画笔像素宽度
+    int         penStyle;           //!< 画布的当前线型
+    float       penPhase;           //!< 画布的当前虚线偏移
+    float       penOrgw;            //!< 画布的当前画笔原始线宽
+    int         brushArgb;          //!< 画布的当前画刷颜色
+    int         batchMode;          //!< 合并绘制模式，见 GiGraphics::setBatchMode
+    bool        batchOpen;          //!< 是否有正在合并的描边路径
+    bool        batchLine;          //!< 是否有待合并的一条直线，单独输出时仍为 drawLine
+    float       lineBuf[4];         //!< 待合并的直线的起点和终点
     GiColor     bkcolor;            //!< 背景色
     float       phase;              //!< 虚线其实偏移
 
@@ -36,6 +47,11 @@ public:
     Box2d       rectDrawMaxM;       //!< 最大剪裁矩形，模型坐标
     Box2d       rectDrawMaxW;       //!< 最大剪裁矩形，世界坐标
 
+    std::vector<Point2d> pxpoints;  //!< 像素坐标缓冲，重复使用以免每次绘图都分配内存
+    std::vector<Point2d> pointBuf;  //!< 坐标转换缓冲，与 pxpoints 同时使用
+    std::vector<Point2d> clipBuf1;  //!< 多边形剪裁缓冲
+    std::vector<Point2d> clipBuf2;  //!< 多边形剪裁缓冲，存放剪裁结果
+
     GiGraphicsImpl(GiTransform* x, bool needFree)
         : xform(x), needFreeXf(needFree), canvas((GiCanvas*)0)
     {
@@ -43,6 +59,9 @@ public:
         stopping = 0;
         isPrint = false;
         ctxused = 0;
+        batchMode = 0;
+        batchOpen = false;
+        batchLine = false;
         bkcolor = GiColor::White();
         phase = -1;
         maxPenWidth = 100;
@@ -66,6 +85,90 @@ public:
         }
     }
 
+    //! 画笔参数与画布的当前画笔不同时才设置到画布
+    void setPen(int argb, float width, int style, float phase, float orgw)
+    {
+        if (!(ctxused & 1) || argb != penArgb || width != penWidth
+            || style != penStyle || phase != penPhase || orgw != penOrgw) {
+            flushBatch();
+            canvas->setPen(argb, width, style, phase, orgw);
+            penArgb = argb;
+            penWidth = width;
+            penStyle = style;
+            penPhase = phase;
+            penOrgw = orgw;
+            ctxused |= 1;
+        }
+    }
+
+    //! 画刷颜色与画布的当前画刷不同时才设置到画布
+    void setBrush(int argb)
+    {
+        if (!(ctxused & 2) || argb != brushArgb) {
+            flushBatch();
+            canvas->setBrush(argb, 0);
+            brushArgb = argb;
+            ctxused |= 2;
+        }
+    }
+
+    //! 合并一条直线，第一条直线先暂存
+    void batchLineTo(float x1, float y1, float x2, float y2)
+    {
+        if (!batchOpen && !batchLine) {
+            lineBuf[0] = x1;
+            lineBuf[1] = y1;
+            lineBuf[2] = x2;
+            lineBuf[3] = y2;
+            batchLine = true;
+        } else {
+            openBatch();
+            canvas->moveTo(x1, y1);
+            canvas->lineTo(x2, y2);
+        }
+    }
+
+    //! 开始合并描边路径，已在合并中则继续追加
+    void openBatch()
+    {
+        if (!batchOpen) {
+            canvas->beginPath();
+            batchOpen = true;
+            if (batchLine) {
+                batchLine = false;
+                canvas->moveTo(lineBuf[0], lineBuf[1]);
+                canvas->lineTo(lineBuf[2], lineBuf[3]);
+            }
+        }
+    }
+
+    //! 输出正在合并的描边路径，在其他绘图操作之前调用
+    void flushBatch()
+    {
+        if (batchLine) {
+            batchLine = false;
+            canvas->drawLine(lineBuf[0], lineBuf[1], lineBuf[2], lineBuf[3]);
+        }
+        else if (batchOpen) {
+            batchOpen = false;
+            canvas->drawPath(true, false);
+        }
+    }
+
+    //! 返回至少有 n 个元素的像素坐标缓冲，内容未初始化
+    Point2d* pxbuf(int n) {
+        if ((int)pxpoints.size() < n)
+            pxpoints.resize(n);
+        return &pxpoints.front();
+    }
+    
+    //! 返回至少有 n 个元素的坐标转换缓冲，内容未初始化
+    Point2d* ptbuf(int n) {
+        if ((int)pointBuf.size() < n)
+            pointBuf.resize(n);
+        return &pointBuf.front();
+    }
+
 private:
     GiGraphicsImpl();
     void operator=(const GiGraphicsImpl&);
@@ -0,0 +1,361 @@
+﻿// giimagereg.cpp: 实现图像名称登记和解码缓存类 GiImageRegistry
+// Copyright (c) 2004-2015, https://github.com/rhcad/vgcore, BSD License
+
+#include "giimagereg.h"
+#include "gilock.h"
+#include "mgdef.h"
+#include <string>
+#include <map>
+#include <list>
+#include <deque>
+#include <vector>
+
+struct GiImageRegistry::Impl
+{
+    enum { kMaxLevel = 8 };
+
+    struct Entry {
+        int     width, height;      // 原始像素大小，-1表示未知，0表示无法得到
+        float   drawnW, drawnH;     // 最近的显示像素大小
+        Entry() : width(-1), height(-1), drawnW(0), drawnH(0) {}
+    };
+    struct Level {
+        int     handle;
+        int     level;
+        long    image;
+        int     bytes;
+        int     users;              // acquireImage() 占用计数
+        bool    stale;              // 已更换解码器，不再被查找，不被占用时释放
+        GiImageDecoder* decoder;    // 解码出本图像的解码器
+    };
+    typedef std::list<Level> Levels;                // 表头为最近使用的级别
+    typedef std::map<long, Levels::iterator> LevelMap;
+
+    volatile long               locker;
+    std::map<std::string, int>  handles;
+    std::deque<std::string>     names;              // 下标为句柄-1，元素地址不变
+    std::deque<Entry>           entries;
+    GiImageDecoder*             decoder;
+    Levels                      levels;
+    LevelMap                    levelMap;           // (handle, level) -> levels 中的位置
+    std::map<long, Levels::iterator> images;        // 已解码图像 -> levels 中的位置
+    int                         budget;
+    int                         used;
+    int                         decodes;
+
+    Impl() : locker(0), decoder(NULL), budget(64 * 1024 * 1024), used(0), decodes(0) {}
+
+    static long key(int handle, int level) { return (long)handle * (kMaxLevel + 1) + level; }
+    bool valid(int handle) const { return handle > 0 && handle <= (int)names.size(); }
+
+    static int chooseLevel(int width, int height, float w, float h);
+    long acquire(int handle, float w, float h);
+    long findLevel(int handle, int level);
+    void releaseLevel(Levels::iterator it);
+    void trim();
+};
+
+GiImageRegistry& GiImageRegistry::instance()
+{
+    static GiImageRegistry obj;
+    return obj;
+}
+
+GiImageRegistry::GiImageRegistry()
+{
+    im = new Impl();
+}
+
+GiImageRegistry::~GiImageRegistry()
+{
+    setDecoder(NULL);
+    delete im;
+}
+
+int GiImageRegistry::intern(const char* name)
+{
+    if (!name || !*name)
+        return 0;
+
+    GiSpinLock lock(&im->locker);
+    std::map<std::string, int>::const_iterator it = im->handles.find(name);
+
+    if (it != im->handles.end())
+        return it->second;
+
+    im->names.push_back(name);
+    im->entries.push_back(Impl::Entry());
+    im->handles[name] = (int)im->names.size();
+
+    return (int)im->names.size();
+}
+
+int GiImageRegistry::findHandle(const char* name) const
+{
+    if (!name || !*name)
+        return 0;
+
+    GiSpinLock lock(&im->locker);
+    std::map<std::string, int>::const_iterator it = im->handles.find(name);
+
+    return it != im->handles.end() ? it->second : 0;
+}
+
+const char* GiImageRegistry::getName(int handle) const
+{
+    GiSpinLock lock(&im->locker);
+    return im->valid(handle) ? im->names[handle - 1].c_str() : "";
+}
+
+int GiImageRegistry::getCount() const
+{
+    GiSpinLock lock(&im->locker);
+    return (int)im->names.size();
+}
+
+void GiImageRegistry::noteDrawn(int handle, float width, float height)
+{
+    GiSpinLock lock(&im->locker);
+
+    if (im->valid(handle)) {
+        Impl::Entry& e = im->entries[handle - 1];
+        e.drawnW = width < 0 ? -width : width;
+        e.drawnH = height < 0 ? -height : height;
+    }
+}
+
+bool GiImageRegistry::getDrawnSize(int handle, float& width, float& height) const
+{
+    GiSpinLock lock(&im->locker);
+
+    if (im->valid(handle) && im->entries[handle - 1].drawnW > 0) {
+        width = im->entries[handle - 1].drawnW;
+        height = im->entries[handle - 1].drawnH;
+        return true;
+    }
+    return false;
+}
+
+void GiImageRegistry::setDecoder(GiImageDecoder* decoder)
+{
+    GiSpinLock lock(&im->locker);
+
+    for (Impl::Levels::iterator it = im->levels.begin(); it != im->levels.end(); ) {
+        Impl::Levels::iterator cur = it++;
+        if (cur->users == 0) {
+            im->releaseLevel(cur);
+        }
+        else if (!cur->stale) {             // 使用中的图像在 releaseImage() 后再释放
+            im->levelMap.erase(Impl::key(cur->handle, cur->level));
+            cur->stale = true;
+        }
+    }
+    for (size_t i = 0; i < im->entries.size(); i++) {
+        im->entries[i].width = im->entries[i].height = -1;
+    }
+    im->decoder = decoder;
+}
+
+void GiImageRegistry::setBudget(int bytes)
+{
+    GiSpinLock lock(&im->locker);
+    im->budget = bytes > 0 ? bytes : 0;
+    im->trim();
+}
+
+int GiImageRegistry::getBudget() const
+{
+    return im->budget;
+}
+
+int GiImageRegistry::getUsedBytes() const
+{
+    return im->used;
+}
+
+int GiImageRegistry::getDecodeCount() const
+{
+    return im->decodes;
+}
+
+long GiImageRegistry::acquireImage(int handle, float width, float height)
+{
+    return im->acquire(handle, width, height);
+}
+
+long GiImageRegistry::acquireImage(const char* name, float width, float height)
+{
+    int handle = findHandle(name);
+    return handle ? im->acquire(handle, width, height) : 0;
+}
+
+void GiImageRegistry::releaseImage(long image)
+{
+    GiSpinLock lock(&im->locker);
+    std::map<long, Impl::Levels::iterator>::iterator it = im->images.find(image);
+
+    if (it != im->images.end() && it->second->users > 0) {
+        Impl::Levels::iterator level = it->second;
+        if (--level->users == 0 && level->stale) {
+            im->releaseLevel(level);
+        }
+        else {
+            im->trim();
+        }
+    }
+}
+
+void GiImageRegistry::purge()
+{
+    GiSpinLock lock(&im->locker);
+    const int budget = im->budget;
+
+    im->budget = 0;
+    im->trim();
+    im->budget = budget;
+}
+
+int GiImageRegistry::Impl::chooseLevel(int width, int height, float w, float h)
+{
+    int level = 0;
+
+    // 选择不小于显示大小的最小级别
+    if (w > 0 && h > 0) {
+        while (level < kMaxLevel && (width >> (level + 1)) >= w
+               && (height >> (level + 1)) >= h) {
+            level++;
+        }
+    }
+    return level;
+}
+
+long GiImageRegistry::Impl::acquire(int handle, float w, float h)
+{
+    GiImageDecoder* dec;
+    const char* name;
+    int width, height;
+
+    {
+        GiSpinLock lock(&locker);
+
+        if (!decoder || !valid(handle))
+            return 0;
+
+        const Entry& e = entries[handle - 1];
+
+        dec = decoder;
+        name = names[handle - 1].c_str();   // 元素地址不变，可在锁外使用
+        width = e.width;
+        height = e.height;
+        w = w > 0 ? w : e.drawnW;
+        h = h > 0 ? h : e.drawnH;
+    }
+
+    if (width < 0) {                        // 在锁外由解码器得到图像大小
+        mgvector<int> size(2);
+
+        if (!dec->getImageSize(name, size) || size.get(0) < 1 || size.get(1) < 1) {
+            width = height = 0;
+        }
+        else {
+            width = size.get(0);
+            height = size.get(1);
+        }
+
+        GiSpinLock lock(&locker);
+        if (decoder == dec) {
+            entries[handle - 1].width = width;
+            entries[handle - 1].height = height;
+        }
+    }
+    if (width < 1 || height < 1)
+        return 0;
+
+    const int level = chooseLevel(width, height, w, h);
+    const int lw = mgMax(1, width >> level);
+    const int lh = mgMax(1, height >> level);
+
+    {
+        GiSpinLock lock(&locker);
+        long image = decoder == dec ? findLevel(handle, level) : 0;
+
+        if (image || decoder != dec)
+            return image;
+    }
+
+    // 在锁外解码，其他线程仍可取用已解码的图像
+    long image = dec->decodeImage(name, lw, lh);
+    if (!image)
+        return 0;
+
+    const int bytes = dec->getImageBytes(image, lw, lh);
+    long existing = 0;
+
+    {
+        GiSpinLock lock(&locker);
+
+        decodes++;
+        if (decoder == dec) {
+            existing = findLevel(handle, level);    // 其他线程可能已解码了同一级别
+            if (!existing) {
+                Level item;
+
+                item.handle = handle;
+                item.level = level;
+                item.image = image;
+                item.bytes = bytes;
+                item.users = 1;
+                item.stale = false;
+                item.decoder = dec;
+
+                used += item.bytes;
+                levels.push_front(item);
+                levelMap[key(handle, level)] = levels.begin();
+                images[image] = levels.begin();
+                trim();
+
+                return image;
+            }
+        }
+    }
+    dec->releaseImage(image);
+
+    return existing;
+}
+
+long GiImageRegistry::Impl::findLevel(int handle, int level)
+{
+    LevelMap::iterator it = levelMap.find(key(handle, level));
+
+    if (it == levelMap.end())
+        return 0;
+
+    levels.splice(levels.begin(), levels, it->second);
+    it->second->users++;
+
+    return it->second->image;
+}
+
+void GiImageRegistry::Impl::releaseLevel(Levels::iterator it)
+{
+    used -= it->bytes;
+    if (!it->stale) {
+        levelMap.erase(key(it->handle, it->level));
+    }
+    images.erase(it->image);
+    it->decoder->releaseImage(it->image);
+    levels.erase(it);
+}
+
+void GiImageRegistry::Impl::trim()
+{
+    Levels::iterator it = levels.end();
+
+    while (used > budget && it != levels.begin()) {
+        Levels::iterator cur = --it;
+        if (cur->users == 0) {
+            ++it;
+            releaseLevel(cur);
+        }
+    }
+}
@@ -18,8 +18,8 @@ template<class T> inline static int getSize(T& arr)
 class PolygonClip
 {
     const Box2d     m_rect;         //!< 剪裁矩形
-    vector<Point2d> m_vs1;          //!< 剪裁交点缓冲
-    vector<Point2d> m_vs2;          //!< 剪裁交点缓冲
+    vector<Point2d>& m_vs1;         //!< 剪裁交点缓冲
+    vector<Point2d>& m_vs2;         //!< 剪裁交点缓冲
     bool            m_closed;       //!< 是否闭合
     
 public:
@@ -27,10 +27,13 @@ public:
     //! 构造函数
     /*!
         \param rect 剪裁矩形，必须为规范化的矩形
+        \param buf1 剪裁交点缓冲，由调用者提供以便重复使用
+        \param buf2 剪裁结果缓冲，由调用者提供以便重复使用
         \param closed 将要传入的坐标序列是多边形还是折线
     */
-    PolygonClip(const Box2d& rect, bool closed = true)
-        : m_rect(rect), m_closed(closed)
+    PolygonClip(const Box2d& rect, vector<Point2d>& buf1, vector<Point2d>& buf2,
+                bool closed = true)
+        : m_rect(rect), m_vs1(buf1), m_vs2(buf2), m_closed(closed)
     {
     }
     
@@ -0,0 +1,171 @@
+﻿// gistyletable.cpp: 实现共享绘图参数的登记表 GiStyleTable
+// Copyright (c) 2004-2015, https://github.com/rhcad/vgcore, BSD License
+
+#include "gistyletable.h"
+#include "gilock.h"
+#include <map>
+#include <vector>
+
+struct GiStyleTable::Impl
+{
+    typedef std::map<GiContext, GiStyleEntry*> Entries;
+
+    volatile long   locker;
+    volatile long   refcount;
+    Entries         entries;
+
+    Impl() : locker(0), refcount(1) {}
+};
+
+GiStyleTable& GiStyleTable::instance()
+{
+    static GiStyleTable* obj = new GiStyleTable();  // 不释放，退出时可能还有图形引用登记项
+    return *obj;
+}
+
+GiStyleTable* GiStyleTable::create()
+{
+    return new GiStyleTable();
+}
+
+GiStyleTable::GiStyleTable()
+{
+    im = new Impl();
+}
+
+GiStyleTable::~GiStyleTable()
+{
+    delete im;
+}
+
+void GiStyleTable::addRef()
+{
+    giAtomicIncrement(&im->refcount);
+}
+
+void GiStyleTable::release()
+{
+    if (giAtomicDecrement(&im->refcount) == 0) {
+        delete this;
+    }
+}
+
+GiStyleEntry* GiStyleTable::intern(const GiContext& ctx)
+{
+    GiSpinLock lock(&im->locker);
+    Impl::Entries::iterator it = im->entries.find(ctx);
+    GiStyleEntry* entry;
+
+    if (it != im->entries.end()) {
+        entry = it->second;
+        giAtomicIncrement(&entry->refcount);
+    } else {
+        entry = new GiStyleEntry();
+        entry->ctx = ctx;
+        entry->refcount = 1;
+        entry->table = this;
+        im->entries.insert(std::make_pair(ctx, entry));
+        addRef();
+    }
+    return entry;
+}
+
+GiStyleEntry* GiStyleTable::defaultEntry()
+{
+    static GiStyleEntry* entry = instance().intern(GiContext());  // 多持有一次引用，不会被移除
+    addRef(entry);
+    return entry;
+}
+
+void GiStyleTable::addRef(GiStyleEntry* entry)
+{
+    giAtomicIncrement(&entry->refcount);
+}
+
+void GiStyleTable::release(GiStyleEntry* entry)
+{
+    // 还有其他引用时不加锁，可能减为0时在锁内减少，以免与 intern() 同时取到该项
+    for (;;) {
+        long n = giAtomicLoad(&entry->refcount);
+        if (n <= 1)
+            break;
+        if (giAtomicCompareAndSwap(&entry->refcount, n - 1, n))
+            return;
+    }
+
+    GiStyleTable* table = entry->table;
+    bool removed = false;
+    {
+        GiSpinLock lock(&table->im->locker);
+
+        if (giAtomicDecrement(&entry->refcount) == 0) {
+            table->im->entries.erase(entry->ctx);
+            delete entry;
+            removed = true;
+        }
+    }
+    if (removed) {
+        table->release();           // 在锁外释放，表可能随最后一项删除
+    }
+}
+
+int GiStyleTable::getCount() const
+{
+    GiSpinLock lock(&im->locker);
+    return (int)im->entries.size();
+}
+
+struct GiStyleIndex::Impl
+{
+    std::vector<GiContext>          styles;
+    std::map<GiContext, int>        indices;
+};
+
+GiStyleIndex::GiStyleIndex()
+{
+    im = new Impl();
+}
+
+GiStyleIndex::~GiStyleIndex()
+{
+    delete im;
+}
+
+int GiStyleIndex::add(const GiContext& ctx)
+{
+    std::pair<std::map<GiContext, int>::iterator, bool> ret =
+        im->indices.insert(std::make_pair(ctx, (int)im->styles.size()));
+    
+    if (ret.second) {
+        im->styles.push_back(ctx);
+    }
+    return ret.first->second;
+}
+
+void GiStyleIndex::append(const GiContext& ctx)
+{
+    im->indices.insert(std::make_pair(ctx, (int)im->styles.size()));
+    im->styles.push_back(ctx);
+}
+
+int GiStyleIndex::find(const GiContext& ctx) const
+{
+    std::map<GiContext, int>::const_iterator it = im->indices.find(ctx);
+    return it != im->indices.end() ? it->second : -1;
+}
+
+int GiStyleIndex::getCount() const
+{
+    return (int)im->styles.size();
+}
+
+const GiContext* GiStyleIndex::get(int index) const
+{
+    return index >= 0 && index < (int)im->styles.size() ? &im->styles[index] : NULL;
+}
+
+void GiStyleIndex::clear()
+{
+    im->styles.clear();
+    im->indices.clear();
+}
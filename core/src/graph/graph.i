@@ -11,6 +11,8 @@
 #include <gigraph.h>
 #include <gicanvas.h>
 #include <mgpath.h>
+#include <mgvector.h>
+#include <giimagereg.h>
 %}
 
 %include <mgdef.h>
@@ -33,3 +35,9 @@
 %include <gixform.h>
 %include <mgpath.h>
 %include <gigraph.h>
+
+%include <mgvector.h>
+%template(Ints) mgvector<int>;
+
+%feature("director") GiImageDecoder;
+%include <giimagereg.h>
@@ -3,18 +3,201 @@
 
 #include "mglines.h"
 #include "mgshape_.h"
+#include "gilock.h"
+#include <string.h>
+#include <vector>
 
 // MgBaseLines
 //
 
+// 压缩的顶点数据：变长整数的顶点数，标志字节(1:有切矢量)，
+// 量化步长、首点和包络框(7个小端浮点数)，其余各点相对前一点的量化差值，
+// 最后是各切矢量相对前一切矢量的量化差值。差值为 zigzag 变长整数。
+
+static const int kPackHeader = 7 * 4;
+
+static void putVarint(std::vector<unsigned char>& buf, unsigned int v)
+{
+    while (v >= 0x80) {
+        buf.push_back((unsigned char)(v | 0x80));
+        v >>= 7;
+    }
+    buf.push_back((unsigned char)v);
+}
+
+static bool getVarint(const unsigned char*& p, const unsigned char* end, unsigned int& v)
+{
+    v = 0;
+    for (int shift = 0; p < end && shift < 35; shift += 7) {
+        unsigned char c = *p++;
+        v |= (unsigned int)(c & 0x7F) << shift;
+        if (!(c & 0x80))
+            return true;
+    }
+    return false;
+}
+
+static void putDelta(std::vector<unsigned char>& buf, int d)
+{
+    putVarint(buf, ((unsigned int)d << 1) ^ (unsigned int)(d >> 31));
+}
+
+static bool getDelta(const unsigned char*& p, const unsigned char* end, int& d)
+{
+    unsigned int v;
+    if (!getVarint(p, end, v))
+        return false;
+    d = (int)(v >> 1) ^ -(int)(v & 1);
+    return true;
+}
+
+static void putFloat(std::vector<unsigned char>& buf, float f)
+{
+    unsigned int v;
+    memcpy(&v, &f, 4);
+    for (int i = 0; i < 4; i++, v >>= 8)
+        buf.push_back((unsigned char)v);
+}
+
+static float getFloat(const unsigned char* p)
+{
+    unsigned int v = p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+    float f;
+    memcpy(&f, &v, 4);
+    return f;
+}
+
+static bool quantize(float v, float quantum, int& q)
+{
+    float f = v / quantum;
+    if (!(fabsf(f) < 5e8f))        // 也排除了非数
+        return false;
+    q = (int)(f < 0 ? f - 0.5f : f + 0.5f);
+    return true;
+}
+
+static bool packPoints(std::vector<unsigned char>& buf, int n, const Point2d* pts,
+                       const Vector2d* vecs, float quantum)
+{
+    std::vector<unsigned char> deltas;
+    Point2d org(pts[0]);
+    Box2d box;
+    int x, y, lastx = 0, lasty = 0;
+
+    deltas.reserve(n * 4);
+    box.set(org, org);
+    for (int i = 1; i < n; i++) {
+        if (!quantize(pts[i].x - org.x, quantum, x) || !quantize(pts[i].y - org.y, quantum, y))
+            return false;
+        putDelta(deltas, x - lastx);
+        putDelta(deltas, y - lasty);
+        lastx = x;
+        lasty = y;
+        box.unionWith(Point2d(org.x + (float)x * quantum, org.y + (float)y * quantum));
+    }
+    lastx = lasty = 0;
+    for (int i = 0; vecs && i < n; i++) {
+        if (!quantize(vecs[i].x, quantum, x) || !quantize(vecs[i].y, quantum, y))
+            return false;
+        putDelta(deltas, x - lastx);
+        putDelta(deltas, y - lasty);
+        lastx = x;
+        lasty = y;
+    }
+
+    buf.clear();
+    buf.reserve(deltas.size() + kPackHeader + 6);
+    putVarint(buf, n);
+    buf.push_back(vecs ? 1 : 0);
+    putFloat(buf, quantum);
+    putFloat(buf, org.x);
+    putFloat(buf, org.y);
+    putFloat(buf, box.xmin);
+    putFloat(buf, box.ymin);
+    putFloat(buf, box.xmax);
+    putFloat(buf, box.ymax);
+    buf.insert(buf.end(), deltas.begin(), deltas.end());
+
+    return true;
+}
+
+// 返回压缩数据中标志字节的位置，数据头无效则返回NULL
+static const unsigned char* packedHeader(const unsigned char* data, int size, unsigned int& n)
+{
+    const unsigned char* p = data;
+    const unsigned char* end = data + size;
+
+    return getVarint(p, end, n) && n > 0 && p + 1 + kPackHeader <= end ? p : NULL;
+}
+
+static bool packedHasVectors(const unsigned char* data, int size)
+{
+    unsigned int n;
+    const unsigned char* p = packedHeader(data, size, n);
+    return p && (*p & 1) != 0;
+}
+
+static void packedExtent(const unsigned char* data, int size, Box2d& box)
+{
+    unsigned int n;
+    const unsigned char* p = packedHeader(data, size, n);
+
+    if (p) {
+        box.set(getFloat(p + 13), getFloat(p + 17), getFloat(p + 21), getFloat(p + 25));
+    }
+}
+
+// 解码压缩数据，pts 为NULL时只校验，返回顶点数，数据无效则返回0
+static int unpackPoints(const unsigned char* data, int size, Point2d* pts, Vector2d* vecs)
+{
+    const unsigned char* end = data + size;
+    unsigned int n;
+    const unsigned char* p = packedHeader(data, size, n);
+
+    if (!p)
+        return 0;
+
+    int flags = *p++;
+    float quantum = getFloat(p);
+    Point2d org(getFloat(p + 4), getFloat(p + 8));
+    int x = 0, y = 0, dx, dy;
+
+    p += kPackHeader;
+    if (pts) {
+        pts[0] = org;
+    }
+    for (unsigned int i = 1; i < n; i++) {
+        if (!getDelta(p, end, dx) || !getDelta(p, end, dy))
+            return 0;
+        x += dx;
+        y += dy;
+        if (pts) {
+            pts[i].set(org.x + (float)x * quantum, org.y + (float)y * quantum);
+        }
+    }
+    x = y = 0;
+    for (unsigned int i = 0; (flags & 1) && i < n; i++) {
+        if (!getDelta(p, end, dx) || !getDelta(p, end, dy))
+            return 0;
+        x += dx;
+        y += dy;
+        if (vecs) {
+            vecs[i].set((float)x * quantum, (float)y * quantum);
+        }
+    }
+
+    return p == end ? (int)n : 0;
+}
+
 MgBaseLines::MgBaseLines() : _points((Point2d*)0), _maxCount(0), _count(0)
+    , _packed((unsigned char*)0), _packedSize(0)
 {
 }
 
 MgBaseLines::~MgBaseLines()
 {
-    if (_points)
-        delete[] _points;
+    delete[] _points;
+    delete[] _packed;
 }
 
 bool MgBaseLines::_isClosed() const
@@ -30,21 +213,115 @@ int MgBaseLines::_getPointCount() const
 Point2d MgBaseLines::_getPoint(int index) const
 {
     return (_count < 1 || index < 0 ? Point2d()
-            : _points[index < _count ? index : index % _count]);
+            : _pts()[index < _count ? index : index % _count]);
 }
 
 void MgBaseLines::_setPoint(int index, const Point2d& pt)
 {
     if (index >= 0 && index < _count) {
-        _points[index] = pt;
+        _editPoints()[index] = pt;
+    }
+}
+
+void MgBaseLines::_freePoints()
+{
+    _setCachedVectors((Vector2d*)0);
+    delete[] _points;
+    _points = (Point2d*)0;
+    delete[] _packed;
+    _packed = (unsigned char*)0;
+    _packedSize = 0;
+    _maxCount = 0;
+    _count = 0;
+}
+
+const Point2d* MgBaseLines::_unpack() const
+{
+    if (!_packed)
+        return _points;
+
+    Point2d* pts = new Point2d[_count];
+    Vector2d* vecs = (packedHasVectors(_packed, _packedSize)
+                      ? new Vector2d[_count] : (Vector2d*)0);
+
+    unpackPoints(_packed, _packedSize, pts, vecs);
+    if (vecs) {
+        _setCachedVectors(vecs);        // 先于顶点发布，看到顶点的绘图线程就能看到切矢量
+    }
+    if (!giAtomicCompareAndSwap((volatile long*)&_points, *(long*)&pts, 0)) {
+        delete[] pts;                   // 其他线程已解码
+    }
+
+    return _points;
+}
+
+Point2d* MgBaseLines::_editPoints()
+{
+    if (_packed) {
+        _pts();
+        delete[] _packed;
+        _packed = (unsigned char*)0;
+        _packedSize = 0;
+        _maxCount = _count;
+    }
+    return _points;
+}
+
+bool MgBaseLines::compact(float quantum)
+{
+    std::vector<unsigned char> buf;
+
+    if (_count < 2 || quantum < _MGZERO
+        || !packPoints(buf, _count, _pts(), _vectorsToPack(), quantum)) {
+        return false;
+    }
+
+    int n = _count;
+
+    _freePoints();
+    _packedSize = (int)buf.size();
+    _packed = new unsigned char[_packedSize];
+    memcpy(_packed, &buf[0], _packedSize);
+    _count = n;
+    update();
+
+    return true;
+}
+
+void MgBaseLines::_clearCachedData()
+{
+    if (_packed && _points) {
+        _setCachedVectors((Vector2d*)0);
+        delete[] _points;
+        _points = (Point2d*)0;
     }
+    __super::_clearCachedData();
 }
 
 void MgBaseLines::_copy(const MgBaseLines& src)
 {
-    resize(src._count);
-    for (int i = 0; i < _count; i++)
-        _points[i] = src._points[i];
+    if (src._packed) {
+        const Point2d* pts = src._points;
+
+        _freePoints();
+        _packedSize = src._packedSize;
+        _packed = new unsigned char[_packedSize];
+        memcpy(_packed, src._packed, _packedSize);
+        _count = src._count;
+        if (pts && !src._vectorsToPack()) {     // 复制已解码的顶点，切矢量则重新解码
+            _points = new Point2d[_count];
+            for (int i = 0; i < _count; i++)
+                _points[i] = pts[i];
+        }
+    }
+    else {
+        if (_packed) {
+            _freePoints();
+        }
+        resize(src._count);
+        for (int i = 0; i < _count; i++)
+            _points[i] = src._points[i];
+    }
 
     __super::_copy(src);
 }
@@ -54,9 +331,15 @@ bool MgBaseLines::_equals(const MgBaseLines& src) const
     if (_count != src._count)
         return false;
 
-    for (int i = 0; i < _count; i++) {
-        if (_points[i] != src._points[i])
-            return false;
+    if (!_packed || !src._packed || _packedSize != src._packedSize
+        || memcmp(_packed, src._packed, _packedSize) != 0) {
+        const Point2d* pts = _pts();
+        const Point2d* srcpts = src._pts();
+
+        for (int i = 0; i < _count; i++) {
+            if (pts[i] != srcpts[i])
+                return false;
+        }
     }
 
     return __super::_equals(src);
@@ -67,8 +350,11 @@ bool MgBaseLines::isIncrementFrom(const MgBaseLines& src) const
     if (_count <= src._count)
         return false;
     
+    const Point2d* pts = _pts();
+    const Point2d* srcpts = src._pts();
+    
     for (int i = 0; i < src._count; i++) {
-        if (!_points[i].isEqualTo(src._points[i], minTol()))
+        if (!pts[i].isEqualTo(srcpts[i], minTol()))
             return false;
     }
     
@@ -82,33 +368,41 @@ bool MgBaseLines::_isKindOf(int type) const
 
 void MgBaseLines::_update()
 {
-    _extent.set(_count, _points);
-    if (_extent.isEmpty() && _points)
-        _extent.set(_points[0], 2 * Tol::gTol().equalPoint(), 0);
+    if (_packed && !_points) {          // 用压缩时记下的包络框，不必解码
+        packedExtent(_packed, _packedSize, _extent);
+    } else {
+        _extent.set(_count, _points);
+    }
+    if (_extent.isEmpty() && _count > 0)
+        _extent.set(_pts()[0], 2 * Tol::gTol().equalPoint(), 0);
     __super::_update();
 }
 
 void MgBaseLines::_transform(const Matrix2d& mat)
 {
-    mat.transformPoints(_count, _points);
+    mat.transformPoints(_count, _editPoints());
     __super::_transform(mat);
 }
 
 void MgBaseLines::_clear()
 {
+    if (_packed) {
+        _freePoints();
+    }
     _count = 0;
     __super::_clear();
 }
 
 Point2d MgBaseLines::endPoint() const
 {
-    return _count > 0 ? _points[_count - 1] : Point2d();
+    return _count > 0 ? _pts()[_count - 1] : Point2d();
 }
 
 bool MgBaseLines::resize(int count)
 {
+    _editPoints();
     if (_maxCount < count) {
-        _maxCount = (count + 32 - 1) / 32 * 32;
+        _maxCount = mgMax((count + 32 - 1) / 32 * 32, _maxCount * 2);   // 倍增，使连续加点时很少分配内存
 
         Point2d* pts = new Point2d[_maxCount];
 
@@ -122,6 +416,15 @@ bool MgBaseLines::resize(int count)
     return true;
 }
 
+void MgBaseLines::reserve(int count)
+{
+    if (_maxCount < count) {
+        const int n = _count;
+        MgBaseLines::resize(count);
+        _count = n;
+    }
+}
+
 int MgBaseLines::maxEdgeIndex() const
 {
     return _count - (isClosed() ? 1 : 2);
@@ -154,8 +457,9 @@ bool MgBaseLines::removePoint(int index)
     bool ret = false;
     
     if (index < _count && _count > 1) {
+        Point2d* pts = _editPoints();
         for (int i = index + 1; i < _count; i++)
-            _points[i - 1] = _points[i];
+            pts[i - 1] = pts[i];
         _count--;
         ret = true;
     }
@@ -165,7 +469,7 @@ bool MgBaseLines::removePoint(int index)
 
 float MgBaseLines::_hitTest(const Point2d& pt, float tol, MgHitResult& res) const
 {
-    return linesHit(_count, _points, isClosed(), pt, tol, res);
+    return linesHit(_count, _pts(), isClosed(), pt, tol, res);
 }
 
 bool MgBaseLines::_hitTestBox(const Box2d& rect) const
@@ -173,8 +477,10 @@ bool MgBaseLines::_hitTestBox(const Box2d& rect) const
     if (!__super::_hitTestBox(rect))
         return false;
     
+    const Point2d* pts = _pts();
+    
     for (int i = 0, n = isClosed() ? _count : _count - 1; i < n; i++) {
-        if (Box2d(_points[i], _points[(i + 1) % _count]).isIntersect(rect)) {
+        if (Box2d(pts[i], pts[(i + 1) % _count]).isIntersect(rect)) {
             return true;
         }
     }
@@ -186,7 +492,11 @@ bool MgBaseLines::_save(MgStorage* s) const
 {
     bool ret = __super::_save(s);
     s->writeInt("count", _count);
-    s->writeFloatArray("points", (const float*)_points, _count * 2);
+    if (_packed) {
+        s->writeBinary("packed", _packed, _packedSize);
+    } else {
+        s->writeFloatArray("points", (const float*)_points, _count * 2);
+    }
     return ret;
 }
 
@@ -198,6 +508,21 @@ bool MgBaseLines::_load(MgShapeFactory* factory, MgStorage* s)
     if (n < 1 || n > 9999)
         return s->setError(n < 1 ? "No point." : "Too many points.");
     
+    if (s->readString("packed") > 0) {
+        std::vector<unsigned char> buf;
+        
+        if (!s->readBinary("packed", buf)
+            || unpackPoints(&buf[0], (int)buf.size(), (Point2d*)0, (Vector2d*)0) != n) {
+            return s->setError("Invalid packed points.");
+        }
+        _freePoints();
+        _packedSize = (int)buf.size();
+        _packed = new unsigned char[_packedSize];
+        memcpy(_packed, &buf[0], _packedSize);
+        _count = n;
+        return ret;
+    }
+    
     resize(n);
     n = s->readFloatArray("points", (float*)_points, _count * 2);
     
@@ -220,8 +545,9 @@ MgLines::~MgLines()
 void MgLines::_output(MgPath& path) const
 {
     if (_count > 1) {
-        path.moveTo(_points[0]);
-        path.linesTo(_count - 1, _points + 1);
+        const Point2d* pts = _pts();
+        path.moveTo(pts[0]);
+        path.linesTo(_count - 1, pts + 1);
         if (isClosed())
             path.closeFigure();
     }
@@ -235,7 +561,7 @@ int MgLines::_getHandleCount() const
 Point2d MgLines::_getHandlePoint(int index) const
 {
     return (index < _count ? __super::_getHandlePoint(index)
-            : (_points[index % _count] + _points[(index + 1) % _count]) / 2);
+            : (_pts()[index % _count] + _pts()[(index + 1) % _count]) / 2);
 }
 
 int MgLines::_getHandleType(int index) const
@@ -3,6 +3,8 @@
 
 #include "mgsplines.h"
 #include "mgshape_.h"
+#include "mgcurvfit.h"
+#include "gilock.h"
 
 MG_IMPLEMENT_CREATE(MgSplines)
 
@@ -17,14 +19,16 @@ MgSplines::~MgSplines()
 
 float MgSplines::_hitTest(const Point2d& pt, float tol, MgHitResult& res) const
 {
+    const Point2d* pts = _pts();
+    
     if (_count == 2) {
-        return mglnrel::ptToLine(_points[0], _points[1], pt, res.nearpt);
+        return mglnrel::ptToLine(pts[0], pts[1], pt, res.nearpt);
     }
     if (_knotvs) {
-        return mgnear::cubicSplinesHit(_count, _points, _knotvs, isClosed(),
+        return mgnear::cubicSplinesHit(_count, pts, _knotvs, isClosed(),
                                        pt, tol, res.nearpt, res.segment, false);
     }
-    return mgnear::quadSplinesHit(_count, _points, isClosed(),
+    return mgnear::quadSplinesHit(_count, pts, isClosed(),
                                   pt, tol, res.nearpt, res.segment);
 }
 
@@ -32,25 +36,27 @@ bool MgSplines::_hitTestBox(const Box2d& rect) const
 {
     if (!__super::_hitTestBox(rect))
         return false;
-    if (_knotvs) {
-        return mgnear::cubicSplinesIntersectBox(rect, _count, _points, _knotvs, isClosed(), false);
+    if (getVectors()) {
+        return mgnear::cubicSplinesIntersectBox(rect, _count, _pts(), _knotvs, isClosed(), false);
     }
     return true;
 }
 
 void MgSplines::_output(MgPath& path) const
 {
+    const Point2d* pts = _pts();
+    
     if (_count < 2) {
     }
     else if (_count == 2) {
-        path.moveTo(_points[0]);
-        path.lineTo(_points[1]);
+        path.moveTo(pts[0]);
+        path.lineTo(pts[1]);
     }
     else if (_knotvs) {
-        path.moveTo(_points[0]);
+        path.moveTo(pts[0]);
         for (int i = 1; i + 1 < _count; i++) {
-            path.bezierTo(_points[i] + _knotvs[i],
-                          _points[i+1] - _knotvs[i+1], _points[i+1]);
+            path.bezierTo(pts[i] + _knotvs[i],
+                          pts[i+1] - _knotvs[i+1], pts[i+1]);
         }
         if (isClosed()) {
             path.closeFigure();
@@ -61,13 +67,13 @@ void MgSplines::_output(MgPath& path) const
         
         for (int i = 0; i < (isClosed() ? _count : _count - 2); i++) {
             if (i == 0) {
-                path.moveTo(isClosed() ? (_points[0] + _points[1]) / 2 : _points[0]);
+                path.moveTo(isClosed() ? (pts[0] + pts[1]) / 2 : pts[0]);
             }
             if (isClosed() || i + 3 < _count)
-                mid = (_points[(i+1) % _count] + _points[(i+2) % _count]) / 2;
+                mid = (pts[(i+1) % _count] + pts[(i+2) % _count]) / 2;
             else
-                mid = _points[i+2];
-            path.quadTo(_points[(i+1) % _count], mid);
+                mid = pts[i+2];
+            path.quadTo(pts[(i+1) % _count], mid);
         }
         if (isClosed()) {
             path.closeFigure();
@@ -78,8 +84,14 @@ void MgSplines::_output(MgPath& path) const
 void MgSplines::_copy(const MgSplines& src)
 {
     __super::_copy(src);    // will clear _knotvs via MgSplines::resize
-    if (src._knotvs) {
-        _knotvs = new Vector2d[_count];
+    if (isCompact())        // 切矢量在压缩数据中
+        return;
+    if (!src._knotvs) {
+        clearVectors();
+    }
+    else {
+        if (!_knotvs)       // 点数相同时重用原有切矢量数组
+            _knotvs = new Vector2d[_count];
         for (int i = 0; i < _count; i++)
             _knotvs[i] = src._knotvs[i];
     }
@@ -87,7 +99,7 @@ void MgSplines::_copy(const MgSplines& src)
 
 bool MgSplines::_equals(const MgSplines& src) const
 {
-    if (!__super::_equals(src) || !_knotvs != !src._knotvs)
+    if (!__super::_equals(src) || !getVectors() != !src.getVectors())
         return false;
     
     if (_knotvs) {
@@ -102,6 +114,7 @@ bool MgSplines::_equals(const MgSplines& src) const
 
 void MgSplines::_transform(const Matrix2d& mat)
 {
+    _editPoints();
     if (_knotvs) {
         for (int i = 0; i < _count; i++)
             _knotvs[i] *= mat;
@@ -111,8 +124,8 @@ void MgSplines::_transform(const Matrix2d& mat)
 
 void MgSplines::_clear()
 {
-    clearVectors();
     __super::_clear();
+    clearVectors();
 }
 
 void MgSplines::_setPoint(int index, const Point2d& pt)
@@ -123,16 +136,30 @@ void MgSplines::_setPoint(int index, const Point2d& pt)
 
 void MgSplines::clearVectors()
 {
+    if (isCompact()) {
+        _editPoints();
+    }
     if (_knotvs) {
         delete[] _knotvs;
         _knotvs = (Vector2d*)0;
     }
 }
 
+void MgSplines::_setCachedVectors(Vector2d* vecs) const
+{
+    if (!vecs) {
+        delete[] _knotvs;
+        _knotvs = (Vector2d*)0;
+    }
+    else if (!giAtomicCompareAndSwap((volatile long*)&_knotvs, *(long*)&vecs, 0)) {
+        delete[] vecs;
+    }
+}
+
 bool MgSplines::_save(MgStorage* s) const
 {
     bool ret = __super::_save(s);
-    if (_knotvs) {
+    if (_knotvs && !isCompact()) {
         s->writeFloatArray("vec", (const float*)_knotvs, _count * 2);
     }
     return ret;
@@ -203,7 +230,7 @@ bool MgSplines::_setHandlePoint(int index, const Point2d& pt, float tol)
 
 bool MgSplines::smooth(const Matrix2d& m2d, float tol)
 {
-    return smoothForPoints(_count, _points, m2d, tol) > 0;
+    return smoothForPoints(_count, _pts(), m2d, tol) > 0;
 }
 
 int MgSplines::smoothForPoints(int count, const Point2d* points, const Matrix2d& m2d, float tol)
@@ -211,27 +238,37 @@ int MgSplines::smoothForPoints(int count, const Point2d* points, const Matrix2d&
     if (count < 3 || !points || tol < _MGZERO)
         return 0;
     
-    int i, knotCount = count + 1;
-    Point2d* ptx = new Point2d[count];
-    Point2d* knots = new Point2d[knotCount];
-    Vector2d* knotvs = new Vector2d[knotCount];
-    Matrix2d d2m(m2d.inverse());
+    MgCurveFitter fitter;
     
-    for (i = 0; i < count; i++)
-        ptx[i] = points[i] * m2d;
+    fitter.begin(tol);
+    for (int i = 0; i < count; i++)
+        fitter.addPoint(points[i] * m2d);
+    fitter.end();
     
-    _count = mgcurv::fitCurve(knotCount, knots, knotvs, count, ptx, tol);
-    _maxCount = knotCount;
+    return smoothForFitter(fitter, m2d);
+}
+
+int MgSplines::smoothForFitter(const MgCurveFitter& fitter, const Matrix2d& m2d)
+{
+    int n = fitter.getKnotCount();
+    
+    if (n < 2)
+        return 0;
+    
+    Point2d* knots = new Point2d[n];
+    Vector2d* knotvs = new Vector2d[n];
+    Matrix2d d2m(m2d.inverse());
     
-    for (i = 0; i < _count; i++) {
-        knots[i] *= d2m;
-        knotvs[i] *= d2m;
+    _editPoints();
+    for (int i = 0; i < n; i++) {
+        knots[i] = fitter.getKnots()[i] * d2m;
+        knotvs[i] = fitter.getKnotVectors()[i] * d2m;
     }
-    delete[] ptx;
     delete[] _points;
     _points = knots;
     delete[] _knotvs;
     _knotvs = knotvs;
+    _count = _maxCount = n;
     update();
     
     return _count;
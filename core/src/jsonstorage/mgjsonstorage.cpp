@@ -14,7 +14,7 @@ using namespace rapidjson;
 class MgJsonStorage::Impl : public MgStorage
 {
 public:
-    Impl() : _fs((FileStream *)0), _err((const char*)0), _arrmode(false), _numAsStr(false) {}
+    Impl() : _fs((FileStream *)0), _err((const char*)0), _arrmode(false), _numAsStr(false), _styleIndex(false), _cloned(false) {}
     virtual ~Impl() { if (_fs) delete(_fs); }
     
     void clear();
@@ -25,11 +25,15 @@ public:
     bool save(FILE* fp, bool pretty);
     void setArrayMode(bool arr) { _arrmode = arr; }
     void saveNumberAsString(bool str) { _numAsStr = str; }
+    void setStyleIndexMode(bool indexed) { _styleIndex = indexed; }
     
 private:
     bool readNode(const char* name, int index, bool ended);
     bool writeNode(const char* name, int index, bool ended);
     bool setError(const char* err);
+    MgStorage* cloneForRead();
+    bool isArrayMode() const { return _arrmode; }
+    bool isStyleIndexMode() const { return _styleIndex; }
     
     int readInt(const char* name, int defvalue);
     bool readBool(const char* name, bool defvalue);
@@ -62,6 +66,8 @@ private:
     int _nodeCount;
     bool _arrmode;
     bool _numAsStr;
+    bool _styleIndex;
+    bool _cloned;       // 由 cloneForRead() 创建，_stack 指向原对象的数据
 };
 
 MgJsonStorage::MgJsonStorage() : _impl(new Impl())
@@ -93,6 +99,11 @@ void MgJsonStorage::saveNumberAsString(bool str)
     _impl->saveNumberAsString(str);
 }
 
+void MgJsonStorage::setStyleIndexMode(bool indexed)
+{
+    _impl->setStyleIndexMode(indexed);
+}
+
 MgStorage* MgJsonStorage::storageForRead(const char* content)
 {
     _impl->clear();
@@ -171,9 +182,42 @@ bool MgJsonStorage::Impl::setError(const char* err)
     return false;
 }
 
+MgStorage* MgJsonStorage::Impl::cloneForRead()
+{
+    if (_stack.empty()) {
+        return (MgStorage*)0;
+    }
+    Impl* p = new Impl();
+    p->_cloned = true;
+    p->_stack.push_back(_stack.back());
+    return p;
+}
+
+// 查找子节点。名称带序号的节点(如shape12)通常按序号连续存放，先在序号位置附近比较，以免逐个查找
+static Value* findChild(Value& parent, const char* name, int index)
+{
+    SizeType len = (SizeType)strlen(name);
+    Value::MemberIterator begin = parent.MemberBegin();
+    Value::MemberIterator end = parent.MemberEnd();
+    
+    if (index >= 0 && index < end - begin) {
+        Value::MemberIterator it = begin + index;
+        for (int i = 0; i < 8 && it != end; i++, ++it) {    // 序号节点前通常还有几个其他键值
+            if (it->name.GetStringLength() == len && memcmp(it->name.GetString(), name, len) == 0)
+                return &it->value;
+        }
+    }
+    for (Value::MemberIterator it = begin; it != end; ++it) {
+        if (it->name.GetStringLength() == len && memcmp(it->name.GetString(), name, len) == 0)
+            return &it->value;
+    }
+    
+    return (Value*)0;
+}
+
 bool MgJsonStorage::Impl::readNode(const char* name, int index, bool ended)
 {
-    if (_doc.IsNull()) {
+    if (_doc.IsNull() && !_cloned) {
         return false;
     }
     if (!ended) {                       // 开始一个新节点
@@ -201,11 +245,13 @@ bool MgJsonStorage::Impl::readNode(const char* name, int index, bool ended)
         }
         else {
             Value &parent = *_stack.back();
+            Value *child = (Value *)0;
+            
             if (parent.IsArray() && index >= 0 && index < (int)parent.Size()) {
                 _stack.push_back(&parent[index]);
             }
-            else if (parent.IsObject() && parent.HasMember(name)) {
-                _stack.push_back(&parent[name]);
+            else if (parent.IsObject() && name && (child = findChild(parent, name, index)) != NULL) {
+                _stack.push_back(child);
             }
             else {
                 return false;
@@ -216,7 +262,7 @@ bool MgJsonStorage::Impl::readNode(const char* name, int index, bool ended)
         if (!_stack.empty()) {
             _stack.pop_back();          // 出栈
         }
-        if (_stack.empty()) {           // 根节点已出栈
+        if (_stack.empty() && !_cloned) {   // 根节点已出栈
             clear();
         }
         _nodeCount++;
@@ -343,7 +389,7 @@ int MgJsonStorage::Impl::readInt(const char* name, int defvalue)
     int ret = defvalue;
     Value *node = _stack.empty() ? (Value *)0 : _stack.back();
     
-    if (node && node->HasMember(name)) {
+    if (node && node->IsObject() && node->HasMember(name)) {
         const Value &item = (*node)[name];
         
         if (item.IsInt()) {
@@ -390,7 +436,7 @@ float MgJsonStorage::Impl::readFloat(const char* name, float defvalue)
     float ret = defvalue;
     Value *node = _stack.empty() ? (Value *)0 : _stack.back();
     
-    if (node && node->HasMember(name)) {
+    if (node && node->IsObject() && node->HasMember(name)) {
         const Value &item = node->GetMember(name);
         
         if (item.IsDouble()) {
@@ -415,7 +461,7 @@ double MgJsonStorage::Impl::readDouble(const char* name, double defvalue)
     double ret = defvalue;
     Value *node = _stack.empty() ? (Value *)0 : _stack.back();
     
-    if (node && node->HasMember(name)) {
+    if (node && node->IsObject() && node->HasMember(name)) {
         const Value &item = node->GetMember(name);
         
         if (item.IsDouble()) {
@@ -442,7 +488,7 @@ int MgJsonStorage::Impl::readFloatArray(const char* name, float* values,
     Value *node = _stack.empty() ? (Value *)0 : _stack.back();
     
     report = report && count > 0 && values;
-    if (node && node->HasMember(name)) {
+    if (node && node->IsObject() && node->HasMember(name)) {
         const Value &item = node->GetMember(name);
         
         if (item.IsArray()) {
@@ -487,7 +533,7 @@ int MgJsonStorage::Impl::readDoubleArray(const char* name, double* values,
     Value *node = _stack.empty() ? (Value *)0 : _stack.back();
     
     report = report && count > 0 && values;
-    if (node && node->HasMember(name)) {
+    if (node && node->IsObject() && node->HasMember(name)) {
         const Value &item = node->GetMember(name);
         
         if (item.IsArray()) {
@@ -530,7 +576,7 @@ int MgJsonStorage::Impl::readString(const char* name, char* value, int count)
     int ret = 0;
     Value *node = _stack.empty() ? (Value *)0 : _stack.back();
     
-    if (node && node->HasMember(name)) {
+    if (node && node->IsObject() && node->HasMember(name)) {
         const Value &item = node->GetMember(name);
         
         if (item.IsString()) {
@@ -674,7 +720,7 @@ int MgJsonStorage::Impl::readIntArray(const char* name, int* values, int count,
     Value *node = _stack.empty() ? (Value *)0 : _stack.back();
     
     report = report && count > 0 && values;
-    if (node && node->HasMember(name)) {
+    if (node && node->IsObject() && node->HasMember(name)) {
         const Value &item = node->GetMember(name);
         
         if (item.IsArray()) {
@@ -10,6 +10,7 @@
 #include "mgstorage.h"
 #include "mgvector.h"
 #include "mglog.h"
+#include "mgtrace.h"
 #include <sstream>
 #include <map>
 
@@ -125,6 +126,7 @@ bool MgRecordShapes::onResume(long ticks)
 bool MgRecordShapes::recordStep(long tick, long changeCountOld, long changeCountNew, MgShapeDoc* doc,
                                 MgShapes* dynShapes, const std::vector<MgShapes*>& extShapes)
 {
+    MG_TRACE_SCOPE("recordStep");
     _im->beginJsonFile();
     _im->tick = (int)tick;
     
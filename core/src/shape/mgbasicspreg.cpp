@@ -106,8 +106,26 @@ static bool drawParallel(const MgParallel& sp, int, GiGraphics& gs, const GiCont
     return gs.drawPolygon(&ctx, 4, sp.getPoints());
 }
 
+// 压缩存储的笔迹显示得很小时，画出包络框的对角线，不必解码顶点
+static bool drawTinyStroke(const MgBaseLines& sp, GiGraphics& gs, const GiContext& ctx, bool& ret)
+{
+    if (!sp.isCompact())
+        return false;
+    
+    Box2d rect(sp.getExtent() * gs.xf().modelToDisplay());
+    
+    if (rect.width() > 2.f || rect.height() > 2.f)
+        return false;
+    ret = gs.drawLine(&ctx, sp.getExtent().leftBottom(), sp.getExtent().rightTop());
+    return true;
+}
+
 static bool drawLines(const MgLines& sp, int, GiGraphics& gs, const GiContext& ctx, int)
 {
+    bool ret;
+    
+    if (drawTinyStroke(sp, gs, ctx, ret))
+        return ret;
     return (sp.isClosed() ? gs.drawPolygon(&ctx, sp.getPointCount(), sp.getPoints())
             : gs.drawLines(&ctx, sp.getPointCount(), sp.getPoints()));
 }
@@ -115,7 +133,10 @@ static bool drawLines(const MgLines& sp, int, GiGraphics& gs, const GiContext& c
 static bool drawSplines(const MgSplines& sp, int, GiGraphics& gs, const GiContext& ctx, int)
 {
     int n = sp.getPointCount();
+    bool ret;
     
+    if (drawTinyStroke(sp, gs, ctx, ret))
+        return ret;
     if (n == 2) {
         return gs.drawLine(&ctx, sp.getPoint(0), sp.getPoint(1));
     }
@@ -166,27 +187,14 @@ static bool drawGrid(const MgGrid& sp, int, GiGraphics& gs, const GiContext& ctx
     
     bool switchx = (nx >= 10 && cell.x < gs.xf().displayToModel(20, true));
     bool switchy = (ny >= 10 && cell.y < gs.xf().displayToModel(20, true));
-    Point2d pts[2] = { rect.leftTop(), rect.leftBottom() };
-    
-    for (int i = 1; i < nx; i++) {
-        pts[0].x += cell.x;
-        pts[1].x += cell.x;
-        ctxgrid.setLineWidth(!switchx || i%5 > 0 ? w/2 : w, false);
-        ctxgrid.setLineAlpha(-w < 0.9f && (!switchx || i%5 > 0) ?
-                             ctx.getLineAlpha() / 2 : ctx.getLineAlpha());
-        ret += gs.drawLine(&ctxgrid, pts[0], pts[1]) ? 1 : 0;
-    }
+    GiContext ctxminor(w/2, ctx.getLineColor());
     
-    pts[0] = rect.leftBottom();
-    pts[1] = rect.rightBottom();
-    for (int j = 1; j < ny; j++) {
-        pts[0].y += cell.y;
-        pts[1].y += cell.y;
-        ctxgrid.setLineWidth(!switchy || j%5 > 0 ? w/2 : w, false);
-        ctxgrid.setLineAlpha(-w < 0.9f && (!switchy || j%5 > 0) ?
-                             ctx.getLineAlpha() / 2 : ctx.getLineAlpha());
-        ret += gs.drawLine(&ctxgrid, pts[0], pts[1]) ? 1 : 0;
+    if (-w < 0.9f) {
+        ctxminor.setLineAlpha(ctx.getLineAlpha() / 2);
     }
+    // 只生成显示区域内的网格线，普通线和每隔5条的主网格线各为一个路径
+    ret += gs.drawGridLines(&ctxminor, &ctxgrid, rect.leftBottom(), cell,
+                            switchx || switchy ? 5 : 1, rect);
     
     return ret > 0;
 }
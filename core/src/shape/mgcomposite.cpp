@@ -2,17 +2,177 @@
 // Copyright (c) 2004-2015, https://github.com/rhcad/vgcore, BSD License
 
 #include "mgcomposite.h"
+#include "gilock.h"
+#include <vector>
+#include <algorithm>
+
+//! 子图形的句柄序号前缀和表及包络框网格索引，只在 _indexLocker 锁内访问
+/*! 只记下子图形ID，用时再按ID查找，子图形被原位替换后不会得到已释放的对象。
+ */
+struct MgComposite::ChildIndex
+{
+    long    changeCount;                // 建立索引时复合图形的改变计数
+    int     shapeCount;                 // 建立索引时的子图形数
+    std::vector<int> ids;               // 按显示顺序的子图形ID
+    std::vector<int> starts;            // starts[i] 为第i个子图形的首个句柄序号，末项为句柄总数
+    Box2d   extent;                     // 网格范围
+    int     nx, ny;                     // 网格列数和行数，为0表示未建网格
+    float   cellw, cellh;
+    std::vector<std::vector<int> > cells;   // 每个网格中的子图形序号
+    std::vector<int> bigs;              // 跨越很多网格的大图形
+    std::vector<int> found;             // query() 的结果，重复使用以免每次分配
+    
+    enum { kMinIndexed = 16, kMaxCellsPerShape = 16 };
+    
+    void build(const MgShapes* list, long count) {
+        MgShapeIterator it(list);
+        int n = 0;
+        
+        changeCount = count;
+        shapeCount = list->getShapeCount();
+        ids.clear();
+        starts.clear();
+        
+        while (const MgShape* sp = it.getNext()) {
+            starts.push_back(n);
+            n += sp->getHandleCount();
+            ids.push_back(sp->getID());
+        }
+        starts.push_back(n);
+        buildGrid(list);
+    }
+    
+    // 子图形较少时不建网格，直接遍历
+    void buildGrid(const MgShapes* list) {
+        const int count = (int)ids.size();
+        
+        nx = ny = count < kMinIndexed ? 0 : mgMax(1, mgMin(64, (int)sqrtf(count / 4.f)));
+        cells.clear();
+        bigs.clear();
+        if (nx == 0)
+            return;
+        
+        extent = list->getExtent();
+        cellw = extent.width() / nx;
+        cellh = extent.height() / ny;
+        cellw = cellw > 1e-6f ? cellw : 1.f;
+        cellh = cellh > 1e-6f ? cellh : 1.f;
+        cells.resize(nx * ny);
+        
+        MgShapeIterator it(list);
+        for (int i = 0; i < count; i++) {
+            int x1, y1, x2, y2;
+            cellRange(it.getNext()->shapec()->getExtent(), x1, y1, x2, y2);
+            
+            if ((x2 - x1 + 1) * (y2 - y1 + 1) > kMaxCellsPerShape) {
+                bigs.push_back(i);
+                continue;
+            }
+            for (int y = y1; y <= y2; y++) {
+                for (int x = x1; x <= x2; x++) {
+                    cells[y * nx + x].push_back(i);
+                }
+            }
+        }
+    }
+    
+    void cellRange(const Box2d& rect, int& x1, int& y1, int& x2, int& y2) const {
+        float fx1 = (rect.xmin - extent.xmin) / cellw, fx2 = (rect.xmax - extent.xmin) / cellw;
+        float fy1 = (rect.ymin - extent.ymin) / cellh, fy2 = (rect.ymax - extent.ymin) / cellh;
+        
+        x1 = fx1 < 0 ? 0 : fx1 >= nx ? nx - 1 : (int)fx1;
+        x2 = fx2 < 0 ? 0 : fx2 >= nx ? nx - 1 : (int)fx2;
+        y1 = fy1 < 0 ? 0 : fy1 >= ny ? ny - 1 : (int)fy1;
+        y2 = fy2 < 0 ? 0 : fy2 >= ny ? ny - 1 : (int)fy2;
+    }
+    
+    //! 返回句柄序号所在的子图形序号，index 改为子图形内的句柄序号，超出范围返回-1
+    int find(int& index) const {
+        if (index < 0 || index >= starts.back())
+            return -1;
+        int i = (int)(std::upper_bound(starts.begin(), starts.end(), index) - starts.begin()) - 1;
+        index -= starts[i];
+        return i;
+    }
+    
+    //! 按显示顺序得到包络框可能与 rect 相交的子图形序号，放在 found 中
+    void query(const Box2d& rect) {
+        std::vector<int>& arr = found;
+        
+        arr.clear();
+        if (nx == 0) {
+            for (int i = 0; i < (int)ids.size(); i++)
+                arr.push_back(i);
+            return;
+        }
+        arr.insert(arr.end(), bigs.begin(), bigs.end());
+        if (rect.isIntersect(extent)) {
+            int x1, y1, x2, y2;
+            cellRange(rect, x1, y1, x2, y2);
+            for (int y = y1; y <= y2; y++) {
+                for (int x = x1; x <= x2; x++) {
+                    const std::vector<int>& cell = cells[y * nx + x];
+                    arr.insert(arr.end(), cell.begin(), cell.end());
+                }
+            }
+        }
+        std::sort(arr.begin(), arr.end());
+        arr.erase(std::unique(arr.begin(), arr.end()), arr.end());
+    }
+};
 
-MgComposite::MgComposite() : _owner(NULL)
+MgComposite::MgComposite() : _owner(NULL), _index(NULL), _indexLocker(0)
 {
     _shapes = MgShapes::create(this);
 }
 
 MgComposite::~MgComposite()
 { 
+    delete _index;
     _shapes->release();
 }
 
+// 调用者应已锁定 _indexLocker
+MgComposite::ChildIndex* MgComposite::_getIndex() const
+{
+    if (!_index) {
+        _index = new ChildIndex();
+        _index->build(_shapes, getChangeCount());
+    } else if (_index->changeCount != getChangeCount()
+               || _index->shapeCount != _shapes->getShapeCount()) {
+        _index->build(_shapes, getChangeCount());
+    }
+    return _index;
+}
+
+// 查找句柄序号所在的子图形，index 改为子图形内的句柄序号，调用者应已锁定 _indexLocker
+const MgShape* MgComposite::_findHandle(int& index) const
+{
+    for (int retry = 0; retry < 2; retry++) {
+        ChildIndex* ci = _getIndex();
+        int h = index;
+        int i = ci->find(h);
+        
+        if (i < 0)
+            return NULL;
+        
+        const MgShape* sp = _shapes->findShape(ci->ids[i]);
+        if (sp && sp->getHandleCount() == ci->starts[i + 1] - ci->starts[i]) {
+            index = h;
+            return sp;
+        }
+        ci->build(_shapes, getChangeCount());   // 子图形被原位替换或改变了句柄数
+    }
+    return NULL;
+}
+
+void MgComposite::_invalidateIndex()
+{
+    GiSpinLock lock(&_indexLocker);
+    delete _index;
+    _index = NULL;
+}
+
 bool MgComposite::_isKindOf(int type) const
 {
     return type == Type() || MgBaseShape::_isKindOf(type);
@@ -22,6 +182,13 @@ void MgComposite::setOwner(MgObject* owner)
 {
     if (!owner || owner->isKindOf(MgShape::Type())) {
         _owner = (MgShape*)owner;
+        
+        if (_owner && !_owner->isShared() && _shapes->getStyleTable()) {  // 子图形也改用文档的登记表
+            MgShapeIterator it(_shapes);
+            while (const MgShape* sp = it.getNext()) {
+                const_cast<MgShape*>(sp)->setParent(_shapes, sp->getID());
+            }
+        }
     }
 }
 
@@ -43,30 +210,16 @@ void MgComposite::_setPoint(int, const Point2d&)
 
 int MgComposite::_getHandleCount() const
 {
-    int n = 0;
-    MgShapeIterator it(_shapes);
-    
-    while (const MgShape* sp = it.getNext()) {
-        n += sp->getHandleCount();
-    }
-    
-    return n;
+    GiSpinLock lock(&_indexLocker);
+    return _getIndex()->starts.back();
 }
 
 Point2d MgComposite::_getHandlePoint(int index) const
 {
-    int n = 0;
-    MgShapeIterator it(_shapes);
-    
-    while (const MgShape* sp = it.getNext()) {
-        int c = sp->getHandleCount();
-        if (index < n + c) {
-            return sp->getHandlePoint(index - n);
-        }
-        n += c;
-    }
+    GiSpinLock lock(&_indexLocker);
+    const MgShape* sp = _findHandle(index);
     
-    return getExtent().center();
+    return sp ? sp->getHandlePoint(index) : getExtent().center();
 }
 
 bool MgComposite::_setHandlePoint(int index, const Point2d& pt, float)
@@ -76,34 +229,18 @@ bool MgComposite::_setHandlePoint(int index, const Point2d& pt, float)
 
 int MgComposite::_getHandleType(int index) const
 {
-    int n = 0;
-    MgShapeIterator it(_shapes);
-    
-    while (const MgShape* sp = it.getNext()) {
-        int c = sp->getHandleCount();
-        if (index < n + c) {
-            return sp->getHandleType(index - n);
-        }
-        n += c;
-    }
+    GiSpinLock lock(&_indexLocker);
+    const MgShape* sp = _findHandle(index);
     
-    return kMgHandleNoSnap;
+    return sp ? sp->getHandleType(index) : kMgHandleNoSnap;
 }
 
 bool MgComposite::_isHandleFixed(int index) const
 {
-    int n = 0;
-    MgShapeIterator it(_shapes);
-    
-    while (const MgShape* sp = it.getNext()) {
-        int c = sp->getHandleCount();
-        if (index < n + c) {
-            return sp->shapec()->isHandleFixed(index - n);
-        }
-        n += c;
-    }
+    GiSpinLock lock(&_indexLocker);
+    const MgShape* sp = _findHandle(index);
     
-    return true;
+    return !sp || sp->shapec()->isHandleFixed(index);
 }
 
 int MgComposite::getShapeCount() const
@@ -115,10 +252,12 @@ void MgComposite::_clearCachedData()
 {
     __super::_clearCachedData();
     _shapes->clearCachedData();
+    _invalidateIndex();
 }
 
 void MgComposite::_update()
 {
+    _invalidateIndex();
     _extent = _shapes->getExtent();
     __super::_update();
 }
@@ -130,17 +269,20 @@ void MgComposite::_transform(const Matrix2d& mat)
         sp->shape()->transform(mat);
     }
     _extent = _shapes->getExtent();
+    _invalidateIndex();
 }
 
 void MgComposite::_clear()
 {
     _shapes->clear();
+    _invalidateIndex();
     MgBaseShape::_clear();
 }
 
 void MgComposite::_copy(const MgComposite& src)
 {
     _shapes->copyShapes(src._shapes);
+    _invalidateIndex();
     __super::_copy(src);
 }
 
@@ -151,15 +293,18 @@ bool MgComposite::_equals(const MgComposite& src) const
 
 float MgComposite::_hitTest(const Point2d& pt, float tol, MgHitResult& res) const
 {
-    MgShapeIterator it(_shapes);
     MgHitResult tmpRes;
     Box2d limits(pt, 2 * tol, 0);
+    GiSpinLock lock(&_indexLocker);
+    ChildIndex* ci = _getIndex();
 
     res.segment = 0;
     res.dist = _FLT_MAX;
 
-    while (const MgShape* sp = it.getNext()) {
-        if (limits.isIntersect(sp->shapec()->getExtent())) {
+    ci->query(limits);
+    for (size_t j = 0; j < ci->found.size(); j++) {
+        const MgShape* sp = _shapes->findShape(ci->ids[ci->found[j]]);
+        if (sp && limits.isIntersect(sp->shapec()->getExtent())) {
             float d = sp->shapec()->hitTest(pt, tol, tmpRes);
             if (res.dist > d - _MGZERO) {
                 res = tmpRes;
@@ -186,6 +331,7 @@ bool MgComposite::_offset(const Vector2d& vec, int)
     while (MgShape* sp = const_cast<MgShape*>(it.getNext())) {
         n += sp->shape()->offset(vec, -1) ? 1 : 0;
     }
+    _invalidateIndex();
 
     return n > 0;
 }
@@ -325,6 +471,7 @@ bool MgGroup::_offset(const Vector2d& vec, int segment)
     MgShape* sp = const_cast<MgShape*>(_shapes->findShape(segment));
 
     if (sp && canOffsetShapeAlone(sp)) {
+        _invalidateIndex();
         return sp->shape()->offset(vec, -1);
     }
     if (!sp) {
@@ -2,14 +2,15 @@
 // Copyright (c) 2004-2015, https://github.com/rhcad/vgcore, BSD License
 
 #include "mgimagesp.h"
-#include "mgcomposite.h"
+#include "mgshapes.h"
 #include "mgshape_.h"
 #include "mglog.h"
+#include "giimagereg.h"
 #include <string.h>
 
 MG_IMPLEMENT_CREATE(MgImageShape)
 
-MgImageShape::MgImageShape()
+MgImageShape::MgImageShape() : _handle(0), _owner(NULL)
 {
     _name[0] = 0;
 }
@@ -27,6 +28,7 @@ void MgImageShape::setName(const char* name)
     strncpy(_name, name, len);
 #endif
     _name[len] = 0;
+    setHandle(GiImageRegistry::instance().intern(_name));
     
     if (strstr(_name, "%d.")) {
         setFlag(kMgHideContent, true);
@@ -34,6 +36,24 @@ void MgImageShape::setName(const char* name)
     }
 }
 
+void MgImageShape::setOwner(MgObject* owner)
+{
+    if (!owner || owner->isKindOf(MgShape::Type())) {
+        _owner = (MgShape*)owner;
+    }
+}
+
+// 图像句柄原地改变后更新所在列表的图像索引
+void MgImageShape::setHandle(int handle)
+{
+    if (_handle != handle) {
+        _handle = handle;
+        if (_owner && _owner->getParent()) {
+            _owner->getParent()->updateIndex(_owner);
+        }
+    }
+}
+
 void MgImageShape::setImageSize(Vector2d size)
 {
     if (size.x < 1 || size.y < 1) {
@@ -49,7 +69,7 @@ bool MgImageShape::_draw(int, GiGraphics& gs, const GiContext& ctx, int) const
     bool ret = false;
     
     if (isVisible()) {
-        ret = gs.rawImage(_name, rect.center().x, rect.center().y,
+        ret = gs.rawImage(_handle, rect.center().x, rect.center().y,
                           rect.width(), rect.height(), vec.angle2());
     }
     
@@ -64,17 +84,19 @@ void MgImageShape::_copy(const MgImageShape& src)
     strcpy(_name, src._name);
 #endif
     _size = src._size;
+    setHandle(src._handle);
     __super::_copy(src);
 }
 
 bool MgImageShape::_equals(const MgImageShape& src) const
 {
-    return strcmp(_name, src._name) == 0 && _size == src._size && __super::_equals(src);
+    return _handle == src._handle && _size == src._size && __super::_equals(src);
 }
 
 void MgImageShape::_clear()
 {
     _name[0] = 0;
+    setHandle(0);
     __super::_clear();
 }
 
@@ -91,6 +113,7 @@ bool MgImageShape::_load(MgShapeFactory* factory, MgStorage* s)
     int len = sizeof(_name) - 1;
     len = s->readString("name", _name, len);
     _name[len] = 0;
+    setHandle(GiImageRegistry::instance().intern(_name));
     
     _size.set(s->readFloat("imageWidth", 0), s->readFloat("imageHeight", 0));
     if (_size.x < 1 || _size.y < 1) {
@@ -103,24 +126,7 @@ bool MgImageShape::_load(MgShapeFactory* factory, MgStorage* s)
 
 const MgShape* MgImageShape::findShapeByImageID(const MgShapes* shapes, const char* name)
 {
-    MgShapeIterator it(shapes);
-    const MgShape* ret = MgShape::Null();
-    
-    while (const MgShape* sp = it.getNext()) {
-        if (sp->shapec()->isKindOf(MgImageShape::Type())) {
-            const MgImageShape *image = (const MgImageShape*)sp->shapec();
-            if (strcmp(name, image->getName()) == 0) {
-                ret = sp;
-                break;
-            }
-        } else if (sp->shapec()->isKindOf(MgComposite::Type())) {
-            const MgComposite *composite = (const MgComposite *)sp->shapec();
-            ret = findShapeByImageID(composite->shapes(), name);
-            if (ret) {
-                break;
-            }
-        }
-    }
-    
-    return ret;
+    // 比较登记的整数句柄，名称未登记过则不会有对应的图形
+    int handle = GiImageRegistry::instance().findHandle(name);
+    return handle && shapes ? shapes->findShapeByImageHandle(handle) : MgShape::Null();
 }
@@ -4,6 +4,7 @@
 #include "mgshape.h"
 #include "mgstorage.h"
 #include "mgcomposite.h"
+#include "gistyletable.h"
 
 bool MgShape::hasFillColor() const
 {
@@ -89,39 +90,61 @@ bool MgShape::equals(const MgObject& src) const
 
 bool MgShape::save(MgStorage* s) const
 {
-    GiColor c;
+    int style = s->getStyleIndex() ? s->getStyleIndex()->find(context()) : -1;
 
     s->writeInt("tag", getTag());
-    s->writeInt("lineStyle", (unsigned char)context().getLineStyle());
-    s->writeFloat("lineWidth", context().getLineWidth());
+    if (style >= 0) {
+        s->writeInt("style", style + 1);        // 文档的绘图参数表中的序号，从1开始
+    } else {
+        saveContext(s, context());
+    }
+
+    return shapec()->save(s);
+}
+
+void MgShape::saveContext(MgStorage* s, const GiContext& ctx)
+{
+    GiColor c;
+
+    s->writeInt("lineStyle", (unsigned char)ctx.getLineStyle());
+    s->writeFloat("lineWidth", ctx.getLineWidth());
 
-    c = context().getLineColor();
+    c = ctx.getLineColor();
     s->writeUInt("lineColor", c.b | (c.g << 8) | (c.r << 16) | (c.a << 24));
-    c = context().getFillColor();
+    c = ctx.getFillColor();
     s->writeUInt("fillColor", c.b | (c.g << 8) | (c.r << 16) | (c.a << 24));
     
-    if (context().getStartArrayHead()) {
-        s->writeInt("startArrayHead", context().getStartArrayHead());
+    if (ctx.getStartArrayHead()) {
+        s->writeInt("startArrayHead", ctx.getStartArrayHead());
     }
-    if (context().getEndArrayHead()) {
-        s->writeInt("endArrayHead", context().getEndArrayHead());
+    if (ctx.getEndArrayHead()) {
+        s->writeInt("endArrayHead", ctx.getEndArrayHead());
     }
-
-    return shapec()->save(s);
 }
 
-bool MgShape::load(MgShapeFactory* factory, MgStorage* s)
+GiContext MgShape::loadContext(MgStorage* s)
 {
-    setTag(s->readInt("tag", getTag()));
-
     GiContext ctx;
+
     ctx.setLineStyle(s->readInt("lineStyle", 0));
     ctx.setLineWidth(s->readFloat("lineWidth", 0), true);
     ctx.setLineColor(GiColor(s->readInt("lineColor", 0xFF000000), true));
     ctx.setFillColor(GiColor(s->readInt("fillColor", 0), true));
     ctx.setStartArrayHead(s->readInt("startArrayHead", 0));
     ctx.setEndArrayHead(s->readInt("endArrayHead", 0));
-    setContext(ctx);
+
+    return ctx;
+}
+
+bool MgShape::load(MgShapeFactory* factory, MgStorage* s)
+{
+    setTag(s->readInt("tag", getTag()));
+
+    int style = s->readInt("style", 0);
+    const GiContext* ctx = (style > 0 && s->getStyleIndex()
+                            ? s->getStyleIndex()->get(style - 1) : NULL);
+    
+    setContext(ctx ? *ctx : loadContext(s));
 
     bool ret = shape()->load(factory, s);
     if (ret) {
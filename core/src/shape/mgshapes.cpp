@@ -4,32 +4,224 @@
 #include "mgstorage.h"
 #include "mgspfactory.h"
 #include "mglog.h"
+#include "mgtrace.h"
+#include "githread.h"
 #include "mgcomposite.h"
+#include "mgimagesp.h"
 #include <list>
+#include <vector>
 #include <map>
 #include <set>
+#include <algorithm>
 
 struct MgShapes::I
 {
     typedef std::list<MgShape*> Container;
     typedef Container::const_iterator citerator;
     typedef Container::iterator iterator;
-    typedef std::map<int, MgShape*>  ID2SHAPE;
+    typedef std::map<int, iterator>  ID2SHAPE;      // ID -> 在列表中的位置，可按ID直接删除和替换
+    enum { kMaxIters = 4, kMaxSpares = 8, kMaxChanges = 4096 };
+    enum { kAdded, kRemoved, kChanged, kUnknown };  // 改动类型，kUnknown 为次序或内容无法按ID确定的改动
+    
+    //! 二级索引项，按显示次序排序
+    struct Entry {
+        double      pos;            // 显示次序值，随列表顺序递增，不必连续
+        MgShape*    sp;
+        bool        nested;         // 为true表示是子图形中含有该键值的复合图形
+        
+        Entry(double pos, MgShape* sp = NULL, bool nested = false) : pos(pos), sp(sp), nested(nested) {}
+        bool operator<(const Entry& e) const { return pos < e.pos; }
+    };
+    typedef std::set<Entry> Bucket;
+    typedef std::map<int, Bucket> KeyIndex;
+    
+    //! 图形加入索引时的键值，移除时按此删除索引项
+    struct Record {
+        double      pos;
+        int         type;
+        int         tag;
+        int         image;          // 图像句柄，不是图像图形则为0
+        std::vector<int> nestedTypes;   // 复合图形的子图形(递归)中的其他类型
+        std::vector<int> nestedImages;  // 复合图形的子图形(递归)中的图像句柄
+    };
+    typedef std::map<const MgShape*, Record> RECORDS;
+    
+    //! 索引数据，浅拷贝的列表共享同一份，修改前才复制(写时复制)
+    struct Index {
+        RECORDS     records;        // 各图形的索引键值和显示次序
+        KeyIndex    byType;         // 图形类型 -> 该类型的图形及含有该类型的复合图形
+        KeyIndex    byTag;          // 非0标签 -> 图形
+        KeyIndex    byImage;        // 图像句柄 -> 图像图形及含有该图像的复合图形
+        volatile long refcount;
+        
+        Index() : refcount(1) {}
+        void addRef() { giAtomicIncrement(&refcount); }
+        void release() {
+            if (giAtomicDecrement(&refcount) == 0)
+                delete this;
+        }
+    };
+    
+    //! 改动记录，浅拷贝的列表共享同一份，只由开始记录的列表追加
+    struct Changes {
+        struct Item {
+            int     sid;
+            int     op;
+        };
+        std::vector<Item> items;
+        int         first;          // items[0] 的序号，超过 kMaxChanges 项时丢弃较早的一半
+        volatile long locker;
+        volatile long refcount;
+        
+        Changes() : first(0), locker(0), refcount(1) {}
+        void addRef() { giAtomicIncrement(&refcount); }
+        void release() {
+            if (giAtomicDecrement(&refcount) == 0)
+                delete this;
+        }
+    };
     
     Container   shapes;
     ID2SHAPE    id2shape;
+    Index*      idx;                // 索引数据，不为NULL
+    volatile long indexed;          // 索引是否已建立，在首次查找时建立，之后随增删图形维护
+    volatile long indexLocker;      // 多个绘图线程同时查找时只由一个线程建立索引
     MgObject*   owner;
     int         index;
     int         newShapeID;
     volatile long refcount;
+    MgLoadProgress* progress;           // 加载进度接口，仅在 load() 期间使用
+    citerator   iters[kMaxIters];       // 预分配的遍历位置，避免遍历时分配内存
+    volatile long itersUsed[kMaxIters];
+    bool        reusing;                // 是否正在原地重建，见 beginReuse()
+    iterator    reuseAt;                // 重建位置，其前的图形已复用或新加入
+    Container   spares;                 // 重建时移除的图形及其结点，保留ID项，留待以后的重建复用
+    Changes*    changes;                // 改动记录，未记录时为NULL
+    bool        changeOwner;            // 是否由本列表追加改动记录，否则为快照
+    int         changeSeq;              // 快照复制时的记录序号
+    
+    I() : idx(new Index()), indexed(0), indexLocker(0), reusing(false)
+        , changes(NULL), changeOwner(false), changeSeq(0) {
+        for (int i = 0; i < kMaxIters; i++)
+            itersUsed[i] = 0;
+    }
+    ~I() {
+        idx->release();
+        if (changes)
+            changes->release();
+    }
+    citerator* newIterator() {
+        for (int i = 0; i < kMaxIters; i++) {
+            if (giAtomicCompareAndSwap(&itersUsed[i], 1, 0)) {
+                iters[i] = shapes.begin();
+                return &iters[i];
+            }
+        }
+        return new citerator(shapes.begin());
+    }
+    void freeIterator(citerator* it) {
+        if (it >= iters && it < iters + kMaxIters) {
+            giAtomicCompareAndSwap(&itersUsed[it - iters], 0, 1);
+        } else {
+            delete it;
+        }
+    }
     
     MgShape* findShape(int sid) const;
     int getNewID(int sid);
     
+    //! 追加改动记录，快照被改动时不再共享记录
+    void changed(int sid, int op) {
+        if (!changes) {
+        } else if (!changeOwner) {
+            changes->release();
+            changes = NULL;
+        } else {
+            GiSpinLock lock(&changes->locker);
+            std::vector<Changes::Item>& items = changes->items;
+            
+            if (items.size() >= (size_t)kMaxChanges) {
+                items.erase(items.begin(), items.begin() + kMaxChanges / 2);
+                changes->first += kMaxChanges / 2;
+            }
+            Changes::Item item = { sid, op };
+            items.push_back(item);
+        }
+    }
+    double posOf(const MgShape* sp) const {
+        RECORDS::const_iterator it = idx->records.find(sp);
+        return it != idx->records.end() ? it->second.pos : 0;
+    }
+    void pushBack(MgShape* sp) {
+        if (reusing) {                  // 重建时加在重建位置，以免被 endReuse() 移除
+            insert(reuseAt, sp);
+            return;
+        }
+        double pos = shapes.empty() ? 0 : posOf(shapes.back()) + 1;
+        id2shape[sp->getID()] = shapes.insert(shapes.end(), sp);
+        if (indexed)
+            attach(sp, pos);
+        changed(sp->getID(), kAdded);
+    }
+    void insert(iterator it, MgShape* sp);
+    void erase(iterator it) {
+        changed((*it)->getID(), kRemoved);
+        if (it == reuseAt)
+            ++reuseAt;
+        shapes.erase(it);
+    }
+    void attach(MgShape* sp, double pos);
+    void detach(const MgShape* sp);
+    void reindex();
+    void buildIndex();
+    void clearIndex() {
+        idx->release();
+        idx = new Index();
+    }
+    //! 返回可修改的索引数据，与其他列表共享时先复制一份
+    Index* writable() {
+        if (giAtomicLoad(&idx->refcount) > 1) {
+            Index* p = new Index(*idx);
+            p->refcount = 1;
+            idx->release();
+            idx = p;
+        }
+        return idx;
+    }
+    static void addEntry(KeyIndex& index, int key, const Entry& e) {
+        index[key].insert(e);
+    }
+    static void removeEntry(KeyIndex& index, int key, double pos) {
+        KeyIndex::iterator it = index.find(key);
+        if (it != index.end()) {
+            it->second.erase(Entry(pos));
+            if (it->second.empty())
+                index.erase(it);
+        }
+    }
+    static const Bucket* bucket(const KeyIndex& index, int key) {
+        KeyIndex::const_iterator it = index.find(key);
+        return it != index.end() ? &it->second : NULL;
+    }
+    const MgBaseShape* sampleOfType(int type) const;
+    int loadParallel(MgShapes* owner, MgShapeFactory* factory, MgStorage* s,
+                     int total, int& count, bool& ret);
+    
+    //! 返回ID在 id2shape 中的项，跳过留待复用的图形
+    ID2SHAPE::iterator findID(int sid) {
+        ID2SHAPE::iterator it = id2shape.find(sid);
+        return it != id2shape.end() && isSpare(it->second) ? id2shape.end() : it;
+    }
+    bool isSpare(citerator pos) const {
+        for (citerator it = spares.begin(); it != spares.end(); ++it) {
+            if (it == pos)
+                return true;
+        }
+        return false;
+    }
     iterator findPositionOfID(int sid) {
-        iterator it = shapes.begin();
-        for (; it != shapes.end() && (*it)->getID() != sid; ++it) ;
-        return it;
+        ID2SHAPE::iterator it = findID(sid);
+        return it != id2shape.end() ? it->second : shapes.end();
     }
     iterator findPositionOfIndex(int index) {
         iterator it = shapes.begin();
@@ -58,6 +250,7 @@ MgShapes::MgShapes(MgObject* owner, int index)
     im->index = index;
     im->newShapeID = 1;
     im->refcount = 1;
+    im->progress = NULL;
 }
 
 MgShapes::~MgShapes()
@@ -102,6 +295,38 @@ int MgShapes::copyShapes(const MgShapes* src, bool deeply, bool needClear)
         clear();
     
     int ret = 0;
+    
+    if (!deeply && src && src != this && im->shapes.empty() && im->spares.empty()) {
+        // 浅拷贝到空列表时图形顺序和ID都不变，已建立的索引直接复制，不必逐个插入
+        im->shapes = src->im->shapes;
+        if (im->changes) {
+            im->changes->release();
+            im->changes = NULL;
+        }
+        if (src->im->changes) {             // 共享改动记录，以后可只比较改动的图形
+            GiSpinLock lock(&src->im->changes->locker);
+            src->im->changes->addRef();
+            im->changes = src->im->changes;
+            im->changeOwner = false;
+            im->changeSeq = src->im->changeOwner ? (im->changes->first + (int)im->changes->items.size())
+                : src->im->changeSeq;
+        }
+        {
+            GiSpinLock lock(&src->im->indexLocker);
+            if (giAtomicLoad(&src->im->indexed)) {
+                src->im->idx->addRef();     // 共享索引数据，任一列表修改时再复制
+                im->idx->release();
+                im->idx = src->im->idx;
+                im->indexed = 1;
+            }
+        }
+        for (I::iterator it = im->shapes.begin(); it != im->shapes.end(); ++it, ++ret) {
+            (*it)->addRef();
+            im->id2shape.insert(im->id2shape.end(), std::make_pair((*it)->getID(), it));
+        }
+        return ret;
+    }
+    
     MgShapeIterator it(src);
     
     while (MgShape* sp = const_cast<MgShape*>(it.getNext())) {
@@ -109,8 +334,7 @@ int MgShapes::copyShapes(const MgShapes* src, bool deeply, bool needClear)
             ret += addShape(*sp) ? 1 : 0;
         } else {
             sp->addRef();
-            im->shapes.push_back(sp);
-            im->id2shape[sp->getID()] = sp;
+            im->pushBack(sp);
             ret++;
         }
     }
@@ -132,17 +356,26 @@ bool MgShapes::equals(const MgObject& src) const
 
 void MgShapes::clear()
 {
+    im->changed(0, I::kUnknown);
     for (I::iterator it = im->shapes.begin(); it != im->shapes.end(); ++it) {
         (*it)->release();
     }
     im->shapes.clear();
     im->id2shape.clear();
+    im->clearIndex();
+    im->reuseAt = im->shapes.end();
+    for (I::iterator it = im->spares.begin(); it != im->spares.end(); ++it) {
+        (*it)->release();
+    }
+    im->spares.clear();
 }
 
 void MgShapes::clearCachedData()
 {
     for (I::iterator it = im->shapes.begin(); it != im->shapes.end(); ++it) {
-        (*it)->shape()->clearCachedData();
+        if (!(*it)->isShared()) {       // 前端文档中的图形可能正在其他线程中绘制
+            (*it)->shape()->clearCachedData();
+        }
     }
 }
 
@@ -158,30 +391,116 @@ int MgShapes::getIndex() const
 
 bool MgShapes::updateShape(MgShape* shape, bool force)
 {
-    if (shape && (force || !shape->getParent() || shape->getParent() == this)) {
-        I::iterator it = im->findPositionOfID(shape->getID());
-        if (it != im->shapes.end()) {
-            shape->shape()->update();
-            shape->shape()->resetChangeCount((*it)->shapec()->getChangeCount()
-                                             + ((*it)->equals(*shape) ? 0 : 1));
-            (*it)->release();
-            *it = shape;
-            shape->setParent(this, shape->getID());
-            im->id2shape[shape->getID()] = shape;
-            return true;
+    return updateShapes(1, &shape, force) == 1;
+}
+
+int MgShapes::updateShapes(int n, MgShape* const* shapes, bool force)
+{
+    std::set<int> done;                 // 已替换的原图形ID
+    int count = 0;
+    
+    for (int i = 0; i < n; i++) {
+        MgShape* shape = shapes[i];
+        if (!shape || !(force || !shape->getParent() || shape->getParent() == this))
+            continue;
+        
+        I::ID2SHAPE::iterator p = shape->getID() ? im->findID(shape->getID()) : im->id2shape.end();
+        if (p == im->id2shape.end())
+            continue;
+        if (!done.insert(shape->getID()).second) {
+            if (*p->second != shape)
+                shape->release();       // 同一ID只用第一个新图形，其余的由本列表释放
+            continue;
         }
+        
+        I::iterator it = p->second;
+        shape->shape()->update();
+        shape->shape()->resetChangeCount((*it)->shapec()->getChangeCount()
+                                         + ((*it)->equals(*shape) ? 0 : 1));
+        double pos = im->posOf(*it);
+        im->detach(*it);
+        (*it)->release();
+        *it = shape;
+        shape->setParent(this, shape->getID());
+        if (im->indexed)
+            im->attach(shape, pos);
+        im->changed(shape->getID(), I::kChanged);
+        count++;
     }
-    return false;
+    
+    return count;
 }
 
 void MgShapes::transform(const Matrix2d& mat)
 {
-    for (I::iterator it = im->shapes.begin(); it != im->shapes.end(); ++it) {
-        MgShape* newsp = (*it)->cloneShape();
-        newsp->shape()->transform(mat);
-        if (!updateShape(newsp, true))
-            MgObject::release_pointer(newsp);
+    transformShapes(0, NULL, mat);
+}
+
+//! 并行变形图形的任务数据
+struct MgShapesTransformer {
+    const Matrix2d*         mat;
+    std::vector<MgShape*>   items;      // 待变形的图形，被共享的图形在任务中换为复本
+    std::vector<char>       shared;
+    
+    static void run(int from, int to, void* data);
+};
+
+void MgShapesTransformer::run(int from, int to, void* data)
+{
+    MgShapesTransformer* t = (MgShapesTransformer*)data;
+    
+    for (int i = from; i < to; i++) {
+        MgShape* sp = t->items[i];
+        
+        if (t->shared[i]) {
+            sp = sp->cloneShape();
+            t->items[i] = sp;
+        }
+        sp->shape()->transform(*t->mat);
+        sp->shape()->update();
+    }
+}
+
+int MgShapes::transformShapes(int n, const int* ids, const Matrix2d& mat)
+{
+    enum { kMinCount = 500 };   // 图形较少时线程开销不值得
+    MgShapesTransformer t;
+    
+    t.mat = &mat;
+    if (ids) {
+        std::set<int> used;
+        for (int i = 0; i < n; i++) {
+            MgShape* sp = im->findShape(ids[i]);
+            if (sp && used.insert(ids[i]).second) {
+                t.items.push_back(sp);
+            }
+        }
+    } else {
+        t.items.assign(im->shapes.begin(), im->shapes.end());
+    }
+    
+    int count = (int)t.items.size();
+    std::vector<MgShape*> newsps;
+    
+    t.shared.resize(count);
+    for (int i = 0; i < count; i++) {
+        t.shared[i] = t.items[i]->isShared() ? 1 : 0;
     }
+    giParallelFor(count, kMinCount, MgShapesTransformer::run, &t);
+    
+    // 就地变形的图形的索引键值不变，只需一次替换复制变形的图形
+    for (int i = 0; i < count; i++) {
+        if (t.shared[i]) {
+            newsps.push_back(t.items[i]);
+        } else {
+            im->changed(t.items[i]->getID(), I::kChanged);
+        }
+    }
+    if (!newsps.empty()) {
+        updateShapes((int)newsps.size(), &newsps.front(), true);
+    }
+    
+    return count;
 }
 
 MgShape* MgShapes::cloneShape(int sid) const
@@ -192,40 +511,215 @@ MgShape* MgShapes::cloneShape(int sid) const
 
 MgShape* MgShapes::addShape(const MgShape& src)
 {
-    MgShape* p = src.cloneShape();
+    MgShape* p = reuseShape(src.getType());
+    
+    if (p) {                            // 原地复制到重建位置上的同类图形，不新建图形和结点
+        const int sid = src.getID();
+        p->copy(src);
+        if (sid && sid != p->getID() && !im->findShape(sid)) {
+            im->id2shape.erase(p->getID());
+            p->setParent(this, sid);
+            im->id2shape[sid] = im->reuseAt;
+        }
+        ++im->reuseAt;
+        p->release();
+        return p;
+    }
+    p = src.cloneShape();
     if (p) {
         p->setParent(this, im->getNewID(src.getID()));
-        im->shapes.push_back(p);
-        im->id2shape[p->getID()] = p;
+        im->pushBack(p);
     }
     return p;
 }
 
 bool MgShapes::addShapeDirect(MgShape* shape, bool force)
 {
-    if (shape && (force || !shape->getParent() || shape->getParent() == this)) {
-        shape->shape()->update();
-        shape->setParent(this, im->getNewID(0));
-        im->shapes.push_back(shape);
-        im->id2shape[shape->getID()] = shape;
+    return addShapes(1, &shape, force) == 1;
+}
+
+int MgShapes::addShapes(int n, MgShape* const* shapes, bool force)
+{
+    int count = 0;
+    
+    for (int i = 0; i < n; i++) {
+        MgShape* shape = shapes[i];
+        if (shape && (force || !shape->getParent() || shape->getParent() == this)) {
+            shape->shape()->update();
+            if (im->reusing && im->reuseAt != im->shapes.end() && *im->reuseAt == shape) {
+                ++im->reuseAt;          // reuseShape() 取出的图形已在原位置
+                shape->release();
+            } else {
+                shape->setParent(this, im->getNewID(0));
+                im->pushBack(shape);
+            }
+            count++;
+        }
+    }
+    return count;
+}
+
+bool MgShapes::addShapeWithID(MgShape* shape, int sid)
+{
+    if (shape) {
+        shape->setParent(this, im->getNewID(sid));
+        im->pushBack(shape);
         return true;
     }
     return false;
 }
 
+bool MgShapes::beginReuse()
+{
+    if (giAtomicLoad(&im->refcount) > 1) {
+        return false;                   // 其他线程可能正在显示本列表
+    }
+    if (im->indexed) {                  // 重建时不维护索引，查找时再建立
+        im->clearIndex();
+        im->indexed = 0;
+    }
+    im->reusing = true;
+    im->reuseAt = im->shapes.begin();
+    im->changed(0, I::kUnknown);        // 原地复用的图形不按ID记录
+    return true;
+}
+
+MgShape* MgShapes::reuseShape(int type)
+{
+    if (!im->reusing)
+        return MgShape::Null();
+    
+    if (im->reuseAt != im->shapes.end()) {
+        MgShape* sp = *im->reuseAt;
+        if (sp->getType() == type && !sp->isShared()) {
+            sp->addRef();
+            return sp;
+        }
+    }
+    for (I::iterator it = im->spares.begin(); it != im->spares.end(); ++it) {
+        MgShape* sp = *it;
+        if (sp->getType() == type && !sp->isShared()) {
+            const int sid = im->getNewID(sp->getID());          // 原ID已被其他图形使用时才换新ID
+            im->shapes.splice(im->reuseAt, im->spares, it);     // 连同结点移到重建位置
+            im->reuseAt = it;
+            sp->setParent(this, sid);
+            im->id2shape[sid] = it;
+            if (im->indexed)
+                im->reindex();
+            sp->addRef();
+            return sp;
+        }
+    }
+    return MgShape::Null();
+}
+
+void MgShapes::endReuse()
+{
+    if (!im->reusing)
+        return;
+    
+    im->reusing = false;
+    while (im->reuseAt != im->shapes.end()) {  // 移除本次未复用的图形，保留几个供以后复用
+        I::iterator it = im->reuseAt++;
+        MgShape* sp = *it;
+        im->detach(sp);
+        if (!sp->isShared() && im->spares.size() < (size_t)I::kMaxSpares) {
+            im->spares.splice(im->spares.end(), im->shapes, it);    // ID项仍指向该结点，复用时不必重建
+        } else {
+            im->id2shape.erase(sp->getID());
+            im->shapes.erase(it);
+            sp->release();
+        }
+    }
+    im->changed(0, I::kUnknown);
+}
+
+void MgShapes::trackChanges() const
+{
+    if (!im->changes) {
+        im->changes = new I::Changes();
+        im->changeOwner = true;
+    }
+}
+
+int MgShapes::getChangedIDs(const MgShapes* base, std::vector<int>& ids) const
+{
+    I::Changes* c = im->changes;
+    
+    ids.clear();
+    if (!c || !base || base->im->changes != c) {
+        return -1;
+    }
+    
+    GiSpinLock lock(&c->locker);
+    const int end = c->first + (int)c->items.size();
+    const int from = base->im->changeOwner ? end : base->im->changeSeq;
+    const int to = im->changeOwner ? end : im->changeSeq;
+    std::set<int> removed, used;
+    
+    if (from < c->first || from > to) {
+        return -1;
+    }
+    for (int i = from - c->first; i < to - c->first; i++) {
+        const I::Changes::Item& item = c->items[i];
+        
+        if (item.op == I::kUnknown
+            || (item.op == I::kAdded && removed.find(item.sid) != removed.end())) {
+            ids.clear();                // 移除后又加入的图形可能改变了次序
+            return -1;
+        }
+        if (item.op == I::kRemoved) {
+            removed.insert(item.sid);
+        }
+        if (used.insert(item.sid).second) {
+            ids.push_back(item.sid);
+        }
+    }
+    
+    return (int)ids.size();
+}
+
 bool MgShapes::removeShape(int sid)
 {
-    I::iterator it = im->findPositionOfID(sid);
+    return removeShapes(1, &sid) == 1;
+}
+
+int MgShapes::removeShapes(int n, const int* ids)
+{
+    int count = 0;
     
-    if (it != im->shapes.end()) {
-        MgShape* shape = *it;
-        im->shapes.erase(it);
-        im->id2shape.erase(shape->getID());
+    for (int i = 0; i < n; i++) {
+        I::ID2SHAPE::iterator p = ids[i] ? im->findID(ids[i]) : im->id2shape.end();
+        if (p == im->id2shape.end())
+            continue;
+        
+        MgShape* shape = *p->second;
+        im->erase(p->second);
+        im->id2shape.erase(p);
+        im->detach(shape);
         shape->release();
-        return true;
+        count++;
     }
     
-    return false;
+    return count;
+}
+
+void MgShapes::updateIndex(const MgShape* shape)
+{
+    if (!shape || im->findShape(shape->getID()) != shape) {
+        return;                     // 不在本列表中，例如尚未提交的复制品
+    }
+    if (im->indexed) {
+        double pos = im->posOf(shape);
+        im->detach(shape);
+        im->attach(const_cast<MgShape*>(shape), pos);
+    }
+    im->changed(shape->getID(), I::kChanged);
+    
+    const MgShape* owner = getParentShape(shape);   // 复合图形登记了子图形的图像句柄
+    if (owner && owner->getParent()) {
+        owner->getParent()->updateIndex(owner);
+    }
 }
 
 bool MgShapes::moveShapeTo(int sid, MgShapes* dest)
@@ -233,12 +727,22 @@ bool MgShapes::moveShapeTo(int sid, MgShapes* dest)
     I::iterator it = im->findPositionOfID(sid);
     
     if (dest && dest != this && it != im->shapes.end()) {
-        MgShape* newsp = (*it)->cloneShape();
-        newsp->setParent(dest, dest->im->getNewID(newsp->getID()));
-        dest->im->shapes.push_back(newsp);
-        dest->im->id2shape[newsp->getID()] = newsp;
+        MgShape* shape = *it;
         
-        return removeShape(sid);
+        if (shape->isShared()) {    // 其他文档副本还在引用，不能改其拥有者，只能移动复制品
+            MgShape* newsp = shape->cloneShape();
+            newsp->setParent(dest, dest->im->getNewID(newsp->getID()));
+            dest->im->pushBack(newsp);
+            
+            return removeShape(sid);
+        }
+        im->erase(it);              // 直接转移图形对象，不复制
+        im->id2shape.erase(sid);
+        im->detach(shape);
+        shape->setParent(dest, dest->im->getNewID(sid));
+        dest->im->pushBack(shape);
+        
+        return true;
     }
     
     return false;
@@ -250,20 +754,45 @@ void MgShapes::copyShapesTo(MgShapes* dest) const
         for (I::iterator it = im->shapes.begin(); it != im->shapes.end(); ++it) {
             MgShape* newsp = (*it)->cloneShape();
             newsp->setParent(dest, dest->im->getNewID(newsp->getID()));
-            dest->im->shapes.push_back(newsp);
-            dest->im->id2shape[newsp->getID()] = newsp;
+            dest->im->pushBack(newsp);
         }
     }
 }
 
+int MgShapes::moveShapesTo(MgShapes* dest)
+{
+    int n = 0;
+    
+    if (dest && dest != this) {
+        for (I::iterator it = im->shapes.begin(); it != im->shapes.end(); ++it, ++n) {
+            MgShape* sp = *it;
+            if (sp->isShared()) {   // 其他文档副本还在引用，不能改其拥有者，只能移动复制品
+                MgShape* newsp = sp->cloneShape();
+                sp->release();
+                sp = newsp;
+            }
+            sp->setParent(dest, dest->im->getNewID(sp->getID()));
+            dest->im->pushBack(sp);
+        }
+        im->shapes.clear();
+        im->id2shape.clear();
+        im->clearIndex();
+        im->reuseAt = im->shapes.end();
+        im->changed(0, I::kUnknown);
+    }
+    
+    return n;
+}
+
 bool MgShapes::bringToFront(int sid)
 {
     I::iterator it = im->findPositionOfID(sid);
     
     if (it != im->shapes.end()) {
         MgShape* shape = *it;
-        im->shapes.erase(it);
-        im->shapes.push_back(shape);
+        im->erase(it);
+        im->detach(shape);
+        im->insert(im->shapes.end(), shape);
         return true;
     }
     
@@ -276,8 +805,9 @@ bool MgShapes::bringToBack(int sid)
     
     if (it != im->shapes.end()) {
         MgShape* shape = *it;
-        im->shapes.erase(it);
-        im->shapes.push_front(shape);
+        im->erase(it);
+        im->detach(shape);
+        im->insert(im->shapes.begin(), shape);
         return true;
     }
     
@@ -290,9 +820,9 @@ bool MgShapes::bringToIndex(int sid, int index)
     
     if (it != im->shapes.end()) {
         MgShape* shape = *it;
-        im->shapes.erase(it);
-        it = im->findPositionOfIndex(index);
-        im->shapes.insert(it, shape);
+        im->erase(it);
+        im->detach(shape);
+        im->insert(im->findPositionOfIndex(index), shape);
         return true;
     }
     
@@ -301,18 +831,22 @@ bool MgShapes::bringToIndex(int sid, int index)
 
 bool MgShapes::reorderShapes(int n, const int *ids)
 {
-    I::Container shapes;
+    std::vector<I::iterator> order;
     std::set<int> newids;
     
     for (int i = 0; i < n; i++) {
-        const MgShape* sp = findShape(ids[i]);
-        if (sp) {
-            shapes.push_back((MgShape*)sp);
-            newids.insert(sp->getID());
+        I::iterator it = im->findPositionOfID(ids[i]);
+        if (it != im->shapes.end() && newids.insert(ids[i]).second) {
+            order.push_back(it);
         }
     }
-    if (!newids.empty() && newids.size() == im->shapes.size()) {
-        im->shapes = shapes;
+    if (!order.empty() && order.size() == im->shapes.size()) {
+        for (size_t i = 0; i < order.size(); i++) {     // 移动结点，各图形在列表中的位置仍有效
+            im->shapes.splice(im->shapes.end(), im->shapes, order[i]);
+        }
+        if (im->indexed)
+            im->reindex();
+        im->changed(0, I::kUnknown);
         return true;
     }
     return false;
@@ -326,7 +860,7 @@ int MgShapes::getShapeCount() const
 void MgShapes::freeIterator(void*& it) const
 {
     if (it) {
-        delete (I::citerator*)it;
+        im->freeIterator((I::citerator*)it);
         it = (void*)0;
     }
 }
@@ -337,7 +871,7 @@ const MgShape* MgShapes::getFirstShape(void*& it) const
         it = NULL;
         return MgShape::Null();
     }
-    it = (void*)(new I::citerator(im->shapes.begin()));
+    it = (void*)im->newIterator();
     return im->shapes.empty() ? MgShape::Null() : im->shapes.front();
 }
 
@@ -369,23 +903,35 @@ const MgShape* MgShapes::findShape(int sid) const
 
 const MgShape* MgShapes::findShapeByTag(int tag) const
 {
-    if (0 == tag) {
-        return MgShape::Null();
-    }
-    for (I::citerator it = im->shapes.begin(); it != im->shapes.end(); ++it) {
-        if ((*it)->getTag() == tag)
-            return *it;
+    im->buildIndex();
+    const I::Bucket* b = tag ? I::bucket(im->idx->byTag, tag) : NULL;
+    
+    if (b) {
+        for (I::Bucket::const_iterator it = b->begin(); it != b->end(); ++it) {
+            if (it->sp->getTag() == tag)    // 跳过加入后又原地改了标签的图形
+                return it->sp;
+        }
     }
     return MgShape::Null();
 }
 
 int MgShapes::getShapeCountByTypeOrTag(int type, int tag) const
 {
+    im->buildIndex();
+    const I::Bucket* types = type ? I::bucket(im->idx->byType, type) : NULL;
+    const I::Bucket* tags = tag ? I::bucket(im->idx->byTag, tag) : NULL;
     int n = 0;
-    for (I::citerator it = im->shapes.begin(); it != im->shapes.end(); ++it) {
-        if ((type != 0 && type == (*it)->shapec()->getType()) ||
-            (tag != 0 && tag == (*it)->getTag())) {
-            n++;
+    
+    if (types) {
+        for (I::Bucket::const_iterator it = types->begin(); it != types->end(); ++it) {
+            if (!it->nested && (!tag || it->sp->getTag() != tag))
+                n++;
+        }
+    }
+    if (tags) {
+        for (I::Bucket::const_iterator it = tags->begin(); it != tags->end(); ++it) {
+            if (it->sp->getTag() == tag)
+                n++;
         }
     }
     return n;
@@ -409,33 +955,88 @@ const MgShape* MgShapes::getShapeAtIndex(int index) const
 
 const MgShape* MgShapes::findShapeByType(int type) const
 {
-    if (0 == type) {
+    im->buildIndex();
+    const I::Bucket* b = type ? I::bucket(im->idx->byType, type) : NULL;
+    
+    if (b) {
+        for (I::Bucket::const_iterator it = b->begin(); it != b->end(); ++it) {
+            if (!it->nested)
+                return it->sp;
+        }
+    }
+    return MgShape::Null();
+}
+
+const MgShape* MgShapes::findShapeByTypeAndTag(int type, int tag) const
+{
+    im->buildIndex();
+    const I::Bucket* b = I::bucket(im->idx->byType, type);
+    const I::Bucket* tags = tag ? I::bucket(im->idx->byTag, tag) : b;
+    
+    if (!b || !tags) {
         return MgShape::Null();
     }
-    for (I::citerator it = im->shapes.begin(); it != im->shapes.end(); ++it) {
-        if ((*it)->shapec()->getType() == type)
-            return *it;
+    if (tags->size() < b->size()) {     // 在较少的一组中查找
+        b = tags;
+    }
+    for (I::Bucket::const_iterator it = b->begin(); it != b->end(); ++it) {
+        if (!it->nested && it->sp->shapec()->getType() == type && it->sp->getTag() == tag)
+            return it->sp;
     }
     return MgShape::Null();
 }
 
-const MgShape* MgShapes::findShapeByTypeAndTag(int type, int tag) const
+const MgShape* MgShapes::findShapeByImageHandle(int handle) const
 {
-    for (I::citerator it = im->shapes.begin(); it != im->shapes.end(); ++it) {
-        if ((*it)->shapec()->getType() == type && (*it)->getTag() == tag)
-            return *it;
+    im->buildIndex();
+    const I::Bucket* b = handle ? I::bucket(im->idx->byImage, handle) : NULL;
+    
+    if (b) {
+        for (I::Bucket::const_iterator it = b->begin(); it != b->end(); ++it) {
+            const MgBaseShape* shape = it->sp->shapec();
+            
+            if (it->nested) {
+                const MgComposite *composite = (const MgComposite *)shape;
+                const MgShape* sp = composite->shapes()->findShapeByImageHandle(handle);
+                if (sp)
+                    return sp;
+            } else if (((const MgImageShape*)shape)->getImageHandle() == handle) {
+                return it->sp;
+            }
+        }
     }
     return MgShape::Null();
 }
 
 int MgShapes::traverseByType(int type, void (*c)(const MgShape*, void*), void* d)
 {
+    std::vector<I::Entry> hits;
     int count = 0;
     
-    for (I::citerator it = im->shapes.begin(); it != im->shapes.end(); ++it) {
-        const MgBaseShape* shape = (*it)->shapec();
-        if (type == 0 || shape->isKindOf(type)) {
+    if (type == 0) {
+        for (I::citerator it = im->shapes.begin(); it != im->shapes.end(); ++it, ++count) {
             (*c)(*it, d);
+        }
+        return count;
+    }
+    
+    im->buildIndex();
+    
+    // 同一类型的图形的 isKindOf 结果相同，按各类型的样本筛选出匹配的图形和含有匹配图形的复合图形
+    for (I::KeyIndex::const_iterator it = im->idx->byType.begin(); it != im->idx->byType.end(); ++it) {
+        const MgBaseShape* sample = im->sampleOfType(it->first);
+        if (sample && sample->isKindOf(type)) {
+            hits.insert(hits.end(), it->second.begin(), it->second.end());
+        }
+    }
+    std::sort(hits.begin(), hits.end());
+    
+    for (size_t i = 0; i < hits.size(); i++) {
+        if (i > 0 && hits[i].sp == hits[i - 1].sp)
+            continue;
+        const MgBaseShape* shape = hits[i].sp->shapec();
+        if (shape->isKindOf(type)) {
+            (*c)(hits[i].sp, d);
             count++;
         } else if (shape->isKindOf(MgComposite::Type())) {
             const MgComposite *composite = (const MgComposite *)shape;
@@ -450,13 +1051,22 @@ const MgShape* MgShapes::getParentShape(const MgShape* shape)
 {
     const MgComposite *composite = (const MgComposite*)0;
     
-    if (shape && shape->getParent()
+    if (shape && shape->getParent() && shape->getParent()->getOwner()
         && shape->getParent()->getOwner()->isKindOf(MgComposite::Type())) {
         composite = (const MgComposite *)(shape->getParent()->getOwner());
     }
     return composite ? composite->getOwnerShape() : MgShape::Null();
 }
 
+GiStyleTable* MgShapes::getStyleTable() const
+{
+    if (im->owner && im->owner->isKindOf(MgComposite::Type())) {
+        const MgShape* sp = ((const MgComposite*)im->owner)->getOwnerShape();
+        return sp && sp->getParent() ? sp->getParent()->getStyleTable() : NULL;
+    }
+    return NULL;
+}
+
 static const float EXTENT_LIMIT = 1e5f - 1.f;
 
 Box2d MgShapes::getExtent() const
@@ -481,6 +1091,7 @@ static bool isVisibleAndLocked(const MgBaseShape* shape)
 const MgShape* MgShapes::hitTest(const Box2d& limits, MgHitResult& res,
                                  Filter filter, void* data) const
 {
+    MG_TRACE_SCOPE("MgShapes::hitTest");
     const MgShape* retshape = MgShape::Null();
     
     res.dist = limits.width() > 1e4f ? limits.width() : limits.width() * 20.f;
@@ -544,6 +1155,7 @@ int MgShapes::dyndraw(int mode, GiGraphics& gs, const GiContext *ctx,
 
 bool MgShapes::save(MgStorage* s, int startIndex) const
 {
+    MG_TRACE_SCOPE("MgShapes::save");
     bool ret = false;
     Box2d rect;
     int index = 0;
@@ -587,6 +1199,7 @@ bool MgShapes::saveShape(MgStorage* s, const MgShape* shape, int index) const
 
 int MgShapes::load(MgShapeFactory* factory, MgStorage* s, bool addOnly)
 {
+    MG_TRACE_SCOPE("MgShapes::load");
     Box2d rect;
     int index = 0, count = 0;
     bool ret = s && s->readNode("shapes", im->index, false);
@@ -597,9 +1210,13 @@ int MgShapes::load(MgShapeFactory* factory, MgStorage* s, bool addOnly)
         
         ret = loadExtra(s);
         s->readFloatArray("extent", &rect.xmin, 4, false);
-        int n = s->readInt("count", 0);
+        const int total = s->readInt("count", 0);
         
-        for (; ret && s->readNode("shape", index, false); n--) {
+        if (!addOnly && !im->progress) {
+            index = im->loadParallel(this, factory, s, total, count, ret);
+        }
+        for (; ret && !(im->progress && im->progress->isStopping())
+             && s->readNode("shape", index, false); ) {
             const int type = s->readInt("type", 0);
             const int sid = s->readInt("id", 0);
             s->readFloatArray("extent", &rect.xmin, 4, false);
@@ -617,12 +1234,14 @@ int MgShapes::load(MgShapeFactory* factory, MgStorage* s, bool addOnly)
                 if (ret) {
                     count++;
                     newsp->shape()->setFlag(kMgClosed, newsp->shape()->isClosed());
-                    im->id2shape[newsp->getID()] = newsp;
                     if (oldsp) {
                         updateShape(newsp);
                     }
                     else {
-                        im->shapes.push_back(newsp);
+                        im->pushBack(newsp);
+                    }
+                    if (im->progress) {
+                        im->progress->onShapeLoaded(this, count, total);
                     }
                 }
                 else {
@@ -643,17 +1262,269 @@ int MgShapes::load(MgShapeFactory* factory, MgStorage* s, bool addOnly)
     return ret ? count : (count > 0 ? -count : -1);
 }
 
+//! 并行解码图形的辅助类，各线程用各自的只读存取对象解码一段图形，结果按序号存放
+struct MgShapesDecoder {
+    enum { kMissing, kUnknown, kFailed, kLoaded };
+    struct Item {
+        MgShape*    shape;
+        int         type;
+        int         sid;
+        int         state;
+    };
+    
+    MgShapes*           owner;
+    MgShapeFactory*     factory;
+    MgStorage*          s;
+    std::vector<Item>   items;
+    
+    static void decode(int from, int to, void* data);
+};
+
+void MgShapesDecoder::decode(int from, int to, void* data)
+{
+    MgShapesDecoder* d = (MgShapesDecoder*)data;
+    MgStorage* s = d->s->cloneForRead();
+    Box2d rect;
+    
+    if (s) {
+        s->setStyleIndex(d->s->getStyleIndex());
+    }
+    
+    for (int i = from; i < to; i++) {
+        Item& item = d->items[i];
+        
+        item.shape = MgShape::Null();
+        item.state = kMissing;
+        if (!s || !s->readNode("shape", i, false)) {
+            continue;
+        }
+        item.type = s->readInt("type", 0);
+        item.sid = s->readInt("id", 0);
+        s->readFloatArray("extent", &rect.xmin, 4, false);
+        
+        item.shape = d->factory->createShape(item.type);
+        item.state = item.shape ? kFailed : kUnknown;
+        if (item.shape) {
+            item.shape->setParent(d->owner, item.sid);  // 在合并时再分配ID
+            item.shape->shape()->setExtent(rect);
+            if (item.shape->load(d->factory, s)) {
+                item.shape->shape()->setFlag(kMgClosed, item.shape->shape()->isClosed());
+                item.state = kLoaded;
+            }
+        }
+        s->readNode("shape", i, true);
+    }
+    delete s;
+}
+
+static volatile long _parallelLoading = 0;  // 避免组合图形等嵌套加载时再并行
+
+int MgShapes::I::loadParallel(MgShapes* owner, MgShapeFactory* factory, MgStorage* s,
+                              int total, int& count, bool& ret)
+{
+    enum { kMinCount = 200 };   // 图形较少时线程开销不值得
+    int index = 0;
+    
+    if (total < kMinCount || giGetCpuCount() < 2) {
+        return index;
+    }
+    if (giAtomicIncrement(&_parallelLoading) == 1) {
+        MgStorage* probe = s->cloneForRead();
+        
+        if (probe) {
+            delete probe;
+            
+            MgShapesDecoder d;
+            d.owner = owner;
+            d.factory = factory;
+            d.s = s;
+            d.items.resize(total);
+            giParallelFor(total, kMinCount, MgShapesDecoder::decode, &d);
+            
+            // 按文件中的顺序合并，分配ID和显示次序的结果与逐个加载时相同
+            for (; ret && index < total; index++) {
+                MgShapesDecoder::Item& item = d.items[index];
+                
+                if (item.state == MgShapesDecoder::kMissing) {
+                    break;
+                }
+                if (item.state == MgShapesDecoder::kUnknown) {
+                    LOGE("Ignore unknown shape type %d, id=%d", item.type, item.sid);
+                }
+                else if (item.state == MgShapesDecoder::kFailed) {
+                    item.shape->release();
+                    item.shape = MgShape::Null();
+                    LOGE("Fail to load shape (id=%d, type=%d)", item.sid, item.type);
+                    ret = false;
+                }
+                else {
+                    count++;
+                    item.shape->setParent(owner, getNewID(item.sid));
+                    pushBack(item.shape);
+                    item.shape = MgShape::Null();
+                }
+            }
+            for (int i = index; i < total; i++) {
+                if (d.items[i].shape) {
+                    d.items[i].shape->release();
+                }
+            }
+        }
+    }
+    giAtomicDecrement(&_parallelLoading);
+    
+    return index;
+}
+
 void MgShapes::setNewShapeID(int sid)
 {
     im->newShapeID = sid;
 }
 
+void MgShapes::setLoadProgress(MgLoadProgress* p)
+{
+    im->progress = p;
+}
+
 MgShape* MgShapes::I::findShape(int sid) const
 {
     if (0 == sid || -1 == sid)
         return MgShape::Null();
     ID2SHAPE::const_iterator it = id2shape.find(sid);
-    return it != id2shape.end() ? it->second : MgShape::Null();
+    return it != id2shape.end() && !isSpare(it->second) ? *it->second : MgShape::Null();
+}
+
+void MgShapes::I::insert(iterator it, MgShape* sp)
+{
+    double pos = 0;
+    bool valid = true;
+    
+    if (!indexed || shapes.empty()) {
+    } else if (it == shapes.end()) {
+        pos = posOf(shapes.back()) + 1;
+    } else if (it == shapes.begin()) {
+        pos = posOf(shapes.front()) - 1;
+    } else {
+        iterator prev = it;
+        double a = posOf(*(--prev)), b = posOf(*it);
+        pos = (a + b) / 2;
+        valid = (a < pos && pos < b);       // 多次插入同一处后精度不够则重新编号
+    }
+    
+    id2shape[sp->getID()] = shapes.insert(it, sp);
+    if (indexed) {
+        if (valid) {
+            attach(sp, pos);
+        } else {
+            reindex();
+        }
+    }
+    changed(sp->getID(), it == shapes.end() ? kAdded : kUnknown);
+}
+
+void MgShapes::I::attach(MgShape* sp, double pos)
+{
+    Index* x = writable();
+    std::pair<RECORDS::iterator, bool> ret = x->records.insert(std::make_pair(sp, Record()));
+    if (!ret.second) {          // 同一图形已在列表中(浅拷贝合并)
+        return;
+    }
+    
+    Record& r = ret.first->second;
+    const MgBaseShape* shape = sp->shapec();
+    
+    r.pos = pos;
+    r.type = shape->getType();
+    r.tag = sp->getTag();
+    r.image = shape->isKindOf(MgImageShape::Type()) ? ((const MgImageShape*)shape)->getImageHandle() : 0;
+    
+    addEntry(x->byType, r.type, Entry(pos, sp));
+    if (r.tag) {
+        addEntry(x->byTag, r.tag, Entry(pos, sp));
+    }
+    if (r.image) {
+        addEntry(x->byImage, r.image, Entry(pos, sp));
+    }
+    
+    // 复合图形按其子图形列表的索引登记递归包含的类型和图像，子图形列表在加入前已生成
+    if (shape->isKindOf(MgComposite::Type())) {
+        I* child = ((const MgComposite*)shape)->shapes()->im;
+        
+        child->buildIndex();
+        for (KeyIndex::const_iterator it = child->idx->byType.begin(); it != child->idx->byType.end(); ++it) {
+            if (it->first != r.type) {
+                r.nestedTypes.push_back(it->first);
+                addEntry(x->byType, it->first, Entry(pos, sp, true));
+            }
+        }
+        for (KeyIndex::const_iterator it = child->idx->byImage.begin(); it != child->idx->byImage.end(); ++it) {
+            r.nestedImages.push_back(it->first);
+            addEntry(x->byImage, it->first, Entry(pos, sp, true));
+        }
+    }
+}
+
+void MgShapes::I::detach(const MgShape* sp)
+{
+    if (idx->records.find(sp) == idx->records.end()) {
+        return;
+    }
+    
+    Index* x = writable();
+    RECORDS::iterator it = x->records.find(sp);
+    const Record& r = it->second;
+    
+    removeEntry(x->byType, r.type, r.pos);
+    if (r.tag) {
+        removeEntry(x->byTag, r.tag, r.pos);
+    }
+    if (r.image) {
+        removeEntry(x->byImage, r.image, r.pos);
+    }
+    for (size_t i = 0; i < r.nestedTypes.size(); i++) {
+        removeEntry(x->byType, r.nestedTypes[i], r.pos);
+    }
+    for (size_t i = 0; i < r.nestedImages.size(); i++) {
+        removeEntry(x->byImage, r.nestedImages[i], r.pos);
+    }
+    x->records.erase(it);
+}
+
+void MgShapes::I::reindex()
+{
+    double pos = 0;
+    
+    clearIndex();
+    for (iterator it = shapes.begin(); it != shapes.end(); ++it, pos += 1) {
+        attach(*it, pos);
+    }
+}
+
+void MgShapes::I::buildIndex()
+{
+    if (!giAtomicLoad(&indexed)) {
+        GiSpinLock lock(&indexLocker);
+        if (!giAtomicLoad(&indexed)) {
+            reindex();
+            giAtomicCompareAndSwap(&indexed, 1, 0);     // 建好后才发布，其他线程可无锁查找
+        }
+    }
+}
+
+const MgBaseShape* MgShapes::I::sampleOfType(int type) const
+{
+    const Bucket* b = bucket(idx->byType, type);
+    const MgComposite* composite = NULL;
+    
+    if (b) {
+        for (Bucket::const_iterator it = b->begin(); it != b->end(); ++it) {
+            if (!it->nested)
+                return it->sp->shapec();
+            if (!composite)
+                composite = (const MgComposite*)it->sp->shapec();
+        }
+    }
+    return composite ? composite->shapes()->im->sampleOfType(type) : NULL;
 }
 
 int MgShapes::I::getNewID(int sid)
@@ -0,0 +1,420 @@
+//! \file mgdocjournal.cpp
+//! \brief 实现增量自动保存的日志类 MgDocJournal
+// Copyright (c) 2004-2015, https://github.com/rhcad/vgcore, BSD License
+
+#include "mgdocjournal.h"
+#include "mgdocpatch.h"
+#include "mgshapedoc.h"
+#include "mgjsonstorage.h"
+#include "mgstorage.h"
+#include "githread.h"
+#include "mglog.h"
+#include <sys/stat.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#if defined(__WINDOWS__) || defined(WIN32)
+#include <io.h>
+#endif
+
+//! 日志记录的头部，其后为 MgDocPatch 补丁数据
+struct MgJournalRecord {
+    char        magic[4];   //!< "VGJR"
+    int         seq;        //!< 记录序号，从1开始递增
+    int         size;       //!< 补丁的字节数
+    unsigned    checksum;   //!< 补丁的校验和
+};
+
+// FNV-1a 校验和，用于发现写入中断的记录
+static unsigned checksum(const unsigned char* data, size_t size)
+{
+    unsigned h = 2166136261u;
+
+    for (size_t i = 0; i < size; i++) {
+        h = (h ^ data[i]) * 16777619u;
+    }
+    return h;
+}
+
+// 等待写入的数据落盘，使追加的记录或替换的文件在断电后仍完整
+static bool syncFile(FILE* fp)
+{
+    if (fflush(fp) != 0)
+        return false;
+#if defined(__WINDOWS__) || defined(WIN32)
+    return _commit(_fileno(fp)) == 0;
+#else
+    return fsync(fileno(fp)) == 0;
+#endif
+}
+
+// 用写好的临时文件替换目标文件，替换前后目标文件都是完整的
+static bool replaceFile(const std::string& tmpfile, const std::string& filename)
+{
+#if defined(__WINDOWS__) || defined(WIN32)
+    return !!MoveFileExA(tmpfile.c_str(), filename.c_str(),
+                         MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+    return rename(tmpfile.c_str(), filename.c_str()) == 0;
+#endif
+}
+
+static long long fileSize(const char* filename)
+{
+    struct stat st;
+    return stat(filename, &st) == 0 ? (long long)st.st_size : -1;
+}
+
+struct MgDocJournal::Impl {
+    enum { kMinCompactSize = 64 * 1024 };
+    enum { kIdle, kCompacting, kCompacted, kCompactFailed };
+
+    std::string     vgfile;
+    std::string     logfile;
+    bool            opened;
+    MgShapeDoc*     last;           // 上次保存的快照，为NULL时下次保存写出完整的基础文件
+    int             seq;            // 最后写入的记录序号
+    long long       baseSize;
+    long long       logSize;
+    float           ratio;
+
+    GiThread        thread;         // 后台重写基础文件
+    volatile long   state;
+    MgShapeDoc*     compactDoc;     // 正在写到基础文件的快照
+    int             compactSeq;     // 该快照包含的最后记录序号
+    long long       compactOffset;  // 该快照对应的日志末尾位置
+    long long       compactSize;    // 新基础文件的字节数
+
+    Impl() : opened(false), last(NULL), seq(0), baseSize(0), logSize(0), ratio(1.f)
+        , state(kIdle), compactDoc(NULL), compactSeq(0), compactOffset(0), compactSize(0) {}
+
+    void setLast(const MgShapeDoc* doc) {
+        if (doc) {
+            const_cast<MgShapeDoc*>(doc)->addRef();
+        }
+        if (last) {
+            last->release();
+        }
+        last = const_cast<MgShapeDoc*>(doc);
+    }
+
+    static long long writeBase(const std::string& filename, const MgShapeDoc* doc, int seq);
+    static void compactProc(void* param);
+    bool replay(MgShapeDoc* doc, MgShapeFactory* factory);
+    bool appendRecord(const std::vector<unsigned char>& patch);
+    bool keepLogRange(long long from, long long to);
+    void startCompact(const MgShapeDoc* doc);
+    void finishCompact(bool wait);
+};
+
+MgDocJournal::MgDocJournal() : im(new Impl())
+{
+}
+
+MgDocJournal::~MgDocJournal()
+{
+    close();
+    delete im;
+}
+
+bool MgDocJournal::isOpened() const
+{
+    return im->opened;
+}
+
+long long MgDocJournal::getLogSize() const
+{
+    return im->logSize;
+}
+
+long long MgDocJournal::getBaseSize() const
+{
+    return im->baseSize;
+}
+
+void MgDocJournal::setCompactRatio(float ratio)
+{
+    im->ratio = mgMax(ratio, 0.f);
+}
+
+bool MgDocJournal::open(const char* vgfile, MgShapeDoc* doc, MgShapeFactory* factory,
+                        GiTransform* xform)
+{
+    close();
+    if (!vgfile || !*vgfile || !doc) {
+        return false;
+    }
+
+    im->vgfile = vgfile;
+    im->logfile = im->vgfile + ".log";
+
+    FILE* fp = mgopenfile(vgfile, "rt");
+
+    if (fp) {
+        MgJsonStorage js;
+        MgStorage* s = js.storageForRead(fp);
+        bool ret = s->readNode("", -1, false);     // 根节点出栈后不能再读取
+
+        im->seq = s->readInt("journalSeq", -1);
+        ret = ret && doc->loadAll(factory, s, xform);
+        s->readNode("", -1, true);
+        fclose(fp);
+        if (!ret) {
+            LOGE("Fail to load file: %s", vgfile);
+            return false;
+        }
+        im->baseSize = fileSize(vgfile);
+        if (im->seq >= 0) {
+            if (im->replay(doc, factory)) {
+                im->last = doc->shallowCopy();
+            }
+        } else {
+            im->seq = 0;                // 不是由本类写出的文件，首次保存时写出完整文件并去掉日志
+        }
+    }
+    im->opened = true;
+    LOGD("MgDocJournal: %s, seq=%d, log %d bytes", vgfile, im->seq, (int)im->logSize);
+
+    return true;
+}
+
+void MgDocJournal::close(bool compact)
+{
+    im->finishCompact(true);
+    if (compact && im->opened && im->last && im->logSize > 0
+        && Impl::writeBase(im->vgfile, im->last, im->seq) >= 0) {
+        remove(im->logfile.c_str());
+    }
+    im->setLast(NULL);
+    im->opened = false;
+    im->seq = 0;
+    im->baseSize = 0;
+    im->logSize = 0;
+}
+
+int MgDocJournal::save(const MgShapeDoc* doc)
+{
+    if (!im->opened || !doc) {
+        return -1;
+    }
+    im->finishCompact(false);
+
+    if (!im->last) {                        // 首次保存或上次追加失败，写出完整的基础文件
+        im->finishCompact(true);
+
+        long long size = Impl::writeBase(im->vgfile, doc, im->seq);
+
+        if (size < 0) {
+            LOGE("Fail to save file: %s", im->vgfile.c_str());
+            return -1;
+        }
+        remove(im->logfile.c_str());        // 其中的记录都已包含在基础文件中
+        im->baseSize = size;
+        im->logSize = 0;
+        im->setLast(doc);
+        return doc->getShapeCount();
+    }
+
+    std::vector<unsigned char> patch;
+    int n = MgDocPatch::make(im->last, doc, patch);
+
+    if (n > 0 && !im->appendRecord(patch)) {
+        LOGE("Fail to append to %s", im->logfile.c_str());
+        im->setLast(NULL);
+        return -1;
+    }
+    im->setLast(doc);
+
+    if (n > 0 && im->logSize > Impl::kMinCompactSize
+        && (float)im->logSize > (float)im->baseSize * im->ratio) {
+        im->startCompact(doc);
+    }
+
+    return n;
+}
+
+long long MgDocJournal::Impl::writeBase(const std::string& filename, const MgShapeDoc* doc, int seq)
+{
+    std::string tmpfile(filename + ".tmp");
+    MgJsonStorage js;
+    MgStorage* s = js.storageForWrite();
+    bool ret = s->writeNode("", -1, false) && doc->save(s, 0);
+
+    if (ret) {
+        s->writeInt("journalSeq", seq);     // 已包含的最后记录序号，与文档节点并列
+        s->writeNode("", -1, true);
+
+        FILE* fp = mgopenfile(tmpfile.c_str(), "wt");
+
+        ret = fp && js.save(fp);
+        if (fp) {
+            ret = syncFile(fp) && ret;
+            fclose(fp);
+        }
+        ret = ret && replaceFile(tmpfile, filename);
+        if (!ret) {
+            remove(tmpfile.c_str());
+        }
+    }
+
+    return ret ? fileSize(filename.c_str()) : -1;
+}
+
+// 应用序号较新的记录，日志中的记录都有效或已去掉无效记录时返回true
+bool MgDocJournal::Impl::replay(MgShapeDoc* doc, MgShapeFactory* factory)
+{
+    FILE* fp = mgopenfile(logfile.c_str(), "rb");
+    std::vector<unsigned char> buf;
+
+    if (fp) {
+        unsigned char tmp[4096];
+        size_t n;
+
+        while ((n = fread(tmp, 1, sizeof(tmp), fp)) > 0) {
+            buf.insert(buf.end(), tmp, tmp + n);
+        }
+        fclose(fp);
+    }
+
+    const long long total = (long long)buf.size();
+    long long pos = 0, head = 0;
+    int count = 0;
+
+    while (total - pos >= (long long)sizeof(MgJournalRecord)) {
+        MgJournalRecord r;
+        memcpy(&r, &buf[(size_t)pos], sizeof(r));
+
+        const unsigned char* data = &buf[(size_t)pos] + sizeof(r);
+        if (memcmp(r.magic, "VGJR", 4) != 0 || r.size <= 0
+            || r.size > total - pos - (long long)sizeof(r)
+            || checksum(data, r.size) != r.checksum) {
+            break;                          // 写入中断的记录
+        }
+        if (r.seq <= seq) {                 // 已包含在基础文件中
+            pos += sizeof(r) + r.size;
+            head = pos;
+            continue;
+        }
+        if (r.seq != seq + 1 || !MgDocPatch::apply(doc, factory, data, r.size)) {
+            LOGE("Stop replaying %s at record %d", logfile.c_str(), r.seq);
+            break;
+        }
+        seq = r.seq;
+        pos += sizeof(r) + r.size;
+        count++;
+    }
+
+    LOGD("Replay %d records (%d bytes) from %s", count, (int)(pos - head), logfile.c_str());
+    logSize = total;
+
+    // 去掉已包含的和无效的记录，使后续记录紧接有效记录
+    return (head == 0 && pos == total) || keepLogRange(head, pos);
+}
+
+bool MgDocJournal::Impl::appendRecord(const std::vector<unsigned char>& patch)
+{
+    MgJournalRecord r;
+
+    memcpy(r.magic, "VGJR", 4);
+    r.seq = seq + 1;
+    r.size = (int)patch.size();
+    r.checksum = checksum(&patch.front(), patch.size());
+
+    FILE* fp = mgopenfile(logfile.c_str(), "ab");
+    bool ret = fp && fwrite(&r, sizeof(r), 1, fp) == 1
+        && fwrite(&patch.front(), 1, patch.size(), fp) == patch.size()
+        && syncFile(fp);
+
+    if (fp) {
+        fclose(fp);
+    }
+    if (ret) {
+        seq = r.seq;
+        logSize += sizeof(r) + patch.size();
+    }
+
+    return ret;
+}
+
+// 只保留日志中 [from, to) 范围的记录，通过临时文件替换
+bool MgDocJournal::Impl::keepLogRange(long long from, long long to)
+{
+    FILE* fp = mgopenfile(logfile.c_str(), "rb");
+    std::string tmpfile(logfile + ".tmp");
+    FILE* out = fp ? mgopenfile(tmpfile.c_str(), "wb") : NULL;
+    bool ret = out && mgseekfile(fp, from) == 0;
+
+    if (ret) {
+        unsigned char buf[4096];
+        long long left = to - from;
+
+        while (ret && left > 0) {
+            size_t n = fread(buf, 1, (size_t)mgMin(left, (long long)sizeof(buf)), fp);
+            ret = n > 0 && fwrite(buf, 1, n, out) == n;
+            left -= n;
+        }
+        ret = syncFile(out) && ret;
+    }
+    if (fp) {
+        fclose(fp);
+    }
+    if (out) {
+        fclose(out);
+        ret = ret && replaceFile(tmpfile, logfile);
+        if (!ret) {
+            remove(tmpfile.c_str());
+        }
+    }
+    if (ret) {
+        logSize = to - from;
+    }
+
+    return ret;
+}
+
+void MgDocJournal::Impl::startCompact(const MgShapeDoc* doc)
+{
+    if (state != kIdle) {
+        return;
+    }
+    const_cast<MgShapeDoc*>(doc)->addRef();
+    compactDoc = const_cast<MgShapeDoc*>(doc);
+    compactSeq = seq;
+    compactOffset = logSize;
+    state = kCompacting;
+
+    if (!thread.start(compactProc, this)) {
+        state = kIdle;
+        compactDoc->release();
+        compactDoc = NULL;
+    }
+}
+
+void MgDocJournal::Impl::compactProc(void* param)
+{
+    Impl* im = (Impl*)param;
+
+    im->compactSize = writeBase(im->vgfile, im->compactDoc, im->compactSeq);
+    giAtomicCompareAndSwap(&im->state, im->compactSize >= 0 ? kCompacted : kCompactFailed,
+                           kCompacting);
+}
+
+void MgDocJournal::Impl::finishCompact(bool wait)
+{
+    long st = giAtomicLoad(&state);
+
+    if (st == kIdle || (st == kCompacting && !wait)) {
+        return;
+    }
+    thread.join();
+
+    if (state == kCompacted) {
+        LOGD("Compacted %s to %d bytes at record %d", vgfile.c_str(), (int)compactSize, compactSeq);
+        baseSize = compactSize;
+        keepLogRange(compactOffset, logSize);   // 失败时保留，恢复时按序号跳过
+    }
+    compactDoc->release();
+    compactDoc = NULL;
+    state = kIdle;
+}
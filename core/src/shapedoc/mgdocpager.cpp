@@ -0,0 +1,655 @@
+//! \file mgdocpager.cpp
+//! \brief 实现按显示范围分页加载图形的类 MgDocPager
+// Copyright (c) 2004-2015, https://github.com/rhcad/vgcore, BSD License
+
+#include "mgdocpager.h"
+#include "mgshapedoc.h"
+#include "mglayer.h"
+#include "mgspfactory.h"
+#include "mgjsonstorage.h"
+#include "mgstorage.h"
+#include "mglog.h"
+#include "gistyletable.h"
+#include <sys/stat.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+//! 空间索引文件中的图形记录
+struct MgPagerEntry {
+    long long   offset;     //!< 图形JSON对象在文件中的字节位置
+    int         length;     //!< 图形JSON对象的字节数
+    int         id;         //!< 图形ID
+    int         type;       //!< 图形类型
+    int         layer;      //!< 图层序号
+    float       box[4];     //!< 模型坐标包络框
+};
+
+//! 空间索引文件的头部
+struct MgPagerHeader {
+    char        magic[4];   //!< "VGPI"
+    int         version;    //!< kVersion
+    long long   fileSize;   //!< 图形文件的字节数，用于判断索引是否过期
+    long long   fileTime;   //!< 图形文件的修改时间
+    int         count;      //!< 图形记录数
+    int         skeletonLen;    //!< 去掉图形后的文档JSON的字节数
+    float       extent[4];  //!< 所有图形的范围
+};
+
+struct MgDocPager::Impl {
+    enum { kVersion = 1, kMaxCellsPerShape = 16 };
+
+    FILE*                       fp;
+    std::string                 skeleton;   // 去掉所有图形的文档JSON，用于加载文档属性和图层
+    GiStyleIndex                styles;     // 骨架中的绘图参数表，图形按序号引用
+    std::vector<MgPagerEntry>   entries;    // 按文件中的顺序
+    Box2d                       extent;
+
+    int                         nx, ny;     // 均匀网格索引
+    float                       cellw, cellh;
+    std::vector<std::vector<int> >  cells;
+    std::vector<int>            bigs;       // 跨越很多网格的大图形
+    std::vector<int>            marks;      // 查询标记，避免重复
+    int                         query;
+
+    std::vector<int>            sids;       // 各记录加载后在图层中的ID，0表示未加载
+    std::vector<int>            loaded;     // 已加载的记录序号
+    Box2d                       lastRect;   // 上次 update() 的窗口
+    Box2d                       covered;    // 其中的图形都已加载的范围
+    float                       margin;
+    int                         maxShapes;
+    std::vector<char>           buf;
+    MgJsonStorage               js;
+
+    Impl() : fp(NULL), nx(0), ny(0), cellw(0), cellh(0), query(0), margin(0.5f), maxShapes(0) {}
+
+    static bool overlap(const float* a, const Box2d& b) {
+        return a[0] <= b.xmax && a[2] >= b.xmin && a[1] <= b.ymax && a[3] >= b.ymin;
+    }
+    static bool hasID(const int* ids, int count, int sid) {
+        for (int i = 0; ids && i < count; i++) {
+            if (ids[i] == sid)
+                return true;
+        }
+        return false;
+    }
+
+    bool scan(FILE* f);
+    bool readIndex(const char* filename, long long size, long long mtime);
+    void writeIndex(const char* filename, long long size, long long mtime);
+    void buildGrid();
+    void loadStyles();
+    void cellRange(const float* box, int& x1, int& y1, int& x2, int& y2) const;
+    int find(const Box2d& rect, std::vector<int>& result);
+    MgShape* loadShape(const MgPagerEntry& e, MgShapeFactory* factory);
+};
+
+MgDocPager::MgDocPager() : im(new Impl())
+{
+}
+
+MgDocPager::~MgDocPager()
+{
+    close();
+    delete im;
+}
+
+bool MgDocPager::isOpened() const
+{
+    return !!im->fp;
+}
+
+int MgDocPager::getShapeCount() const
+{
+    return (int)im->entries.size();
+}
+
+int MgDocPager::getLoadedCount() const
+{
+    return (int)im->loaded.size();
+}
+
+Box2d MgDocPager::getExtent() const
+{
+    return im->extent;
+}
+
+void MgDocPager::setLimits(float margin, int maxShapes)
+{
+    im->margin = mgMax(margin, 0.f);
+    im->maxShapes = mgMax(maxShapes, 0);
+}
+
+void MgDocPager::close()
+{
+    if (im->fp) {
+        fclose(im->fp);
+        im->fp = NULL;
+    }
+    im->skeleton.clear();
+    im->styles.clear();
+    im->entries.clear();
+    im->cells.clear();
+    im->bigs.clear();
+    im->marks.clear();
+    im->sids.clear();
+    im->loaded.clear();
+    im->extent.empty();
+    im->lastRect.empty();
+    im->covered.empty();
+}
+
+bool MgDocPager::open(const char* vgfile, bool useIndexFile)
+{
+    close();
+
+    struct stat st;
+    if (!vgfile || stat(vgfile, &st) != 0) {
+        LOGE("Fail to open file: %s", vgfile ? vgfile : "");
+        return false;
+    }
+    im->fp = mgopenfile(vgfile, "rb");      // 二进制方式，使字节位置与文件一致
+    if (!im->fp) {
+        LOGE("Fail to open file: %s", vgfile);
+        return false;
+    }
+
+    std::string idxfile(std::string(vgfile) + ".idx");
+    const long long size = st.st_size, mtime = st.st_mtime;
+
+    if (!useIndexFile || !im->readIndex(idxfile.c_str(), size, mtime)) {
+        if (!im->scan(im->fp)) {
+            LOGE("Fail to index file: %s", vgfile);
+            close();
+            return false;
+        }
+        if (useIndexFile) {
+            im->writeIndex(idxfile.c_str(), size, mtime);
+        }
+    }
+    im->buildGrid();
+    im->loadStyles();
+    im->sids.assign(im->entries.size(), 0);
+    im->marks.assign(im->entries.size(), 0);
+    LOGD("MgDocPager: %d shapes in %s", (int)im->entries.size(), vgfile);
+
+    return true;
+}
+
+// 逐字节扫描JSON文本，记录图形对象的位置，并生成去掉这些对象的文档JSON
+// 支持对象方式(shapedoc/shapesN/shapeM)和数组方式(shapedoc 为图层数组，图层为图形数组)
+bool MgDocPager::Impl::scan(FILE* f)
+{
+    enum { kOther, kRoot, kDoc, kLayer, kShape };
+    std::vector<int> kinds;             // 各层JSON对象或数组的种类
+    std::vector<bool> arrays;           // 各层是否为数组
+    int docItems = 0;                   // 数组方式的 shapedoc 中已有的图层数
+    std::string key, str, span;
+    bool inString = false, escape = false, dropComma = false;
+    size_t keyPos = 0;                  // 当前键名在 skeleton 中的位置
+    long long pos = 0, start = 0;
+    int layer = -1;
+    float ext[4] = { _FLT_MAX, _FLT_MAX, -_FLT_MAX, -_FLT_MAX };
+    char chunk[16384];
+    size_t n;
+
+    skeleton.clear();
+    entries.clear();
+    fseek(f, 0, SEEK_SET);
+    if (fread(chunk, 1, 3, f) == 3 && memcmp(chunk, "\xEF\xBB\xBF", 3) == 0) {
+        pos = 3;                        // 跳过 UTF-8 BOM
+    } else {
+        fseek(f, 0, SEEK_SET);
+    }
+
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+        for (size_t i = 0; i < n; i++, pos++) {
+            const char c = chunk[i];
+            const bool inShape = !kinds.empty() && kinds.back() >= kShape;
+
+            if (inShape) {
+                span += c;
+            }
+            if (inString) {
+                if (escape) {
+                    escape = false;
+                } else if (c == '\\') {
+                    escape = true;
+                } else if (c == '"') {
+                    inString = false;
+                }
+                if (!inShape) {
+                    if (inString || escape) {
+                        str += c;
+                    }
+                    skeleton += c;
+                }
+                continue;
+            }
+
+            switch (c) {
+                case '"':
+                    inString = true;
+                    if (!inShape) {
+                        str.clear();
+                        keyPos = skeleton.size();
+                    }
+                    break;
+                case ':':
+                    if (!inShape) {
+                        key = str;
+                    }
+                    break;
+                case '{':
+                case '[': {
+                    int kind = kOther;
+                    const int parent = kinds.empty() ? -1 : kinds.back();
+                    const bool inArray = !arrays.empty() && arrays.back();  // 数组元素没有键名
+
+                    if (parent < 0) {
+                        kind = c == '{' ? kRoot : kOther;
+                    } else if (parent == kRoot && key == "shapedoc") {
+                        kind = kDoc;
+                        docItems = 0;
+                    } else if (parent == kDoc && inArray) {
+                        kind = kLayer;
+                        layer = docItems++;
+                    } else if (parent == kDoc && c == '{' && key.compare(0, 6, "shapes") == 0
+                               && key.size() > 6 && isdigit(key[6])) {
+                        kind = kLayer;
+                        layer = atoi(key.c_str() + 6) - 1;
+                    } else if (parent == kLayer && c == '{' && (inArray
+                               || (key.compare(0, 5, "shape") == 0 && key.size() > 5 && isdigit(key[5])))) {
+                        kind = kShape;
+                    }
+                    if (inShape) {
+                        kind = kShape + 1;
+                    } else if (kind == kShape) {
+                        start = pos;
+                        span = c;
+                        skeleton.resize(inArray ? skeleton.size() : keyPos);    // 去掉键名和冒号，及其前面的逗号
+                        while (!skeleton.empty() && isspace((unsigned char)skeleton[skeleton.size() - 1]))
+                            skeleton.resize(skeleton.size() - 1);
+                        if (!skeleton.empty() && skeleton[skeleton.size() - 1] == ',')
+                            skeleton.resize(skeleton.size() - 1);
+                        else
+                            dropComma = true;       // 是第一个成员，则去掉其后的逗号
+                    }
+                    kinds.push_back(kind);
+                    arrays.push_back(c == '[');
+                    break;
+                }
+                case '}':
+                case ']':
+                    if (kinds.empty()) {
+                        return false;
+                    }
+                    if (kinds.back() == kShape) {
+                        MgPagerEntry e;
+                        MgStorage* s = js.storageForRead(span.c_str());
+
+                        e.offset = start;
+                        e.length = (int)span.size();
+                        e.layer = layer;
+                        if (!s->readNode("", -1, false)) {
+                            return false;
+                        }
+                        e.id = s->readInt("id", 0);
+                        e.type = s->readInt("type", 0);
+                        if (s->readFloatArray("extent", e.box, 4, false) == 4) {
+                            for (int k = 0; k < 2; k++) {
+                                ext[k] = mgMin(ext[k], e.box[k]);
+                                ext[k + 2] = mgMax(ext[k + 2], e.box[k + 2]);
+                            }
+                        } else {                // 没有包络框的图形总是加载
+                            e.box[0] = e.box[1] = -_FLT_MAX;
+                            e.box[2] = e.box[3] = _FLT_MAX;
+                        }
+                        s->readNode("", -1, true);
+                        entries.push_back(e);
+                        span.clear();
+                        kinds.pop_back();
+                        arrays.pop_back();
+                        continue;               // 已去掉该成员
+                    }
+                    kinds.pop_back();
+                    arrays.pop_back();
+                    break;
+                case ',':
+                    if (dropComma && !inShape) {
+                        dropComma = false;
+                        continue;
+                    }
+                    break;
+                default:
+                    break;
+            }
+            if (!inShape && !(kinds.size() > 0 && kinds.back() == kShape)) {
+                if (!isspace((unsigned char)c) && c != ',') {
+                    dropComma = false;
+                }
+                skeleton += c;
+            }
+        }
+    }
+
+    extent.set(ext[0], ext[1], ext[2], ext[3]);
+    if (ext[0] > ext[2]) {
+        extent.empty();
+    }
+
+    return kinds.empty() && !skeleton.empty();
+}
+
+bool MgDocPager::Impl::readIndex(const char* filename, long long size, long long mtime)
+{
+    FILE* f = mgopenfile(filename, "rb");
+    MgPagerHeader h;
+    bool ret = f && fread(&h, sizeof(h), 1, f) == 1
+        && memcmp(h.magic, "VGPI", 4) == 0 && h.version == kVersion
+        && h.fileSize == size && h.fileTime == mtime
+        && h.count >= 0 && h.skeletonLen > 0;
+
+    if (ret) {
+        skeleton.resize(h.skeletonLen);
+        entries.resize(h.count);
+        ret = fread(&skeleton[0], 1, h.skeletonLen, f) == (size_t)h.skeletonLen
+            && (h.count == 0 || fread(&entries[0], sizeof(MgPagerEntry), h.count, f) == (size_t)h.count);
+        extent.set(h.extent[0], h.extent[1], h.extent[2], h.extent[3]);
+    }
+    if (f) {
+        fclose(f);
+    }
+    if (!ret) {
+        skeleton.clear();
+        entries.clear();
+    }
+
+    return ret;
+}
+
+void MgDocPager::Impl::writeIndex(const char* filename, long long size, long long mtime)
+{
+    FILE* f = mgopenfile(filename, "wb");
+    MgPagerHeader h;
+
+    if (f) {
+        memcpy(h.magic, "VGPI", 4);
+        h.version = kVersion;
+        h.fileSize = size;
+        h.fileTime = mtime;
+        h.count = (int)entries.size();
+        h.skeletonLen = (int)skeleton.size();
+        h.extent[0] = extent.xmin;
+        h.extent[1] = extent.ymin;
+        h.extent[2] = extent.xmax;
+        h.extent[3] = extent.ymax;
+
+        bool ret = fwrite(&h, sizeof(h), 1, f) == 1
+            && fwrite(skeleton.c_str(), 1, skeleton.size(), f) == skeleton.size()
+            && (entries.empty() || fwrite(&entries[0], sizeof(MgPagerEntry), entries.size(), f)
+                == entries.size());
+        fclose(f);
+        if (!ret) {
+            remove(filename);       // 不留下不完整的索引文件
+        }
+    }
+}
+
+void MgDocPager::Impl::buildGrid()
+{
+    const int count = (int)entries.size();
+
+    nx = ny = mgMax(1, mgMin(1024, (int)sqrt(count / 4.f)));
+    cellw = extent.width() / nx;
+    cellh = extent.height() / ny;
+    cellw = cellw > 1e-6f ? cellw : 1.f;
+    cellh = cellh > 1e-6f ? cellh : 1.f;
+    cells.assign(nx * ny, std::vector<int>());
+    bigs.clear();
+
+    for (int i = 0; i < count; i++) {
+        int x1, y1, x2, y2;
+        cellRange(entries[i].box, x1, y1, x2, y2);
+
+        if ((x2 - x1 + 1) * (y2 - y1 + 1) > kMaxCellsPerShape) {
+            bigs.push_back(i);
+            continue;
+        }
+        for (int y = y1; y <= y2; y++) {
+            for (int x = x1; x <= x2; x++) {
+                cells[y * nx + x].push_back(i);
+            }
+        }
+    }
+}
+
+void MgDocPager::Impl::cellRange(const float* box, int& x1, int& y1, int& x2, int& y2) const
+{
+    float fx1 = (box[0] - extent.xmin) / cellw, fx2 = (box[2] - extent.xmin) / cellw;
+    float fy1 = (box[1] - extent.ymin) / cellh, fy2 = (box[3] - extent.ymin) / cellh;
+
+    x1 = fx1 < 0 ? 0 : fx1 >= nx ? nx - 1 : (int)fx1;
+    x2 = fx2 < 0 ? 0 : fx2 >= nx ? nx - 1 : (int)fx2;
+    y1 = fy1 < 0 ? 0 : fy1 >= ny ? ny - 1 : (int)fy1;
+    y2 = fy2 < 0 ? 0 : fy2 >= ny ? ny - 1 : (int)fy2;
+}
+
+// 查找与矩形相交的记录，按文件中的顺序返回
+int MgDocPager::Impl::find(const Box2d& rect, std::vector<int>& result)
+{
+    const float box[4] = { rect.xmin, rect.ymin, rect.xmax, rect.ymax };
+    int x1, y1, x2, y2;
+
+    result.clear();
+    if (++query == 0) {
+        std::fill(marks.begin(), marks.end(), 0);
+        query = 1;
+    }
+    if (!cells.empty() && overlap(box, extent)) {
+        cellRange(box, x1, y1, x2, y2);
+        for (int y = y1; y <= y2; y++) {
+            for (int x = x1; x <= x2; x++) {
+                const std::vector<int>& cell = cells[y * nx + x];
+                for (size_t i = 0; i < cell.size(); i++) {
+                    const int e = cell[i];
+                    if (marks[e] != query && overlap(entries[e].box, rect)) {
+                        marks[e] = query;
+                        result.push_back(e);
+                    }
+                }
+            }
+        }
+    }
+    for (size_t j = 0; j < bigs.size(); j++) {
+        if (overlap(entries[bigs[j]].box, rect)) {
+            marks[bigs[j]] = query;
+            result.push_back(bigs[j]);
+        }
+    }
+    std::sort(result.begin(), result.end());
+
+    return (int)result.size();
+}
+
+void MgDocPager::Impl::loadStyles()
+{
+    MgStorage* s = js.storageForRead(skeleton.c_str());
+
+    styles.clear();
+    if (s->readNode("shapedoc", -1, false)) {
+        MgShapeDoc::loadStyles(s, styles);
+        s->readNode("shapedoc", -1, true);
+    }
+}
+
+MgShape* MgDocPager::Impl::loadShape(const MgPagerEntry& e, MgShapeFactory* factory)
+{
+    MgShape* sp = NULL;
+
+    buf.resize(e.length + 1);
+    if (mgseekfile(fp, e.offset) == 0
+        && fread(&buf[0], 1, e.length, fp) == (size_t)e.length) {
+        buf[e.length] = 0;
+
+        MgStorage* s = js.storageForRead(&buf[0]);
+        s->setStyleIndex(&styles);          // 图形可能只保存了绘图参数的序号
+        if (s->readNode("", -1, false)) {
+            sp = factory->createShape(e.type);
+            if (sp) {
+                sp->shape()->setExtent(Box2d(e.box[0], e.box[1], e.box[2], e.box[3]));
+                if (sp->load(factory, s)) {
+                    sp->shape()->setFlag(kMgClosed, sp->shape()->isClosed());
+                } else {
+                    sp->release();
+                    sp = NULL;
+                }
+            }
+            s->readNode("", -1, true);
+        }
+    }
+    if (!sp) {
+        LOGE("Fail to load shape (id=%d, type=%d)", e.id, e.type);
+    }
+
+    return sp;
+}
+
+bool MgDocPager::loadSkeleton(MgShapeDoc* doc, MgShapeFactory* factory, GiTransform* xform)
+{
+    if (!im->fp || !doc) {
+        return false;
+    }
+    MgJsonStorage js;
+    MgShapeDoc* tmpdoc = MgShapeDoc::createDoc();   // 先加载到临时文档，成功后才替换，失败时不改变原文档
+    bool ret = tmpdoc->loadAll(factory, js.storageForRead(im->skeleton.c_str()), NULL);
+
+    if (ret) {
+        tmpdoc->moveShapesTo(doc);
+        if (xform && !doc->zoomToInitial(xform)) {
+            xform->setModelTransform(doc->modelTransform());
+            xform->zoomTo(doc->getPageRectW());
+        }
+        std::fill(im->sids.begin(), im->sids.end(), 0);
+        im->loaded.clear();
+        im->lastRect.empty();
+        im->covered.empty();
+    }
+    tmpdoc->release();
+
+    return ret;
+}
+
+int MgDocPager::update(MgShapeDoc* doc, MgShapeFactory* factory, const Box2d& rectM,
+                       const int* keepIds, int keepCount)
+{
+    if (!im->fp || !doc || rectM.isEmpty() || rectM == im->lastRect) {
+        return 0;
+    }
+
+    Box2d loadBox(rectM), keepBox(rectM);
+    std::vector<int> wanted;
+    std::vector<int> layers;
+    int changes = 0;
+
+    loadBox.inflate(rectM.width() * im->margin, rectM.height() * im->margin);
+    keepBox.inflate(rectM.width() * (im->margin * 2 + 0.5f), rectM.height() * (im->margin * 2 + 0.5f));
+    if (im->covered.contains(rectM) && keepBox.contains(im->covered)) {
+        return 0;                       // 平移或缩放幅度不大，窗口内的图形都已加载
+    }
+
+    bool truncated = false;
+    if (im->find(loadBox, wanted) > im->maxShapes && im->maxShapes > 0) {
+        // 超出上限时只加载较大的图形，较小的图形在此缩放比例下本就不易看清
+        std::vector<std::pair<float, int> > sizes(wanted.size());
+        for (size_t i = 0; i < wanted.size(); i++) {
+            const float* b = im->entries[wanted[i]].box;
+            sizes[i] = std::make_pair(-mgMax(b[2] - b[0], b[3] - b[1]), wanted[i]);
+        }
+        std::nth_element(sizes.begin(), sizes.begin() + im->maxShapes, sizes.end());
+        wanted.resize(im->maxShapes);
+        for (int j = 0; j < im->maxShapes; j++) {
+            wanted[j] = sizes[j].second;
+        }
+        std::sort(wanted.begin(), wanted.end());
+        if (++im->query == 0) {
+            std::fill(im->marks.begin(), im->marks.end(), 0);
+            im->query = 1;
+        }
+        for (int k = 0; k < im->maxShapes; k++) {
+            im->marks[wanted[k]] = im->query;
+        }
+        truncated = true;
+    }
+
+    // 释放远离窗口的图形，每个图层批量删除一次
+    std::vector<std::vector<int> > removed;
+    size_t n = 0;
+    for (size_t i = 0; i < im->loaded.size(); i++) {
+        const int e = im->loaded[i];
+        const int sid = im->sids[e];
+        const bool keep = im->marks[e] == im->query
+            || (!truncated && Impl::overlap(im->entries[e].box, keepBox))
+            || Impl::hasID(keepIds, keepCount, sid);
+        MgLayer* layer = doc->getLayer(im->entries[e].layer);
+
+        if (keep || !layer) {
+            im->loaded[n++] = e;
+        } else {
+            if ((int)removed.size() <= im->entries[e].layer) {
+                removed.resize(im->entries[e].layer + 1);
+            }
+            removed[im->entries[e].layer].push_back(sid);
+            im->sids[e] = 0;
+        }
+    }
+    im->loaded.resize(n);
+    for (size_t k = 0; k < removed.size(); k++) {
+        if (!removed[k].empty()) {
+            changes += doc->getLayer((int)k)->removeShapes((int)removed[k].size(), &removed[k].front());
+        }
+    }
+
+    // 加载新进入窗口的图形
+    for (size_t j = 0; j < wanted.size(); j++) {
+        const int e = wanted[j];
+        const MgPagerEntry& entry = im->entries[e];
+        MgLayer* layer = im->sids[e] ? NULL : doc->getLayer(entry.layer);
+        MgShape* sp = layer ? im->loadShape(entry, factory) : NULL;
+
+        if (sp) {
+            layer->addShapeWithID(sp, entry.id);
+            im->sids[e] = sp->getID();
+            im->loaded.push_back(e);
+            if (std::find(layers.begin(), layers.end(), entry.layer) == layers.end()) {
+                layers.push_back(entry.layer);
+            }
+            changes++;
+        }
+    }
+
+    // 按文件中的顺序排列图形，使显示次序与完整加载时相同
+    if (!layers.empty()) {
+        std::vector<int> ids;
+
+        std::sort(im->loaded.begin(), im->loaded.end());
+        for (size_t k = 0; k < layers.size(); k++) {
+            MgLayer* layer = doc->getLayer(layers[k]);
+            ids.clear();
+            for (size_t i = 0; i < im->loaded.size(); i++) {
+                if (im->entries[im->loaded[i]].layer == layers[k])
+                    ids.push_back(im->sids[im->loaded[i]]);
+            }
+            if (!ids.empty() && (int)ids.size() == layer->getShapeCount()) {
+                layer->reorderShapes((int)ids.size(), &ids.front());
+            }
+        }
+    }
+    im->lastRect = rectM;
+    im->covered = truncated ? Box2d() : loadBox;
+
+    return changes;
+}
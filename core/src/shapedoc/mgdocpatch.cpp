@@ -0,0 +1,850 @@
+//! \file mgdocpatch.cpp
+//! \brief 实现文档版本间的二进制差异补丁类 MgDocPatch
+// Copyright (c) 2004-2015, https://github.com/rhcad/vgcore, BSD License
+
+#include "mgdocpatch.h"
+#include "mgshapedoc.h"
+#include "mglayer.h"
+#include "mgshape.h"
+#include "mgspfactory.h"
+#include "mgstorage.h"
+#include "mglog.h"
+#include <stdio.h>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+
+// 补丁格式: "VGP"+版本, 页面标记[范围和显示比例], 图层数, 各图层:
+//   原图形数, 删除的ID, 替换的图形, 添加的图形, 绘图参数改变的图形, 新的ID次序(可为空)
+static const unsigned char kPatchMagic[] = { 'V', 'G', 'P', 1 };
+static const int kMaxDepth = 64;
+
+//! 补丁中图形记录的一项键值或子节点
+struct MgPatchValue {
+    enum { kNode, kInt, kFloat, kDouble, kString, kFloats, kDoubles, kInts };
+
+    int         kind;
+    std::string name;
+    int         ivalue;
+    double      dvalue;
+    std::string str;
+    std::vector<double>         nums;   // 数组的各项
+    std::vector<MgPatchValue*>  items;  // 子节点的各项
+
+    MgPatchValue(int kind, const std::string& name) : kind(kind), name(name), ivalue(0), dvalue(0) {}
+    ~MgPatchValue() {
+        for (size_t i = 0; i < items.size(); i++)
+            delete items[i];
+    }
+    MgPatchValue* add(int k, const char* n) {
+        items.push_back(new MgPatchValue(k, n));
+        return items.back();
+    }
+    const MgPatchValue* find(const char* n) const {
+        for (size_t i = 0; i < items.size(); i++) {
+            if (items[i]->name == n)
+                return items[i];
+        }
+        return NULL;
+    }
+    bool isNumber() const { return kind == kInt || kind == kFloat || kind == kDouble; }
+    bool isArray() const { return kind == kFloats || kind == kDoubles || kind == kInts; }
+    double number() const { return kind == kInt ? ivalue : dvalue; }
+
+private:
+    MgPatchValue(const MgPatchValue&);
+    void operator=(const MgPatchValue&);
+};
+
+//! 在内存节点树上读写的序列化对象，节点命名规则同 MgJsonStorage
+class MgPatchStorage : public MgStorage
+{
+public:
+    MgPatchStorage(MgPatchValue* root) { _stack.push_back(root); }
+
+    virtual bool readNode(const char* name, int index, bool ended) {
+        if (ended) {
+            if (_stack.size() > 1)
+                _stack.pop_back();
+            return true;
+        }
+        const MgPatchValue* v = find(nodeName(name, index).c_str());
+        if (v && v->kind == MgPatchValue::kNode) {
+            _stack.push_back(const_cast<MgPatchValue*>(v));
+            return true;
+        }
+        return false;
+    }
+    virtual bool writeNode(const char* name, int index, bool ended) {
+        if (ended) {
+            if (_stack.size() > 1)
+                _stack.pop_back();
+        } else {
+            _stack.push_back(add(MgPatchValue::kNode, nodeName(name, index).c_str()));
+        }
+        return true;
+    }
+
+    virtual bool readBool(const char* name, bool defvalue) {
+        const MgPatchValue* v = find(name);
+        return v && v->isNumber() ? v->number() != 0 : defvalue;
+    }
+    virtual int readInt(const char* name, int defvalue) {
+        const MgPatchValue* v = find(name);
+        return v && v->isNumber() ? (v->kind == MgPatchValue::kInt ? v->ivalue : (int)v->dvalue) : defvalue;
+    }
+    virtual float readFloat(const char* name, float defvalue) {
+        const MgPatchValue* v = find(name);
+        return v && v->isNumber() ? (float)v->number() : defvalue;
+    }
+    virtual double readDouble(const char* name, double defvalue) {
+        const MgPatchValue* v = find(name);
+        return v && v->isNumber() ? v->number() : defvalue;
+    }
+    virtual int readFloatArray(const char* name, float* values, int count, bool) {
+        return readArray(name, values, count);
+    }
+    virtual int readDoubleArray(const char* name, double* values, int count, bool) {
+        return readArray(name, values, count);
+    }
+    virtual int readIntArray(const char* name, int* values, int count, bool) {
+        return readArray(name, values, count);
+    }
+    virtual int readString(const char* name, char* value, int count) {
+        const MgPatchValue* v = find(name);
+        int ret = 0;
+
+        if (v && v->kind == MgPatchValue::kString) {
+            ret = (int)v->str.size();
+            if (value) {
+                ret = ret < count ? ret : count;
+                std::copy(v->str.begin(), v->str.begin() + ret, value);
+            }
+        }
+        if (value) {
+            value[ret] = 0;
+        }
+        return ret;
+    }
+
+    virtual void writeBool(const char* name, bool value) { writeInt(name, value ? 1 : 0); }
+    virtual void writeInt(const char* name, int value) { add(MgPatchValue::kInt, name)->ivalue = value; }
+    virtual void writeUInt(const char* name, int value) { writeInt(name, value); }
+    virtual void writeFloat(const char* name, float value) { add(MgPatchValue::kFloat, name)->dvalue = value; }
+    virtual void writeDouble(const char* name, double value) { add(MgPatchValue::kDouble, name)->dvalue = value; }
+    virtual void writeString(const char* name, const char* value) {
+        add(MgPatchValue::kString, name)->str = value ? value : "";
+    }
+    virtual void writeFloatArray(const char* name, const float* values, int count) {
+        add(MgPatchValue::kFloats, name)->nums.assign(values, values + count);
+    }
+    virtual void writeDoubleArray(const char* name, const double* values, int count) {
+        add(MgPatchValue::kDoubles, name)->nums.assign(values, values + count);
+    }
+    virtual void writeIntArray(const char* name, const int* values, int count) {
+        add(MgPatchValue::kInts, name)->nums.assign(values, values + count);
+    }
+
+private:
+    static std::string nodeName(const char* name, int index) {
+        char tmpname[32];
+
+        if (name && index >= 0) {
+            snprintf(tmpname, sizeof(tmpname), "%s%d", name, index + 1);
+            return tmpname;
+        }
+        return name ? name : "";
+    }
+    const MgPatchValue* find(const char* name) const {
+        return name ? _stack.back()->find(name) : NULL;
+    }
+    MgPatchValue* add(int kind, const char* name) {
+        return _stack.back()->add(kind, name ? name : "");
+    }
+    template <typename T>
+    int readArray(const char* name, T* values, int count) {
+        const MgPatchValue* v = find(name);
+        int ret = v && v->isArray() ? (int)v->nums.size() : 0;
+
+        if (values && ret > 0) {
+            ret = ret < count ? ret : count;
+            for (int i = 0; i < ret; i++) {
+                values[i] = (T)v->nums[i];
+            }
+        }
+        return ret;
+    }
+
+    std::vector<MgPatchValue*>  _stack;
+};
+
+//! 补丁的二进制编码器，字段名在整个补丁中首次出现时写出，之后只写序号
+class MgPatchWriter
+{
+public:
+    MgPatchWriter(std::vector<unsigned char>& buf) : _buf(buf) {}
+
+    void putVarint(unsigned v) {
+        for (; v >= 0x80; v >>= 7) {
+            _buf.push_back((unsigned char)(v | 0x80));
+        }
+        _buf.push_back((unsigned char)v);
+    }
+    void putInt(int v) { putVarint(((unsigned)v << 1) ^ (unsigned)(v >> 31)); }
+    void putFloat(float v) {
+        union { float f; unsigned u; } x;
+        x.f = v;
+        for (int i = 0; i < 32; i += 8)
+            _buf.push_back((unsigned char)(x.u >> i));
+    }
+    void putDouble(double v) {
+        union { double d; unsigned long long u; } x;
+        x.d = v;
+        for (int i = 0; i < 64; i += 8)
+            _buf.push_back((unsigned char)(x.u >> i));
+    }
+    void putString(const std::string& s) {
+        putVarint((unsigned)s.size());
+        _buf.insert(_buf.end(), s.begin(), s.end());
+    }
+
+    //! 写出升序ID或任意次序ID，均按与前一个的差值编码
+    void putIds(const std::vector<int>& ids) {
+        int last = 0;
+        putVarint((unsigned)ids.size());
+        for (size_t i = 0; i < ids.size(); i++) {
+            putInt(ids[i] - last);
+            last = ids[i];
+        }
+    }
+
+    void putValue(const MgPatchValue* v) {
+        std::map<std::string, int>::const_iterator it = _names.find(v->name);
+
+        if (it != _names.end()) {
+            putVarint((unsigned)(it->second + 1) << 3 | v->kind);
+        } else {
+            putVarint((unsigned)v->kind);
+            putString(v->name);
+            _names[v->name] = (int)_names.size();
+        }
+
+        switch (v->kind) {
+            case MgPatchValue::kNode:
+                putVarint((unsigned)v->items.size());
+                for (size_t i = 0; i < v->items.size(); i++)
+                    putValue(v->items[i]);
+                break;
+            case MgPatchValue::kInt: putInt(v->ivalue); break;
+            case MgPatchValue::kFloat: putFloat((float)v->dvalue); break;
+            case MgPatchValue::kDouble: putDouble(v->dvalue); break;
+            case MgPatchValue::kString: putString(v->str); break;
+            default:
+                putVarint((unsigned)v->nums.size());
+                for (size_t i = 0; i < v->nums.size(); i++) {
+                    if (v->kind == MgPatchValue::kFloats)
+                        putFloat((float)v->nums[i]);
+                    else if (v->kind == MgPatchValue::kDoubles)
+                        putDouble(v->nums[i]);
+                    else
+                        putInt((int)v->nums[i]);
+                }
+                break;
+        }
+    }
+
+private:
+    std::vector<unsigned char>& _buf;
+    std::map<std::string, int>  _names;
+};
+
+//! 补丁的二进制解码器，遇到越界或无效数据后各函数均返回失败
+class MgPatchReader
+{
+public:
+    MgPatchReader(const unsigned char* data, int size) : _p(data), _end(data + size), _ok(true) {}
+
+    bool ok() const { return _ok; }
+    bool atEnd() const { return _p == _end; }
+
+    bool getMagic() {
+        if (_end - _p < (int)sizeof(kPatchMagic)
+            || !std::equal(kPatchMagic, kPatchMagic + sizeof(kPatchMagic), _p)) {
+            return _ok = false;
+        }
+        _p += sizeof(kPatchMagic);
+        return true;
+    }
+    unsigned getVarint() {
+        unsigned v = 0;
+        for (int shift = 0; _ok && shift < 35; shift += 7) {
+            if (_p == _end)
+                break;
+            unsigned char b = *_p++;
+            v |= (unsigned)(b & 0x7F) << shift;
+            if (!(b & 0x80))
+                return v;
+        }
+        _ok = false;
+        return 0;
+    }
+    int getInt() {
+        unsigned v = getVarint();
+        return (int)(v >> 1) ^ -(int)(v & 1);
+    }
+    //! 读取个数，每项至少占 minBytes 个字节，超出剩余数据时失败
+    int getCount(int minBytes) {
+        unsigned n = getVarint();
+        if (_ok && n > (unsigned)(_end - _p) / (unsigned)minBytes) {
+            _ok = false;
+        }
+        return _ok ? (int)n : 0;
+    }
+    float getFloat() {
+        union { float f; unsigned u; } x;
+        x.u = (unsigned)getBytes(4);
+        return x.f;
+    }
+    double getDouble() {
+        union { double d; unsigned long long u; } x;
+        x.u = getBytes(8);
+        return x.d;
+    }
+    bool getString(std::string& s) {
+        int n = getCount(1);
+        if (_ok) {
+            s.assign((const char*)_p, (size_t)n);
+            _p += n;
+        }
+        return _ok;
+    }
+    bool getIds(std::vector<int>& ids) {
+        int n = getCount(1), last = 0;
+        ids.resize(n);
+        for (int i = 0; _ok && i < n; i++) {
+            last += getInt();
+            ids[i] = last;
+        }
+        return _ok;
+    }
+
+    //! 读取一个键值或节点，失败返回NULL
+    MgPatchValue* getValue(int depth = 0) {
+        unsigned key = getVarint();
+        int kind = (int)(key & 7), ref = (int)(key >> 3);
+        std::string name;
+
+        if (!_ok || kind > MgPatchValue::kInts || depth > kMaxDepth) {
+            _ok = false;
+            return NULL;
+        }
+        if (ref == 0) {
+            if (!getString(name))
+                return NULL;
+            _names.push_back(name);
+        } else if (ref <= (int)_names.size()) {
+            name = _names[ref - 1];
+        } else {
+            _ok = false;
+            return NULL;
+        }
+
+        MgPatchValue* v = new MgPatchValue(kind, name);
+        int n;
+
+        switch (kind) {
+            case MgPatchValue::kNode:
+                n = getCount(2);
+                for (int i = 0; _ok && i < n; i++) {
+                    MgPatchValue* item = getValue(depth + 1);
+                    if (item)
+                        v->items.push_back(item);
+                }
+                break;
+            case MgPatchValue::kInt: v->ivalue = getInt(); break;
+            case MgPatchValue::kFloat: v->dvalue = getFloat(); break;
+            case MgPatchValue::kDouble: v->dvalue = getDouble(); break;
+            case MgPatchValue::kString: getString(v->str); break;
+            default:
+                n = getCount(kind == MgPatchValue::kFloats ? 4 : kind == MgPatchValue::kDoubles ? 8 : 1);
+                v->nums.resize(n);
+                for (int i = 0; _ok && i < n; i++) {
+                    v->nums[i] = (kind == MgPatchValue::kFloats ? getFloat()
+                                  : kind == MgPatchValue::kDoubles ? getDouble() : getInt());
+                }
+                break;
+        }
+        if (!_ok) {
+            delete v;
+            v = NULL;
+        }
+        return v;
+    }
+
+private:
+    unsigned long long getBytes(int n) {
+        unsigned long long v = 0;
+        if (_end - _p < n) {
+            _ok = false;
+            return 0;
+        }
+        for (int i = 0; i < n; i++)
+            v |= (unsigned long long)*_p++ << (i * 8);
+        return v;
+    }
+
+    const unsigned char*        _p;
+    const unsigned char*        _end;
+    bool                        _ok;
+    std::vector<std::string>    _names;
+};
+
+//! 一个图层的改动
+struct MgLayerPatch {
+    int                         baseCount;  // 原图层的图形数，用于核对起始版本
+    std::vector<int>            deletes;
+    std::vector<MgPatchValue*>  updates;    // 替换的图形，与原图形ID相同
+    std::vector<MgPatchValue*>  adds;
+    std::vector<MgPatchValue*>  styles;     // 只改变了绘图参数或标签的图形
+    std::vector<int>            order;      // 全部图形的新ID次序，次序未变时为空
+
+    MgLayerPatch() : baseCount(0) {}
+    ~MgLayerPatch() {
+        freeValues(updates);
+        freeValues(adds);
+        freeValues(styles);
+    }
+    static void freeValues(std::vector<MgPatchValue*>& arr) {
+        for (size_t i = 0; i < arr.size(); i++)
+            delete arr[i];
+        arr.clear();
+    }
+};
+
+//! 记录图形的类型、ID、范围和几何形状，同 MgShapes::saveShape
+static void putShape(MgPatchWriter& w, const MgShape* sp)
+{
+    MgPatchValue v(MgPatchValue::kNode, "shape");
+    MgPatchStorage s(&v);
+    Box2d rect(sp->shapec()->getExtent());
+
+    s.writeInt("type", sp->getType() & 0xFFFF);
+    s.writeInt("id", sp->getID());
+    s.writeFloatArray("extent", &rect.xmin, 4);
+    sp->save(&s);
+    if (!sp->context().isAutoScale()) {     // 序列化时未保存，补丁需如实复原
+        s.writeBool("autoScale", false);
+    }
+    w.putValue(&v);
+}
+
+//! 只记录图形的ID、标签和绘图参数
+static void putStyle(MgPatchWriter& w, const MgShape* sp)
+{
+    MgPatchValue v(MgPatchValue::kNode, "style");
+    MgPatchStorage s(&v);
+
+    s.writeInt("id", sp->getID());
+    s.writeInt("tag", sp->getTag());
+    MgShape::saveContext(&s, sp->context());
+    if (!sp->context().isAutoScale()) {
+        s.writeBool("autoScale", false);
+    }
+    w.putValue(&v);
+}
+
+//! 一个图层的比较结果
+struct MgLayerDiff {
+    std::vector<int>            deletes;
+    std::vector<const MgShape*> updates;
+    std::vector<const MgShape*> adds;
+    std::vector<const MgShape*> styles;
+    std::vector<int>            order;      // 新的ID次序，次序未变时为空
+
+    void clear() {
+        deletes.clear();
+        updates.clear();
+        adds.clear();
+        styles.clear();
+        order.clear();
+    }
+    void compare(const MgShape* oldsp, const MgShape* sp) {
+        if (oldsp == sp) {                  // 前端文档间未改变的图形是共享的
+            return;
+        }
+        if (oldsp->getType() != sp->getType()       // 改绘图参数也会增加改变计数，只按几何形状判断
+            || !oldsp->shapec()->equals(*sp->shapec())) {
+            updates.push_back(sp);
+        }
+        else if (oldsp->context() != sp->context() || oldsp->getTag() != sp->getTag()) {
+            styles.push_back(sp);
+        }
+    }
+
+    bool diffByChanges(const MgShapes* a, const MgShapes* b);
+    bool diffInOrder(const MgShapes* a, const MgShapes* b);
+    void diffByMap(const MgShapes* a, const MgShapes* b);
+};
+
+// 只比较改动记录中的图形，新图形都已追加在末尾，不能按改动记录比较时返回false
+bool MgLayerDiff::diffByChanges(const MgShapes* a, const MgShapes* b)
+{
+    std::vector<int> ids;
+
+    if (!a || !b || b->getChangedIDs(a, ids) < 0)
+        return false;
+
+    for (size_t i = 0; i < ids.size(); i++) {
+        const MgShape* pa = a->findShape(ids[i]);
+        const MgShape* pb = b->findShape(ids[i]);
+
+        if (pa && pb) {
+            compare(pa, pb);
+        } else if (pa) {
+            deletes.push_back(ids[i]);
+        } else if (pb) {
+            adds.push_back(pb);
+        }
+    }
+
+    return (a->getShapeCount() - (int)deletes.size() + (int)adds.size() == b->getShapeCount()
+            && (adds.empty() || adds.back() == b->getLastShape()));
+}
+
+// 同步遍历两个图形列表，只对不同的图形按ID查找，新次序不是原次序去掉删除的再追加新图形时返回false
+bool MgLayerDiff::diffInOrder(const MgShapes* a, const MgShapes* b)
+{
+    MgShapeIterator ia(a), ib(b);
+    const MgShape* pa = ia.getNext();
+    const MgShape* pb = ib.getNext();
+
+    while (pa || pb) {
+        if (pa == pb || (pa && pb && pa->getID() == pb->getID())) {
+            if (!adds.empty())              // 添加的图形不在末尾
+                return false;
+            compare(pa, pb);
+            pa = ia.getNext();
+            pb = ib.getNext();
+        }
+        else if (pa && !(b && b->findShape(pa->getID()))) {
+            deletes.push_back(pa->getID());
+            pa = ia.getNext();
+        }
+        else if (pb && !(a && a->findShape(pb->getID()))) {
+            adds.push_back(pb);
+            pb = ib.getNext();
+        }
+        else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void MgLayerDiff::diffByMap(const MgShapes* a, const MgShapes* b)
+{
+    std::map<int, const MgShape*> olds;
+    std::vector<int> aorder;
+
+    for (MgShapeIterator it(a); it.hasNext(); ) {
+        const MgShape* sp = it.getNext();
+        olds[sp->getID()] = sp;
+        aorder.push_back(sp->getID());
+    }
+    for (MgShapeIterator it(b); it.hasNext(); ) {
+        const MgShape* sp = it.getNext();
+        std::map<int, const MgShape*>::iterator old = olds.find(sp->getID());
+
+        order.push_back(sp->getID());
+        if (old == olds.end()) {
+            adds.push_back(sp);
+        } else {
+            compare(old->second, sp);
+            olds.erase(old);
+        }
+    }
+    for (std::map<int, const MgShape*>::const_iterator it = olds.begin(); it != olds.end(); ++it) {
+        deletes.push_back(it->first);       // 剩下的原图形已删除，map已按ID升序
+    }
+
+    std::vector<int> expected;              // 原次序去掉删除的再追加新图形
+    for (size_t i = 0; i < aorder.size(); i++) {
+        if (!std::binary_search(deletes.begin(), deletes.end(), aorder[i]))
+            expected.push_back(aorder[i]);
+    }
+    for (size_t i = 0; i < adds.size(); i++) {
+        expected.push_back(adds[i]->getID());
+    }
+    if (expected == order) {
+        order.clear();
+    }
+}
+
+static int diffLayer(MgPatchWriter& w, const MgShapes* a, const MgShapes* b)
+{
+    MgLayerDiff d;
+
+    if (!d.diffByChanges(a, b)) {           // 不是同一改动记录的快照时才遍历图形
+        d.clear();
+        if (!d.diffInOrder(a, b)) {         // 次序改变时才按ID比较全部图形
+            d.clear();
+            d.diffByMap(a, b);
+        }
+    }
+
+    w.putVarint(a ? (unsigned)a->getShapeCount() : 0);
+    w.putIds(d.deletes);
+    w.putVarint((unsigned)d.updates.size());
+    for (size_t i = 0; i < d.updates.size(); i++)
+        putShape(w, d.updates[i]);
+    w.putVarint((unsigned)d.adds.size());
+    for (size_t i = 0; i < d.adds.size(); i++)
+        putShape(w, d.adds[i]);
+    w.putVarint((unsigned)d.styles.size());
+    for (size_t i = 0; i < d.styles.size(); i++)
+        putStyle(w, d.styles[i]);
+    w.putIds(d.order);
+
+    return (int)(d.deletes.size() + d.updates.size() + d.adds.size() + d.styles.size())
+        + (d.order.empty() ? 0 : 1);
+}
+
+int MgDocPatch::make(const MgShapeDoc* from, const MgShapeDoc* to,
+                     std::vector<unsigned char>& patch)
+{
+    MgPatchWriter w(patch);
+    int count = 0;
+
+    patch.clear();
+    patch.assign(kPatchMagic, kPatchMagic + sizeof(kPatchMagic));
+    if (!to)
+        return -1;
+
+    bool pageChanged = !from || from->getPageRectW() != to->getPageRectW()
+        || from->getViewScale() != to->getViewScale();
+
+    w.putVarint(pageChanged ? 1 : 0);
+    if (pageChanged) {
+        const Box2d& rect = to->getPageRectW();
+        w.putFloat(rect.xmin);
+        w.putFloat(rect.ymin);
+        w.putFloat(rect.xmax);
+        w.putFloat(rect.ymax);
+        w.putFloat(to->getViewScale());
+        count++;
+    }
+
+    int layers = std::max(from ? from->getLayerCount() : 0, to->getLayerCount());
+
+    w.putVarint((unsigned)layers);
+    for (int i = 0; i < layers; i++) {
+        count += diffLayer(w, from && i < from->getLayerCount() ? from->getLayer(i) : NULL,
+                           i < to->getLayerCount() ? to->getLayer(i) : NULL);
+    }
+
+    return count;
+}
+
+static bool readValues(MgPatchReader& r, std::vector<MgPatchValue*>& arr)
+{
+    int n = r.getCount(2);
+
+    for (int i = 0; r.ok() && i < n; i++) {
+        MgPatchValue* v = r.getValue();
+        if (v)
+            arr.push_back(v);
+    }
+    return r.ok();
+}
+
+static bool readLayer(MgPatchReader& r, MgLayerPatch& layer)
+{
+    layer.baseCount = (int)r.getVarint();
+    return (r.getIds(layer.deletes)
+            && readValues(r, layer.updates)
+            && readValues(r, layer.adds)
+            && readValues(r, layer.styles)
+            && r.getIds(layer.order));
+}
+
+//! 复原 loadContext 不能读出的线宽不缩放标记
+static void loadAutoScale(MgStorage* s, MgShape* sp)
+{
+    if (!s->readBool("autoScale", true)) {
+        GiContext ctx(sp->context());
+        ctx.setLineWidth(ctx.getLineWidth(), false);
+        sp->setContext(ctx);
+    }
+}
+
+//! 由图形记录创建图形，同 MgShapes::load 中的单个图形，但保留记录的闭合标志
+static MgShape* loadShape(MgShapes* shapes, MgShapeFactory* factory, MgPatchValue* v)
+{
+    MgPatchStorage s(v);
+    const int type = s.readInt("type", 0);
+    const int sid = s.readInt("id", 0);
+    Box2d rect;
+
+    s.readFloatArray("extent", &rect.xmin, 4, false);
+
+    MgShape* newsp = factory->createShape(type);
+
+    if (newsp) {
+        newsp->setParent(shapes, sid);
+        newsp->shape()->setExtent(rect);
+        if (newsp->load(factory, &s)) {
+            loadAutoScale(&s, newsp);
+            return newsp;
+        }
+        newsp->release();
+    }
+    LOGE("Fail to load shape in patch (id=%d, type=%d)", sid, type);
+    return MgShape::Null();
+}
+
+//! 复制原图形并设置补丁中的标签和绘图参数
+static MgShape* loadStyle(const MgShapes* shapes, MgPatchValue* v)
+{
+    MgPatchStorage s(v);
+    const MgShape* oldsp = shapes ? shapes->findShape(s.readInt("id", 0)) : MgShape::Null();
+    MgShape* newsp = oldsp ? oldsp->cloneShape() : MgShape::Null();
+
+    if (newsp) {
+        newsp->setTag(s.readInt("tag", 0));
+        newsp->setContext(MgShape::loadContext(&s));
+        loadAutoScale(&s, newsp);
+    }
+    return newsp;
+}
+
+static void releaseShapes(std::vector<MgShape*>& arr)
+{
+    for (size_t i = 0; i < arr.size(); i++) {
+        if (arr[i])
+            arr[i]->release();
+    }
+    arr.clear();
+}
+
+//! 核对图层的起始版本并创建改动的图形，失败时不改变文档
+static bool prepareLayer(const MgLayerPatch& p, MgShapes* shapes, MgShapeFactory* factory,
+                         std::vector<MgShape*>& replaced, std::vector<MgShape*>& added)
+{
+    if ((shapes ? shapes->getShapeCount() : 0) != p.baseCount)
+        return false;
+
+    bool ret = true;
+    std::set<int> ids;      // 各ID只能改动一次，使替换的图形都能被图层接管
+    size_t i;
+
+    for (i = 0; ret && i < p.deletes.size(); i++) {
+        ret = shapes && shapes->findShape(p.deletes[i]) && ids.insert(p.deletes[i]).second;
+    }
+    for (i = 0; ret && i < p.updates.size(); i++) {
+        MgShape* sp = loadShape(shapes, factory, p.updates[i]);
+        replaced.push_back(sp);
+        ret = sp && shapes && shapes->findShape(sp->getID()) && ids.insert(sp->getID()).second;
+    }
+    for (i = 0; ret && i < p.styles.size(); i++) {
+        MgShape* sp = loadStyle(shapes, p.styles[i]);
+        replaced.push_back(sp);
+        ret = sp && ids.insert(sp->getID()).second;
+    }
+    for (i = 0; ret && i < p.adds.size(); i++) {
+        MgShape* sp = loadShape(shapes, factory, p.adds[i]);
+        added.push_back(sp);
+        ret = (sp && sp->getID() != 0 && !(shapes && shapes->findShape(sp->getID()))
+               && ids.insert(sp->getID()).second);
+    }
+    if (ret && !p.order.empty()) {
+        ret = (p.order.size() == (size_t)p.baseCount - p.deletes.size() + p.adds.size());
+    }
+
+    return ret;
+}
+
+bool MgDocPatch::apply(MgShapeDoc* doc, MgShapeFactory* factory,
+                       const unsigned char* data, int size)
+{
+    MgPatchReader r(data, size);
+
+    if (!doc || !factory || !data || !r.getMagic())
+        return false;
+
+    const bool pageChanged = r.getVarint() != 0;
+    Box2d rect;
+    float viewScale = 0;
+
+    if (pageChanged) {
+        rect.xmin = r.getFloat();
+        rect.ymin = r.getFloat();
+        rect.xmax = r.getFloat();
+        rect.ymax = r.getFloat();
+        viewScale = r.getFloat();
+    }
+
+    const int layerCount = r.getCount(6);
+    std::vector<MgLayerPatch> layers(layerCount);
+    bool ret = r.ok() && doc->getLayerCount() <= layerCount;
+
+    for (int i = 0; ret && i < layerCount; i++) {
+        ret = readLayer(r, layers[i]);
+    }
+    if (!ret || !r.atEnd()) {
+        LOGE("Invalid document patch (%d bytes)", size);
+        return false;
+    }
+
+    std::vector<std::vector<MgShape*> > replaced(layerCount), added(layerCount);
+
+    for (int i = 0; ret && i < layerCount; i++) {
+        ret = prepareLayer(layers[i], i < doc->getLayerCount() ? doc->getLayer(i) : NULL,
+                           factory, replaced[i], added[i]);
+    }
+    if (!ret) {
+        LOGE("The document does not match the base version of the patch");
+        for (int i = 0; i < layerCount; i++) {
+            releaseShapes(replaced[i]);
+            releaseShapes(added[i]);
+        }
+        return false;
+    }
+
+    const int curLayer = doc->getCurrentLayer()->getIndex();
+
+    for (int i = 0; i < layerCount; i++) {
+        const MgLayerPatch& p = layers[i];
+
+        if (i == doc->getLayerCount()) {
+            doc->switchLayer(i);
+        }
+        MgShapes* shapes = doc->getLayer(i);
+
+        // 按ID直接定位，只处理补丁涉及的图形
+        if (!p.deletes.empty()) {
+            shapes->removeShapes((int)p.deletes.size(), &p.deletes.front());
+        }
+        if (!replaced[i].empty()
+            && shapes->updateShapes((int)replaced[i].size(), &replaced[i].front()) != (int)replaced[i].size()) {
+            for (size_t j = 0; j < replaced[i].size(); j++) {   // 未被接管的新图形在此释放，ID已核对为不重复
+                if (shapes->findShape(replaced[i][j]->getID()) != replaced[i][j])
+                    replaced[i][j]->release();
+            }
+        }
+        for (size_t j = 0; j < added[i].size(); j++) {
+            shapes->addShapeWithID(added[i][j], added[i][j]->getID());
+        }
+        if (!p.order.empty()) {
+            shapes->reorderShapes((int)p.order.size(), &p.order.front());
+        }
+    }
+    doc->switchLayer(curLayer);
+
+    if (pageChanged) {
+        doc->setPageRectW(rect, viewScale);
+    }
+
+    return true;
+}
@@ -29,6 +29,11 @@ MgShapeDoc* MgLayer::doc() const
     return (MgShapeDoc*)getOwner();
 }
 
+GiStyleTable* MgLayer::getStyleTable() const
+{
+    return doc() ? doc()->getStyleTable() : NULL;
+}
+
 MgObject* MgLayer::clone() const
 {
     MgObject* p = new MgLayer(doc(), -1);
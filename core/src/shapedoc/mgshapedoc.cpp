@@ -8,6 +8,7 @@
 #include "mglayer.h"
 #include "mgcomposite.h"
 #include "mglog.h"
+#include "gistyletable.h"
 
 struct MgShapeDoc::Impl {
     std::vector<MgLayer*> layers;
@@ -20,6 +21,8 @@ struct MgShapeDoc::Impl {
     float       viewScale;
     volatile long   refcount;
     bool        readOnly;
+    MgLoadProgress* progress;
+    GiStyleTable*   styles;     // 绘图参数登记表，由本文档的各副本共享
 };
 
 //static volatile long _n = 0;
@@ -34,6 +37,8 @@ MgShapeDoc::MgShapeDoc()
     im->viewScale = 0;
     im->readOnly = false;
     im->refcount = 1;
+    im->progress = NULL;
+    im->styles = GiStyleTable::create();
 }
 
 MgShapeDoc::~MgShapeDoc()
@@ -41,6 +46,7 @@ MgShapeDoc::~MgShapeDoc()
     for (unsigned i = 0; i < im->layers.size(); i++) {
         im->layers[i]->release();
     }
+    im->styles->release();
     delete im;
     //LOGD("-MgShapeDoc %ld", giAtomicDecrement(&_n));
 }
@@ -94,7 +100,15 @@ int MgShapeDoc::copyShapes(const MgShapeDoc* src, bool deeply)
     int ret = 0;
     
     copy(*src);
+    if (im->styles != src->im->styles) {
+        src->im->styles->addRef();      // 文档副本共享登记表，复制的图形不必重新登记
+        im->styles->release();
+        im->styles = src->im->styles;
+    }
     
+    for (i = 0; !deeply && i < src->im->layers.size(); i++) {
+        src->im->layers[i]->trackChanges();    // 浅拷贝的文档快照间可只比较改动的图形
+    }
     for (i = 0; i < im->layers.size() && i < src->im->layers.size(); i++) {
         ret += im->layers[i]->copyShapes(src->im->layers[i], deeply);
     }
@@ -241,6 +255,11 @@ int MgShapeDoc::getLayerCount() const
     return (int)im->layers.size();
 }
 
+MgLayer* MgShapeDoc::getLayer(int index) const
+{
+    return index >= 0 && index < getLayerCount() ? im->layers[index] : (MgLayer*)0;
+}
+
 bool MgShapeDoc::switchLayer(int index)
 {
     bool ret = false;
@@ -289,10 +308,57 @@ int MgShapeDoc::dyndraw(int mode, GiGraphics& gs, const int* ignoreIds) const
     return n;
 }
 
+GiStyleTable* MgShapeDoc::getStyleTable() const
+{
+    return im->styles;
+}
+
+// 收集各图形(含复合图形的子图形)的绘图参数，返回图形数
+static int collectStyles(const MgShapes* shapes, GiStyleIndex& styles)
+{
+    MgShapeIterator it(shapes);
+    int n = 0;
+    
+    while (const MgShape* sp = it.getNext()) {
+        styles.add(sp->context());
+        n++;
+        if (sp->shapec()->isKindOf(MgComposite::Type())) {
+            n += collectStyles(((const MgComposite*)sp->shapec())->shapes(), styles);
+        }
+    }
+    return n;
+}
+
+static void saveStyles(MgStorage* s, const GiStyleIndex& styles)
+{
+    if (styles.getCount() > 0 && s->writeNode("styles", -1, false)) {
+        s->writeInt("count", styles.getCount());
+        for (int i = 0; i < styles.getCount(); i++) {
+            s->writeNode("style", i, false);
+            MgShape::saveContext(s, *styles.get(i));
+            s->writeNode("style", i, true);
+        }
+        s->writeNode("styles", -1, true);
+    }
+}
+
+void MgShapeDoc::loadStyles(MgStorage* s, GiStyleIndex& styles)
+{
+    if (s->readNode("styles", -1, false)) {
+        for (int i = 0; s->readNode("style", i, false); i++) {
+            styles.append(MgShape::loadContext(s));
+            s->readNode("style", i, true);
+        }
+        s->readNode("styles", -1, true);
+    }
+}
+
 bool MgShapeDoc::save(MgStorage* s, int startIndex) const
 {
     bool ret = true;
     Box2d rect;
+    GiStyleIndex styles;                // 参数表方式下各图形的绘图参数只写一次，图形只保存序号
+    GiStyleIndex* oldStyles = s ? s->getStyleIndex() : NULL;
 
     if (!s || !s->writeNode("shapedoc", -1, false)) {
         return false;
@@ -307,12 +373,25 @@ bool MgShapeDoc::save(MgStorage* s, int startIndex) const
         s->writeFloatArray("extent", &rect.xmin, 4);
         s->writeInt("count", (int)im->layers.size());
     }
+    if (!oldStyles && s->isStyleIndexMode() && !s->isArrayMode()) {  // 数组方式下图层数组会取代 styles 节点
+        int refs = 0;
+        for (unsigned i = 0; i < im->layers.size(); i++) {
+            refs += collectStyles(im->layers[i], styles);
+        }
+        // 参数表的每项比图形内联的参数略大，序号只占内联参数的几分之一，
+        // 平均每种参数至少被两个图形使用时才写参数表，以免文件变大
+        if (styles.getCount() * 2 <= refs) {
+            saveStyles(s, styles);
+            s->setStyleIndex(&styles);
+        }
+    }
 
     for (unsigned i = 0; i < im->layers.size(); i++) {
         ret = im->layers[i]->save(s, startIndex) || ret;
         startIndex = -1;
     }
 
+    s->setStyleIndex(oldStyles);
     s->writeNode("shapedoc", -1, true);
 
     return ret;
@@ -322,6 +401,8 @@ bool MgShapeDoc::load(MgShapeFactory* factory, MgStorage* s, bool addOnly)
 {
     bool ret = false;
     Box2d rect;
+    GiStyleIndex styles;
+    GiStyleIndex* oldStyles = s ? s->getStyleIndex() : NULL;
 
     if (!s || !s->readNode("shapedoc", -1, false)) {
         return s && s->setError("No shapedoc node.");
@@ -338,25 +419,36 @@ bool MgShapeDoc::load(MgShapeFactory* factory, MgStorage* s, bool addOnly)
         s->readFloatArray("extent", &rect.xmin, 4, false);
         s->readInt("count", 0);
     }
+    loadStyles(s, styles);
+    s->setStyleIndex(&styles);
 
-    for (int i = 0; i < 99; i++) {
+    for (int i = 0; i < 99 && !(im->progress && im->progress->isStopping()); i++) {
         if (i < getLayerCount()) {
+            im->layers[i]->setLoadProgress(im->progress);
             ret = im->layers[i]->load(factory, s, addOnly) >= 0 || ret;
+            im->layers[i]->setLoadProgress(NULL);
         }
         else {
             MgLayer* layer = MgLayer::create(this, i);
+            im->layers.push_back(layer);    // 先加入文档，以便分批提交时可见
+            layer->setLoadProgress(im->progress);
             if (layer->load(factory, s, addOnly) >= 0) {
-                im->layers.push_back(layer);
+                layer->setLoadProgress(NULL);
                 ret = true;
             }
             else {
+                im->layers.pop_back();
                 layer->release();
                 break;
             }
         }
         addOnly = false;
     }
+    if (im->progress && im->progress->isStopping()) {
+        ret = false;
+    }
 
+    s->setStyleIndex(oldStyles);
     s->readNode("shapedoc", -1, true);
 
     return ret;
@@ -385,6 +477,32 @@ bool MgShapeDoc::loadAll(MgShapeFactory* factory, MgStorage* s, GiTransform* xfo
     return ret;
 }
 
+void MgShapeDoc::setLoadProgress(MgLoadProgress* p)
+{
+    im->progress = p;
+}
+
+int MgShapeDoc::moveShapesTo(MgShapeDoc* dest)
+{
+    int ret = 0;
+    
+    if (dest && dest != this) {
+        dest->clear();
+        dest->copy(*this);
+        dest->im->rectWInitial = im->rectWInitial;
+        
+        for (unsigned i = 0; i < im->layers.size(); i++) {
+            if (i >= dest->im->layers.size()) {
+                dest->im->layers.push_back(MgLayer::create(dest, i));
+            }
+            dest->im->layers[i]->copy(*im->layers[i]);
+            ret += im->layers[i]->moveShapesTo(dest->im->layers[i]);
+        }
+    }
+    
+    return ret;
+}
+
 bool MgShapeDoc::zoomToInitial(GiTransform* xform)
 {
     bool ret = xform && !im->rectWInitial.isEmpty();
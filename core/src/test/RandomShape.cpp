@@ -45,6 +45,7 @@ int RandomParam::addShapes(MgShapes* shapes)
     
     for (int n = getShapeCount(); n > 0; n--) {
         int type = RandInt(0, 2);
+        GiContext ctx;
         
         if (0 == type && 0 == lineCount)
             type = 1;
@@ -71,7 +72,8 @@ int RandomParam::addShapes(MgShapes* shapes)
                 }
             }
             
-            setShapeProp(shape._context);
+            setShapeProp(ctx);
+            shape.setContext(ctx, GiContext::kCopyAll);
             shapes->addShape(shape);
             curveCount--;
             ret++;
@@ -81,7 +83,8 @@ int RandomParam::addShapes(MgShapes* shapes)
             Box2d rect(Point2d(RandF(-1000, 1000), RandF(-1000, 1000)), RandF(1, 200), 0);
             
             shape._shape.setRect2P(rect.leftTop(), rect.rightBottom());
-            setShapeProp(shape._context);
+            setShapeProp(ctx);
+            shape.setContext(ctx, GiContext::kCopyAll);
             shapes->addShape(shape);
             arcCount--;
             ret++;
@@ -91,7 +94,8 @@ int RandomParam::addShapes(MgShapes* shapes)
             Box2d rect(Point2d(RandF(-1000, 1000), RandF(-1000, 1000)), RandF(1, 200), 0);
             
             shape._shape.setRect2P(rect.leftTop(), rect.rightBottom());
-            setShapeProp(shape._context);
+            setShapeProp(ctx);
+            shape.setContext(ctx, GiContext::kCopyAll);
             shapes->addShape(shape);
             rectCount--;
             ret++;
@@ -102,7 +106,8 @@ int RandomParam::addShapes(MgShapes* shapes)
 
             shape._shape.setPoint(0, pt);
             shape._shape.setPoint(1, pt + Vector2d(RandF(-100, 100), RandF(-100, 100)));
-            setShapeProp(shape._context);
+            setShapeProp(ctx);
+            shape.setContext(ctx, GiContext::kCopyAll);
             shapes->addShape(shape);
             lineCount--;
             ret++;
@@ -0,0 +1,165 @@
+//! \file testalloc.cpp
+//! \brief 检查拖动和手绘手势在稳定状态下不分配堆内存
+// Copyright (c) 2004-2015, https://github.com/rhcad/vgcore, BSD License
+//
+// 需与按 MG_ALLOC_COUNTER 编译的 gicoreview.cpp 链接，见本目录的 Makefile (make check)。
+
+#include "gicoreview.h"
+#include "giview.h"
+#include "gicanvas.h"
+#include <stdio.h>
+#include <string.h>
+
+//! 不输出的画布，只用于驱动绘图代码
+class NullCanvas : public GiCanvas
+{
+public:
+    void setPen(int, float, int, float, float) {}
+    void setBrush(int, int) {}
+    void clearRect(float, float, float, float) {}
+    void drawRect(float, float, float, float, bool, bool) {}
+    void drawLine(float, float, float, float) {}
+    void drawEllipse(float, float, float, float, bool, bool) {}
+    void beginPath() {}
+    void moveTo(float, float) {}
+    void lineTo(float, float) {}
+    void bezierTo(float, float, float, float, float, float) {}
+    void quadTo(float, float, float, float) {}
+    void closePath() {}
+    void drawPath(bool, bool) {}
+    void saveClip() {}
+    void restoreClip() {}
+    bool clipRect(float, float, float, float) { return true; }
+    bool clipPath() { return true; }
+    bool drawHandle(float, float, int, float) { return true; }
+    bool drawBitmap(const char*, float, float, float, float, float) { return true; }
+    float drawTextAt(const char*, float, float, float, int, float) { return 0; }
+};
+
+class TestView : public GiView {};
+
+static const int kEvents = 400;         // 计数的手势事件数
+
+//! 第 i 个拖动位置，沿锯齿线前进
+static void dragPoint(int i, float& x, float& y)
+{
+    x = 300.f + 1.5f * i;
+    y = 300.f + (float)(i % 20 < 10 ? i % 10 : 10 - i % 10);
+}
+
+//! 统计拖动事件(含动态图形的显示和提交)中分配了内存的事件数和分配次数
+static void dragEvents(GiCoreView* core, TestView* view, GiCanvas* canvas,
+                       int from, int to, int step, int& allocEvents, long& allocs)
+{
+    float x, y;
+
+    allocEvents = 0;
+    allocs = 0;
+    for (int i = from; i != to; i += step) {
+        dragPoint(i, x, y);
+
+        long n = GiCoreView::getAllocCount();
+        core->onGesture(view, kGiGesturePan, kGiGestureMoved, x, y);
+        core->submitDynamicShapes(view);
+        core->dynDraw(view, canvas);
+        n = GiCoreView::getAllocCount() - n;
+
+        allocEvents += n > 0 ? 1 : 0;
+        allocs += n;
+    }
+}
+
+//! 选择一个图形并沿同一路径往返拖动，预热后的第二遍应没有分配
+static bool testSelectDrag()
+{
+    TestView view;
+    NullCanvas canvas;
+    GiCoreView* core = GiCoreView::createView(&view);
+    int allocEvents;
+    long allocs;
+    float x, y;
+
+    core->onSize(&view, 1024, 768);
+    core->addShapesForTest(50);
+    core->setCommand("rect");
+    core->onGesture(&view, kGiGesturePan, kGiGestureBegan, 250, 250);
+    core->onGesture(&view, kGiGesturePan, kGiGestureMoved, 320, 320);
+    core->onGesture(&view, kGiGesturePan, kGiGestureEnded, 350, 350);
+    core->setCommand("select");
+    core->onGesture(&view, kGiGestureTap, kGiGestureEnded, 350, 300);
+
+    bool ret = core->getSelectedShapeCount() == 1;
+
+    dragPoint(0, x, y);
+    core->onGesture(&view, kGiGesturePan, kGiGestureBegan, x, y);
+    dragEvents(core, &view, &canvas, 0, kEvents, 1, allocEvents, allocs);
+    dragEvents(core, &view, &canvas, kEvents, 0, -1, allocEvents, allocs);
+    dragEvents(core, &view, &canvas, 0, kEvents, 1, allocEvents, allocs);
+    core->onGesture(&view, kGiGesturePan, kGiGestureEnded, x, y);
+
+    ret = ret && allocs == 0;
+    printf("%-10s %s: %ld allocations in %d events\n", "select", ret ? "ok" : "FAILED",
+           allocs, kEvents);
+
+    core->destoryView(&view);
+    core->release();
+
+    return ret;
+}
+
+//! 手绘一笔
+static void drawStroke(GiCoreView* core, TestView* view, GiCanvas* canvas,
+                       int& allocEvents, long& allocs)
+{
+    float x, y;
+
+    dragPoint(0, x, y);
+    core->onGesture(view, kGiGesturePan, kGiGestureBegan, x, y);
+    core->submitDynamicShapes(view);
+    dragEvents(core, view, canvas, 0, 20, 1, allocEvents, allocs);
+    dragEvents(core, view, canvas, 20, 20 + kEvents, 1, allocEvents, allocs);
+    dragPoint(20 + kEvents, x, y);
+    core->onGesture(view, kGiGesturePan, kGiGestureEnded, x, y);
+    core->submitDynamicShapes(view);
+}
+
+//! 先手绘一笔预热，再手绘同样的一笔，第二笔的每个事件都不应分配
+static bool testFreehand(const char* cmd)
+{
+    TestView view;
+    NullCanvas canvas;
+    GiCoreView* core = GiCoreView::createView(&view);
+    int allocEvents;
+    long allocs;
+
+    core->onSize(&view, 1024, 768);
+    core->setCommand(cmd);
+    drawStroke(core, &view, &canvas, allocEvents, allocs);
+    drawStroke(core, &view, &canvas, allocEvents, allocs);
+
+    bool ret = allocs == 0;
+    printf("%-10s %s: %ld allocations in %d of %d events\n", cmd, ret ? "ok" : "FAILED",
+           allocs, allocEvents, kEvents);
+
+    core->destoryView(&view);
+    core->release();
+
+    return ret;
+}
+
+int main()
+{
+    if (GiCoreView::getAllocCount() < 0) {
+        printf("testalloc: gicoreview.cpp is not built with MG_ALLOC_COUNTER\n");
+        return 1;
+    }
+
+    bool ret = testSelectDrag();
+    const char* cmds[] = { "splines", "lines", "freelines" };
+
+    for (int i = 0; i < 3; i++) {
+        ret = testFreehand(cmds[i]) && ret;
+    }
+
+    return ret ? 0 : 1;
+}
@@ -0,0 +1,168 @@
+//! \file testpatch.cpp
+//! \brief 检查文档补丁的往返: 由两个快照生成补丁，应用到起始版本后应与目标版本一致
+// Copyright (c) 2004-2015, https://github.com/rhcad/vgcore, BSD License
+//
+// 见本目录的 Makefile (make check)。
+
+#include "mgshapedoc.h"
+#include "mglayer.h"
+#include "mgdocpatch.h"
+#include "mgbasicsps.h"
+#include "mgshapet.h"
+#include "mgbasicspreg.h"
+#include "spfactoryimpl.h"
+#include "mgjsonstorage.h"
+#include "mgstorage.h"
+#include "RandomShape.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+//! 保存为JSON文本，用于比较两个文档
+static std::string content(const MgShapeDoc* doc)
+{
+    MgJsonStorage js;
+    doc->save(js.storageForWrite(), 0);
+    return js.stringify(false);
+}
+
+static void collectIds(const MgShapes* shapes, std::vector<int>& ids)
+{
+    MgShapeIterator it(shapes);
+
+    ids.clear();
+    while (const MgShape* sp = it.getNext()) {
+        ids.push_back(sp->getID());
+    }
+}
+
+//! 在文档上删除、改变形状、只改绘图参数、添加和调整次序，并在第二个图层添加图形
+static void editDoc(MgShapeDoc* doc)
+{
+    MgShapes* shapes = doc->getCurrentShapes();
+    std::vector<int> ids;
+    int i;
+
+    collectIds(shapes, ids);
+    for (i = 0; i < 20; i++) {
+        shapes->removeShape(ids[i * 7]);
+    }
+    for (i = 0; i < 40; i++) {
+        const MgShape* sp = shapes->findShape(ids[i * 5 + 1]);
+        if (!sp)
+            continue;
+
+        MgShape* newsp = sp->cloneShape();
+        if (i % 2) {
+            newsp->shape()->offset(Vector2d(3.f, 4.f), -1);
+        } else {
+            GiContext ctx(newsp->context());
+            ctx.setLineColor(GiColor(255, 0, 0));
+            ctx.setLineWidth(-3.f, true);
+            newsp->setContext(ctx);
+            newsp->setTag(i + 1);
+        }
+        shapes->updateShape(newsp);
+    }
+    for (i = 0; i < 10; i++) {
+        MgShapeT<MgRect> rect;
+        rect._shape.setRect2P(Point2d((float)i, (float)i), Point2d(i + 5.f, i + 9.f));
+        shapes->addShape(rect);
+    }
+
+    collectIds(shapes, ids);
+    std::swap(ids[5], ids[50]);
+    shapes->reorderShapes((int)ids.size(), &ids.front());
+
+    doc->switchLayer(1);
+    MgShapeT<MgLine> line;
+    line._shape.setPoint(1, Point2d(9.f, 9.f));
+    doc->getCurrentShapes()->addShape(line);
+    doc->switchLayer(0);
+}
+
+//! 生成补丁并应用到起始版本的深复制品，结果应与目标版本相同，再次应用应因版本不符而失败
+static bool testLoopback(MgShapeFactory* factory)
+{
+    MgShapeDoc* doc = MgShapeDoc::createDoc();
+    RandomParam param(100);
+
+    param.randomLineStyle = true;
+    param.addShapes(doc->getCurrentShapes());
+
+    MgShapeDoc* from = doc->shallowCopy();
+    editDoc(doc);
+    MgShapeDoc* to = doc->shallowCopy();
+
+    std::vector<unsigned char> patch;
+    int changes = MgDocPatch::make(from, to, patch);
+    MgShapeDoc* target = MgShapeDoc::createDoc();
+    target->copyShapes(from, true);
+    bool applied = MgDocPatch::apply(target, factory, &patch.front(), (int)patch.size());
+    bool ret = applied && content(target) == content(to);
+    std::string before(content(target));
+
+    ret = ret && !MgDocPatch::apply(target, factory, &patch.front(), (int)patch.size())
+        && content(target) == before;
+    printf("%-10s %s: %d changes in %d bytes\n", "loopback", ret ? "ok" : "FAILED",
+           changes, (int)patch.size());
+
+    target->release();
+    to->release();
+    from->release();
+    doc->release();
+
+    return ret;
+}
+
+//! 只改变绘图参数的图形应按绘图参数记录，补丁不含其顶点
+static bool testStyleOnly(MgShapeFactory* factory)
+{
+    MgShapeDoc* doc = MgShapeDoc::createDoc();
+    MgShapeT<MgLines> lines;
+
+    for (int i = 0; i < 1000; i++) {
+        lines._shape.addPoint(Point2d(i * 0.5f, (float)(i % 17)));
+    }
+    int sid = doc->getCurrentShapes()->addShape(lines)->getID();
+
+    MgShapeDoc* from = doc->shallowCopy();
+    MgShape* newsp = doc->findShape(sid)->cloneShape();
+    GiContext ctx(newsp->context());
+
+    ctx.setLineColor(GiColor(0, 0, 255));
+    newsp->setContext(ctx);
+    doc->getCurrentShapes()->updateShape(newsp);
+
+    MgShapeDoc* to = doc->shallowCopy();
+    std::vector<unsigned char> patch;
+    MgDocPatch::make(from, to, patch);
+
+    MgShapeDoc* target = MgShapeDoc::createDoc();
+    target->copyShapes(from, true);
+    bool ret = (patch.size() < 200
+                && MgDocPatch::apply(target, factory, &patch.front(), (int)patch.size())
+                && content(target) == content(to));
+    printf("%-10s %s: %d bytes\n", "style", ret ? "ok" : "FAILED", (int)patch.size());
+
+    target->release();
+    to->release();
+    from->release();
+    doc->release();
+
+    return ret;
+}
+
+int main()
+{
+    MgShapeFactoryImpl factory;
+
+    MgBasicShapes::registerShapes(&factory);
+    srand(3);
+
+    bool ret = testLoopback(&factory);
+    ret = testStyleOnly(&factory) && ret;
+
+    return ret ? 0 : 1;
+}
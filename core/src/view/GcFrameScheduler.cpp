@@ -0,0 +1,154 @@
+﻿// GcFrameScheduler.cpp: 实现按帧合并重绘请求的调度类 GcFrameScheduler
+// Copyright (c) 2004-2015, https://github.com/rhcad/vgcore, BSD License
+
+#include "GcFrameScheduler.h"
+#include "gilock.h"
+#include "mgtrace.h"
+#include <algorithm>
+
+GcFrameScheduler::GcFrameScheduler()
+    : _scheduled(false), _batching(false), _inputTime(0), _startTime(0), _locker(0)
+    , _frames(0), _requests(0), _updates(0)
+{
+}
+
+bool GcFrameScheduler::beginBatch()
+{
+    if (_batching)
+        return false;
+    _batching = true;
+    return true;
+}
+
+bool GcFrameScheduler::endBatch()
+{
+    GiSpinLock lock(&_locker);
+
+    _batching = false;
+    _inputTime = 0;
+    return !_scheduled;
+}
+
+void GcFrameScheduler::noteRequest()
+{
+    GiSpinLock lock(&_locker);
+
+    _requests++;
+    if (!_startTime) {
+        _startTime = _inputTime ? _inputTime : mgMonotonicMicros();
+    }
+    if (!_batching && !_scheduled) {
+        _updates++;
+    }
+}
+
+bool GcFrameScheduler::requestRegen(bool changed)
+{
+    noteRequest();
+    if (!_batching && !_scheduled)
+        return false;
+
+    _pending.regen = std::max(_pending.regen, changed ? 2 : 1);
+    return true;
+}
+
+bool GcFrameScheduler::requestAppend(int sid, long playh)
+{
+    noteRequest();
+    if (!_batching && !_scheduled)
+        return false;
+
+    if (!_pending.sid) {
+        _pending.sid = sid;
+        _pending.playh = playh;
+    }
+    else if (_pending.sid != sid || _pending.playh != playh) {
+        _pending.regen = 2;             // 追加了多个图形，合并为一次全部重新生成
+    }
+    return true;
+}
+
+bool GcFrameScheduler::requestRedraw(bool changed)
+{
+    noteRequest();
+    if (!_batching && !_scheduled)
+        return false;
+
+    _pending.redraw = std::max(_pending.redraw, changed ? 2 : 1);
+    return true;
+}
+
+bool GcFrameScheduler::take(Pending& pending)
+{
+    pending = _pending;
+    _pending = Pending();
+
+    if (_scheduled && pending.type() == kAppendUpdate && pending.redraw) {
+        _pending.redraw = pending.redraw;   // 每帧只发出一个更新，重绘留到下一帧
+        pending.redraw = 0;
+    }
+
+    if (pending.type() == kNoUpdate)
+        return false;
+
+    GiSpinLock lock(&_locker);
+    _updates++;
+    return true;
+}
+
+void GcFrameScheduler::noteInput()
+{
+    GiSpinLock lock(&_locker);
+    _inputTime = mgMonotonicMicros();
+}
+
+float GcFrameScheduler::notePresented()
+{
+    GiSpinLock lock(&_locker);
+
+    if (!_startTime)
+        return -1.f;
+
+    float ms = (float)(mgMonotonicMicros() - _startTime) * 1e-3f;
+
+    _samples[_frames % kMaxSamples] = ms;
+    _frames++;
+    _startTime = 0;
+    _inputTime = 0;
+
+    return ms;
+}
+
+int GcFrameScheduler::getStats(mgvector<float>& stats) const
+{
+    float samples[kMaxSamples];
+    float values[7];
+    int n;
+
+    {
+        GiSpinLock lock(const_cast<volatile long*>(&_locker));
+
+        n = (int)std::min(_frames, (long)kMaxSamples);
+        std::copy(_samples, _samples + n, samples);
+        values[0] = (float)_frames;
+        values[1] = (float)_requests;
+        values[2] = (float)_updates;
+    }
+
+    float sum = 0;
+    std::sort(samples, samples + n);
+    for (int i = 0; i < n; i++) {
+        sum += samples[i];
+    }
+    values[3] = n > 0 ? sum / n : 0;
+    values[4] = n > 0 ? samples[n / 2] : 0;
+    values[5] = n > 0 ? samples[(n * 95 - 1) / 100] : 0;
+    values[6] = n > 0 ? samples[n - 1] : 0;
+
+    stats.setSize(7);
+    for (int i = 0; i < 7; i++) {
+        stats.set(i, values[i]);
+    }
+
+    return n;
+}
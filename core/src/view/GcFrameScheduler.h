@@ -0,0 +1,86 @@
+﻿//! \file GcFrameScheduler.h
+//! \brief 定义按帧合并重绘请求的调度类 GcFrameScheduler
+// Copyright (c) 2004-2015, https://github.com/rhcad/vgcore, BSD License
+
+#ifndef TOUCHVG_CORE_FRAMESCHEDULER_H
+#define TOUCHVG_CORE_FRAMESCHEDULER_H
+
+#include "mgvector.h"
+
+//! 按帧合并重绘请求的调度类
+/*! 在批处理(DrawLocker)期间或启用按帧调度后，regenAll、regenAppend 和 redraw 请求
+    只累积下来，结束批处理或帧开始时(onFrameTick)最多发出一个按优先级合并的更新：
+    全部重新生成 > 追加新图形 > 重绘动态图形。只追加一个图形时发出追加请求，
+    追加了多个不同图形则升级为全部重新生成。与追加同时累积的重绘请求在按帧调度时留到下一帧发出。
+
+    同时记录从输入(手势)或首个请求到帧显示(onFramePresented)的延迟。
+    \ingroup CORE_VIEW
+ */
+class GcFrameScheduler
+{
+public:
+    enum { kMaxSamples = 128 };
+    enum { kNoUpdate, kRedrawUpdate, kAppendUpdate, kRegenUpdate };
+
+    //! 累积的更新
+    struct Pending {
+        int     regen;                  //!< 0-无，1-重新生成，2-内容已改变
+        int     redraw;                 //!< 0-无，1-重绘，2-内容已改变
+        int     sid;                    //!< 追加的图形ID，0表示无
+        long    playh;                  //!< 追加图形所在的播放项
+
+        Pending() : regen(0), redraw(0), sid(0), playh(0) {}
+        int type() const {
+            return regen ? kRegenUpdate : sid ? kAppendUpdate : redraw ? kRedrawUpdate : kNoUpdate;
+        }
+    };
+
+    GcFrameScheduler();
+
+    //! 设置是否按帧调度，启用后请求累积到 take() 时发出
+    void setScheduled(bool scheduled) { _scheduled = scheduled; }
+    bool isScheduled() const { return _scheduled; }
+
+    //! 开始批处理，已在批处理中则返回false
+    bool beginBatch();
+
+    //! 结束批处理，返回是否应立即发出累积的更新(未启用按帧调度)
+    bool endBatch();
+
+    //! 累积全部重新生成请求，不在批处理中且未启用按帧调度时返回false，应立即发出
+    bool requestRegen(bool changed);
+
+    //! 累积追加图形的请求，返回false表示应立即发出
+    bool requestAppend(int sid, long playh);
+
+    //! 累积重绘请求，返回false表示应立即发出
+    bool requestRedraw(bool changed);
+
+    //! 取出累积的更新并清空，按帧调度时与追加同时累积的重绘留到下次取出，没有更新则返回false
+    bool take(Pending& pending);
+
+    //! 记录输入事件的时刻，在本批处理中产生请求时作为延迟的起点
+    void noteInput();
+
+    //! 记录一帧已显示，返回输入到显示的毫秒数，没有待显示的更新则返回-1
+    float notePresented();
+
+    //! 得到延迟统计，见 GiCoreView::getFrameStats()
+    int getStats(mgvector<float>& stats) const;
+
+private:
+    void noteRequest();
+
+    Pending         _pending;
+    bool            _scheduled;
+    bool            _batching;
+    long long       _inputTime;         // 当前批处理的输入时刻，微秒
+    long long       _startTime;         // 首个未显示的请求的起点时刻，微秒
+    volatile long   _locker;            // 保护时刻和统计数据
+    float           _samples[kMaxSamples];  // 最近各帧的延迟，毫秒
+    long            _frames;            // 已显示的帧数
+    long            _requests;          // 累计的请求数
+    long            _updates;           // 累计发出的更新数
+};
+
+#endif // TOUCHVG_CORE_FRAMESCHEDULER_H
@@ -101,30 +101,14 @@ void GcGraphView::draw(GiGraphics& gs)
     if (gridType < 1 || gridType > 2 || gs.xf().getViewScale() < 0.05f)
         return;
     
-    Box2d rect(gs.xf().getWndRectW());
     GiContext ctx(0, GiColor(127, 127, 127, gridType == 2 ? 48 : 20));
     
-    if (gridType == 1) {
+    if (gridType == 1) {                    // 每10个世界单位一条线，每5条一条主网格线
         GiContext ctx5(0, GiColor(127, 127, 127, 48));
-        float x = mgbase::roundReal(rect.xmin, -1) - 10;
-        float y = mgbase::roundReal(rect.ymin, -1) - 10;
-        int i = mgRound(x) / 10;
-        
-        for (; x < rect.xmax + 10; x += 10) {
-            gs.drawLine(i++ % 5 ? &ctx : &ctx5, Point2d(x, rect.ymin), Point2d(x, rect.ymax), false);
-        }
-        i = mgRound(y) / 10;
-        for (; y < rect.ymax + 10; y += 10) {
-            gs.drawLine(i++ % 5 ? &ctx : &ctx5, Point2d(rect.xmin, y), Point2d(rect.xmax, y), false);
-        }
+        gs.drawGridLines(&ctx, &ctx5, Point2d::kOrigin(), Vector2d(10, 10), 5, Box2d(), false);
     }
     else if (gridType == 2) {
-        for (float x = rect.xmin - 10; x < rect.xmax + 10; x += 10) {
-            for (float y = rect.ymin - 10; y < rect.ymax + 10; y += 10) {
-                gs.drawLine(&ctx, Point2d(x, y - 0.5f), Point2d(x, y + 0.5f), false);
-                gs.drawLine(&ctx, Point2d(x - 0.5f, y), Point2d(x + 0.5f, y), false);
-            }
-        }
+        gs.drawGridDots(&ctx, Point2d::kOrigin(), Vector2d(10, 10), 0.5f, Box2d(), false);
     }
     
     GcBaseView::draw(gs);
@@ -0,0 +1,145 @@
+﻿// GcRenderCache.cpp: 实现多个视图共享绘图结果的缓存类 GcRenderCache
+// Copyright (c) 2004-2015, https://github.com/rhcad/vgcore, BSD License
+
+#include "GcRenderCache.h"
+#include "girecordcanvas.h"
+#include "gigraph.h"
+#include "mgshapedoc.h"
+#include "mgshapes.h"
+#include "gilock.h"
+
+//! 主视图记录的一次绘图结果
+struct GcRenderCache::Product
+{
+    volatile long   refcount;
+    MgShapeDoc*     doc;            // 已增加引用，其地址不会被新文档重用
+    int             mode;
+    Box2d           rectW;          // 记录时的世界坐标绘图范围
+    Matrix2d        w2d;            // 记录时的世界坐标到显示坐标的变换
+    MgShapes*       shapes;         // 每个图形的绘图指令(MgRecordShape)
+    int             count;          // 绘制的图形数
+
+    Product(MgShapeDoc* doc, int mode) : refcount(1), doc(doc), mode(mode), count(0) {
+        doc->addRef();
+        shapes = MgShapes::create();
+    }
+    ~Product() {
+        shapes->release();
+        doc->release();
+    }
+    void addRef() { giAtomicIncrement(&refcount); }
+    void release() {
+        if (giAtomicDecrement(&refcount) == 0)
+            delete this;
+    }
+};
+
+GcRenderCache::GcRenderCache() : _product(NULL), _locker(0), _replays(0), _secondaries(0)
+{
+}
+
+GcRenderCache::~GcRenderCache()
+{
+    clear();
+}
+
+void GcRenderCache::clear()
+{
+    setProduct(NULL);
+}
+
+void GcRenderCache::addSecondary()
+{
+    giAtomicIncrement(&_secondaries);
+}
+
+void GcRenderCache::removeSecondary()
+{
+    if (giAtomicDecrement(&_secondaries) == 0) {
+        clear();
+    }
+}
+
+void GcRenderCache::setProduct(Product* p)
+{
+    Product* old;
+
+    if (p) {
+        p->addRef();
+    }
+    {
+        GiSpinLock lock(&_locker);
+        old = _product;
+        _product = p;
+    }
+    if (old) {
+        old->release();
+    }
+}
+
+GcRenderCache::Product* GcRenderCache::acquire(const MgShapeDoc* doc, int mode,
+                                               const GiGraphics& gs, bool secondary)
+{
+    GiSpinLock lock(&_locker);
+    Product* p = _product;
+
+    if (!p || p->doc != doc || p->mode != mode
+        || !p->rectW.contains(gs.xf().getWndRectW())) {
+        return NULL;
+    }
+    // 次级视图可按自己的坐标系重放，主视图仅在显示变换未变时重放(线宽等为记录时的显示大小)
+    if (!secondary && p->w2d != gs.xf().worldToDisplay()) {
+        return NULL;
+    }
+    p->addRef();
+
+    return p;
+}
+
+int GcRenderCache::draw(MgShapeDoc* doc, int mode, GiGraphics& gs, GiCanvas* canvas, bool secondary)
+{
+    int n = -1;
+    Product* p = acquire(doc, mode, gs, secondary);
+
+    if (p) {                                // 重放已有的记录，由各记录图形的范围剔除
+        if (gs.beginPaint(canvas)) {
+            p->shapes->draw(gs);
+            n = p->count;
+            gs.endPaint();
+            giAtomicIncrement(&_replays);
+        }
+        p->release();
+    }
+    else if (secondary || giAtomicLoad(&_secondaries) == 0) {
+        // 次级视图不替换主视图的记录，没有次级视图时主视图不必记录
+        if (gs.beginPaint(canvas)) {
+            n = doc->dyndraw(mode, gs);
+            gs.endPaint();
+        }
+    }
+    else {                                  // 绘制到画布的同时记录下来
+        p = new Product(doc, mode);
+        GiRecordCanvas recorder(p->shapes, &gs.xf(), -1, canvas);
+        int batchMode = gs.getBatchMode();
+
+        if (batchMode > 1) {                // 记录画布按图形分组，只在图形内合并
+            gs.setBatchMode(1);
+        }
+        if (gs.beginPaint(&recorder)) {
+            p->rectW = gs.getClipWorld();
+            p->w2d = gs.xf().worldToDisplay();
+            n = p->count = doc->dyndraw(mode, gs);
+
+            bool stopped = gs.isStopping();
+            gs.endPaint();
+            recorder.clear();
+            if (!stopped && giAtomicLoad(&_secondaries) > 0) {
+                setProduct(p);
+            }
+        }
+        gs.setBatchMode(batchMode);
+        p->release();
+    }
+
+    return n;
+}
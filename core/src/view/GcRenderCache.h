@@ -0,0 +1,61 @@
+﻿//! \file GcRenderCache.h
+//! \brief 定义多个视图共享绘图结果的缓存类 GcRenderCache
+// Copyright (c) 2004-2015, https://github.com/rhcad/vgcore, BSD License
+
+#ifndef TOUCHVG_CORE_RENDERCACHE_H
+#define TOUCHVG_CORE_RENDERCACHE_H
+
+class MgShapeDoc;
+class GiGraphics;
+class GiCanvas;
+
+//! 多个视图共享绘图结果的缓存类
+/*! 主视图绘制文档时，在输出到画布的同时将每个图形的绘图指令按世界坐标记录下来。
+    放大镜等次级视图的显示窗口在记录范围内时，按自己的坐标系重放这些指令，
+    不再遍历文档、裁剪和生成曲线。文档或绘制模式改变后由下一次绘制重新记录。
+    没有次级视图时主视图直接绘制，不记录。
+    本类的函数可在多个绘图线程中调用。
+    \ingroup CORE_VIEW
+ */
+class GcRenderCache
+{
+public:
+    GcRenderCache();
+    ~GcRenderCache();
+
+    //! 在画布上绘制文档，返回绘制的图形数，不能开始绘制则返回-1
+    /*! \param doc 前端文档
+        \param mode 绘制模式，0-正常，2-放缩中
+        \param gs 图形显示对象，本函数负责 beginPaint 和 endPaint
+        \param canvas 画布
+        \param secondary 是否为次级视图，次级视图优先重放已有的记录
+     */
+    int draw(MgShapeDoc* doc, int mode, GiGraphics& gs, GiCanvas* canvas, bool secondary);
+
+    //! 释放记录的绘图结果
+    void clear();
+
+    //! 创建次级视图后调用，此后主视图绘制时才记录
+    void addSecondary();
+
+    //! 销毁次级视图后调用，没有次级视图时释放记录的绘图结果
+    void removeSecondary();
+
+    //! 返回重放的次数
+    int getReplayCount() const { return (int)_replays; }
+
+private:
+    struct Product;
+    Product* acquire(const MgShapeDoc* doc, int mode, const GiGraphics& gs, bool secondary);
+    void setProduct(Product* p);
+
+    Product*        _product;
+    volatile long   _locker;
+    volatile long   _replays;
+    volatile long   _secondaries;
+
+    GcRenderCache(const GcRenderCache&);
+    void operator=(const GcRenderCache&);
+};
+
+#endif // TOUCHVG_CORE_RENDERCACHE_H
@@ -0,0 +1,84 @@
+﻿// GcRenderService.cpp: 实现在工作线程中绘制静态图形的渲染服务类 GcRenderService
+// Copyright (c) 2004-2015, https://github.com/rhcad/vgcore, BSD License
+
+#include "GcRenderService.h"
+#include "gicoreview.h"
+#include "gigraph.h"
+#include "gilock.h"
+#include "mgtrace.h"
+
+GcRenderService::GcRenderService(GiCoreView* coreView, GiView* view, GiRenderTarget* target)
+    : _coreView(coreView), _view(view), _target(target)
+    , _requests(0), _quit(0), _locker(0), _rendering(NULL), _frames(0)
+{
+}
+
+GcRenderService::~GcRenderService()
+{
+    giAtomicIncrement(&_quit);
+    requestRender();
+    _thread.join();
+}
+
+bool GcRenderService::start()
+{
+    return _thread.start(threadProc, this);
+}
+
+void GcRenderService::requestRender()
+{
+    giAtomicIncrement(&_requests);
+    {
+        GiSpinLock lock(&_locker);
+        if (_rendering) {
+            _rendering->stopDrawing(true);
+        }
+    }
+    _signal.set();
+}
+
+void GcRenderService::threadProc(void* param)
+{
+    GcRenderService* p = (GcRenderService*)param;
+    
+    for (;;) {
+        p->_signal.wait();      // 多次请求合并为一次唤醒
+        if (giAtomicLoad(&p->_quit))
+            break;
+        p->render();
+    }
+}
+
+void GcRenderService::render()
+{
+    MG_TRACE_SCOPE("renderService");
+    long request = giAtomicLoad(&_requests);
+    long doc = _coreView->acquireFrontDoc();
+    long hGs = _coreView->acquireGraphics(_view);
+    GiGraphics* gs = GiGraphics::fromHandle(hGs);
+    
+    if (doc && gs) {
+        {
+            GiSpinLock lock(&_locker);
+            _rendering = gs;
+        }
+        if (request == giAtomicLoad(&_requests)) {  // 否则已过时，等待下一次唤醒
+            int frame = ++_frames;
+            GiCanvas* canvas = _target->beginFrame(frame, gs->xf().getWidth(), gs->xf().getHeight());
+            
+            if (canvas) {
+                int n = _coreView->drawAll(doc, hGs, canvas);
+                bool completed = (n >= 0 && !gs->isStopping()
+                                  && request == giAtomicLoad(&_requests));
+                _target->endFrame(canvas, frame, completed, n);
+            }
+        }
+        {
+            GiSpinLock lock(&_locker);
+            _rendering = NULL;
+        }
+        gs->stopDrawing(false);
+    }
+    _coreView->releaseGraphics(hGs);
+    MgCoreView::releaseDoc(doc);
+}
@@ -0,0 +1,53 @@
+﻿//! \file GcRenderService.h
+//! \brief 定义在工作线程中绘制静态图形的渲染服务类 GcRenderService
+// Copyright (c) 2004-2015, https://github.com/rhcad/vgcore, BSD License
+
+#ifndef TOUCHVG_CORE_RENDERSERVICE_H
+#define TOUCHVG_CORE_RENDERSERVICE_H
+
+#include "githread.h"
+
+class GiCoreView;
+class GiView;
+class GiGraphics;
+struct GiRenderTarget;
+
+//! 在工作线程中绘制静态图形的渲染服务类
+/*! 每次提交前端文档或坐标系(requestRender)后，由工作线程将前端文档绘制到
+    GiRenderTarget 提供的离屏画布上，完成后通知宿主显示。绘制中收到新的请求时
+    立即中断当前绘制(结果标记为未完成)，再按最新的文档和坐标系重新绘制。
+    UI线程只需处理手势和动态图形。
+    \ingroup CORE_VIEW
+ */
+class GcRenderService
+{
+public:
+    GcRenderService(GiCoreView* coreView, GiView* view, GiRenderTarget* target);
+    ~GcRenderService();         //!< 中断绘制并等待工作线程结束
+
+    bool start();               //!< 启动工作线程
+    void requestRender();       //!< 请求按最新的前端文档重新绘制，中断正在进行的绘制
+
+    GiCoreView* coreView() const { return _coreView; }
+    GiView* view() const { return _view; }
+
+private:
+    static void threadProc(void* param);
+    void render();
+
+    GiCoreView*     _coreView;
+    GiView*         _view;
+    GiRenderTarget* _target;
+    GiThread        _thread;
+    GiSignal        _signal;
+    volatile long   _requests;      // 累计的绘制请求数，绘制完成时未变才有效
+    volatile long   _quit;
+    volatile long   _locker;        // 保护 _rendering
+    GiGraphics*     _rendering;     // 正在绘制所用的图形显示对象
+    int             _frames;        // 已开始绘制的帧数，仅在工作线程中使用
+
+    GcRenderService(const GcRenderService&);
+    void operator=(const GcRenderService&);
+};
+
+#endif // TOUCHVG_CORE_RENDERSERVICE_H
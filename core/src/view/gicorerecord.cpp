@@ -4,6 +4,7 @@
 
 #include "gicoreview.h"
 #include "gicoreviewimpl.h"
+#include "giatomicptr.h"
 #include <algorithm>
 
 static const bool VG_PRETTY = false;
@@ -256,19 +257,17 @@ bool GiCoreView::onResume(long curTick)
 //
 
 struct GiPlaying::Impl {
-    MgShapeDoc* frontDoc_;
+    GiAtomicRefPtr<MgShapeDoc>  frontDoc;   // 由绘图线程无锁获取
     MgShapeDoc* backDoc;
-    MgShapes*   front_;
+    GiAtomicRefPtr<MgShapes>    front;
     MgShapes*   back;
+    MgShapes*   spare;                      // 已不再显示的列表，由 rebuildBackShapes() 轮换复用
     int         tag;
     bool        doubleSided;
     volatile long stopping;
     
-    Impl(int tag, bool doubleSided) : frontDoc_(NULL), backDoc(NULL)
-        , front_(NULL), back(NULL), tag(tag), doubleSided(doubleSided), stopping(0) {}
-    
-    MgShapeDoc*& frontDoc() { return doubleSided ? frontDoc_ : backDoc; }
-    MgShapes*& frontShapes() { return doubleSided ? front_ : back; }
+    Impl(int tag, bool doubleSided) : backDoc(NULL)
+        , back(NULL), spare(NULL), tag(tag), doubleSided(doubleSided), stopping(0) {}
 };
 
 GiPlaying* GiPlaying::create(MgCoreView* v, int tag, bool doubleSided)
@@ -300,10 +299,11 @@ GiPlaying::~GiPlaying()
 
 void GiPlaying::clear()
 {
-    MgObject::release_pointer(impl->frontDoc_);
+    impl->frontDoc.reset(NULL);
     MgObject::release_pointer(impl->backDoc);
-    MgObject::release_pointer(impl->front_);
+    impl->front.reset(NULL);
     MgObject::release_pointer(impl->back);
+    MgObject::release_pointer(impl->spare);
 }
 
 int GiPlaying::getTag() const
@@ -323,10 +323,13 @@ bool GiPlaying::isStopping() const
 
 long GiPlaying::acquireFrontDoc()
 {
-    if (!impl->frontDoc())
+    MgShapeDoc* doc = impl->doubleSided ? impl->frontDoc.acquire() : impl->backDoc;
+    
+    if (!doc)
         return 0;
-    impl->frontDoc()->addRef();
-    return impl->frontDoc()->toHandle();
+    if (!impl->doubleSided)
+        doc->addRef();
+    return doc->toHandle();
 }
 
 void GiPlaying::releaseDoc(long doc)
@@ -346,19 +349,24 @@ MgShapeDoc* GiPlaying::getBackDoc()
 void GiPlaying::submitBackDoc()
 {
     if (impl->doubleSided) {
-        MgObject::release_pointer(impl->frontDoc_);
-        if (impl->backDoc) {
-            impl->frontDoc_ = impl->backDoc->shallowCopy();
-        }
+        impl->frontDoc.reset(impl->backDoc ? impl->backDoc->shallowCopy() : NULL);
     }
 }
 
+void GiPlaying::clearFrontDoc()
+{
+    impl->frontDoc.reset(NULL);
+}
+
 long GiPlaying::acquireFrontShapes()
 {
-    if (!impl->frontShapes())
+    MgShapes* shapes = impl->doubleSided ? impl->front.acquire() : impl->back;
+    
+    if (!shapes)
         return 0;
-    impl->frontShapes()->addRef();
-    return impl->frontShapes()->toHandle();
+    if (!impl->doubleSided)
+        shapes->addRef();
+    return shapes->toHandle();
 }
 
 void GiPlaying::releaseShapes(long shapes)
@@ -385,11 +393,26 @@ MgShapes* GiPlaying::getBackShapes(bool needClear)
     return impl->back;
 }
 
+MgShapes* GiPlaying::rebuildBackShapes()
+{
+    MgShapes* old = impl->back;         // 提交后仍在显示，下次再复用
+    
+    impl->back = impl->spare;
+    impl->spare = old;
+    if (impl->back && !impl->back->beginReuse()) {
+        MgObject::release_pointer(impl->back);
+    }
+    if (!impl->back) {
+        impl->back = MgShapes::create();
+    }
+    return impl->back;
+}
+
 void GiPlaying::submitBackShapes()
 {
+    impl->back->endReuse();
     if (impl->doubleSided) {
-        MgObject::release_pointer(impl->front_);
-        impl->front_ = impl->back;
-        impl->front_->addRef();
+        impl->back->addRef();
+        impl->front.reset(impl->back);
     }
 }
@@ -13,9 +13,58 @@
 #include "svgcanvas.h"
 #include "../corever.h"
 #include "mgimagesp.h"
+#include "mgdocpatch.h"
 #include "mglocal.h"
+#include "mgtrace.h"
 #include <sstream>
 
+#ifdef MG_ALLOC_COUNTER                 // 编译时定义此宏以统计堆分配次数，用于检查手势热点路径
+#include <new>
+#include <stdlib.h>
+
+#if __cplusplus >= 201103L
+#define MG_NEW_THROW
+#define MG_DEL_THROW noexcept
+#else
+#define MG_NEW_THROW throw(std::bad_alloc)
+#define MG_DEL_THROW throw()
+#endif
+
+static volatile long _allocCount = 0;   // 全局 operator new 调用次数
+
+static void* countedAlloc(size_t size)
+{
+    giAtomicIncrement(&_allocCount);
+    void* p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(size_t size) MG_NEW_THROW { return countedAlloc(size); }
+void* operator new[](size_t size) MG_NEW_THROW { return countedAlloc(size); }
+void operator delete(void* p) MG_DEL_THROW { free(p); }
+void operator delete[](void* p) MG_DEL_THROW { free(p); }
+
+long GiCoreView::getAllocCount() { return _allocCount; }
+#else
+long GiCoreView::getAllocCount() { return -1; }
+#endif // MG_ALLOC_COUNTER
+
+bool GiCoreView::dumpTrace(MgStringCallback* c)
+{
+#ifdef MG_TRACE
+    std::string json;
+    mgTraceDump(json);
+    if (c) {
+        c->onGetString(json.c_str());
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
 static volatile long _viewCount = 0;    // 总视图数
 static int _dpi = 96;                   // 屏幕分辨率，在 GiCoreView::onSize() 中应用到新视图中
 float GiCoreViewImpl::_factor = 1.0f;   // 屏幕放大系数，Android高清屏可用
@@ -35,11 +84,9 @@ GcBaseView::GcBaseView(MgView* mgview, GiView *view)
 
 GiCoreViewImpl::GiCoreViewImpl(GiCoreView* owner, bool useCmds)
     : _cmds(NULL), curview(NULL), refcount(1)
-    , gestureHandler(0), regenPending(-1), appendPending(-1), redrawPending(-1)
-    , changeCount(0), drawCount(0), stopping(0)
+    , gestureHandler(0)
+    , changeCount(0), drawCount(0), stopping(0), pager(NULL), journal(NULL)
 {
-    memset(&gsBuf, 0, sizeof(gsBuf));
-    memset((void*)&gsUsed, 0, sizeof(gsUsed));
     
     drawing = GiPlaying::create(NULL, GiPlaying::kDrawingTag, useCmds);
     backDoc = drawing->getBackDoc();
@@ -64,11 +111,11 @@ GiCoreViewImpl::GiCoreViewImpl(GiCoreView* owner, bool useCmds)
 
 GiCoreViewImpl::~GiCoreViewImpl()
 {
-    for (unsigned i = 0; i < sizeof(gsBuf)/sizeof(gsBuf[0]); i++) {
-        delete gsBuf[i];
-    }
+    stopRenderServices(NULL, NULL);
     MgObject::release_pointer(_cmds);
     delete _gcdoc;
+    delete pager;
+    delete journal;
 }
 
 void GiCoreViewImpl::resetOptions()
@@ -232,6 +279,7 @@ GiCoreView::~GiCoreView()
 {
     LOGD("GiCoreView %p destroyed, refcount=%ld, n=%ld",
          this, impl->refcount, giAtomicDecrement(&_viewCount));
+    impl->stopRenderServices(this, NULL);
     if (--impl->refcount == 0) {
         delete impl;
     }
@@ -366,6 +414,7 @@ void GiCoreView::releaseShapesArray(const mgvector<long>& shapes)
 
 bool GiCoreView::submitBackDoc(GiView* view, bool changed)
 {
+    MG_TRACE_SCOPE("submitBackDoc");
     GcBaseView* aview = impl->_gcdoc->findView(view);
     bool ret = !aview || aview == impl->curview;
     
@@ -384,6 +433,7 @@ bool GiCoreView::submitBackDoc(GiView* view, bool changed)
     if (aview) {
         aview->submitBackXform();
     }
+    impl->requestRender(ret ? NULL : view);     // 新文档需所有视图重绘，否则只是本视图的坐标系改变
     
     return ret;
 }
@@ -417,6 +467,7 @@ void GiCoreView::createMagnifierView_(GiView* newview, GiView* mainView)
 
     if (refview && newview && !impl->_gcdoc->findView(newview)) {
         new GcMagnifierView(impl, newview, refview);
+        impl->renderCache.addSecondary();
     }
 }
 
@@ -424,10 +475,14 @@ void GiCoreView::destoryView(GiView* view)
 {
     GcBaseView* aview = impl->_gcdoc->findView(view);
 
+    impl->stopRenderServices(NULL, view);
     if (aview && impl->_gcdoc->removeView(aview)) {
         if (impl->curview == aview) {
             impl->curview = impl->_gcdoc->firstView();
         }
+        if (dynamic_cast<GcMagnifierView*>(aview)) {
+            impl->renderCache.removeSecondary();
+        }
         delete aview;
     }
 }
@@ -451,8 +506,8 @@ void GiCoreView::setScreenDpi(int dpi, float factor)
 
 bool GiCoreView::isDrawing()
 {
-    for (unsigned i = 0; i < sizeof(impl->gsBuf)/sizeof(impl->gsBuf[0]); i++) {
-        if (impl->gsUsed[i] && impl->gsBuf[i] && impl->gsBuf[i]->isDrawing())
+    for (GcGraphicsPool::Node* node = impl->gsPool.first(); node; node = node->next) {
+        if (giAtomicLoad(&node->used) && node->gs->isDrawing())
             return true;
     }
     return false;
@@ -468,8 +523,8 @@ bool GiCoreView::isStopping()
     if (!impl || impl->stopping) {
         return true;
     }
-    for (unsigned i = 0; i < sizeof(impl->gsBuf)/sizeof(impl->gsBuf[0]); i++) {
-        if (impl->gsUsed[i] && impl->gsBuf[i] && impl->gsBuf[i]->isStopping())
+    for (GcGraphicsPool::Node* node = impl->gsPool.first(); node; node = node->next) {
+        if (giAtomicLoad(&node->used) && node->gs->isStopping())
             return true;
     }
     return false;
@@ -484,11 +539,9 @@ int GiCoreView::stopDrawing(bool stop)
     else while (impl->stopping > 0 && !stop)
         giAtomicDecrement(&impl->stopping);
     
-    for (unsigned i = 0; i < sizeof(impl->gsBuf)/sizeof(impl->gsBuf[0]); i++) {
-        if (impl->gsBuf[i]) {
-            impl->gsBuf[i]->stopDrawing(stop);
-            n++;
-        }
+    for (GcGraphicsPool::Node* node = impl->gsPool.first(); node; node = node->next) {
+        node->gs->stopDrawing(stop);
+        n++;
     }
     return n;
 }
@@ -499,36 +552,12 @@ long GiCoreView::acquireGraphics(GiView* view)
     if (!aview)
         return 0;
     
-    GiGraphics* gs = (GiGraphics*)0;
-    int i = sizeof(impl->gsBuf)/sizeof(impl->gsBuf[0]);
+    GcGraphicsPool::Node* node = impl->gsPool.acquire();
     
-    while (--i >= 0) {
-        if (!impl->gsUsed[i] && impl->gsBuf[i]) {
-            if (giAtomicIncrement(&impl->gsUsed[i]) == 1) {
-                gs = impl->gsBuf[i];
-                aview->copyGs(gs);
-                break;
-            } else {
-                giAtomicDecrement(&impl->gsUsed[i]);
-            }
-        }
-    }
-    if (!gs) {
-        gs = new GiGraphics();
-        aview->copyGs(gs);
-        for (i = 0; i < (int)(sizeof(impl->gsBuf)/sizeof(impl->gsBuf[0])); i++) {
-            if (!impl->gsBuf[i]) {
-                if (giAtomicIncrement(&impl->gsUsed[i]) == 1) {
-                    impl->gsBuf[i] = gs;
-                    break;
-                } else {
-                    giAtomicDecrement(&impl->gsUsed[i]);
-                }
-            }
-        }
-    }
+    aview->copyGs(node->gs);
+    node->secondary = dynamic_cast<GcMagnifierView*>(aview) != NULL;
     
-    return gs->toHandle();
+    return node->gs->toHandle();
 }
 
 void GiCoreView::releaseGraphics(long hGs)
@@ -538,13 +567,13 @@ void GiCoreView::releaseGraphics(long hGs)
     if (!gs) {
         return;
     }
-    for (unsigned i = 0; i < sizeof(impl->gsBuf)/sizeof(impl->gsBuf[0]); i++) {
-        if (impl->gsBuf[i] == gs) {
-            giAtomicDecrement(&impl->gsUsed[i]);
-            return;
-        }
+    GcGraphicsPool::Node* node = impl->gsPool.find(gs);
+    
+    if (node) {
+        giAtomicCompareAndSwap(&node->used, 0, 1);
+    } else {
+        delete gs;
     }
-    delete gs;
 }
 
 int GiCoreView::drawAll(GiView* view, GiCanvas* canvas) {
@@ -576,12 +605,17 @@ int GiCoreView::dynDraw(GiView* view, GiCanvas* canvas){
 
 int GiCoreView::drawAll(long doc, long hGs, GiCanvas* canvas)
 {
+    MG_TRACE_SCOPE("drawAll");
     int n = -1;
     GiGraphics* gs = GiGraphics::fromHandle(hGs);
     
-    if (doc && gs && gs->beginPaint(canvas)) {
-        n = MgShapeDoc::fromHandle(doc)->dyndraw(isZooming() ? 2 : 0, *gs);
-        gs->endPaint();
+    if (doc && gs) {
+        GcGraphicsPool::Node* node = impl->gsPool.find(gs);
+        bool secondary = node && node->secondary;
+        
+        gs->setBatchMode(impl->getOptionInt("batchDraw", 0));
+        n = impl->renderCache.draw(MgShapeDoc::fromHandle(doc), isZooming() ? 2 : 0,
+                                   *gs, canvas, secondary);
     }
 
     return n;
@@ -596,10 +630,12 @@ int GiCoreView::drawAll(const mgvector<long>& docs, long hGs, GiCanvas* canvas)
 int GiCoreView::drawAll(const mgvector<long>& docs, long hGs,
                         GiCanvas* canvas, const mgvector<int>& ignoreIds)
 {
+    MG_TRACE_SCOPE("drawAll");
     int n = -1;
     GiGraphics* gs = GiGraphics::fromHandle(hGs);
     
     if (gs && gs->beginPaint(canvas)) {
+        gs->setBatchMode(impl->getOptionInt("batchDraw", 0));
         if (impl->curview) {
             impl->curview->draw(*gs);
         }
@@ -631,6 +667,7 @@ int GiCoreView::drawAppend(long doc, long hGs, GiCanvas* canvas, int sid)
 
 int GiCoreView::dynDraw(long hShapes, long hGs, GiCanvas* canvas)
 {
+    MG_TRACE_SCOPE("dynDraw");
     int n = -1;
     GiGraphics* gs = GiGraphics::fromHandle(hGs);
     
@@ -646,6 +683,7 @@ int GiCoreView::dynDraw(long hShapes, long hGs, GiCanvas* canvas)
 
 int GiCoreView::dynDraw(const mgvector<long>& shapes, long hGs, GiCanvas* canvas)
 {
+    MG_TRACE_SCOPE("dynDraw");
     int n = -1;
     GiGraphics* gs = GiGraphics::fromHandle(hGs);
     
@@ -717,6 +755,8 @@ static void movePointInView(Point2d& pt, const Box2d& rect)
 bool GiCoreView::onGesture(GiView* view, GiGestureType type,
                            GiGestureState state, float x, float y, bool switchGesture)
 {
+    MG_TRACE_SCOPE("onGesture");
+    impl->scheduler.noteInput();
     DrawLocker locker(impl);
     GcBaseView* aview = impl->_gcdoc->findView(view);
     bool ret = false;
@@ -769,6 +809,8 @@ bool GiCoreView::onGesture(GiView* view, GiGestureType type,
 bool GiCoreView::twoFingersMove(GiView* view, GiGestureState state,
                                 float x1, float y1, float x2, float y2, bool switchGesture)
 {
+    MG_TRACE_SCOPE("twoFingersMove");
+    impl->scheduler.noteInput();
     DrawLocker locker(impl);
     GcBaseView* aview = impl->_gcdoc->findView(view);
     bool ret = false;
@@ -957,6 +999,29 @@ long GiCoreView::getDrawCount() const
     return impl->drawCount;
 }
 
+void GiCoreView::setFrameScheduling(bool enabled)
+{
+    impl->scheduler.setScheduled(enabled);
+    if (!enabled) {
+        impl->flushUpdates();
+    }
+}
+
+int GiCoreView::onFrameTick()
+{
+    return impl->flushUpdates();
+}
+
+float GiCoreView::onFramePresented()
+{
+    return impl->scheduler.notePresented();
+}
+
+int GiCoreView::getFrameStats(mgvector<float>& stats)
+{
+    return impl->scheduler.getStats(stats);
+}
+
 int GiCoreView::getSelectedShapeCount()
 {
     return impl->cmds()->getSelection(impl, 0, NULL);
@@ -1021,6 +1086,8 @@ bool GiCoreView::loadShapes(MgStorage* s, bool readOnly)
     if (cmd) cmd->cancel(impl->motion());
     
     impl->hideContextActions();
+    impl->closePager();
+    impl->closeJournal();
 
     if (s) {
         ret = impl->doc()->loadAll(impl->getShapeFactory(), s, impl->xform());
@@ -1060,15 +1127,60 @@ bool GiCoreView::submitDynamicShapes(GiView* view)
     return ret;
 }
 
+bool GiCoreView::startRenderService(GiView* view, GiRenderTarget* target)
+{
+    if (!target || !impl->_gcdoc->findView(view)) {
+        return false;
+    }
+    impl->stopRenderServices(NULL, view);
+    
+    GcRenderService* service = new GcRenderService(this, view, target);
+    
+    if (!service->start()) {
+        delete service;
+        return false;
+    }
+    impl->renderServices.push_back(service);
+    service->requestRender();
+    
+    return true;
+}
+
+void GiCoreView::stopRenderService(GiView* view)
+{
+    impl->stopRenderServices(NULL, view);
+}
+
+void GiCoreViewImpl::stopRenderServices(GiCoreView* owner, GiView* view)
+{
+    for (size_t i = renderServices.size(); i > 0; i--) {
+        GcRenderService* service = renderServices[i - 1];
+        if ((!owner || service->coreView() == owner) && (!view || service->view() == view)) {
+            renderServices.erase(renderServices.begin() + (i - 1));
+            delete service;
+        }
+    }
+}
+
+void GiCoreViewImpl::requestRender(GiView* view)
+{
+    for (size_t i = 0; i < renderServices.size(); i++) {
+        if (!view || renderServices[i]->view() == view) {
+            renderServices[i]->requestRender();
+        }
+    }
+}
+
 void GiCoreViewImpl::submitDynamicShapes(GcBaseView* v)
 {
     MgCommand* cmd = getCommand();
-    MgShapes* shapes = drawing->getBackShapes(true);
+    MgShapes* shapes = drawing->rebuildBackShapes();    // 复用上上帧的图形对象
     
     mgCopy(motion()->d2mgs, cmds()->displayMmToModel(1, v->frontGraph()));
     if (cmd) {
         if (!cmd->gatherShapes(motion(), shapes)) {
-            GiRecordCanvas canvas(shapes, v->xform(), cmd->isDrawingCommand() ? 0 : -1);
+            GiRecordCanvas canvas(shapes, v->xform(), cmd->isDrawingCommand() ? 0 : -1,
+                                  NULL, &recordBuffer);
             if (v->frontGraph()->beginPaint(&canvas)) {
                 cmd->draw(motion(), v->frontGraph());
                 if (!cmd->isDrawingCommand() && !isCommand("select")) {
@@ -1081,7 +1193,7 @@ void GiCoreViewImpl::submitDynamicShapes(GcBaseView* v)
             }
         }
     } else {
-        GiRecordCanvas canvas(shapes, v->xform(), -1);
+        GiRecordCanvas canvas(shapes, v->xform(), -1, NULL, &recordBuffer);
         if (v->frontGraph()->beginPaint(&canvas)) {
             getCmdSubject()->drawInSelectCommand(motion(), NULL, -1, v->frontGraph());
             v->frontGraph()->endPaint();
@@ -1123,6 +1235,57 @@ bool GiCoreView::setContent(const char* content, bool readOnly)
     return ret;
 }
 
+int GiCoreView::savePatch(long fromDoc, long toDoc, const char* filename)
+{
+    std::vector<unsigned char> patch;
+    int n = MgDocPatch::make(MgShapeDoc::fromHandle(fromDoc), MgShapeDoc::fromHandle(toDoc), patch);
+    FILE *fp = n < 0 ? NULL : mgopenfile(filename, "wb");
+    
+    if (!fp) {
+        LOGE("Fail to save patch: %s", filename);
+        return -1;
+    }
+    if (fwrite(&patch.front(), 1, patch.size(), fp) != patch.size()) {
+        n = -1;
+    }
+    fclose(fp);
+    LOGD("savePatch: %d changes, %d bytes", n, (int)patch.size());
+    
+    return n;
+}
+
+bool GiCoreView::applyPatch(const char* filename)
+{
+    FILE *fp = mgopenfile(filename, "rb");
+    if (!fp) {
+        LOGE("Fail to open patch: %s", filename);
+        return false;
+    }
+    
+    std::vector<unsigned char> patch;
+    unsigned char buf[4096];
+    size_t n;
+    
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        patch.insert(patch.end(), buf, buf + n);
+    }
+    fclose(fp);
+    
+    DrawLocker locker(impl);
+    MgCommand* cmd = impl->getCommand();
+    if (cmd) cmd->cancel(impl->motion());
+    impl->hideContextActions();
+    
+    bool ret = !patch.empty() && MgDocPatch::apply(impl->doc(), impl->getShapeFactory(),
+                                                   &patch.front(), (int)patch.size());
+    if (ret) {
+        impl->regenAll(true);
+    }
+    LOGD("applyPatch: %d, %s", ret, filename);
+    
+    return ret;
+}
+
 bool GiCoreView::loadFromFile(const char* vgfile, bool readOnly)
 {
     if (*vgfile == '{') {
@@ -1144,6 +1307,229 @@ bool GiCoreView::loadFromFile(const char* vgfile, bool readOnly)
     return ret;
 }
 
+//! 异步加载时分批提交图形的辅助类，提交间隔成倍增长以使浅拷贝的总开销与图形数成正比
+class GiLoadingProgress : public MgLoadProgress
+{
+public:
+    enum { kFirstBatch = 64 };  //!< 首批图形数，使第一屏尽快显示
+    
+    GiLoadingProgress(GiPlaying* p, MgLoadingCallback* c) : _playing(p), _c(c), _shapes(NULL)
+        , _count(0), _total(0), _doneCount(0), _doneTotal(0), _next(kFirstBatch) {}
+    
+    virtual bool isStopping() { return _playing->isStopping(); }
+    
+    virtual void onShapeLoaded(MgShapes* shapes, int count, int total) {
+        if (_shapes != shapes) {        // 开始加载下一个图层
+            _shapes = shapes;
+            _doneCount += _count;
+            _doneTotal += _total;
+        }
+        _count = count;
+        _total = total;
+        if (_doneCount + _count >= _next) {
+            submit();
+            _next *= 2;
+        }
+    }
+    
+    void submit() {
+        _playing->submitBackDoc();
+        if (_c) {
+            _c->onLoadingProgress(_playing->toHandle(), _doneCount + _count,
+                                  mgMax(_doneTotal + _total, _doneCount + _count));
+        }
+    }
+    
+private:
+    GiPlaying*          _playing;
+    MgLoadingCallback*  _c;
+    MgShapes*           _shapes;
+    int                 _count, _total;
+    int                 _doneCount, _doneTotal;
+    int                 _next;
+};
+
+long GiCoreView::beginLoading()
+{
+    GiPlaying* p = GiPlaying::create(NULL, GiPlaying::kLoadingTag);
+    impl->addPlaying(p);
+    return p->toHandle();
+}
+
+bool GiCoreView::loadInBackground(long playh, const char* vgfile, MgLoadingCallback* c)
+{
+    MG_TRACE_SCOPE("loadInBackground");
+    GiPlaying* p = GiPlaying::fromHandle(playh);
+    FILE *fp = NULL;
+    MgJsonStorage s;
+    MgStorage* storage = NULL;
+    
+    if (!p || !vgfile) {
+        return false;
+    }
+    if (*vgfile == '{') {
+        storage = s.storageForRead(vgfile);
+    }
+    else if ((fp = mgopenfile(vgfile, "rt")) != NULL) {
+        storage = s.storageForRead(fp);
+        fclose(fp);
+    }
+    else {
+        LOGE("Fail to open file: %s", vgfile);
+    }
+    
+    MgShapeDoc* doc = p->getBackDoc();
+    GiLoadingProgress progress(p, c);
+    
+    doc->setLoadProgress(&progress);
+    bool ret = storage && !p->isStopping() && doc->loadAll(impl->getShapeFactory(), storage, NULL);
+    doc->setLoadProgress(NULL);
+    
+    if (ret) {
+        progress.submit();
+    } else {
+        p->stop();              // 失败或已取消，endLoading() 将丢弃结果
+    }
+    LOGD("loadInBackground: %d, %d shapes", ret, doc->getShapeCount());
+    
+    return ret;
+}
+
+bool GiCoreView::endLoading(long playh, bool readOnly)
+{
+    GiPlaying* p = GiPlaying::fromHandle(playh);
+    bool ret = p && p->getTag() == GiPlaying::kLoadingTag && !p->isStopping();
+    
+    if (ret) {
+        DrawLocker locker(impl);
+        MgCommand* cmd = impl->getCommand();
+        if (cmd) cmd->cancel(impl->motion());
+        impl->hideContextActions();
+        
+        MgShapeDoc* doc = impl->doc();
+        impl->closePager();
+        p->clearFrontDoc();     // 图形不再共享时才能直接转移，否则会复制
+        p->getBackDoc()->moveShapesTo(doc);
+        doc->setReadOnly(readOnly);
+        if (impl->xform() && !doc->zoomToInitial(impl->xform())) {
+            impl->xform()->setModelTransform(doc->modelTransform());
+            impl->xform()->zoomTo(doc->getPageRectW());
+        }
+        LOGD("Load %d shapes and %d layers in background",
+             doc->getShapeCount(), doc->getLayerCount());
+        
+        impl->regenAll(true);
+        if (impl->curview && impl->cmds()) {
+            impl->getCmdSubject()->onDocLoaded(impl->motion(), false);
+        }
+    }
+    if (p) {
+        impl->removePlaying(p);
+        p->release(NULL);
+        if (!ret) {
+            impl->regenAll(false);
+        }
+    }
+    
+    return ret;
+}
+
+bool GiCoreView::loadPagedFile(const char* vgfile, int maxShapes)
+{
+    DrawLocker locker(impl);
+    MgCommand* cmd = impl->getCommand();
+    if (cmd) cmd->cancel(impl->motion());
+    impl->hideContextActions();
+    
+    MgDocPager* pager = new MgDocPager();
+    bool ret = pager->open(vgfile)
+        && pager->loadSkeleton(impl->doc(), impl->getShapeFactory(), impl->xform());
+    
+    if (ret) {
+        impl->closePager();
+        impl->pager = pager;
+        pager->setLimits(0.5f, maxShapes);
+        impl->doc()->setReadOnly(true);     // 只有部分图形在内存中，不能编辑和保存
+        LOGD("Page %d shapes and %d layers", pager->getShapeCount(), impl->doc()->getLayerCount());
+        
+        impl->regenAll(true);               // 在 DrawLocker 结束时加载显示范围内的图形
+        if (impl->curview && impl->cmds()) {
+            impl->getCmdSubject()->onDocLoaded(impl->motion(), false);
+        }
+    }
+    else {
+        delete pager;
+    }
+    
+    return ret;
+}
+
+bool GiCoreView::openAutoSave(const char* vgfile)
+{
+    DrawLocker locker(impl);
+    MgCommand* cmd = impl->getCommand();
+    if (cmd) cmd->cancel(impl->motion());
+    impl->hideContextActions();
+    impl->closePager();
+    impl->closeJournal();
+    
+    MgDocJournal* journal = new MgDocJournal();
+    bool ret = journal->open(vgfile, impl->doc(), impl->getShapeFactory(), impl->xform());
+    
+    if (ret) {
+        impl->journal = journal;
+        LOGD("Load %d shapes and %d layers with autosave log",
+             impl->doc()->getShapeCount(), impl->doc()->getLayerCount());
+    }
+    else {
+        delete journal;
+    }
+    impl->regenAll(true);
+    if (impl->curview && impl->cmds()) {
+        impl->getCmdSubject()->onDocLoaded(impl->motion(), false);
+    }
+    
+    return ret;
+}
+
+int GiCoreView::autoSave(long doc)
+{
+    const MgShapeDoc* p = MgShapeDoc::fromHandle(doc);
+    return impl->journal && p ? impl->journal->save(p) : -1;
+}
+
+void GiCoreView::closeAutoSave(bool compact)
+{
+    if (impl->journal) {
+        impl->journal->close(compact);
+        impl->closeJournal();
+    }
+}
+
+int GiCoreView::updatePaging()
+{
+    return impl->updatePaging();
+}
+
+int GiCoreViewImpl::updatePaging()
+{
+    enum { kMaxKeep = 20 };
+    const MgShape* shapes[kMaxKeep];
+    int ids[kMaxKeep];
+    int n = 0;
+    
+    if (!pager || !xform()) {
+        return 0;
+    }
+    if (_cmds) {                            // 不释放选中的图形
+        n = getSelection()->getSelection(this, kMaxKeep, shapes);
+        for (int i = 0; i < n; i++) {
+            ids[i] = shapes[i]->getID();
+        }
+    }
+    return pager->update(doc(), this, xform()->getWndRectM(), ids, n);
+}
+
 bool GiCoreView::saveToFile(long doc, const char* vgfile, bool pretty)
 {
     FILE *fp = doc ? mgopenfile(vgfile, "wt") : NULL;
@@ -1698,7 +2084,7 @@ bool GiCoreViewImpl::getOptionBool(const char* name, bool defValue)
 int GiCoreViewImpl::getOptionInt(const char* name, int defValue)
 {
     int ret = defValue;
-    OPT_MAP::const_iterator kv = options.find(std::string(name));
+    OPT_MAP::const_iterator kv = options.find(name);
     
     if (kv != options.end()
         && MgJsonStorage::parseInt(kv->second.second.c_str(), defValue)) {
@@ -1711,7 +2097,7 @@ int GiCoreViewImpl::getOptionInt(const char* name, int defValue)
 float GiCoreViewImpl::getOptionFloat(const char* name, float defValue)
 {
     float ret = defValue;
-    OPT_MAP::const_iterator kv = options.find(std::string(name));
+    OPT_MAP::const_iterator kv = options.find(name);
     
     if (kv != options.end()
         && MgJsonStorage::parseFloat(kv->second.second.c_str(), defValue)) {
@@ -1726,7 +2112,7 @@ void GiCoreViewImpl::setOptionBool(const char* name, bool value)
     if (!value && strchr(name, '_')) {
         options.erase(name);
     } else {
-        options[std::string(name)] = OPT_VALUE(kOptBool, std::string(value ? "1" : "0"));
+        options[internOptionName(name)] = OPT_VALUE(kOptBool, std::string(value ? "1" : "0"));
     }
 }
 
@@ -1734,25 +2120,25 @@ void GiCoreViewImpl::setOptionInt(const char* name, int value)
 {
     std::stringstream ss;
     ss << value;
-    options[std::string(name)] = OPT_VALUE(kOptInt, ss.str());
+    options[internOptionName(name)] = OPT_VALUE(kOptInt, ss.str());
 }
 
 void GiCoreViewImpl::setOptionFloat(const char* name, float value)
 {
     std::stringstream ss;
     ss << value;
-    options[std::string(name)] = OPT_VALUE(kOptFloat, ss.str());
+    options[internOptionName(name)] = OPT_VALUE(kOptFloat, ss.str());
 }
 
 const char* GiCoreViewImpl::getOptionString(const char* name)
 {
-    OPT_MAP::const_iterator kv = options.find(std::string(name));
+    OPT_MAP::const_iterator kv = options.find(name);
     return kv != options.end() ? kv->second.second.c_str() : "";
 }
 
 void GiCoreViewImpl::setOptionString(const char* name, const char* text)
 {
-    options[std::string(name)] = OPT_VALUE(kOptStr, text ? text : "");
+    options[internOptionName(name)] = OPT_VALUE(kOptStr, text ? text : "");
 }
 
 void GiCoreView::setOptionBool(const char* name, bool value)
@@ -1796,19 +2182,19 @@ void GiCoreView::traverseOptions(MgOptionCallback* c)
     GiCoreViewImpl::OPT_MAP::const_iterator kv = impl->getOptions().begin();
     
     for (; kv != impl->getOptions().end(); ++kv) {
-        const std::string& name = kv->first;
+        const char* name = kv->first;
         switch (kv->second.first) {
             case GiCoreViewImpl::kOptBool:
-                c->onGetOptionBool(name.c_str(), impl->getOptionBool(name.c_str(), false));
+                c->onGetOptionBool(name, impl->getOptionBool(name, false));
                 break;
             case GiCoreViewImpl::kOptInt:
-                c->onGetOptionInt(name.c_str(), impl->getOptionInt(name.c_str(), 0));
+                c->onGetOptionInt(name, impl->getOptionInt(name, 0));
                 break;
             case GiCoreViewImpl::kOptFloat:
-                c->onGetOptionFloat(name.c_str(), impl->getOptionFloat(name.c_str(), 0));
+                c->onGetOptionFloat(name, impl->getOptionFloat(name, 0));
                 break;
             case GiCoreViewImpl::kOptStr:
-                c->onGetOptionString(name.c_str(), impl->getOptionString(name.c_str()));
+                c->onGetOptionString(name, impl->getOptionString(name));
                 break;
             default:
                 break;
@@ -8,18 +8,26 @@
 #include "gicoreviewdata.h"
 #include "GcShapeDoc.h"
 #include "GcMagnifierView.h"
+#include "GcRenderCache.h"
+#include "GcFrameScheduler.h"
+#include "GcRenderService.h"
 #include "mgcmdmgr.h"
 #include "mgcmdmgrfactory.h"
 #include "cmdsubject.h"
 #include "mgjsonstorage.h"
 #include "mgstorage.h"
 #include "girecordshape.h"
+#include "gibuffercanvas.h"
 #include "mgshapet.h"
 #include "cmdbasic.h"
 #include "mglayer.h"
 #include "mgcomposite.h"
 #include "mglog.h"
+#include "mgdocpager.h"
+#include "mgdocjournal.h"
 #include <map>
+#include <set>
+#include <vector>
 
 #define CALL_VIEW(func) if (curview) curview->func
 #define CALL_VIEW2(func, v) curview ? curview->func : v
@@ -64,6 +72,71 @@ public:
     }
 };
 
+//! 供多个绘图线程使用的 GiGraphics 对象池
+/*! 对象链表只在头部无锁添加，直到析构才删除结点，因此可以无锁遍历。
+    获取时用比较交换占用空闲对象，都被占用时新建对象，数量不设上限。
+ */
+class GcGraphicsPool
+{
+public:
+    struct Node {
+        GiGraphics*     gs;
+        volatile long   used;
+        bool            secondary;      // 是否为放大镜等次级视图所用
+        Node*           next;
+    };
+    
+    GcGraphicsPool() : _head(0) {}
+    ~GcGraphicsPool() {
+        for (Node* node = first(); node; ) {
+            Node* next = node->next;
+            delete node->gs;
+            delete node;
+            node = next;
+        }
+    }
+    
+    Node* first() const {
+        Node* p;
+        *(long*)&p = giAtomicLoad(const_cast<volatile long*>(&_head));
+        return p;
+    }
+    
+    //! 占用一个空闲对象，没有则新建
+    /*! 绘图对象在 beginPaint 中不清除中断标记，占用时清除上次使用者留下的中断请求 */
+    Node* acquire() {
+        for (Node* node = first(); node; node = node->next) {
+            if (giAtomicCompareAndSwap(&node->used, 1, 0)) {
+                node->gs->stopDrawing(false);
+                return node;
+            }
+        }
+        Node* node = new Node();
+        node->gs = new GiGraphics();
+        node->used = 1;
+        node->secondary = false;
+        
+        long head, value = 0;
+        *(Node**)&value = node;
+        do {
+            head = giAtomicLoad(&_head);
+            *(long*)&node->next = head;
+        } while (!giAtomicCompareAndSwap(&_head, value, head));
+        
+        return node;
+    }
+    
+    //! 查找对象所在的结点
+    Node* find(const GiGraphics* gs) const {
+        Node* node = first();
+        for (; node && node->gs != gs; node = node->next) {}
+        return node;
+    }
+    
+private:
+    volatile long   _head;
+};
+
 //! GiCoreView实现类
 class GiCoreViewImpl : public GiCoreViewData, public MgShapeFactory
 {
@@ -77,9 +150,7 @@ public:
     int             gestureHandler;
     MgJsonStorage   defaultStorage;
     
-    long            regenPending;
-    long            appendPending;
-    long            redrawPending;
+    GcFrameScheduler scheduler;     // 合并 regenAll、regenAppend 和 redraw 请求
     volatile long   changeCount;
     volatile long   drawCount;
     
@@ -87,18 +158,28 @@ public:
     
     typedef enum { kOptBool, kOptInt, kOptFloat, kOptStr } OPT_TYPE;
     typedef std::pair<OPT_TYPE, std::string> OPT_VALUE;
-    typedef std::map<std::string, OPT_VALUE> OPT_MAP;
+    struct OptNameLess {
+        bool operator()(const char* a, const char* b) const { return strcmp(a, b) < 0; }
+    };
+    typedef std::map<const char*, OPT_VALUE, OptNameLess> OPT_MAP;   // 键为 optionNames 中的名称
     OPT_MAP         options;
+    std::set<std::string>   optionNames;    // 驻留的选项名，查找选项时无需构造字符串
     
-    GiGraphics*     gsBuf[20];
-    volatile long   gsUsed[20];
+    GcGraphicsPool  gsPool;
+    GcRenderCache   renderCache;        // 主视图记录的绘图结果，供次级视图重放
+    GiBufferCanvas  recordBuffer;       // 录制动态图形的命令缓冲，各帧复用其容量
+    std::vector<GcRenderService*> renderServices;   // 在工作线程中绘制静态图形，在主线程中增删
     volatile long   stopping;
+    MgDocPager*     pager;          // 分页加载超大文档，为NULL表示完整加载
+    MgDocJournal*   journal;        // 增量自动保存的日志，为NULL表示未启用
     
 public:
     GiCoreViewImpl(GiCoreView* owner, bool useCmds = true);
     ~GiCoreViewImpl();
     
     void submitBackXform() { CALL_VIEW(submitBackXform()); }
+    void stopRenderServices(GiCoreView* owner, GiView* view);   // 停止匹配的渲染服务，参数为NULL表示任意
+    void requestRender(GiView* view);                           // 请求渲染服务重绘，view为NULL表示所有视图
     
     MgMotion* motion() { return &_motion; }
     MgCmdManager* cmds() const { return _cmds; }
@@ -109,6 +190,9 @@ public:
     GiTransform* xform() const { return CALL_VIEW2(xform(), NULL); }
     Matrix2d& modelTransform() const { return backDoc->modelTransform(); }
     void* createRegenLocker();
+    int updatePaging();
+    void closePager() { delete pager; pager = NULL; }
+    void closeJournal() { delete journal; journal = NULL; }
     
     int getNewShapeID() { return _cmds->getNewShapeID(); }
     void setNewShapeID(int sid) { _cmds->setNewShapeID(sid); }
@@ -210,6 +294,27 @@ public:
         return ret;
     }
     
+    int removeShapes(const mgvector<int>& ids) {
+        mgvector<int> valid(ids.count());
+        int n = 0, ret = 0;
+        
+        hideContextActions();
+        for (int i = 0; i < ids.count(); i++) {
+            const MgShape* shape = shapes()->findShape(ids.get(i));
+            if (shape && !shape->shapec()->getFlag(kMgNoDel)) {
+                valid.set(n++, shape->getID());
+            }
+        }
+        if (n > 0) {
+            mgvector<int> sids(valid.address(), n);
+            
+            ret = getCmdSubject()->onShapesDeleted(motion(), sids);
+            ret += shapes()->removeShapes(n, sids.address());
+            CALL_VIEW(deviceView()->shapesDeleted(sids));
+        }
+        return ret;
+    }
+    
     bool useFinger() {
         return CALL_VIEW2(deviceView()->useFinger(), true);
     }
@@ -243,59 +348,89 @@ public:
         regenAppend(sp->getID());
     }
     
-    void redraw(bool changed = true) {
-        if (redrawPending >= 0) {
-            redrawPending += changed ? 100 : 1;
+    void shapesAdded(const mgvector<int>& ids) {
+        if (ids.count() > 0) {
+            getCmdSubject()->onShapesAdded(motion(), ids);
+            if (ids.count() == 1) {
+                regenAppend(ids.get(0));
+            } else {
+                regenAll(true);
+            }
         }
-        else {
+    }
+    
+    void redraw(bool changed = true) {
+        if (!scheduler.requestRedraw(changed)) {
             CALL_VIEW(deviceView()->redraw(changed));
         }
     }
     
     void regenAll(bool changed) {
-        if (regenPending >= 0) {
-            regenPending += changed ? 100 : 1;
-        }
-        if (regenPending < 0) {
-            bool zooming = CALL_VIEW2(isZooming(), false);
-            CALL_VIEW(deviceView()->regenAll(changed));
-            if (changed) {
-                for (int i = 0; i < _gcdoc->getViewCount(); i++) {
-                    if (_gcdoc->getView(i) != curview && !zooming) {
-                        _gcdoc->getView(i)->deviceView()->regenAll(changed);
-                    }
-                    _gcdoc->getView(i)->checkZoomTimes();
-                }
-                CALL_VIEW(deviceView()->contentChanged());
-            }
-            else {
-                for (int i = 0; i < _gcdoc->getViewCount(); i++) {
-                    if (_gcdoc->getView(i) != curview && !zooming) {
-                        _gcdoc->getView(i)->deviceView()->redraw(changed);
-                    }
-                    _gcdoc->getView(i)->checkZoomTimes();
-                }
-            }
+        if (!scheduler.requestRegen(changed)) {
+            emitRegenAll(changed);
         }
     }
     
     void regenAppend(int sid, long playh = 0) {
-        if (appendPending >= 0 && sid) {
-            if (appendPending == 0 || appendPending == sid) {
-                appendPending = sid;
-            }
-            else if (appendPending > 0 && appendPending != sid) {
-                regenPending += 100;
+        if (sid && !scheduler.requestAppend(sid, playh)) {
+            emitRegenAppend(sid, playh);
+        }
+    }
+    
+    //! 发出累积的更新，返回更新类型
+    int flushUpdates() {
+        GcFrameScheduler::Pending p;
+        
+        if (!scheduler.take(p)) {
+            return GcFrameScheduler::kNoUpdate;
+        }
+        if (p.regen) {
+            emitRegenAll(p.regen > 1);
+        }
+        else if (p.sid) {
+            emitRegenAppend(p.sid, p.playh);
+            if (p.redraw) {     // 未按帧调度时一并重绘动态图形
+                CALL_VIEW(deviceView()->redraw(p.redraw > 1));
             }
         }
-        if (appendPending < 0 && sid) {
-            CALL_VIEW(deviceView()->regenAppend(sid, playh));
+        else {
+            CALL_VIEW(deviceView()->redraw(p.redraw > 1));
+        }
+        return p.type();
+    }
+    
+    void emitRegenAll(bool changed) {
+        if (pager && updatePaging() > 0) {
+            changed = true;
+        }
+        bool zooming = CALL_VIEW2(isZooming(), false);
+        CALL_VIEW(deviceView()->regenAll(changed));
+        if (changed) {
             for (int i = 0; i < _gcdoc->getViewCount(); i++) {
-                if (_gcdoc->getView(i) != curview)
-                    _gcdoc->getView(i)->deviceView()->regenAppend(sid, playh);
+                if (_gcdoc->getView(i) != curview && !zooming) {
+                    _gcdoc->getView(i)->deviceView()->regenAll(changed);
+                }
+                _gcdoc->getView(i)->checkZoomTimes();
             }
             CALL_VIEW(deviceView()->contentChanged());
         }
+        else {
+            for (int i = 0; i < _gcdoc->getViewCount(); i++) {
+                if (_gcdoc->getView(i) != curview && !zooming) {
+                    _gcdoc->getView(i)->deviceView()->redraw(changed);
+                }
+                _gcdoc->getView(i)->checkZoomTimes();
+            }
+        }
+    }
+    
+    void emitRegenAppend(int sid, long playh) {
+        CALL_VIEW(deviceView()->regenAppend(sid, playh));
+        for (int i = 0; i < _gcdoc->getViewCount(); i++) {
+            if (_gcdoc->getView(i) != curview)
+                _gcdoc->getView(i)->deviceView()->regenAppend(sid, playh);
+        }
+        CALL_VIEW(deviceView()->contentChanged());
     }
     
     bool setView(GcBaseView* view) {
@@ -319,6 +454,9 @@ public:
     const char* getOptionString(const char* name);
     void setOptionString(const char* name, const char* text);
     OPT_MAP& getOptions() { return options; }
+    const char* internOptionName(const char* name) {
+        return optionNames.insert(std::string(name)).first->c_str();
+    }
     void resetOptions();
     
 private:
@@ -359,38 +497,11 @@ class DrawLocker
 {
     GiCoreViewImpl* _impl;
 public:
-    DrawLocker(GiCoreViewImpl* impl) : _impl(NULL) {
-        if (impl->regenPending < 0
-            && impl->appendPending < 0
-            && impl->redrawPending < 0)
-        {
-            _impl = impl;
-            _impl->regenPending = 0;
-            _impl->appendPending = 0;
-            _impl->redrawPending = 0;
-        }
-    }
+    DrawLocker(GiCoreViewImpl* impl) : _impl(impl->scheduler.beginBatch() ? impl : NULL) {}
     
     ~DrawLocker() {
-        if (!_impl) {
-            return;
-        }
-        long regenPending = _impl->regenPending;
-        long appendPending = _impl->appendPending;
-        long redrawPending = _impl->redrawPending;
-        
-        _impl->regenPending = -1;
-        _impl->appendPending = -1;
-        _impl->redrawPending = -1;
-        
-        if (regenPending > 0) {
-            _impl->regenAll(regenPending >= 100);
-        }
-        else if (appendPending > 0) {
-            _impl->regenAppend((int)appendPending);
-        }
-        else if (redrawPending > 0) {
-            _impl->redraw(redrawPending >= 100);
+        if (_impl && _impl->scheduler.endBatch()) {
+            _impl->flushUpdates();
         }
     }
 };
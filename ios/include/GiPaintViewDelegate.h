@@ -23,6 +23,7 @@
 - (void)onShapesRecorded:(NSDictionary *)info;  //!< 录制的通知
 - (void)onShapeWillDelete:(id)num;      //!< 图形将删除的通知, [NSNumber intValue]
 - (void)onShapeDeleted:(id)num;         //!< 图形已删除的通知, [NSNumber intValue]
+- (void)onShapesDeleted:(NSArray *)ids; //!< 批量删除图形的通知, NSNumber数组, 未实现则逐个调用 onShapeDeleted:
 - (BOOL)onShapeDblClick:(NSDictionary *)info;   //!< 图形双击编辑的通知
 - (BOOL)onShapeClicked:(NSDictionary *)info;    //!< 图形点击的通知
 
@@ -77,6 +77,8 @@ private:
     GiShapeAdapterCallback* _callback;
     UIBezierPath    *_container;
     UIBezierPath    *_path;
-    UIColor         *_lineColor;
-    UIColor         *_fillColor;
+    UIColor         *_lineColor;    // 当前路径的描边颜色
+    UIColor         *_fillColor;    // 当前路径的填充颜色
+    UIColor         *_penColor;     // 最近设置的画笔颜色
+    UIColor         *_brushColor;   // 最近设置的画刷颜色
 };
@@ -538,6 +538,7 @@ GiColor CGColorToGiColor(CGColorRef color);
         _adapter->respondsTo.didShapesRecorded |= [d respondsToSelector:@selector(onShapesRecorded:)];
         _adapter->respondsTo.didShapeWillDelete |= [d respondsToSelector:@selector(onShapeWillDelete:)];
         _adapter->respondsTo.didShapeDeleted |= [d respondsToSelector:@selector(onShapeDeleted:)];
+        _adapter->respondsTo.didShapesDeleted |= [d respondsToSelector:@selector(onShapesDeleted:)];
         _adapter->respondsTo.didShapeDblClick |= [d respondsToSelector:@selector(onShapeDblClick:)];
         _adapter->respondsTo.didShapeClicked |= [d respondsToSelector:@selector(onShapeClicked:)];
         _adapter->respondsTo.didGestureShouldBegin |= [d respondsToSelector:@selector(onGestureShouldBegin:)];
@@ -8,6 +8,7 @@
 GiShapeAdapter::GiShapeAdapter(GiShapeAdapterCallback* shapeCallback)
     : _callback(shapeCallback), _container([UIBezierPath bezierPath]), _path(nil)
     , _lineColor([UIColor blackColor]), _fillColor([UIColor clearColor])
+    , _penColor(_lineColor), _brushColor(_fillColor)
 {
 }
 
@@ -29,20 +30,31 @@ bool GiShapeAdapter::hasFillColor() const
 void GiShapeAdapter::fireLastPath()
 {
     if (!CGRectIsEmpty(_container.bounds)) {
-        _callback->addPath(_container, _lineColor, _fillColor);
+        UIBezierPath *last = _container;
+        NSInteger count = 10;
+        CGFloat pattern[count];
+        CGFloat phase = 0;
+        
+        _callback->addPath(last, _lineColor, _fillColor);
         _container = [UIBezierPath bezierPath];
+        
+        // 画笔只在改变时才设置，新路径沿用上一路径的线宽和线型
+        [last getLineDash:pattern count:&count phase:&phase];
+        _container.lineWidth = last.lineWidth;
+        _container.lineCapStyle = last.lineCapStyle;
+        [_container setLineDash:(count > 0 ? pattern : NULL) count:count phase:phase];
     }
 }
 
 void GiShapeAdapter::checkNeedFire(bool stroke, bool fill)
 {
-    if (!stroke && hasLineColor()) {
-        fireLastPath();
-        _lineColor = [UIColor clearColor];
-    }
-    if (!fill && hasFillColor()) {
+    UIColor *lineColor = stroke ? _penColor : [UIColor clearColor];
+    UIColor *fillColor = fill ? _brushColor : [UIColor clearColor];
+    
+    if (lineColor != _lineColor || fillColor != _fillColor) {
         fireLastPath();
-        _fillColor = [UIColor clearColor];
+        _lineColor = lineColor;
+        _fillColor = fillColor;
     }
 }
 
@@ -68,6 +80,7 @@ void GiShapeAdapter::setPen(int argb, float width, int style, float phase, float
                                   green:GiCanvasAdapter::colorPart(argb, 1)
                                    blue:GiCanvasAdapter::colorPart(argb, 0)
                                   alpha:alpha]);
+    _penColor = _lineColor;
     if (width > 0) {
         _container.lineWidth = width;
     }
@@ -110,6 +123,7 @@ void GiShapeAdapter::setBrush(int argb, int style)
                                       green:GiCanvasAdapter::colorPart(argb, 1)
                                        blue:GiCanvasAdapter::colorPart(argb, 0)
                                       alpha:alpha]);
+        _brushColor = _fillColor;
     }
 }
 
@@ -142,6 +156,7 @@ bool GiShapeAdapter::clipRect(float x, float y, float w, float h)
 
 void GiShapeAdapter::drawLine(float x1, float y1, float x2, float y2)
 {
+    checkNeedFire(true, false);
     UIBezierPath *path = [UIBezierPath bezierPath];
     [path moveToPoint:CGPointMake(x1, y1)];
     [path addLineToPoint:CGPointMake(x2, y2)];
@@ -726,6 +726,38 @@ void GiViewAdapter::shapeDeleted(int sid)
     }
 }
 
+void GiViewAdapter::shapesDeleted(const mgvector<int>& ids)
+{
+    if (!respondsTo.didShapesDeleted && ![_view respondsToSelector:@selector(onShapesDeleted:)]) {
+        GiView::shapesDeleted(ids);
+        return;
+    }
+    
+    NSMutableArray *arr = [NSMutableArray arrayWithCapacity:ids.count()];
+    
+    for (int i = 0; i < ids.count(); i++) {
+        [arr addObject:@(ids.get(i))];
+    }
+    for (size_t i = 0; i < delegates.size(); i++) {
+        if ([delegates[i] respondsToSelector:@selector(onShapesDeleted:)]) {
+            [delegates[i] onShapesDeleted:arr];
+        }
+        else if ([delegates[i] respondsToSelector:@selector(onShapeDeleted:)]) {
+            for (NSNumber *obj in arr) {
+                [delegates[i] onShapeDeleted:obj];
+            }
+        }
+    }
+    if ([_view respondsToSelector:@selector(onShapesDeleted:)]) {
+        [_view performSelector:@selector(onShapesDeleted:) withObject:arr];
+    }
+    else if ([_view respondsToSelector:@selector(onShapeDeleted:)]) {
+        for (NSNumber *obj in arr) {
+            [_view performSelector:@selector(onShapeDeleted:) withObject:obj];
+        }
+    }
+}
+
 bool GiViewAdapter::shapeDblClick(int type, int sid, int tag)
 {
     NSDictionary *info = @{ @"id" : @(sid),
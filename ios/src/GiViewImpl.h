@@ -86,6 +86,7 @@ public:
         unsigned int didShapesRecorded:1;
         unsigned int didShapeWillDelete:1;
         unsigned int didShapeDeleted:1;
+        unsigned int didShapesDeleted:1;
         unsigned int didShapeDblClick:1;
         unsigned int didShapeClicked:1;
         unsigned int didGestureShouldBegin:1;
@@ -140,6 +141,7 @@ public:
     virtual void zoomChanged();
     virtual void shapeWillDelete(int sid);
     virtual void shapeDeleted(int sid);
+    virtual void shapesDeleted(const mgvector<int>& ids);
     virtual bool shapeDblClick(int type, int sid, int tag);
     virtual bool shapeClicked(int type, int sid, int tag, float x, float y);
     virtual void showMessage(const char* text);